@@ -6,7 +6,7 @@
 -- Author     : Philemon Orphee Favrod  <philemon.favrod@epfl.ch>
 -- Company    : 
 -- Created    : 2016-03-10
--- Last update: 2017-02-21
+-- Last update: 2026-10-19
 -- Platform   : 
 -- Standard   : VHDL'87
 -------------------------------------------------------------------------------
@@ -20,6 +20,10 @@
 -- 2016-04-25  1.1      P. Favrod       Debuged
 -- 2016-05-23  1.2      P. Favrod       Increased bandwidth + fifo sync @ VFP
 -- 2016-05-29  1.3      P. Favrod       Added MSB to FIFO + removed wrfull
+-- 2026-10-19  1.4                      DMA_DATA_WIDTH generic + underflow counter
+-- 2026-10-19  1.5                      Performance counters
+-- 2026-10-19  1.6                      Pixel replication (1x/2x/4x)
+-- 2026-10-19  1.7                      Pending/active start address + status
 -------------------------------------------------------------------------------
 -- Register Memory Mapping
 -- +-------+--------+-----+-----+-----+-----+----+-----------+
@@ -37,6 +41,26 @@
 -- +-------+--------+---------------------------+------------+
 -- | 5     | R/W    |           |       FB_BURST_COUNT       |
 -- +-------+--------+-----------+----------------------------+
+-- | 6     | RO     |          UNDERFLOW_COUNT               |
+-- +-------+--------+----------------------------------------+
+-- | 7     | RO     |           |       DMA_DATA_WIDTH       |
+-- +-------+--------+-----------+----------------------------+
+-- | 8     | RO     |          BURSTS                        |
+-- +-------+--------+----------------------------------------+
+-- | 9     | RO     |          STALL_CYCLES                  |
+-- +-------+--------+----------------------------------------+
+-- | 10    | R/W    |           |       MIN_FIFO_FILL        |
+-- +-------+--------+-----------+----------------------------+
+-- | 11    | RO     |          FRAMES                        |
+-- +-------+--------+----------------------------------------+
+-- | 12    | R/W    |           |   V_SCALE   |   H_SCALE    |
+-- +-------+--------+-----------+--------------+--------------+
+-- | 13    | RO     |          LINE_BUFFER_DEPTH             |
+-- +-------+--------+----------------------------------------+
+-- | 14    | RO     |          ACTIVE_START_ADDRESS          |
+-- +-------+--------+----------------------------------------+
+-- | 15    | RO     |                    | ENABLED | PENDING |
+-- +-------+--------+--------------------+---------+---------+
 --
 -- Command register:
 -- [0] Enable DMA loop
@@ -44,6 +68,44 @@
 -- [2] Enable interrupts
 -- [3] Disable interrupts
 -- [4] Acknowledge IRQ
+--
+-- FB_BURST_COUNT is in words of the DMA master (DMA_DATA_WIDTH bits, i.e.
+-- DMA_DATA_WIDTH / 32 pixels). Lines must be a whole number of bursts.
+--
+-- UNDERFLOW_COUNT counts the pixel clock cycles where the video interface
+-- wanted a pixel while the FIFO was empty. It is free running (the reader
+-- computes differences) so that it can be safely moved across clock domains
+-- in Gray code.
+--
+-- Performance counters (clk domain, free running like UNDERFLOW_COUNT):
+-- BURSTS       bursts issued on the DMA master.
+-- STALL_CYCLES cycles a burst request waited on am_waitrequest.
+-- FRAMES       frames completely read from memory.
+-- MIN_FIFO_FILL is the lowest FIFO fill level (in words of 4 pixels) seen
+-- when issuing a burst, from the second line of a frame on (the FIFO starts
+-- every frame empty). Writing any value sets it back to the FIFO depth.
+--
+-- Page flips: FRAME_START_ADDRESS is the pending start address. It is
+-- committed to ACTIVE_START_ADDRESS at the start of the next frame (on
+-- frame_sync, or when the DMA is enabled), and the frame is read from there.
+-- Writing FRAME_START_ADDRESS sets STATUS.PENDING, which is cleared once the
+-- flip has landed: the previous buffer is not read anymore. A flip can be
+-- queued at any time, without waiting for the interrupt. The other frame
+-- registers are taken at the start of each frame too, but aren't tracked.
+--
+-- Pixel replication: H_SCALE (bits [1:0]) and V_SCALE (bits [3:2]) are the
+-- log2 of the horizontal and vertical replication factors (0: 1x, 1: 2x,
+-- 2 or 3: 4x). FRAME_PIXEL_PER_LINE and FRAME_LINES_PER_FRAME are the size of
+-- the frame in memory, the video interface gets FRAME_PIXEL_PER_LINE * H x
+-- FRAME_LINES_PER_FRAME * V pixels. Each line is read once from memory: the
+-- pixel clock side repeats every pixel H times, and keeps the line in a line
+-- buffer of LINE_BUFFER_DEPTH pixels to show it V - 1 more times. With
+-- V_SCALE /= 0, FRAME_PIXEL_PER_LINE must not exceed LINE_BUFFER_DEPTH.
+-- Like the other registers, the scale is taken at the start of a frame.
+--
+-- DMA_DATA_WIDTH is 128 or 64 bits. With 64 bits, two words are gathered
+-- before being written to the FIFO, so lines must have a multiple of 4
+-- pixels (as with 128 bits).
 -- 
 library ieee;
 use ieee.std_logic_1164.all;
@@ -51,6 +113,10 @@ use ieee.numeric_std.all;
 
 entity framebuffer_manager is
 
+    generic(
+        DMA_DATA_WIDTH    : positive := 128;   -- 64 or 128
+        LINE_BUFFER_DEPTH : positive := 512);  -- power of 2, in pixels
+
     port(
         clk    : in std_logic;
         pixclk : in std_logic;
@@ -68,7 +134,7 @@ entity framebuffer_manager is
         am_waitrequest   : in  std_logic;
         am_burstcount    : out std_logic_vector(10 downto 0);
         am_read          : out std_logic;
-        am_readdata      : in  std_logic_vector(127 downto 0);
+        am_readdata      : in  std_logic_vector(DMA_DATA_WIDTH - 1 downto 0);
         am_readdatavalid : in  std_logic;
 
         frame_sync : in std_logic;
@@ -86,14 +152,51 @@ architecture rtl of framebuffer_manager is
 
     constant MAX_BURST_COUNT : integer := 1024;
 
+    constant PIX_PER_WORD        : positive := DMA_DATA_WIDTH / 32;
+    constant BYTES_PER_WORD      : positive := DMA_DATA_WIDTH / 8;
+    constant WORDS_PER_FIFO_WORD : positive := 4 / PIX_PER_WORD;  -- the FIFO takes 4 pixels
+
     constant FRAME_START_ADDRESS_REGNO   : std_logic_vector(as_address'range) := std_logic_vector(to_unsigned(0, as_address'length));
     constant FRAME_PIXEL_PER_LINE_REGNO  : std_logic_vector(as_address'range) := std_logic_vector(to_unsigned(1, as_address'length));
     constant FRAME_LINES_PER_FRAME_REGNO : std_logic_vector(as_address'range) := std_logic_vector(to_unsigned(2, as_address'length));
     constant FRAME_EOL_BYTE_OFFSET_REGNO : std_logic_vector(as_address'range) := std_logic_vector(to_unsigned(3, as_address'length));
     constant FB_COMMAND_REGNO            : std_logic_vector(as_address'range) := std_logic_vector(to_unsigned(4, as_address'length));
     constant FB_BURST_COUNT_REGNO        : std_logic_vector(as_address'range) := std_logic_vector(to_unsigned(5, as_address'length));
+    constant UNDERFLOW_COUNT_REGNO       : std_logic_vector(as_address'range) := std_logic_vector(to_unsigned(6, as_address'length));
+    constant DMA_DATA_WIDTH_REGNO        : std_logic_vector(as_address'range) := std_logic_vector(to_unsigned(7, as_address'length));
+    constant BURSTS_REGNO                : std_logic_vector(as_address'range) := std_logic_vector(to_unsigned(8, as_address'length));
+    constant STALL_CYCLES_REGNO          : std_logic_vector(as_address'range) := std_logic_vector(to_unsigned(9, as_address'length));
+    constant MIN_FIFO_FILL_REGNO         : std_logic_vector(as_address'range) := std_logic_vector(to_unsigned(10, as_address'length));
+    constant FRAMES_REGNO                : std_logic_vector(as_address'range) := std_logic_vector(to_unsigned(11, as_address'length));
+    constant SCALE_REGNO                 : std_logic_vector(as_address'range) := std_logic_vector(to_unsigned(12, as_address'length));
+    constant LINE_BUFFER_DEPTH_REGNO     : std_logic_vector(as_address'range) := std_logic_vector(to_unsigned(13, as_address'length));
+    constant ACTIVE_START_ADDRESS_REGNO  : std_logic_vector(as_address'range) := std_logic_vector(to_unsigned(14, as_address'length));
+    constant STATUS_REGNO                : std_logic_vector(as_address'range) := std_logic_vector(to_unsigned(15, as_address'length));
+
+    function gray_to_binary(g : std_logic_vector) return unsigned is
+        variable b : unsigned(g'range);
+    begin
+        b(g'high) := g(g'high);
+        for i in g'high - 1 downto g'low loop
+            b(i) := b(i + 1) xor g(i);
+        end loop;
+        return b;
+    end function gray_to_binary;
+
+    -- Replication factor of a log2 scale field (3 saturates to 4x)
+    function scale_factor(log2 : std_logic_vector(1 downto 0)) return positive is
+    begin
+        case log2 is
+            when "00"   => return 1;
+            when "01"   => return 2;
+            when others => return 4;
+        end case;
+    end function scale_factor;
 
     signal start_address                         : integer;
+    signal active_start_address                  : integer;
+    signal flip_pending                          : boolean;
+    signal frame_start                           : boolean;
     signal current_address                       : integer;
     signal pix_per_line, pix_per_line_copy       : integer;
     signal num_lines, num_lines_copy             : integer;
@@ -102,6 +205,7 @@ architecture rtl of framebuffer_manager is
     signal burst_count, burst_count_copy         : integer;
     signal irq_enabled                           : boolean;
     signal irq_acknowledged                      : boolean;
+    signal scale, scale_copy                     : std_logic_vector(3 downto 0);
 
     signal burst_counter : integer range 1 to MAX_BURST_COUNT;
     signal pix_counter   : integer;
@@ -120,6 +224,40 @@ architecture rtl of framebuffer_manager is
     signal fifo_freew            : integer range 0 to INTERNAL_FIFO_DEPTH;
     signal fifo_empty            : std_logic;
     signal fifo_large_enough     : boolean;
+
+    -- Underflow counter, in the pixclk domain then synchronized in Gray code
+    signal underflow_count_pix : unsigned(31 downto 0);
+    signal underflow_gray_pix  : std_logic_vector(31 downto 0);
+    signal underflow_gray_meta : std_logic_vector(31 downto 0);
+    signal underflow_gray_sync : std_logic_vector(31 downto 0);
+
+    -- Performance counters
+    signal burst_issued        : boolean;
+    signal frame_done          : boolean;
+    signal bursts              : unsigned(31 downto 0);
+    signal stall_cycles        : unsigned(31 downto 0);
+    signal frames              : unsigned(31 downto 0);
+    signal min_fifo_fill       : integer range 0 to INTERNAL_FIFO_DEPTH;
+    signal min_fifo_fill_clear : boolean;
+
+    -- Internal copy of am_read
+    signal am_read_i : std_logic;
+
+    -- Pixel replication (pixclk domain)
+    type line_buffer_t is array (0 to LINE_BUFFER_DEPTH - 1) of std_logic_vector(23 downto 0);
+    signal line_buffer         : line_buffer_t;
+    signal line_buffer_q       : std_logic_vector(23 downto 0);
+    signal h_scale_pix         : positive range 1 to 4;
+    signal v_scale_pix         : positive range 1 to 4;
+    signal line_pixels_pix     : integer;
+    signal h_rep               : integer range 0 to 3;
+    signal v_rep               : integer range 0 to 3;
+    signal line_pos            : integer;
+    signal line_x, line_x_next : integer range 0 to LINE_BUFFER_DEPTH - 1;
+    signal replay              : boolean;
+    signal pixel_taken         : boolean;
+    signal last_rep            : boolean;
+    signal src_valid_i         : std_logic;
 begin
     dc_video_fifo_inst : entity work.dc_video_fifo port map (
         aclr    => fifo_clr,
@@ -132,36 +270,188 @@ begin
         rdempty => fifo_empty,
         wrusedw => fifo_usedw);
 
-    fifo_write        <= am_readdatavalid and not fifo_clr when current_state = MEMREAD else '0';
-    fifo_read         <= src_ready and not fifo_empty;
+    fifo_read         <= '1' when pixel_taken and last_rep and not replay else '0';
     fifo_clr          <= '1'                               when current_state = IDLE    else '0';
     fifo_freew        <= INTERNAL_FIFO_DEPTH - to_integer(unsigned(fifo_usedw));
-    fifo_large_enough <= fifo_freew >= burst_count_copy;
-    fifo_data_in      <= am_readdata(119 downto 96) & am_readdata(87 downto 64) & am_readdata(55 downto 32) & am_readdata(23 downto 0);
+    fifo_large_enough <= fifo_freew * WORDS_PER_FIFO_WORD >= burst_count_copy;
+
+    -- A 128-bit word holds the 4 pixels of a FIFO word.
+    g_data_128 : if DMA_DATA_WIDTH = 128 generate
+        fifo_write   <= am_readdatavalid and not fifo_clr when current_state = MEMREAD else '0';
+        fifo_data_in <= am_readdata(119 downto 96) & am_readdata(87 downto 64) & am_readdata(55 downto 32) & am_readdata(23 downto 0);
+    end generate g_data_128;
+
+    -- A 64-bit word holds 2 pixels: keep the first one of each pair of words.
+    g_data_64 : if DMA_DATA_WIDTH = 64 generate
+        signal first_pixels : std_logic_vector(47 downto 0);
+        signal second_word  : boolean;
+    begin
+        fifo_write   <= am_readdatavalid and not fifo_clr when current_state = MEMREAD and second_word else '0';
+        fifo_data_in <= am_readdata(55 downto 32) & am_readdata(23 downto 0) & first_pixels;
+
+        p_gather : process (clk, reset)
+        begin
+            if reset = '1' then
+                first_pixels <= (others => '0');
+                second_word  <= false;
+            elsif rising_edge(clk) then
+                if current_state = IDLE then
+                    second_word <= false;
+                elsif current_state = MEMREAD and am_readdatavalid = '1' then
+                    if not second_word then
+                        first_pixels <= am_readdata(55 downto 32) & am_readdata(23 downto 0);
+                    end if;
+                    second_word <= not second_word;
+                end if;
+            end if;
+        end process p_gather;
+    end generate g_data_64;
+
+    -- The first copy of a line comes from the FIFO, the others from the line
+    -- buffer.
+    replay      <= v_rep /= 0;
+    src_valid_i <= '1' when replay else not fifo_empty;
+    src_data    <= line_buffer_q when replay else
+                   fifo_data_out when fifo_empty = '0' else X"ff0000";
+    src_valid   <= src_valid_i;
+    pixel_taken <= src_ready = '1' and src_valid_i = '1';
+    last_rep    <= h_rep = h_scale_pix - 1;
+
+    -- The scale and line length are taken while the video interface is in its
+    -- vertical front porch: the FSM copies them in IDLE at the start of the
+    -- front porch, and they don't change until the next one.
+    p_scale_sync : process (pixclk, reset)
+    begin
+        if reset = '1' then
+            h_scale_pix     <= 1;
+            v_scale_pix     <= 1;
+            line_pixels_pix <= 0;
+        elsif rising_edge(pixclk) then
+            if frame_sync = '1' then
+                h_scale_pix     <= scale_factor(scale_copy(1 downto 0));
+                v_scale_pix     <= scale_factor(scale_copy(3 downto 2));
+                line_pixels_pix <= pix_per_line_copy;
+            end if;
+        end if;
+    end process p_scale_sync;
+
+    -- line_pos is the position in the source line, line_x its address in the
+    -- line buffer (it wraps on lines longer than the buffer, which are only
+    -- allowed without vertical replication). The line buffer is read at the
+    -- next address, so that its registered output is the pixel at line_x.
+    line_x_next <= 0 when frame_sync = '1' else
+                   0 when pixel_taken and last_rep and line_pos >= line_pixels_pix - 1 else
+                   (line_x + 1) mod LINE_BUFFER_DEPTH when pixel_taken and last_rep else
+                   line_x;
+
+    p_replicate : process (pixclk, reset)
+    begin
+        if reset = '1' then
+            h_rep    <= 0;
+            v_rep    <= 0;
+            line_x   <= 0;
+            line_pos <= 0;
+        elsif rising_edge(pixclk) then
+            line_x <= line_x_next;
+
+            if frame_sync = '1' then
+                h_rep    <= 0;
+                v_rep    <= 0;
+                line_pos <= 0;
+
+            elsif pixel_taken then
+                if not last_rep then
+                    h_rep <= h_rep + 1;
+                else
+                    h_rep <= 0;
+
+                    if line_pos < line_pixels_pix - 1 then
+                        line_pos <= line_pos + 1;
+                    else
+                        line_pos <= 0;
+
+                        if v_rep < v_scale_pix - 1 then
+                            v_rep <= v_rep + 1;
+                        else
+                            v_rep <= 0;
+                        end if;
+                    end if;
+                end if;
+            end if;
+        end if;
+    end process p_replicate;
+
+    -- The line buffer keeps the pixels of the first copy of each line.
+    p_line_buffer : process (pixclk)
+    begin
+        if rising_edge(pixclk) then
+            if fifo_read = '1' then
+                line_buffer(line_x) <= fifo_data_out;
+            end if;
+
+            line_buffer_q <= line_buffer(line_x_next);
+        end if;
+    end process p_line_buffer;
+
+    -- Count the pixels the video interface asked for while the FIFO was empty.
+    p_underflow_count : process (pixclk, reset)
+    begin
+        if reset = '1' then
+            underflow_count_pix <= (others => '0');
+            underflow_gray_pix  <= (others => '0');
+        elsif rising_edge(pixclk) then
+            if src_ready = '1' and src_valid_i = '0' then
+                underflow_count_pix <= underflow_count_pix + 1;
+            end if;
 
-    src_data  <= fifo_data_out when fifo_empty = '0' else X"ff0000";
-    src_valid <= not fifo_empty;
+            underflow_gray_pix <= std_logic_vector(underflow_count_pix xor shift_right(underflow_count_pix, 1));
+        end if;
+    end process p_underflow_count;
+
+    -- Only one bit of a Gray counter changes at a time: it can be synchronized
+    -- bit by bit.
+    p_underflow_sync : process (clk, reset)
+    begin
+        if reset = '1' then
+            underflow_gray_meta <= (others => '0');
+            underflow_gray_sync <= (others => '0');
+        elsif rising_edge(clk) then
+            underflow_gray_meta <= underflow_gray_pix;
+            underflow_gray_sync <= underflow_gray_meta;
+        end if;
+    end process p_underflow_sync;
 
     p_as_write : process (clk, reset)
     begin
         if reset = '1' then
-            start_address    <= 0;
-            pix_per_line     <= 0;
-            num_lines        <= 0;
-            eol_byte_offset  <= 0;
-            burst_count      <= 4;
-            enabled          <= false;
-            irq_enabled      <= false;
-            irq_acknowledged <= false;
+            start_address       <= 0;
+            pix_per_line        <= 0;
+            num_lines           <= 0;
+            eol_byte_offset     <= 0;
+            burst_count         <= 4;
+            scale               <= (others => '0');
+            enabled             <= false;
+            irq_enabled         <= false;
+            irq_acknowledged    <= false;
+            min_fifo_fill_clear <= false;
+            flip_pending        <= false;
 
         elsif rising_edge(clk) then
 
-            irq_acknowledged <= false;
+            irq_acknowledged    <= false;
+            min_fifo_fill_clear <= false;
+
+            -- The FSM took the start address. A write in the same cycle is
+            -- for the next frame (below).
+            if frame_start then
+                flip_pending <= false;
+            end if;
 
             if as_write = '1' then
                 case as_address is
                     when FRAME_START_ADDRESS_REGNO =>
                         start_address <= to_integer(unsigned(as_writedata));
+                        flip_pending  <= true;
 
                     when FRAME_PIXEL_PER_LINE_REGNO =>
                         pix_per_line <= to_integer(unsigned(as_writedata));
@@ -200,6 +490,12 @@ begin
                             burst_count <= to_integer(unsigned(as_writedata));
                         end if;
 
+                    when MIN_FIFO_FILL_REGNO =>
+                        min_fifo_fill_clear <= true;
+
+                    when SCALE_REGNO =>
+                        scale <= as_writedata(3 downto 0);
+
                     when others => null;
                 end case;
             end if;
@@ -233,6 +529,42 @@ begin
                     when FB_BURST_COUNT_REGNO =>
                         as_readdata <= std_logic_vector(to_unsigned(burst_count, as_readdata'length));
 
+                    when UNDERFLOW_COUNT_REGNO =>
+                        as_readdata <= std_logic_vector(gray_to_binary(underflow_gray_sync));
+
+                    when DMA_DATA_WIDTH_REGNO =>
+                        as_readdata <= std_logic_vector(to_unsigned(DMA_DATA_WIDTH, as_readdata'length));
+
+                    when BURSTS_REGNO =>
+                        as_readdata <= std_logic_vector(bursts);
+
+                    when STALL_CYCLES_REGNO =>
+                        as_readdata <= std_logic_vector(stall_cycles);
+
+                    when MIN_FIFO_FILL_REGNO =>
+                        as_readdata <= std_logic_vector(to_unsigned(min_fifo_fill, as_readdata'length));
+
+                    when FRAMES_REGNO =>
+                        as_readdata <= std_logic_vector(frames);
+
+                    when SCALE_REGNO =>
+                        as_readdata(3 downto 0) <= scale;
+
+                    when LINE_BUFFER_DEPTH_REGNO =>
+                        as_readdata <= std_logic_vector(to_unsigned(LINE_BUFFER_DEPTH, as_readdata'length));
+
+                    when ACTIVE_START_ADDRESS_REGNO =>
+                        as_readdata <= std_logic_vector(to_unsigned(active_start_address, as_readdata'length));
+
+                    when STATUS_REGNO =>
+                        if flip_pending then
+                            as_readdata(0) <= '1';
+                        end if;
+
+                        if enabled then
+                            as_readdata(1) <= '1';
+                        end if;
+
                     when others => null;
                 end case;
             end if;
@@ -241,15 +573,58 @@ begin
     end process p_as_read;
 
 
+    -- A burst is issued when its read request is not stalled, and a frame is
+    -- done when the FSM leaves MEMREAD for WAITSYNC (not on FLUSHBURST).
+    burst_issued <= am_read_i = '1' and am_waitrequest = '0';
+    frame_done   <= current_state = MEMREAD and am_readdatavalid = '1' and
+                    burst_counter = burst_count_copy and
+                    pix_counter >= pix_per_line_copy and line_counter >= num_lines_copy and
+                    frame_sync = '0';
+
+    p_counters : process (clk, reset)
+    begin
+        if reset = '1' then
+            bursts        <= (others => '0');
+            stall_cycles  <= (others => '0');
+            frames        <= (others => '0');
+            min_fifo_fill <= INTERNAL_FIFO_DEPTH;
+
+        elsif rising_edge(clk) then
+            if burst_issued then
+                bursts <= bursts + 1;
+            end if;
+
+            if am_read_i = '1' and am_waitrequest = '1' then
+                stall_cycles <= stall_cycles + 1;
+            end if;
+
+            if frame_done then
+                frames <= frames + 1;
+            end if;
+
+            if min_fifo_fill_clear then
+                min_fifo_fill <= INTERNAL_FIFO_DEPTH;
+            elsif burst_issued and line_counter > 1 and
+                to_integer(unsigned(fifo_usedw)) < min_fifo_fill then
+                min_fifo_fill <= to_integer(unsigned(fifo_usedw));
+            end if;
+        end if;
+    end process p_counters;
+
+    -- The frame registers are copied when a frame starts.
+    frame_start <= current_state = IDLE and enabled;
+
     p_fsm : process (clk, reset)
     begin
         if reset = '1' then
 
             current_address      <= 0;
+            active_start_address <= 0;
             pix_per_line_copy    <= 0;
             num_lines_copy       <= 0;
             eol_byte_offset_copy <= 0;
             burst_count_copy     <= 0;
+            scale_copy           <= (others => '0');
 
             burst_counter <= 1;
             pix_counter   <= 0;
@@ -268,15 +643,17 @@ begin
                 when IDLE =>
                     -- In IDLE state, wait for enabled to be high Then, save a copy of registers 
                     -- in shadow registers and start reading memory.
-                    if enabled then
+                    if frame_start then
                         current_address      <= start_address;
+                        active_start_address <= start_address;
                         pix_per_line_copy    <= pix_per_line;
                         num_lines_copy       <= num_lines;
                         eol_byte_offset_copy <= eol_byte_offset;
                         burst_count_copy     <= burst_count;
+                        scale_copy           <= scale;
                         current_state        <= MEMSTARTREAD;
 
-                        pix_counter  <= 4 * burst_count;  -- so that when pix_counter =
+                        pix_counter  <= PIX_PER_WORD * burst_count;  -- so that when pix_counter =
                                         -- pix_per_line_copy we are done
                         line_counter <= 1;
                     end if;
@@ -305,16 +682,16 @@ begin
                             -- If in the middle of a line, increment the pixel counter and the
                             -- address accordingly
                             if pix_counter < pix_per_line_copy then
-                                pix_counter     <= pix_counter + 4 * burst_count_copy;
-                                current_address <= current_address + 16 * burst_count_copy;
+                                pix_counter     <= pix_counter + PIX_PER_WORD * burst_count_copy;
+                                current_address <= current_address + BYTES_PER_WORD * burst_count_copy;
                                 current_state   <= MEMRESTARTREAD;
 
                             -- If at the end of a line, increment the line counter and the
                             -- address accordingly. Reset pix_counter too!
                             elsif line_counter < num_lines_copy then
                                 line_counter    <= line_counter + 1;
-                                pix_counter     <= 4 * burst_count_copy;
-                                current_address <= current_address + 16 * burst_count_copy + eol_byte_offset_copy;
+                                pix_counter     <= PIX_PER_WORD * burst_count_copy;
+                                current_address <= current_address + BYTES_PER_WORD * burst_count_copy + eol_byte_offset_copy;
                                 current_state   <= MEMRESTARTREAD;
 
                             -- If at the end of a frame, go back to WAITSYNC until blanking
@@ -358,6 +735,7 @@ begin
     end process p_fsm;
 
     am_address    <= std_logic_vector(to_unsigned(current_address, am_address'length));
-    am_read       <= '1' when fifo_large_enough and current_state = MEMSTARTREAD else '0';
+    am_read_i     <= '1' when fifo_large_enough and current_state = MEMSTARTREAD else '0';
+    am_read       <= am_read_i;
     am_burstcount <= std_logic_vector(to_unsigned(burst_count_copy, am_burstcount'length));
 end architecture;
@@ -47,6 +47,22 @@ add_fileset_file dc_video_fifo.vhd VHDL PATH dc_video_fifo.vhd
 #
 # parameters
 #
+add_parameter DMA_DATA_WIDTH POSITIVE 128
+set_parameter_property DMA_DATA_WIDTH DEFAULT_VALUE 128
+set_parameter_property DMA_DATA_WIDTH DISPLAY_NAME DMA_DATA_WIDTH
+set_parameter_property DMA_DATA_WIDTH TYPE POSITIVE
+set_parameter_property DMA_DATA_WIDTH UNITS Bits
+set_parameter_property DMA_DATA_WIDTH ALLOWED_RANGES {64 128}
+set_parameter_property DMA_DATA_WIDTH DESCRIPTION "Width of the fpga2hps bridge / SDRAM port the DMA master is connected to"
+set_parameter_property DMA_DATA_WIDTH HDL_PARAMETER true
+add_parameter LINE_BUFFER_DEPTH POSITIVE 512
+set_parameter_property LINE_BUFFER_DEPTH DEFAULT_VALUE 512
+set_parameter_property LINE_BUFFER_DEPTH DISPLAY_NAME LINE_BUFFER_DEPTH
+set_parameter_property LINE_BUFFER_DEPTH TYPE POSITIVE
+set_parameter_property LINE_BUFFER_DEPTH UNITS None
+set_parameter_property LINE_BUFFER_DEPTH ALLOWED_RANGES {256 512 1024 2048}
+set_parameter_property LINE_BUFFER_DEPTH DESCRIPTION "Longest line (in pixels) that can be replicated vertically"
+set_parameter_property LINE_BUFFER_DEPTH HDL_PARAMETER true
 
 
 #
@@ -176,7 +192,7 @@ set_interface_property dma SVD_ADDRESS_GROUP ""
 add_interface_port dma am_address address Output 32
 add_interface_port dma am_burstcount burstcount Output 11
 add_interface_port dma am_read read Output 1
-add_interface_port dma am_readdata readdata Input 128
+add_interface_port dma am_readdata readdata Input DMA_DATA_WIDTH
 add_interface_port dma am_readdatavalid readdatavalid Input 1
 add_interface_port dma am_waitrequest waitrequest Input 1
 
@@ -0,0 +1,557 @@
+-- #############################################################################
+-- tb_framebuffer_manager.vhd
+-- ==========================
+-- Testbench for the performance counters and the pixel replication of the
+-- framebuffer manager.
+--
+-- The framebuffer manager reads a 64x32 frame from a memory model and feeds
+-- a vga_sequencer, which gives it its frame_sync. The frame is larger than
+-- the FIFO, so the scanout depends on the memory bandwidth:
+--   1. With a fast memory, every frame is read completely: the number of
+--      bursts matches the number of frames, there are no stalls and no
+--      underflows, and the pixels come out in order.
+--   2. A page flip queued in the middle of a frame lands at the next frame
+--      sync, and is reported as pending until then.
+--   3. Smaller frames replicated 2x2 and 4x4 fill the same screen.
+--   4. With an artificially slow memory (long waitrequest and gaps between
+--      the beats of a burst), the counters must report stalls, underflows
+--      and a FIFO that runs dry.
+--
+-- The DMA master is DMA_DATA_WIDTH bits wide (128 or 64), and so is the
+-- memory model. tb_framebuffer_manager_widths runs this testbench with both.
+--
+-- Needs the altera_mf library (dc_video_fifo).
+--
+-- Revision      : 4
+-- Last modified : 2026-10-19
+-- #############################################################################
+
+library ieee;
+use ieee.std_logic_1164.all;
+use ieee.numeric_std.all;
+
+entity tb_framebuffer_manager is
+    generic(
+        DMA_DATA_WIDTH : positive := 128    -- 64 or 128
+    );
+end entity;
+
+architecture rtl of tb_framebuffer_manager is
+
+    -- 50 MHz bus clock, 25 MHz pixel clock
+    constant CLK_PERIOD    : time := 20 ns;
+    constant PIXCLK_PERIOD : time := 40 ns;
+
+    -- Signal used to end simulator when we finished submitting our test cases
+    signal sim_finished : boolean := false;
+
+    -- Frame geometry
+    constant HDATA           : positive := 64;
+    constant VDATA           : positive := 32;
+    constant BURST_COUNT     : positive := 4;
+    constant START_ADDRESS   : natural  := 16#1000#;
+    constant START_ADDRESS_2 : natural  := 16#20000#;
+
+    -- Words of the DMA master: 4 pixels (128 bits) or 2 pixels (64 bits)
+    constant PIX_PER_WORD     : positive := DMA_DATA_WIDTH / 32;
+    constant BYTES_PER_WORD   : positive := DMA_DATA_WIDTH / 8;
+    constant BURSTS_PER_FRAME : natural  := VDATA * (HDATA / PIX_PER_WORD) / BURST_COUNT;
+    constant FIFO_DEPTH       : natural  := 256;
+
+    -- Register numbers of the framebuffer manager
+    constant REG_FRAME_START_ADDRESS  : natural := 0;
+    constant REG_FRAME_PIX_PER_LINE   : natural := 1;
+    constant REG_FRAME_NUM_LINES      : natural := 2;
+    constant REG_FRAME_EOL_BYTE_OFST  : natural := 3;
+    constant REG_COMMAND              : natural := 4;
+    constant REG_BURST_COUNT          : natural := 5;
+    constant REG_UNDERFLOW_COUNT      : natural := 6;
+    constant REG_DMA_DATA_WIDTH       : natural := 7;
+    constant REG_BURSTS               : natural := 8;
+    constant REG_STALL_CYCLES         : natural := 9;
+    constant REG_MIN_FIFO_FILL        : natural := 10;
+    constant REG_FRAMES               : natural := 11;
+    constant REG_SCALE                : natural := 12;
+    constant REG_ACTIVE_START_ADDRESS : natural := 14;
+    constant REG_STATUS               : natural := 15;
+
+    constant STATUS_PENDING : natural := 16#01#;
+    constant STATUS_ENABLED : natural := 16#02#;
+
+    constant COMMAND_ENABLE_DMA  : natural := 16#01#;
+    constant COMMAND_DISABLE_DMA : natural := 16#02#;
+    constant COMMAND_ENABLE_IRQ  : natural := 16#04#;
+    constant COMMAND_ACK_IRQ     : natural := 16#10#;
+
+    -- FRAMEBUFFER MANAGER PORTS
+    signal clk              : std_logic := '0';
+    signal pixclk           : std_logic := '0';
+    signal reset            : std_logic;
+    signal as_address       : std_logic_vector(3 downto 0);
+    signal as_read          : std_logic;
+    signal as_readdata      : std_logic_vector(31 downto 0);
+    signal as_write         : std_logic;
+    signal as_writedata     : std_logic_vector(31 downto 0);
+    signal am_address       : std_logic_vector(31 downto 0);
+    signal am_waitrequest   : std_logic;
+    signal am_burstcount    : std_logic_vector(10 downto 0);
+    signal am_read          : std_logic;
+    signal am_readdata      : std_logic_vector(DMA_DATA_WIDTH - 1 downto 0) := (others => '0');
+    signal am_readdatavalid : std_logic := '0';
+    signal frame_sync       : std_logic;
+    signal irq              : std_logic;
+    signal video_data       : std_logic_vector(23 downto 0);
+    signal video_valid      : std_logic;
+    signal video_ready      : std_logic;
+
+    -- VGA SEQUENCER PORTS
+    signal seq_address   : std_logic_vector(4 downto 0);
+    signal seq_write     : std_logic;
+    signal seq_writedata : std_logic_vector(31 downto 0);
+    signal seq_readdata  : std_logic_vector(31 downto 0);
+    signal r, g, b       : std_logic_vector(7 downto 0);
+    signal hsync, vsync  : std_logic;
+    signal de            : std_logic;
+
+    -- Memory model: each burst is accepted after mem_wait_cycles cycles of
+    -- waitrequest, then its words come out every mem_beat_cycles + 1 cycles.
+    signal mem_wait_cycles : natural := 0;
+    signal mem_beat_cycles : natural := 0;
+
+    type mem_state_t is (MEM_IDLE, MEM_BURST);
+    signal mem_state      : mem_state_t := MEM_IDLE;
+    signal mem_address    : natural;
+    signal mem_remaining  : natural;
+    signal mem_wait_count : natural := 0;
+    signal mem_beat_count : natural := 0;
+
+    -- Pixel checker, with the frame width and scale it expects
+    signal check_pixels  : boolean  := false;
+    signal check_base    : natural  := START_ADDRESS;
+    signal check_width   : positive := HDATA;
+    signal check_h_scale : positive := 1;
+    signal check_v_scale : positive := 1;
+
+    -- The pixel at byte address 'address' is address / 4.
+    function memory_word(address : natural) return std_logic_vector is
+        variable word : std_logic_vector(DMA_DATA_WIDTH - 1 downto 0) := (others => '0');
+    begin
+        for i in 0 to PIX_PER_WORD - 1 loop
+            word(32 * i + 23 downto 32 * i) := std_logic_vector(to_unsigned(address / 4 + i, 24));
+        end loop;
+        return word;
+    end function memory_word;
+
+begin
+
+    -- Instantiate DUT
+    dut : entity work.framebuffer_manager
+    generic map(
+        DMA_DATA_WIDTH => DMA_DATA_WIDTH
+    )
+    port map(
+        clk              => clk,
+        pixclk           => pixclk,
+        reset            => reset,
+        as_address       => as_address,
+        as_read          => as_read,
+        as_readdata      => as_readdata,
+        as_write         => as_write,
+        as_writedata     => as_writedata,
+        am_address       => am_address,
+        am_waitrequest   => am_waitrequest,
+        am_burstcount    => am_burstcount,
+        am_read          => am_read,
+        am_readdata      => am_readdata,
+        am_readdatavalid => am_readdatavalid,
+        frame_sync       => frame_sync,
+        irq              => irq,
+        src_data         => video_data,
+        src_valid        => video_valid,
+        src_ready        => video_ready
+    );
+
+    -- Video interface that consumes the pixels and gives the frame sync
+    sequencer : entity work.vga_sequencer
+    generic map(
+        HBP_DEFAULT   => 4,
+        HFP_DEFAULT   => 4,
+        VBP_DEFAULT   => 2,
+        VFP_DEFAULT   => 2,
+        HDATA_DEFAULT => HDATA,
+        VDATA_DEFAULT => VDATA,
+        HSYNC_DEFAULT => 2,
+        VSYNC_DEFAULT => 2
+    )
+    port map(
+        pixclk     => pixclk,
+        clk        => clk,
+        reset      => reset,
+        address    => seq_address,
+        read       => '0',
+        write      => seq_write,
+        readdata   => seq_readdata,
+        writedata  => seq_writedata,
+        sink_data  => video_data,
+        sink_valid => video_valid,
+        sink_ready => video_ready,
+        r          => r,
+        g          => g,
+        b          => b,
+        hsync      => hsync,
+        vsync      => vsync,
+        de         => de,
+        frame_sync => frame_sync
+    );
+
+    clk    <= not clk after CLK_PERIOD / 2 when not sim_finished else '0';
+    pixclk <= not pixclk after PIXCLK_PERIOD / 2 when not sim_finished else '0';
+
+    -- Memory model
+    am_waitrequest <= '0' when mem_state = MEM_IDLE and mem_wait_count >= mem_wait_cycles else '1';
+
+    memory : process (clk)
+    begin
+        if rising_edge(clk) then
+            am_readdatavalid <= '0';
+
+            case mem_state is
+                when MEM_IDLE =>
+                    if am_read = '1' then
+                        if mem_wait_count >= mem_wait_cycles then
+                            mem_address    <= to_integer(unsigned(am_address));
+                            mem_remaining  <= to_integer(unsigned(am_burstcount));
+                            mem_beat_count <= 0;
+                            mem_wait_count <= 0;
+                            mem_state      <= MEM_BURST;
+                        else
+                            mem_wait_count <= mem_wait_count + 1;
+                        end if;
+                    end if;
+
+                when MEM_BURST =>
+                    if mem_beat_count >= mem_beat_cycles then
+                        am_readdatavalid <= '1';
+                        am_readdata      <= memory_word(mem_address);
+                        mem_address      <= mem_address + BYTES_PER_WORD;
+                        mem_remaining    <= mem_remaining - 1;
+                        mem_beat_count   <= 0;
+
+                        if mem_remaining = 1 then
+                            mem_state <= MEM_IDLE;
+                        end if;
+                    else
+                        mem_beat_count <= mem_beat_count + 1;
+                    end if;
+            end case;
+        end if;
+    end process memory;
+
+    -- Without underflow, pixel (x, y) of the screen is the pixel
+    -- (x / h_scale, y / v_scale) of the frame. Like the DUT, the checker takes
+    -- a new geometry during the vertical front porch.
+    pixel_checker : process (pixclk)
+        variable previous_de       : std_logic := '0';
+        variable x, y              : natural   := 0;
+        variable width             : positive  := HDATA;
+        variable base              : natural   := START_ADDRESS;
+        variable h_scale, v_scale  : positive  := 1;
+        variable pixel, expected   : natural;
+    begin
+        if rising_edge(pixclk) then
+            if frame_sync = '1' then
+                x       := 0;
+                y       := 0;
+                base    := check_base;
+                width   := check_width;
+                h_scale := check_h_scale;
+                v_scale := check_v_scale;
+
+            elsif de = '1' then
+                pixel    := to_integer(unsigned(r & g & b));
+                expected := base / 4 + (y / v_scale) * width + x / h_scale;
+
+                if check_pixels then
+                    assert pixel = expected
+                    report "Unexpected pixel at (" &
+                    integer'image(x) & ", " & integer'image(y) & "): " &
+                    "pixel = " & integer'image(pixel) & "; " &
+                    "pixel_expected = " & integer'image(expected)
+                    severity error;
+                end if;
+
+                x := x + 1;
+
+            elsif previous_de = '1' then
+                x := 0;
+                y := y + 1;
+            end if;
+
+            previous_de := de;
+        end if;
+    end process pixel_checker;
+
+    -- Test the counters
+    simulation : process
+
+        variable frames, bursts, stalls, underflows, min_fill : natural;
+        variable frames_0, stalls_0, underflows_0             : natural;
+        variable status, active_address                       : natural;
+
+        procedure async_reset is
+        begin
+            wait until rising_edge(clk);
+            wait for CLK_PERIOD / 4;
+
+            reset <= '1';
+            wait for CLK_PERIOD / 2;
+
+            reset <= '0';
+            wait for CLK_PERIOD / 4;
+        end procedure async_reset;
+
+        procedure write_register(constant regno : in natural;
+                                 constant val   : in natural) is
+        begin
+            wait until rising_edge(clk);
+
+            as_address   <= std_logic_vector(to_unsigned(regno, as_address'length));
+            as_write     <= '1';
+            as_writedata <= std_logic_vector(to_unsigned(val, as_writedata'length));
+            wait until rising_edge(clk);
+
+            as_address   <= (others => '0');
+            as_write     <= '0';
+            as_writedata <= (others => '0');
+            wait until rising_edge(clk);
+        end procedure write_register;
+
+        procedure read_register(constant regno : in  natural;
+                                variable val   : out natural) is
+        begin
+            wait until rising_edge(clk);
+
+            as_address <= std_logic_vector(to_unsigned(regno, as_address'length));
+            as_read    <= '1';
+            -- The read has a 1 cycle wait-state, so we need to keep the read
+            -- signal high for 2 clock cycles.
+            wait until rising_edge(clk);
+            wait until rising_edge(clk);
+            val := to_integer(unsigned(as_readdata));
+
+            as_address <= (others => '0');
+            as_read    <= '0';
+            wait until rising_edge(clk);
+        end procedure read_register;
+
+        procedure write_sequencer(constant regno : in natural;
+                                  constant val   : in natural) is
+        begin
+            wait until rising_edge(clk);
+
+            seq_address   <= std_logic_vector(to_unsigned(regno, seq_address'length));
+            seq_write     <= '1';
+            seq_writedata <= std_logic_vector(to_unsigned(val, seq_writedata'length));
+            wait until rising_edge(clk);
+
+            seq_address   <= (others => '0');
+            seq_write     <= '0';
+            seq_writedata <= (others => '0');
+        end procedure write_sequencer;
+
+        -- Wait for the end of a frame and read the counters meanwhile: the
+        -- next frame only starts at the next frame sync.
+        procedure read_counters_at_end_of_frame is
+        begin
+            wait until rising_edge(irq);
+            read_register(REG_FRAMES, frames);
+            read_register(REG_BURSTS, bursts);
+            read_register(REG_STALL_CYCLES, stalls);
+            read_register(REG_UNDERFLOW_COUNT, underflows);
+            read_register(REG_MIN_FIFO_FILL, min_fill);
+            write_register(REG_COMMAND, COMMAND_ACK_IRQ);
+        end procedure read_counters_at_end_of_frame;
+
+    begin
+
+        -- Default values
+        reset         <= '0';
+        as_address    <= (others => '0');
+        as_read       <= '0';
+        as_write      <= '0';
+        as_writedata  <= (others => '0');
+        seq_address   <= (others => '0');
+        seq_write     <= '0';
+        seq_writedata <= (others => '0');
+        wait until rising_edge(clk);
+
+        -- Reset the circuit
+        async_reset;
+
+        read_register(REG_DMA_DATA_WIDTH, frames);
+        assert frames = DMA_DATA_WIDTH report "Unexpected DMA_DATA_WIDTH" severity error;
+
+        read_register(REG_MIN_FIFO_FILL, min_fill);
+        assert min_fill = FIFO_DEPTH report "MIN_FIFO_FILL does not reset to the FIFO depth" severity error;
+
+        ------------------------------------------------------------------------
+        -- 1. Fast memory
+        ------------------------------------------------------------------------
+        mem_wait_cycles <= 0;
+        mem_beat_cycles <= 0;
+        check_pixels    <= true;
+
+        write_register(REG_FRAME_START_ADDRESS, START_ADDRESS);
+        write_register(REG_FRAME_PIX_PER_LINE, HDATA);
+        write_register(REG_FRAME_NUM_LINES, VDATA);
+        write_register(REG_FRAME_EOL_BYTE_OFST, 0);
+        write_register(REG_BURST_COUNT, BURST_COUNT);
+        write_register(REG_COMMAND, COMMAND_ENABLE_DMA + COMMAND_ENABLE_IRQ);
+        write_sequencer(0, 1);
+
+        -- Skip the first frame (the sequencer starts on the first pixel).
+        read_counters_at_end_of_frame;
+        read_counters_at_end_of_frame;
+        read_counters_at_end_of_frame;
+
+        assert frames >= 2
+        report "Unexpected FRAMES: " & integer'image(frames) severity error;
+
+        assert bursts = frames * BURSTS_PER_FRAME
+        report "Unexpected BURSTS: " &
+        "BURSTS = " & integer'image(bursts) & "; " &
+        "BURSTS_expected = " & integer'image(frames * BURSTS_PER_FRAME)
+        severity error;
+
+        assert stalls = 0
+        report "Unexpected STALL_CYCLES with a fast memory: " & integer'image(stalls) severity error;
+
+        assert underflows = 0
+        report "Unexpected UNDERFLOW_COUNT with a fast memory: " & integer'image(underflows) severity error;
+
+        assert min_fill > 0
+        report "The FIFO ran dry with a fast memory" severity error;
+
+        -- MIN_FIFO_FILL is cleared by a write (no burst until the next frame).
+        write_register(REG_MIN_FIFO_FILL, 0);
+        read_register(REG_MIN_FIFO_FILL, min_fill);
+        assert min_fill = FIFO_DEPTH report "MIN_FIFO_FILL not cleared" severity error;
+
+        ------------------------------------------------------------------------
+        -- 2. Page flip
+        ------------------------------------------------------------------------
+        -- Queue a flip while the frame is being read.
+        wait until frame_sync = '1';
+        wait until frame_sync = '0';
+        wait for 20 us;
+
+        check_base <= START_ADDRESS_2;
+        write_register(REG_FRAME_START_ADDRESS, START_ADDRESS_2);
+
+        read_register(REG_STATUS, status);
+        assert status = STATUS_PENDING + STATUS_ENABLED
+        report "Flip not pending: STATUS = " & integer'image(status) severity error;
+
+        read_register(REG_ACTIVE_START_ADDRESS, active_address);
+        assert active_address = START_ADDRESS
+        report "Flip landed in the middle of a frame" severity error;
+
+        -- It lands at the next frame sync.
+        wait until frame_sync = '1';
+        wait until rising_edge(clk);
+
+        read_register(REG_STATUS, status);
+        assert status = STATUS_ENABLED
+        report "Flip still pending after the frame sync: STATUS = " & integer'image(status) severity error;
+
+        read_register(REG_ACTIVE_START_ADDRESS, active_address);
+        assert active_address = START_ADDRESS_2
+        report "Unexpected ACTIVE_START_ADDRESS: " & integer'image(active_address) severity error;
+
+        -- The pixel checker checks the new frame.
+        read_counters_at_end_of_frame;
+
+        ------------------------------------------------------------------------
+        -- 3. Pixel replication
+        ------------------------------------------------------------------------
+        -- 2x2: a 32x16 frame
+        check_width   <= HDATA / 2;
+        check_h_scale <= 2;
+        check_v_scale <= 2;
+        write_register(REG_FRAME_PIX_PER_LINE, HDATA / 2);
+        write_register(REG_FRAME_NUM_LINES, VDATA / 2);
+        write_register(REG_SCALE, 1 + 1 * 4);
+
+        read_counters_at_end_of_frame;
+        read_counters_at_end_of_frame;
+        read_counters_at_end_of_frame;
+
+        -- 4x4: a 16x8 frame
+        check_width   <= HDATA / 4;
+        check_h_scale <= 4;
+        check_v_scale <= 4;
+        write_register(REG_FRAME_PIX_PER_LINE, HDATA / 4);
+        write_register(REG_FRAME_NUM_LINES, VDATA / 4);
+        write_register(REG_SCALE, 2 + 2 * 4);
+
+        read_counters_at_end_of_frame;
+        read_counters_at_end_of_frame;
+        read_counters_at_end_of_frame;
+
+        assert underflows = 0
+        report "Unexpected UNDERFLOW_COUNT with pixel replication: " & integer'image(underflows) severity error;
+
+        -- Back to 1x1 before the last frame is shown (checked by the pixel
+        -- checker until then).
+        check_width   <= HDATA;
+        check_h_scale <= 1;
+        check_v_scale <= 1;
+        write_register(REG_FRAME_PIX_PER_LINE, HDATA);
+        write_register(REG_FRAME_NUM_LINES, VDATA);
+        write_register(REG_SCALE, 0);
+        wait until frame_sync = '1';
+
+        ------------------------------------------------------------------------
+        -- 4. Slow memory
+        ------------------------------------------------------------------------
+        frames_0     := frames;
+        stalls_0     := stalls;
+        underflows_0 := underflows;
+
+        check_pixels    <= false;
+        mem_wait_cycles <= 40;
+        mem_beat_cycles <= 8;
+
+        -- Frames may be cut by the frame sync now: wait for a few frames.
+        wait for 4 * (2 + 4 + HDATA + 4) * (2 + 2 + VDATA + 2) * PIXCLK_PERIOD;
+
+        read_register(REG_FRAMES, frames);
+        read_register(REG_STALL_CYCLES, stalls);
+        read_register(REG_UNDERFLOW_COUNT, underflows);
+        read_register(REG_MIN_FIFO_FILL, min_fill);
+
+        assert stalls > stalls_0
+        report "No STALL_CYCLES with a slow memory" severity error;
+
+        assert underflows > underflows_0
+        report "No UNDERFLOW_COUNT with a slow memory" severity error;
+
+        assert min_fill = 0
+        report "Unexpected MIN_FIFO_FILL with a slow memory: " & integer'image(min_fill) severity error;
+
+        report integer'image(DMA_DATA_WIDTH) & "-bit slow memory: " &
+        integer'image(frames - frames_0) & " complete frames, " &
+        integer'image(stalls - stalls_0) & " stall cycles, " &
+        integer'image(underflows - underflows_0) & " underflow cycles"
+        severity note;
+
+        write_register(REG_COMMAND, COMMAND_DISABLE_DMA);
+
+        -- Instruct the clock generators to halt execution.
+        sim_finished <= true;
+
+        -- Make this process wait indefinitely (it will never re-execute from
+        -- its beginning again).
+        wait;
+    end process simulation;
+end architecture rtl;
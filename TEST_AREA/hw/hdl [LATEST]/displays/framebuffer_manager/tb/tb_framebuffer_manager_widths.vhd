@@ -0,0 +1,33 @@
+-- #############################################################################
+-- tb_framebuffer_manager_widths.vhd
+-- =================================
+-- Runs tb_framebuffer_manager with a 128-bit and a 64-bit DMA master side by
+-- side: the same counters, page flip, pixel replication and pixel checker
+-- for both widths of the framebuffer manager.
+--
+-- Needs the altera_mf library (dc_video_fifo).
+--
+-- Revision      : 1
+-- Last modified : 2026-10-19
+-- #############################################################################
+
+library ieee;
+use ieee.std_logic_1164.all;
+
+entity tb_framebuffer_manager_widths is
+end entity;
+
+architecture rtl of tb_framebuffer_manager_widths is
+begin
+
+    tb_128 : entity work.tb_framebuffer_manager
+    generic map(
+        DMA_DATA_WIDTH => 128
+    );
+
+    tb_64 : entity work.tb_framebuffer_manager
+    generic map(
+        DMA_DATA_WIDTH => 64
+    );
+
+end architecture rtl;
@@ -1,15 +1,18 @@
 -- Lepton Avalon Memory-Mapped Slave Interface
 -- Author: Philémon Favrod (philemon.favrod@epfl.ch)
 -- Modified by: Sahand Kashani-Akhavan (sahand.kashani-akhavan@epfl.ch)
--- Revision: 2
+-- Revision: 5 (adjustment modes)
 
 -- Register map
 -- +---------------+-----------------+--------+---------------------------------------------------+
 -- | RegNo         | Name            | Access | Description                                       |
 -- +---------------+-----------------+--------+---------------------------------------------------+
 -- |             0 | COMMAND         | WO     | Command                                           |
--- |               |                 |        | - Writing 1 starts capturing a frame & resets the |
+-- |               |                 |        | - Bit 0: 1 starts capturing a frame & resets the  |
 -- |               |                 |        |   ERROR bit (bit 1) in the STATUS register.       |
+-- |               |                 |        |   0 stops after the frame being captured.         |
+-- |               |                 |        | - Bit 1: 1 --> continuous mode, the frames are    |
+-- |               |                 |        |   captured back to back until bit 0 is cleared.   |
 -- +---------------+-----------------+--------+---------------------------------------------------+
 -- |             1 | STATUS          | RO     | Status                                            |
 -- |               |                 |        | - Bit 0: 0 --> no capture in progress.            |
@@ -17,34 +20,98 @@
 -- |               |                 |        | - Bit 1: 0 --> previous capture successful.       |
 -- |               |                 |        |          1 --> error during previous capture.     |
 -- +---------------+-----------------+--------+---------------------------------------------------+
--- |             2 | MIN             | RO     | Minimum pixel value in frame.                     |
+-- |             2 | MIN             | RO     | Minimum pixel value in frame (*).                 |
 -- +---------------+-----------------+--------+---------------------------------------------------+
--- |             3 | MAX             | RO     | Maximum pixel value in frame.                     |
+-- |             3 | MAX             | RO     | Maximum pixel value in frame (*).                 |
 -- +---------------+-----------------+--------+---------------------------------------------------+
--- |             4 | SUM_LSB         | RO     | Sum of all pixels in frame (low 16 bits).         |
+-- |             4 | SUM_LSB         | RO     | Sum of all pixels in frame (low 16 bits) (*).     |
 -- +---------------+-----------------+--------+---------------------------------------------------+
--- |             5 | SUM_MSB         | RO     | Sum of all pixels in frame (high 16 bits).        |
+-- |             5 | SUM_MSB         | RO     | Sum of all pixels in frame (high 16 bits) (*).    |
 -- +---------------+-----------------+--------+---------------------------------------------------+
 -- |             6 | ROW_IDX         | RO     | Current line being captured (1 <= ROW_IDX <= 60). |
 -- |               |                 |        | Available for debugging purposes.                 |
 -- +---------------+-----------------+--------+---------------------------------------------------+
--- |             7 | RESERVED        | -      | Reserved                                          |
+-- |             7 | BANK            | R/W    | Frame banks                                       |
+-- |               |                 |        | Read:                                             |
+-- |               |                 |        | - Bit 0: READ_BANK, bank seen through (*).        |
+-- |               |                 |        | - Bit 1: WRITE_BANK, bank the sensor writes to.   |
+-- |               |                 |        | - Bit 2: FRAME_READY, a new frame is complete.    |
+-- |               |                 |        | - Bit 3: HOLD, READ_BANK is held by software.     |
+-- |               |                 |        | - Bits 15-8: DROPPED, complete frames overwritten |
+-- |               |                 |        |   before an ACQUIRE (wraps around).               |
+-- |               |                 |        | Write:                                            |
+-- |               |                 |        | - Bit 0: ACQUIRE, hold the newest complete frame  |
+-- |               |                 |        |   (or the current READ_BANK if none).             |
+-- |               |                 |        | - Bit 1: RELEASE, stop holding READ_BANK.         |
 -- +---------------+-----------------+--------+---------------------------------------------------+
--- |     8 -  4807 | RAW BUFFER      | RO     | View into RAW pixel buffer.                       |
+-- |     8 -  4807 | RAW BUFFER      | RO     | View into RAW pixel buffer (*).                   |
 -- +---------------+-----------------+--------+---------------------------------------------------+
--- |  4808 -  8191 | RESERVED        | -      | Reserved                                          |
+-- |  4808 -  4863 | RESERVED        | -      | Reserved                                          |
 -- +---------------+-----------------+--------+---------------------------------------------------+
--- |  8192 - 12991 | ADJUSTED BUFFER | RO     | View into adjusted (scaled) pixel buffer.         |
--- |               |                 |        | Values are scaled between MIN and MAX.            |
+-- |          4864 | HIST_OFFSET     | R/W    | First pixel value of bin 0 of the histogram.      |
 -- +---------------+-----------------+--------+---------------------------------------------------+
--- | 12992 - 16383 | RESERVED        | -      | Reserved                                          |
+-- |          4865 | HIST_SHIFT      | R/W    | Bits 3-0: log2 of the width of a bin.             |
+-- |               |                 |        | Pixel p goes in bin (p - HIST_OFFSET) >>          |
+-- |               |                 |        | HIST_SHIFT, saturated to the last bin. Taken into |
+-- |               |                 |        | account from the next frame.                      |
 -- +---------------+-----------------+--------+---------------------------------------------------+
+-- |          4866 | HIST_BINS       | RO     | Number of bins of the histogram (HIST_BINS).      |
+-- +---------------+-----------------+--------+---------------------------------------------------+
+-- |          4867 | ADJUST_MODE     | R/W    | Bits 1-0: mapping of the ADJUSTED BUFFER.         |
+-- |               |                 |        | 0 --> linear between MIN and MAX.                 |
+-- |               |                 |        | 1 --> GAMMA_LUT[linear >> 4].                     |
+-- |               |                 |        | 2 --> histogram equalization: pixels in the bins  |
+-- |               |                 |        |       up to the pixel's * 0x3fff / 4800.          |
+-- +---------------+-----------------+--------+---------------------------------------------------+
+-- |  4868 -  5119 | RESERVED        | -      | Reserved                                          |
+-- +---------------+-----------------+--------+---------------------------------------------------+
+-- |  5120 -  7167 | HISTOGRAM       | RO     | Number of pixels in each bin (*). Only the first  |
+-- |               |                 |        | HIST_BINS words are used.                         |
+-- +---------------+-----------------+--------+---------------------------------------------------+
+-- |  7168 -  8191 | RESERVED        | -      | Reserved                                          |
+-- +---------------+-----------------+--------+---------------------------------------------------+
+-- |  8192 - 12991 | ADJUSTED BUFFER | RO     | View into adjusted (scaled) pixel buffer (*).     |
+-- |               |                 |        | Values are mapped to 0 - 0x3fff (ADJUST_MODE).    |
+-- +---------------+-----------------+--------+---------------------------------------------------+
+-- | 12992 - 15359 | RESERVED        | -      | Reserved                                          |
+-- +---------------+-----------------+--------+---------------------------------------------------+
+-- | 15360 - 16383 | GAMMA_LUT       | WO     | Output value (14 bits) of ADJUST_MODE 1 for each  |
+-- |               |                 |        | linear value >> 4.                                |
+-- +---------------+-----------------+--------+---------------------------------------------------+
+-- (*) of the frame in READ_BANK.
+--
+-- Frame banks: the sensor writes its frames alternately into two banks, each
+-- with its own statistics, so that software can read a frame while the next
+-- one is captured. When a frame is complete, it becomes the newest frame
+-- (FRAME_READY). Without HOLD, READ_BANK follows the newest frame and the
+-- sensor moves to the other bank, like with a single buffer. With HOLD, the
+-- sensor never writes READ_BANK: it keeps writing the other bank, replacing
+-- the newest frame if software didn't ACQUIRE it in time. DROPPED counts
+-- these frames, when the sensor starts overwriting them. Without HOLD, the
+-- newest frame is never overwritten: frames that software didn't ACQUIRE
+-- are not counted.
+-- Continuous mode with ACQUIRE/RELEASE:
+--   COMMAND = 3; loop { wait FRAME_READY; BANK = ACQUIRE; read; }
+--
+-- Histogram: computed during the capture, so that software can stretch the
+-- contrast of a frame without going through its pixels. HIST_BINS is a power
+-- of 2 from 64 to 2048, the size of the HISTOGRAM window (see lepton_stats for
+-- the block RAM it takes). After reset, the bins cover the whole 14-bit range
+-- (HIST_OFFSET = 0, HIST_SHIFT = 14 - log2(HIST_BINS)).
+--
+-- A frame is complete (FRAME_READY, end of capture in STATUS) once the
+-- mapping of its ADJUSTED BUFFER is computed, HIST_BINS + a few cycles after
+-- its last pixel.
 
 library ieee;
 use ieee.std_logic_1164.all;
 use ieee.numeric_std.all;
+use work.utils.all;
 
 entity lepton is
+    generic(
+        SYNC_DELAY_MS : positive := 200;  -- CS_n high time before a frame
+        HIST_BINS     : positive := 64);
     port(
         clk       : in  std_logic;
         reset     : in  std_logic;
@@ -85,8 +152,8 @@ architecture rtl of lepton is
     signal stat_valid           : std_logic;
     signal ram_data             : std_logic_vector(15 downto 0);
     signal ram_wren             : std_logic;
-    signal ram_wraddress        : std_logic_vector(12 downto 0);
-    signal ram_rdaddress        : std_logic_vector(12 downto 0);
+    signal ram_wraddress        : std_logic_vector(13 downto 0);
+    signal ram_rdaddress        : std_logic_vector(13 downto 0);
     signal ram_q                : std_logic_vector(15 downto 0);
     signal row_idx              : std_logic_vector(5 downto 0);
     signal raw_pixel            : std_logic_vector(13 downto 0);
@@ -94,6 +161,17 @@ architecture rtl of lepton is
     signal raw_min              : std_logic_vector(13 downto 0);
     signal raw_sum              : std_logic_vector(26 downto 0);
     signal adjusted_pixel       : std_logic_vector(13 downto 0);
+    signal hist_rdaddress       : std_logic_vector(bitlength(HIST_BINS - 1) - 1 downto 0);
+    signal hist_q               : std_logic_vector(15 downto 0);
+    signal stat_hist_offset     : std_logic_vector(13 downto 0);
+    signal stat_hist_shift      : std_logic_vector(3 downto 0);
+    signal eq_rdaddress         : std_logic_vector(bitlength(HIST_BINS - 1) - 1 downto 0);
+    signal eq_q                 : std_logic_vector(15 downto 0);
+    signal setup_start          : std_logic;
+    signal setup_min            : std_logic_vector(13 downto 0);
+    signal setup_max            : std_logic_vector(13 downto 0);
+    signal frame_done           : std_logic;
+    signal gamma_wren           : std_logic;
 
     constant COMMAND_REG_OFFSET         : std_logic_vector(address'range) := "00000000000000";
     constant STATUS_REG_OFFSET          : std_logic_vector(address'range) := "00000000000001";
@@ -102,19 +180,65 @@ architecture rtl of lepton is
     constant SUM_LSB_REG_OFFSET         : std_logic_vector(address'range) := "00000000000100";
     constant SUM_MSB_REG_OFFSET         : std_logic_vector(address'range) := "00000000000101";
     constant ROW_IDX_REG_OFFSET         : std_logic_vector(address'range) := "00000000000110";
+    constant BANK_REG_OFFSET            : std_logic_vector(address'range) := "00000000000111";
     constant BUFFER_REG_OFFSET          : unsigned(address'range)         := "00000000001000";
     constant ADJUSTED_BUFFER_REG_OFFSET : unsigned(address'range)         := "10000000000000";
+    constant HIST_OFFSET_REG_OFFSET     : std_logic_vector(address'range) := "01001100000000";
+    constant HIST_SHIFT_REG_OFFSET      : std_logic_vector(address'range) := "01001100000001";
+    constant HIST_BINS_REG_OFFSET       : std_logic_vector(address'range) := "01001100000010";
+    constant ADJUST_MODE_REG_OFFSET     : std_logic_vector(address'range) := "01001100000011";
+    constant HISTOGRAM_REG_OFFSET       : unsigned(address'range)         := "01010000000000";
 
     constant IMAGE_SIZE       : integer                 := 80 * 60;
     constant BUFFER_REG_LIMIT : unsigned(address'range) := unsigned(BUFFER_REG_OFFSET) + IMAGE_SIZE;
 
     constant ADJUSTED_BUFFER_LIMIT : unsigned(address'range) := unsigned(ADJUSTED_BUFFER_REG_OFFSET) + IMAGE_SIZE;
 
+    constant HISTOGRAM_LIMIT : unsigned(address'range) := HISTOGRAM_REG_OFFSET + HIST_BINS;
+
     signal max_reg   : std_logic_vector(stat_max'range);
     signal min_reg   : std_logic_vector(stat_min'range);
     signal sum_reg   : std_logic_vector(stat_sum'range);
     signal error_reg : std_logic;
 
+    signal continuous_reg : std_logic;
+
+    signal hist_offset_reg : std_logic_vector(13 downto 0);
+    signal hist_shift_reg  : std_logic_vector(3 downto 0);
+    signal adjust_mode_reg : std_logic_vector(1 downto 0);
+
+    -- The last pixel of a frame is in its histogram 3 cycles after pix_eof.
+    signal frame_end_delay : std_logic_vector(3 downto 0);
+
+    function bank_index(bank : std_logic) return natural is
+    begin
+        if bank = '1' then
+            return 1;
+        end if;
+        return 0;
+    end function bank_index;
+
+    -- Frame banks, each with the statistics of its frame
+    type min_max_banks_t is array (0 to 1) of std_logic_vector(stat_min'range);
+    type sum_banks_t is array (0 to 1) of std_logic_vector(stat_sum'range);
+    type hist_shift_banks_t is array (0 to 1) of std_logic_vector(stat_hist_shift'range);
+    signal min_banks         : min_max_banks_t;
+    signal max_banks         : min_max_banks_t;
+    signal sum_banks         : sum_banks_t;
+    signal hist_offset_banks : min_max_banks_t;
+    signal hist_shift_banks  : hist_shift_banks_t;
+
+    signal hist_offset_reg_bank : std_logic_vector(13 downto 0);
+    signal hist_shift_reg_bank  : std_logic_vector(3 downto 0);
+    signal read_bank   : std_logic;
+    signal write_bank  : std_logic;
+    signal ready_bank  : std_logic;
+    signal frame_ready : std_logic;
+    signal hold        : std_logic;
+    signal dropped     : unsigned(7 downto 0);
+    signal acquire     : boolean;
+    signal release     : boolean;
+
 begin
     spi_controller0 : entity work.avalon_st_spi_master
     port map(
@@ -133,6 +257,9 @@ begin
     );
 
     lepton_manager0 : entity work.lepton_manager
+    generic map(
+        SYNC_DELAY_MS => SYNC_DELAY_MS
+    )
     port map(
         clk                 => clk,
         reset               => reset,
@@ -166,17 +293,33 @@ begin
     );
 
     lepton_stats0 : entity work.lepton_stats
+    generic map(
+        HIST_BINS => HIST_BINS
+    )
     port map(
-        reset      => reset,
-        clk        => clk,
-        pix_data   => pix_data,
-        pix_valid  => pix_valid,
-        pix_sof    => pix_sof,
-        pix_eof    => pix_eof,
-        stat_min   => stat_min,
-        stat_max   => stat_max,
-        stat_sum   => stat_sum,
-        stat_valid => stat_valid
+        reset          => reset,
+        clk            => clk,
+        pix_data       => pix_data,
+        pix_valid      => pix_valid,
+        pix_sof        => pix_sof,
+        pix_eof        => pix_eof,
+        stat_min       => stat_min,
+        stat_max       => stat_max,
+        stat_sum       => stat_sum,
+        stat_valid     => stat_valid,
+        hist_offset    => hist_offset_reg,
+        hist_shift     => hist_shift_reg,
+        hist_bank      => write_bank,
+        hist_rdbank    => read_bank,
+        hist_rdaddress => hist_rdaddress,
+        hist_q         => hist_q,
+
+        stat_hist_offset => stat_hist_offset,
+        stat_hist_shift  => stat_hist_shift,
+
+        eq_rdbank    => write_bank,
+        eq_rdaddress => eq_rdaddress,
+        eq_q         => eq_q
     );
 
     ram_writer0 : entity work.ram_writer
@@ -187,6 +330,7 @@ begin
         pix_valid     => pix_valid,
         pix_sof       => pix_sof,
         pix_eof       => pix_eof,
+        bank          => write_bank,
         ram_data      => ram_data,
         ram_wren      => ram_wren,
         ram_wraddress => ram_wraddress
@@ -203,25 +347,43 @@ begin
     );
 
     level_adjuster0 : entity work.level_adjuster
+    generic map(
+        HIST_BINS => HIST_BINS
+    )
     port map(
-        clk            => clk,
-        raw_pixel      => ram_q(13 downto 0),
-        raw_max        => max_reg,
-        raw_min        => min_reg,
-        raw_sum        => sum_reg,
-        adjusted_pixel => adjusted_pixel
+        clk             => clk,
+        reset           => reset,
+        setup_start     => setup_start,
+        setup_bank      => write_bank,
+        setup_min       => setup_min,
+        setup_max       => setup_max,
+        setup_done      => frame_done,
+        eq_rdaddress    => eq_rdaddress,
+        eq_q            => eq_q,
+        gamma_wraddress => address(9 downto 0),
+        gamma_wrdata    => writedata(13 downto 0),
+        gamma_wren      => gamma_wren,
+        mode            => adjust_mode_reg,
+        raw_bank        => read_bank,
+        raw_min         => min_reg,
+        hist_offset     => hist_offset_reg_bank,
+        hist_shift      => hist_shift_reg_bank,
+        raw_pixel       => ram_q(13 downto 0),
+        adjusted_pixel  => adjusted_pixel
     );
 
     p_lepton_start : process(clk, reset)
     begin
         if reset = '1' then
             lepton_manager_start <= '0';
+            continuous_reg       <= '0';
             error_reg            <= '0';
         elsif rising_edge(clk) then
             if write = '1' and address = COMMAND_REG_OFFSET then
                 lepton_manager_start <= writedata(0);
+                continuous_reg       <= writedata(1);
                 error_reg            <= '0';
-            elsif pix_eof = '1' then
+            elsif frame_done = '1' and continuous_reg = '0' then
                 lepton_manager_start <= '0';
             elsif lepton_manager_error = '1' then
                 error_reg <= '1';
@@ -229,26 +391,138 @@ begin
         end if;
     end process p_lepton_start;
 
+    p_hist_reg : process(clk, reset)
+    begin
+        if reset = '1' then
+            hist_offset_reg <= (others => '0');
+            hist_shift_reg  <= std_logic_vector(to_unsigned(14 - bitlength(HIST_BINS - 1), hist_shift_reg'length));
+            adjust_mode_reg <= (others => '0');
+        elsif rising_edge(clk) then
+            if write = '1' and address = HIST_OFFSET_REG_OFFSET then
+                hist_offset_reg <= writedata(hist_offset_reg'range);
+            end if;
+
+            if write = '1' and address = HIST_SHIFT_REG_OFFSET then
+                hist_shift_reg <= writedata(hist_shift_reg'range);
+            end if;
+
+            if write = '1' and address = ADJUST_MODE_REG_OFFSET then
+                adjust_mode_reg <= writedata(adjust_mode_reg'range);
+            end if;
+        end if;
+    end process p_hist_reg;
+
+    gamma_wren <= write and address(13) and address(12) and address(11) and address(10);
+
+    acquire <= write = '1' and address = BANK_REG_OFFSET and writedata(0) = '1';
+    release <= write = '1' and address = BANK_REG_OFFSET and writedata(1) = '1';
+
+    -- The statistics are kept with the frame they belong to.
     p_stat_reg : process(clk, reset)
     begin
         if reset = '1' then
-            min_reg <= (others => '0');
-            max_reg <= (others => '0');
-            sum_reg <= (others => '0');
+            min_banks         <= (others => (others => '0'));
+            max_banks         <= (others => (others => '0'));
+            sum_banks         <= (others => (others => '0'));
+            hist_offset_banks <= (others => (others => '0'));
+            hist_shift_banks  <= (others => (others => '0'));
+            frame_end_delay   <= (others => '0');
         elsif rising_edge(clk) then
             if stat_valid = '1' then
-                min_reg <= stat_min;
-                max_reg <= stat_max;
-                sum_reg <= stat_sum;
+                min_banks(bank_index(write_bank))         <= stat_min;
+                max_banks(bank_index(write_bank))         <= stat_max;
+                sum_banks(bank_index(write_bank))         <= stat_sum;
+                hist_offset_banks(bank_index(write_bank)) <= stat_hist_offset;
+                hist_shift_banks(bank_index(write_bank))  <= stat_hist_shift;
             end if;
+
+            frame_end_delay <= frame_end_delay(frame_end_delay'high - 1 downto 0) & stat_valid;
         end if;
     end process p_stat_reg;
 
+    -- Then the level adjuster computes the mapping of the frame, which
+    -- completes it (frame_done).
+    setup_start <= frame_end_delay(frame_end_delay'high);
+
+    min_reg <= min_banks(bank_index(read_bank));
+    max_reg <= max_banks(bank_index(read_bank));
+    sum_reg <= sum_banks(bank_index(read_bank));
+
+    hist_offset_reg_bank <= hist_offset_banks(bank_index(read_bank));
+    hist_shift_reg_bank  <= hist_shift_banks(bank_index(read_bank));
+
+    setup_min <= min_banks(bank_index(write_bank));
+    setup_max <= max_banks(bank_index(write_bank));
+
+    -- An ACQUIRE or a RELEASE in the cycle a frame is done applies after it.
+    p_banks : process(clk, reset)
+        variable v_read_bank, v_write_bank, v_ready_bank : std_logic;
+        variable v_frame_ready, v_hold                   : std_logic;
+    begin
+        if reset = '1' then
+            read_bank   <= '0';
+            write_bank  <= '0';
+            ready_bank  <= '0';
+            frame_ready <= '0';
+            hold        <= '0';
+            dropped     <= (others => '0');
+        elsif rising_edge(clk) then
+            v_read_bank   := read_bank;
+            v_write_bank  := write_bank;
+            v_ready_bank  := ready_bank;
+            v_frame_ready := frame_ready;
+            v_hold        := hold;
+
+            if pix_valid = '1' and pix_sof = '1' and write_bank = ready_bank then
+                -- The newest frame is being replaced: dropped if nobody
+                -- acquired it.
+                if frame_ready = '1' then
+                    dropped <= dropped + 1;
+                end if;
+                v_frame_ready := '0';
+            end if;
+
+            if frame_done = '1' then
+                v_ready_bank  := write_bank;
+                v_frame_ready := '1';
+
+                -- Without HOLD, the newest frame is shown and the sensor
+                -- moves to the other bank. With HOLD, the other bank is
+                -- held: stay.
+                if hold = '0' then
+                    v_read_bank  := write_bank;
+                    v_write_bank := not write_bank;
+                end if;
+            end if;
+
+            if acquire then
+                v_hold := '1';
+
+                -- Hold the newest frame and give the previously held bank to
+                -- the sensor (it can't be writing the newest frame's bank).
+                if v_frame_ready = '1' then
+                    v_read_bank   := v_ready_bank;
+                    v_write_bank  := not v_ready_bank;
+                    v_frame_ready := '0';
+                end if;
+            elsif release then
+                v_hold := '0';
+            end if;
+
+            read_bank   <= v_read_bank;
+            write_bank  <= v_write_bank;
+            ready_bank  <= v_ready_bank;
+            frame_ready <= v_frame_ready;
+            hold        <= v_hold;
+        end if;
+    end process p_banks;
+
     p_read : process(clk, reset)
     begin
         if reset = '1' then
-            readdata      <= (others => '0');
-            ram_rdaddress <= (others => '0');
+            readdata       <= (others => '0');
+            ram_rdaddress  <= (others => '0');
+            hist_rdaddress <= (others => '0');
         elsif rising_edge(clk) then
             readdata <= (others => '0');
             if read = '1' then
@@ -272,13 +546,35 @@ begin
                     when ROW_IDX_REG_OFFSET =>
                         readdata(5 downto 0) <= row_idx;
 
+                    when BANK_REG_OFFSET =>
+                        readdata(15 downto 8) <= std_logic_vector(dropped);
+                        readdata(3)           <= hold;
+                        readdata(2)           <= frame_ready;
+                        readdata(1)           <= write_bank;
+                        readdata(0)           <= read_bank;
+
+                    when HIST_OFFSET_REG_OFFSET =>
+                        readdata <= "00" & hist_offset_reg;
+
+                    when HIST_SHIFT_REG_OFFSET =>
+                        readdata(hist_shift_reg'range) <= hist_shift_reg;
+
+                    when HIST_BINS_REG_OFFSET =>
+                        readdata <= std_logic_vector(to_unsigned(HIST_BINS, readdata'length));
+
+                    when ADJUST_MODE_REG_OFFSET =>
+                        readdata(adjust_mode_reg'range) <= adjust_mode_reg;
+
                     when others =>
                         if unsigned(address) >= BUFFER_REG_OFFSET and unsigned(address) < BUFFER_REG_LIMIT then
-                            ram_rdaddress <= std_logic_vector(resize(unsigned(address) - BUFFER_REG_OFFSET, ram_rdaddress'length));
+                            ram_rdaddress <= read_bank & std_logic_vector(resize(unsigned(address) - BUFFER_REG_OFFSET, ram_rdaddress'length - 1));
                             readdata      <= ram_q;
                         elsif unsigned(address) >= ADJUSTED_BUFFER_REG_OFFSET and unsigned(address) < ADJUSTED_BUFFER_LIMIT then
-                            ram_rdaddress <= std_logic_vector(resize(unsigned(address) - ADJUSTED_BUFFER_REG_OFFSET, ram_rdaddress'length));
+                            ram_rdaddress <= read_bank & std_logic_vector(resize(unsigned(address) - ADJUSTED_BUFFER_REG_OFFSET, ram_rdaddress'length - 1));
                             readdata      <= "00" & adjusted_pixel;
+                        elsif unsigned(address) >= HISTOGRAM_REG_OFFSET and unsigned(address) < HISTOGRAM_LIMIT then
+                            hist_rdaddress <= std_logic_vector(resize(unsigned(address) - HISTOGRAM_REG_OFFSET, hist_rdaddress'length));
+                            readdata       <= hist_q;
                         end if;
                 end case;
             end if;
@@ -49,12 +49,19 @@ add_fileset_file lepton_stats.vhd VHDL PATH lepton_stats.vhd
 add_fileset_file ram_writer.vhd VHDL PATH ram_writer.vhd
 add_fileset_file utils.vhd VHDL PATH utils.vhd
 add_fileset_file level_adjuster.vhd VHDL PATH level_adjuster.vhd
-add_fileset_file lpm_divider.vhd VHDL PATH lpm_divider.vhd
 
 
 #
 # parameters
 #
+add_parameter HIST_BINS POSITIVE 64
+set_parameter_property HIST_BINS DEFAULT_VALUE 64
+set_parameter_property HIST_BINS DISPLAY_NAME HIST_BINS
+set_parameter_property HIST_BINS TYPE POSITIVE
+set_parameter_property HIST_BINS UNITS None
+set_parameter_property HIST_BINS ALLOWED_RANGES {64 128 256 512 1024 2048}
+set_parameter_property HIST_BINS DESCRIPTION "Number of bins of the histogram"
+set_parameter_property HIST_BINS HDL_PARAMETER true
 
 
 #
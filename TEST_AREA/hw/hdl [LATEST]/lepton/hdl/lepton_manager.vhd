@@ -4,7 +4,8 @@ use ieee.numeric_std.all;
 
 entity lepton_manager is
     generic(
-        INPUT_CLK_FREQ : integer := 50000000);
+        INPUT_CLK_FREQ : integer  := 50000000;
+        SYNC_DELAY_MS  : positive := 200);  -- CS_n high time before a frame
     port(
         clk   : in std_logic := '0';
         reset : in std_logic := '0';
@@ -43,7 +44,7 @@ architecture rtl of lepton_manager is
     signal header_3_last_nibbles : std_logic_vector(11 downto 0);
 
     constant CLOCK_TICKS_PER_37_MS  : integer := 37 * (INPUT_CLK_FREQ / 1e3);  -- the timeout delay for a frame
-    constant CLOCK_TICKS_PER_200_MS : integer := 200 * (INPUT_CLK_FREQ / 1e3);
+    constant CLOCK_TICKS_PER_200_MS : integer := SYNC_DELAY_MS * (INPUT_CLK_FREQ / 1e3);  -- SYNC_DELAY_MS (200 ms on hardware)
     constant CLOCK_TICKS_PER_200_NS : integer := (200 * (INPUT_CLK_FREQ / 1e6)) / 1e3;
     constant BYTES_PER_HEADER       : integer := 4;
     constant BYTES_PER_PAYLOAD      : integer := 160;
@@ -1,8 +1,32 @@
 library ieee;
 use ieee.std_logic_1164.all;
 use ieee.numeric_std.all;
+use work.utils.all;
+
+-- Frame statistics: MIN, MAX, SUM and a histogram.
+--
+-- Histogram: pixel p goes in bin (p - hist_offset) >> hist_shift, saturated to
+-- the last bin (pixels below hist_offset go in bin 0). hist_offset and
+-- hist_shift are sampled at the start of each frame. There is one histogram
+-- per frame bank: the frame is accumulated in the one of hist_bank, and
+-- hist_rdbank/hist_rdaddress select the bin read on hist_q (1 cycle latency).
+-- A second read port (eq_*) serves the equalization of level_adjuster.
+-- stat_hist_offset and stat_hist_shift are the settings used for the frame.
+--
+-- A bin is updated with a read-modify-write over 3 cycles, which is fine as
+-- byte2pix outputs at most a pixel every 2 SPI bytes. The bins are cleared at
+-- the start of a frame by a valid bit per bin, so that no clearing pass is
+-- needed.
+--
+-- The bins are read by the read-modify-write, hist_rdaddress and
+-- eq_rdaddress at the same time. A block RAM has a single read port next to
+-- its write port, so the bins are kept in three copies written together, one
+-- per reader: 3 M10K for up to 256 bins, 6 for 512, 12 for 1024 and 24 for
+-- 2048. The valid bits are 2 * HIST_BINS registers.
 
 entity lepton_stats is
+    generic(
+        HIST_BINS : positive := 64);  -- power of 2, 64 to 2048
     port(
         clk        : in  std_logic;
         reset      : in  std_logic;
@@ -13,7 +37,21 @@ entity lepton_stats is
         stat_min   : out std_logic_vector(13 downto 0);
         stat_max   : out std_logic_vector(13 downto 0);
         stat_sum   : out std_logic_vector(26 downto 0);
-        stat_valid : out std_logic);
+        stat_valid : out std_logic;
+
+        hist_offset    : in  std_logic_vector(13 downto 0);
+        hist_shift     : in  std_logic_vector(3 downto 0);
+        hist_bank      : in  std_logic;
+        hist_rdbank    : in  std_logic;
+        hist_rdaddress : in  std_logic_vector(bitlength(HIST_BINS - 1) - 1 downto 0);
+        hist_q         : out std_logic_vector(15 downto 0);
+
+        stat_hist_offset : out std_logic_vector(13 downto 0);
+        stat_hist_shift  : out std_logic_vector(3 downto 0);
+
+        eq_rdbank    : in  std_logic;
+        eq_rdaddress : in  std_logic_vector(bitlength(HIST_BINS - 1) - 1 downto 0);
+        eq_q         : out std_logic_vector(15 downto 0));
 end lepton_stats;
 
 architecture rtl of lepton_stats is
@@ -21,6 +59,31 @@ architecture rtl of lepton_stats is
     signal u_resized_pix_data            : unsigned(stat_sum'range);
     signal running_min, running_max      : unsigned(stat_min'range);
     signal running_sum, next_running_sum : unsigned(stat_sum'range);
+
+    -- Histograms of both banks: bank & bin. One copy per reader.
+    subtype hist_address_t is unsigned(hist_rdaddress'length downto 0);
+    type hist_ram_t is array (0 to 2 * HIST_BINS - 1) of unsigned(hist_q'range);
+    signal hist_ram_inc : hist_ram_t := (others => (others => '0'));
+    signal hist_ram_rd  : hist_ram_t := (others => (others => '0'));
+    signal hist_ram_eq  : hist_ram_t := (others => (others => '0'));
+    signal hist_valid   : std_logic_vector(0 to 2 * HIST_BINS - 1);
+
+    signal frame_offset : unsigned(hist_offset'range);
+    signal frame_shift  : unsigned(hist_shift'range);
+
+    -- Read-modify-write pipeline
+    signal inc_address : hist_address_t;
+    signal inc_read    : std_logic;
+    signal inc_write   : std_logic;
+    signal inc_q       : unsigned(hist_q'range);
+    signal inc_data    : unsigned(hist_q'range);
+    signal rd_address  : hist_address_t;
+    signal rd_q        : unsigned(hist_q'range);
+    signal rd_valid    : std_logic;
+    signal eq_address  : hist_address_t;
+    signal eq_rd_q     : unsigned(hist_q'range);
+    signal eq_valid    : std_logic;
+
 begin
     u_pix_data         <= unsigned(pix_data);
     u_resized_pix_data <= resize(u_pix_data, running_sum'length);
@@ -58,4 +121,96 @@ begin
     stat_max   <= std_logic_vector(running_max);
     stat_sum   <= std_logic_vector(next_running_sum);
     stat_valid <= pix_eof and pix_valid;
+
+    -- Stage 1: bin address, clear the bank at the start of a frame.
+    p_hist_bin : process(clk, reset)
+        variable offset : unsigned(hist_offset'range);
+        variable shift  : unsigned(hist_shift'range);
+    begin
+        if reset = '1' then
+            frame_offset <= (others => '0');
+            frame_shift  <= (others => '0');
+            inc_address  <= (others => '0');
+            inc_read     <= '0';
+            inc_write    <= '0';
+            hist_valid   <= (others => '0');
+        elsif rising_edge(clk) then
+            inc_read  <= '0';
+            inc_write <= inc_read;
+
+            if pix_valid = '1' then
+                offset := frame_offset;
+                shift  := frame_shift;
+
+                if pix_sof = '1' then
+                    offset       := unsigned(hist_offset);
+                    shift        := unsigned(hist_shift);
+                    frame_offset <= offset;
+                    frame_shift  <= shift;
+
+                    if hist_bank = '0' then
+                        hist_valid(0 to HIST_BINS - 1) <= (others => '0');
+                    else
+                        hist_valid(HIST_BINS to 2 * HIST_BINS - 1) <= (others => '0');
+                    end if;
+                end if;
+
+                inc_address <= hist_bank & hist_bin(u_pix_data, offset, shift, HIST_BINS);
+                inc_read    <= '1';
+            end if;
+
+            -- Stage 3: count the pixel (an invalid bin counts from 0).
+            if inc_write = '1' then
+                hist_valid(to_integer(inc_address)) <= '1';
+            end if;
+        end if;
+    end process p_hist_bin;
+
+    -- Stage 2: read the bin. Stage 3: write it back incremented, to every
+    -- copy.
+    inc_data <= inc_q + 1 when hist_valid(to_integer(inc_address)) = '1' else
+                to_unsigned(1, hist_q'length);
+
+    p_hist_ram_inc : process(clk)
+    begin
+        if rising_edge(clk) then
+            if inc_write = '1' then
+                hist_ram_inc(to_integer(inc_address)) <= inc_data;
+            end if;
+
+            inc_q <= hist_ram_inc(to_integer(inc_address));
+        end if;
+    end process p_hist_ram_inc;
+
+    p_hist_ram_rd : process(clk)
+    begin
+        if rising_edge(clk) then
+            if inc_write = '1' then
+                hist_ram_rd(to_integer(inc_address)) <= inc_data;
+            end if;
+
+            rd_q     <= hist_ram_rd(to_integer(rd_address));
+            rd_valid <= hist_valid(to_integer(rd_address));
+        end if;
+    end process p_hist_ram_rd;
+
+    p_hist_ram_eq : process(clk)
+    begin
+        if rising_edge(clk) then
+            if inc_write = '1' then
+                hist_ram_eq(to_integer(inc_address)) <= inc_data;
+            end if;
+
+            eq_rd_q  <= hist_ram_eq(to_integer(eq_address));
+            eq_valid <= hist_valid(to_integer(eq_address));
+        end if;
+    end process p_hist_ram_eq;
+
+    rd_address <= hist_rdbank & unsigned(hist_rdaddress);
+    hist_q     <= std_logic_vector(rd_q) when rd_valid = '1' else (others => '0');
+    eq_address <= eq_rdbank & unsigned(eq_rdaddress);
+    eq_q       <= std_logic_vector(eq_rd_q) when eq_valid = '1' else (others => '0');
+
+    stat_hist_offset <= std_logic_vector(frame_offset);
+    stat_hist_shift  <= std_logic_vector(frame_shift);
 end rtl;
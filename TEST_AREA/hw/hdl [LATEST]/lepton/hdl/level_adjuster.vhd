@@ -1,41 +1,280 @@
 library ieee;
 use ieee.std_logic_1164.all;
 use ieee.numeric_std.all;
+use work.utils.all;
+
+-- Maps the RAW pixels of a frame to 0 - 0x3fff (the ADJUSTED buffer).
+--
+-- Mappings (mode):
+--   "00" linear:    (p - MIN) * 0x3fff / (MAX - MIN), 0 if MAX = MIN
+--   "01" gamma:     gamma_lut(linear >> 4), 1024 entries written by software
+--   "10" equalized: (number of pixels in the bins up to bin(p)) * 0x3fff /
+--                   IMAGE_SIZE, from the histogram of the frame
+--
+-- The division of the linear mapping is a multiplication by a reciprocal
+-- computed once per frame, m = ceil(0x3fff * 2^28 / (MAX - MIN)).
+-- ((p - MIN) * m) >> 28 is exactly the quotient of the division, as
+-- (p - MIN) * (MAX - MIN) < 2^28, so the result is the same as with the
+-- lpm_divider this replaces. The same holds for the equalization table with
+-- IMAGE_SIZE and a shift of 25.
+--
+-- A setup_start pulse computes the reciprocal (42 cycles) and the
+-- equalization table (HIST_BINS + 3 cycles) of the frame in setup_bank, then
+-- pulses setup_done. The pixels are mapped with the parameters of their bank:
+-- one pixel per clock, 5 cycles of latency.
 
 entity level_adjuster is
+    generic(
+        HIST_BINS : positive := 64);
     port(
-        clk            : in  std_logic;
+        clk   : in std_logic;
+        reset : in std_logic;
+
+        -- Frame setup
+        setup_start  : in  std_logic;
+        setup_bank   : in  std_logic;
+        setup_min    : in  std_logic_vector(13 downto 0);
+        setup_max    : in  std_logic_vector(13 downto 0);
+        setup_done   : out std_logic;
+        eq_rdaddress : out std_logic_vector(bitlength(HIST_BINS - 1) - 1 downto 0);  -- histogram of setup_bank
+        eq_q         : in  std_logic_vector(15 downto 0);
+
+        -- Gamma table
+        gamma_wraddress : in std_logic_vector(9 downto 0);
+        gamma_wrdata    : in std_logic_vector(13 downto 0);
+        gamma_wren      : in std_logic;
+
+        -- Pixels
+        mode           : in  std_logic_vector(1 downto 0);
+        raw_bank       : in  std_logic;
+        raw_min        : in  std_logic_vector(13 downto 0);  -- of raw_bank
+        hist_offset    : in  std_logic_vector(13 downto 0);  -- of raw_bank
+        hist_shift     : in  std_logic_vector(3 downto 0);   -- of raw_bank
         raw_pixel      : in  std_logic_vector(13 downto 0);
-        raw_max        : in  std_logic_vector(13 downto 0);
-        raw_min        : in  std_logic_vector(13 downto 0);
-        raw_sum        : in  std_logic_vector(26 downto 0);
         adjusted_pixel : out std_logic_vector(13 downto 0));
 end level_adjuster;
 
 architecture rtl of level_adjuster is
-    component lpm_divider
-        port(
-            clock    : in  std_logic;
-            denom    : in  std_logic_vector(13 downto 0);
-            numer    : in  std_logic_vector(27 downto 0);
-            quotient : out std_logic_vector(27 downto 0);
-            remain   : out std_logic_vector(13 downto 0));
-    end component;
-
-    signal denom    : std_logic_vector(13 downto 0);
-    signal numer    : std_logic_vector(27 downto 0);
-    signal quotient : std_logic_vector(27 downto 0);
+    constant MODE_GAMMA     : std_logic_vector(mode'range) := "01";
+    constant MODE_EQUALIZED : std_logic_vector(mode'range) := "10";
+
+    constant PIXEL_MAX   : natural := 16#3fff#;
+    constant RECIP_SHIFT : natural := 28;
+    constant EQ_SHIFT    : natural := 25;
+
+    -- ceil(PIXEL_MAX * 2^EQ_SHIFT / IMAGE_SIZE), IMAGE_SIZE = 80 * 60
+    constant EQ_RECIP : unsigned(26 downto 0) := to_unsigned(114525471, 27);
+
+    constant BIN_BITS : positive := bitlength(HIST_BINS - 1);
+
+    subtype pixel_t is unsigned(13 downto 0);
+    subtype recip_t is unsigned(RECIP_SHIFT + pixel_t'length - 1 downto 0);
+    type recip_banks_t is array (0 to 1) of recip_t;
+    type eq_lut_t is array (0 to 2 * HIST_BINS - 1) of pixel_t;
+    type gamma_lut_t is array (0 to 1023) of pixel_t;
+
+    signal recip_banks : recip_banks_t;
+    signal eq_lut      : eq_lut_t    := (others => (others => '0'));
+    signal gamma_lut   : gamma_lut_t := (others => (others => '0'));
+
+    -- Reciprocal: restoring division of PIXEL_MAX * 2^RECIP_SHIFT
+    signal div_busy      : std_logic;
+    signal div_step      : natural range 0 to recip_t'length - 1;
+    signal div_denom     : unsigned(pixel_t'range);
+    signal div_remainder : unsigned(pixel_t'length downto 0);
+    signal div_quotient  : recip_t;
+
+    -- Equalization table: cumulative histogram
+    signal eq_busy        : std_logic;
+    signal eq_bin         : unsigned(BIN_BITS - 1 downto 0);
+    signal eq_wr          : std_logic;
+    signal eq_wrbin       : unsigned(BIN_BITS - 1 downto 0);
+    signal eq_cumsum      : unsigned(15 downto 0);
+    signal eq_lut_wren    : std_logic;
+    signal eq_lut_address : unsigned(BIN_BITS downto 0);
+    signal eq_lut_data    : pixel_t;
+    signal setup_bank_reg : std_logic;
+    signal setup_busy     : std_logic;
+
+    -- Pixel pipeline
+    signal s1_x        : pixel_t;
+    signal s1_recip    : recip_t;
+    signal s1_eq_addr  : unsigned(BIN_BITS downto 0);
+    signal s2_product  : unsigned(pixel_t'length + recip_t'length - 1 downto 0);
+    signal s2_eq       : pixel_t;
+    signal s3_linear   : pixel_t;
+    signal s3_eq       : pixel_t;
+    signal s4_linear   : pixel_t;
+    signal s4_gamma    : pixel_t;
+    signal s4_eq       : pixel_t;
+    signal s5_adjusted : pixel_t;
+
 begin
-    lpm_divider0 : lpm_divider
-    port map(
-        clock    => clk,
-        denom    => denom,
-        numer    => numer,
-        quotient => quotient,
-        remain   => open);
-
-    numer          <= std_logic_vector((unsigned(raw_pixel) - unsigned(raw_min)) * resize(X"3fff", raw_pixel'length));
-    denom          <= std_logic_vector(unsigned(raw_max) - unsigned(raw_min));
-    adjusted_pixel <= quotient(13 downto 0);
+    eq_rdaddress <= std_logic_vector(eq_bin);
+
+    p_setup : process(clk, reset)
+        variable partial   : unsigned(div_remainder'range);
+        variable numer_bit : std_logic;
+        variable quotient  : recip_t;
+        variable cumsum    : unsigned(eq_cumsum'range);
+        variable product   : unsigned(cumsum'length + EQ_RECIP'length - 1 downto 0);
+    begin
+        if reset = '1' then
+            recip_banks    <= (others => (others => '0'));
+            div_busy       <= '0';
+            div_step       <= 0;
+            div_denom      <= (others => '0');
+            div_remainder  <= (others => '0');
+            div_quotient   <= (others => '0');
+            eq_busy        <= '0';
+            eq_bin         <= (others => '0');
+            eq_wr          <= '0';
+            eq_wrbin       <= (others => '0');
+            eq_cumsum      <= (others => '0');
+            eq_lut_wren    <= '0';
+            eq_lut_address <= (others => '0');
+            eq_lut_data    <= (others => '0');
+            setup_bank_reg <= '0';
+            setup_busy     <= '0';
+            setup_done     <= '0';
+        elsif rising_edge(clk) then
+            setup_done <= '0';
+
+            -- One quotient bit per cycle. The numerator is PIXEL_MAX
+            -- (14 ones) followed by RECIP_SHIFT zeros.
+            if div_busy = '1' then
+                if div_step >= RECIP_SHIFT then
+                    numer_bit := '1';
+                else
+                    numer_bit := '0';
+                end if;
+
+                quotient := div_quotient;
+                partial  := div_remainder(div_remainder'high - 1 downto 0) & numer_bit;
+                if partial >= div_denom then
+                    partial            := partial - div_denom;
+                    quotient(div_step) := '1';
+                else
+                    quotient(div_step) := '0';
+                end if;
+                div_quotient  <= quotient;
+                div_remainder <= partial;
+
+                if div_step = 0 then
+                    -- Ceiling: add 1 if there is a remainder. MAX = MIN
+                    -- gives 0.
+                    if div_denom = 0 then
+                        quotient := (others => '0');
+                    elsif partial /= 0 then
+                        quotient := quotient + 1;
+                    end if;
+
+                    if setup_bank_reg = '1' then
+                        recip_banks(1) <= quotient;
+                    else
+                        recip_banks(0) <= quotient;
+                    end if;
+
+                    div_busy <= '0';
+                else
+                    div_step <= div_step - 1;
+                end if;
+            end if;
+
+            -- Bin eq_bin is read at this edge, its count arrives on eq_q
+            -- during the next cycle.
+            if eq_busy = '1' then
+                if eq_bin = HIST_BINS - 1 then
+                    eq_busy <= '0';
+                end if;
+                eq_bin <= eq_bin + 1;
+            end if;
+            eq_wr    <= eq_busy;
+            eq_wrbin <= eq_bin;
+
+            eq_lut_wren <= eq_wr;
+            if eq_wr = '1' then
+                cumsum    := eq_cumsum + unsigned(eq_q);
+                eq_cumsum <= cumsum;
+
+                product        := cumsum * EQ_RECIP;
+                eq_lut_address <= setup_bank_reg & eq_wrbin;
+                eq_lut_data    <= product(EQ_SHIFT + pixel_t'length - 1 downto EQ_SHIFT);
+            end if;
+
+            if setup_busy = '1' and div_busy = '0' and eq_busy = '0' and eq_wr = '0' and eq_lut_wren = '0' then
+                setup_busy <= '0';
+                setup_done <= '1';
+            end if;
+
+            if setup_start = '1' then
+                setup_bank_reg <= setup_bank;
+                setup_busy     <= '1';
+
+                div_busy      <= '1';
+                div_step      <= recip_t'high;
+                div_denom     <= unsigned(setup_max) - unsigned(setup_min);
+                div_remainder <= (others => '0');
+
+                eq_busy   <= '1';
+                eq_bin    <= (others => '0');
+                eq_cumsum <= (others => '0');
+            end if;
+        end if;
+    end process p_setup;
+
+    p_gamma_lut : process(clk)
+    begin
+        if rising_edge(clk) then
+            if gamma_wren = '1' then
+                gamma_lut(to_integer(unsigned(gamma_wraddress))) <= unsigned(gamma_wrdata);
+            end if;
+
+            -- Stage 4
+            s4_gamma <= gamma_lut(to_integer(s3_linear(13 downto 4)));
+        end if;
+    end process p_gamma_lut;
+
+    p_pixel : process(clk)
+        variable bank : natural range 0 to 1;
+    begin
+        if rising_edge(clk) then
+            if eq_lut_wren = '1' then
+                eq_lut(to_integer(eq_lut_address)) <= eq_lut_data;
+            end if;
+
+            if raw_bank = '1' then
+                bank := 1;
+            else
+                bank := 0;
+            end if;
+
+            -- Stage 1
+            s1_x       <= unsigned(raw_pixel) - unsigned(raw_min);
+            s1_recip   <= recip_banks(bank);
+            s1_eq_addr <= raw_bank & hist_bin(unsigned(raw_pixel), unsigned(hist_offset), unsigned(hist_shift), HIST_BINS);
+
+            -- Stage 2
+            s2_product <= s1_x * s1_recip;
+            s2_eq      <= eq_lut(to_integer(s1_eq_addr));
+
+            -- Stage 3
+            s3_linear <= s2_product(RECIP_SHIFT + pixel_t'length - 1 downto RECIP_SHIFT);
+            s3_eq     <= s2_eq;
+
+            -- Stage 4 (+ s4_gamma)
+            s4_linear <= s3_linear;
+            s4_eq     <= s3_eq;
+
+            -- Stage 5
+            case mode is
+                when MODE_GAMMA     => s5_adjusted <= s4_gamma;
+                when MODE_EQUALIZED => s5_adjusted <= s4_eq;
+                when others         => s5_adjusted <= s4_linear;  -- MODE_LINEAR
+            end case;
+        end if;
+    end process p_pixel;
+
+    adjusted_pixel <= std_logic_vector(s5_adjusted);
 
 end rtl;
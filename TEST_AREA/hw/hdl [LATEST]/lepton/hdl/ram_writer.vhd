@@ -9,14 +9,15 @@ entity ram_writer is
         pix_valid     : in  std_logic;
         pix_sof       : in  std_logic;
         pix_eof       : in  std_logic;
+        bank          : in  std_logic;  -- frame bank (MSB of the address)
         ram_data      : out std_logic_vector(15 downto 0);
         ram_wren      : out std_logic;
-        ram_wraddress : out std_logic_vector(12 downto 0));
+        ram_wraddress : out std_logic_vector(13 downto 0));
 
 end ram_writer;
 
 architecture rtl of ram_writer is
-    signal wraddress_counter : unsigned(ram_wraddress'range);
+    signal wraddress_counter : unsigned(ram_wraddress'high - 1 downto 0);
 begin
     p_address_gen : process(clk, reset)
     begin
@@ -33,6 +34,6 @@ begin
 
     ram_data      <= "00" & pix_data;
     ram_wren      <= pix_valid;
-    ram_wraddress <= std_logic_vector(wraddress_counter);
+    ram_wraddress <= bank & std_logic_vector(wraddress_counter);
 
 end rtl;
@@ -4,6 +4,10 @@ use ieee.numeric_std.all;
 
 package utils is
     function bitlength(number : positive) return positive;
+    function hist_bin(pix    : unsigned(13 downto 0);
+                      offset : unsigned(13 downto 0);
+                      shift  : unsigned(3 downto 0);
+                      bins   : positive) return unsigned;
 
 end package utils;
 
@@ -24,4 +28,25 @@ package body utils is
         end loop;
     end function bitlength;
 
+    -- purpose: returns the histogram bin of a pixel: (pix - offset) >> shift,
+    --          saturated to 0 and bins - 1 (on bitlength(bins - 1) bits)
+    function hist_bin(pix    : unsigned(13 downto 0);
+                      offset : unsigned(13 downto 0);
+                      shift  : unsigned(3 downto 0);
+                      bins   : positive) return unsigned is
+        constant BIN_BITS : positive := bitlength(bins - 1);
+        variable bin      : unsigned(pix'range);
+    begin
+        if pix < offset then
+            return to_unsigned(0, BIN_BITS);
+        end if;
+
+        bin := shift_right(pix - offset, to_integer(shift));
+        if bin > bins - 1 then
+            return to_unsigned(bins - 1, BIN_BITS);
+        end if;
+
+        return resize(bin, BIN_BITS);
+    end function hist_bin;
+
 end package body utils;
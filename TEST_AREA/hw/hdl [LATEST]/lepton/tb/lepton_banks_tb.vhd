@@ -0,0 +1,300 @@
+-- Testbench for the frame banks of the lepton core.
+--
+-- A VoSPI model sends a new frame every time CS_n is asserted: a discard
+-- packet, the 60 lines of the frame, then discard packets until CS_n is
+-- released. Pixel (row, col) of frame f is f * 2500 + row * 80 + col, so
+-- every frame up to 3 stays within the 14 bits of a pixel (at most 12299).
+--
+-- The core captures in continuous mode. Software acquires frame 0 and holds
+-- it while frame 1 is captured in the other bank, then acquires frame 1.
+-- It then skips the ACQUIRE of frame 2, which frame 3 overwrites (DROPPED),
+-- and acquires frame 3. The pixels, statistics and histogram of the held
+-- frame are checked each time. The sync delay between frames is shortened to
+-- 1 ms.
+
+library ieee;
+use ieee.std_logic_1164.all;
+use ieee.numeric_std.all;
+
+entity lepton_banks_tb is
+end lepton_banks_tb;
+
+architecture tb of lepton_banks_tb is
+    signal clk       : std_logic                     := '0';
+    signal reset     : std_logic                     := '0';
+    signal address   : std_logic_vector(13 downto 0) := (others => '0');
+    signal readdata  : std_logic_vector(15 downto 0) := (others => '0');
+    signal writedata : std_logic_vector(15 downto 0) := (others => '0');
+    signal read      : std_logic                     := '0';
+    signal write     : std_logic                     := '0';
+    signal SCLK      : std_logic                     := '1';
+    signal CSn       : std_logic                     := '1';
+    signal MOSI      : std_logic                     := '0';
+    signal MISO      : std_logic                     := '1';
+
+    constant CLK_PERIOD : time := 20 ns;
+
+    signal sim_ended : boolean := false;
+
+    -- Register map (see lepton.vhd)
+    constant COMMAND_REG : natural := 0;
+    constant STATUS_REG  : natural := 1;
+    constant MIN_REG     : natural := 2;
+    constant MAX_REG     : natural := 3;
+    constant BANK_REG    : natural := 7;
+    constant RAW_BUFFER  : natural := 8;
+    constant HIST_SHIFT  : natural := 4865;
+    constant HIST_BINS   : natural := 4866;
+    constant HISTOGRAM   : natural := 5120;
+
+    constant COMMAND_START      : natural := 16#01#;
+    constant COMMAND_CONTINUOUS : natural := 16#02#;
+    constant BANK_ACQUIRE       : natural := 16#01#;
+    constant BANK_RELEASE       : natural := 16#02#;
+    constant BANK_FRAME_READY   : natural := 16#04#;
+    constant BANK_HOLD          : natural := 16#08#;
+
+    constant NUM_ROWS         : natural := 60;
+    constant NUM_COLS         : natural := 80;
+    constant BYTES_PER_PACKET : natural := 164;
+
+    function pixel_value(frame, row, col : natural) return natural is
+    begin
+        return frame * 2500 + row * NUM_COLS + col;
+    end function pixel_value;
+
+    -- Number of pixels of 'frame' in [first, last]: the pixels of a frame
+    -- are all the values from pixel_value(frame, 0, 0) on.
+    function pixel_count(frame, first, last : natural) return natural is
+        constant LO : natural := pixel_value(frame, 0, 0);
+        constant HI : natural := pixel_value(frame, NUM_ROWS - 1, NUM_COLS - 1);
+    begin
+        if last < LO or first > HI then
+            return 0;
+        elsif last > HI then
+            return pixel_count(frame, first, HI);
+        elsif first < LO then
+            return pixel_count(frame, LO, last);
+        end if;
+        return last - first + 1;
+    end function pixel_count;
+
+    -- Byte 'index' of the stream sent for 'frame' after CS_n is asserted.
+    function vospi_byte(frame, index : natural) return std_logic_vector is
+        variable packet : natural := index / BYTES_PER_PACKET;
+        variable pos    : natural := index mod BYTES_PER_PACKET;
+        variable pixel  : unsigned(15 downto 0);
+    begin
+        -- Discard packets (ID = xFxx) before and after the frame
+        if packet = 0 or packet > NUM_ROWS then
+            if pos = 0 then
+                return X"0F";
+            end if;
+            return X"FF";
+        end if;
+
+        case pos is
+            when 0      => return X"00";  -- ID: line number (< 256)
+            when 1      => return std_logic_vector(to_unsigned(packet - 1, 8));
+            when 2 | 3  => return X"00";  -- CRC (not checked)
+            when others =>
+                pixel := to_unsigned(pixel_value(frame, packet - 1, (pos - 4) / 2), 16);
+                if (pos - 4) mod 2 = 0 then
+                    return std_logic_vector(pixel(15 downto 8));
+                end if;
+                return std_logic_vector(pixel(7 downto 0));
+        end case;
+    end function vospi_byte;
+
+begin
+    dut : entity work.lepton
+    generic map(
+        SYNC_DELAY_MS => 1
+    )
+    port map(
+        clk       => clk,
+        reset     => reset,
+        address   => address,
+        readdata  => readdata,
+        writedata => writedata,
+        read      => read,
+        write     => write,
+        SCLK      => SCLK,
+        CSn       => CSn,
+        MOSI      => MOSI,
+        MISO      => MISO
+    );
+
+    clk <= not clk after CLK_PERIOD / 2 when not sim_ended else '0';
+
+    -- VoSPI model (SPI mode 3: MISO changes on the falling edge of SCLK)
+    vospi : process
+        variable frame : natural := 0;
+        variable index : natural;
+        variable byte  : std_logic_vector(7 downto 0);
+    begin
+        wait until CSn = '0';
+        index := 0;
+
+        l_bytes : while CSn = '0' loop
+            byte := vospi_byte(frame, index);
+
+            for i in 7 downto 0 loop
+                wait until falling_edge(SCLK) or CSn = '1';
+                exit l_bytes when CSn = '1';
+                MISO <= byte(i);
+            end loop;
+
+            index := index + 1;
+        end loop;
+
+        MISO  <= '1';
+        frame := frame + 1;
+    end process vospi;
+
+    stimuli : process
+        variable value : natural;
+        variable bank  : natural;
+        variable bins  : natural;
+        variable shift : natural;
+
+        procedure write_register(constant regno : in natural;
+                                 constant val   : in natural) is
+        begin
+            wait until rising_edge(clk);
+            address   <= std_logic_vector(to_unsigned(regno, address'length));
+            writedata <= std_logic_vector(to_unsigned(val, writedata'length));
+            write     <= '1';
+            wait until rising_edge(clk);
+            write     <= '0';
+        end procedure write_register;
+
+        -- The slave has 9 wait states.
+        procedure read_register(constant regno : in  natural;
+                                variable val   : out natural) is
+        begin
+            wait until rising_edge(clk);
+            address <= std_logic_vector(to_unsigned(regno, address'length));
+            read    <= '1';
+            for i in 1 to 10 loop
+                wait until rising_edge(clk);
+            end loop;
+            val  := to_integer(unsigned(readdata));
+            read <= '0';
+        end procedure read_register;
+
+        procedure wait_frame_ready is
+        begin
+            loop
+                read_register(BANK_REG, value);
+                exit when (value / BANK_FRAME_READY) mod 2 = 1;
+                wait for 100 us;
+            end loop;
+        end procedure wait_frame_ready;
+
+        -- Check a few pixels and the statistics of the frame in READ_BANK.
+        procedure check_frame(constant frame : in natural) is
+            type positions_t is array (0 to 3) of natural;
+            constant ROWS : positions_t := (0, 0, 31, 59);
+            constant COLS : positions_t := (0, 1, 40, 79);
+        begin
+            for i in positions_t'range loop
+                read_register(RAW_BUFFER + ROWS(i) * NUM_COLS + COLS(i), value);
+                assert value = pixel_value(frame, ROWS(i), COLS(i))
+                report "Unexpected pixel (" & integer'image(ROWS(i)) & ", " & integer'image(COLS(i)) & "): " &
+                "value = " & integer'image(value) & "; " &
+                "value_expected = " & integer'image(pixel_value(frame, ROWS(i), COLS(i)))
+                severity error;
+            end loop;
+
+            read_register(MIN_REG, value);
+            assert value = pixel_value(frame, 0, 0)
+            report "Unexpected MIN: " & integer'image(value) severity error;
+
+            read_register(MAX_REG, value);
+            assert value = pixel_value(frame, NUM_ROWS - 1, NUM_COLS - 1)
+            report "Unexpected MAX: " & integer'image(value) severity error;
+
+            -- HIST_OFFSET = 0: bin i holds [i << shift, (i + 1) << shift[,
+            -- the last bin everything above.
+            for i in 0 to bins - 1 loop
+                read_register(HISTOGRAM + i, value);
+                if i = bins - 1 then
+                    assert value = pixel_count(frame, i * 2 ** shift, 16#3fff#)
+                    report "Unexpected last bin: " & integer'image(value) severity error;
+                else
+                    assert value = pixel_count(frame, i * 2 ** shift, (i + 1) * 2 ** shift - 1)
+                    report "Unexpected bin " & integer'image(i) & ": " & integer'image(value) severity error;
+                end if;
+            end loop;
+        end procedure check_frame;
+
+    begin
+        reset <= '1';
+        wait for 2 * CLK_PERIOD;
+        reset <= '0';
+        wait for CLK_PERIOD;
+
+        read_register(HIST_BINS, bins);
+        read_register(HIST_SHIFT, shift);
+        assert bins = 64 and shift = 8 report "Unexpected default histogram settings" severity error;
+
+        write_register(COMMAND_REG, COMMAND_START + COMMAND_CONTINUOUS);
+
+        -- Frame 0
+        wait_frame_ready;
+        write_register(BANK_REG, BANK_ACQUIRE);
+
+        read_register(BANK_REG, value);
+        assert (value / BANK_HOLD) mod 2 = 1 report "HOLD not set" severity error;
+        assert (value / BANK_FRAME_READY) mod 2 = 0 report "FRAME_READY not cleared" severity error;
+        bank := value mod 2;
+
+        check_frame(0);
+
+        -- Frame 1 is captured in the other bank while frame 0 is held.
+        wait_frame_ready;
+        check_frame(0);
+
+        write_register(BANK_REG, BANK_ACQUIRE);
+        read_register(BANK_REG, value);
+        assert value mod 2 /= bank report "READ_BANK did not change" severity error;
+        assert value / 256 = 0 report "Unexpected DROPPED: " & integer'image(value / 256) severity error;
+
+        check_frame(1);
+
+        -- Frame 2 is complete but not acquired: frame 3 overwrites it.
+        wait_frame_ready;
+        loop
+            read_register(BANK_REG, value);
+            exit when (value / BANK_FRAME_READY) mod 2 = 0;
+            wait for 100 us;
+        end loop;
+        assert value / 256 = 1 report "Unexpected DROPPED after a skipped ACQUIRE: " & integer'image(value / 256) severity error;
+        assert value mod 2 /= bank report "READ_BANK changed without ACQUIRE" severity error;
+
+        -- The held frame is untouched.
+        check_frame(1);
+
+        wait_frame_ready;
+        write_register(BANK_REG, BANK_ACQUIRE);
+        read_register(BANK_REG, value);
+        assert value / 256 = 1 report "Unexpected DROPPED: " & integer'image(value / 256) severity error;
+
+        check_frame(3);
+
+        -- Stop after the current frame.
+        write_register(BANK_REG, BANK_RELEASE);
+        write_register(COMMAND_REG, 0);
+
+        loop
+            read_register(STATUS_REG, value);
+            exit when value mod 2 = 0;
+            wait for 100 us;
+        end loop;
+
+        sim_ended <= true;
+        wait;
+    end process stimuli;
+
+end tb;
@@ -0,0 +1,230 @@
+-- Testbench for the level adjuster.
+--
+-- Linear mode is compared with the previous design, the lpm_divider fed with
+-- (p - MIN) * 0x3fff / (MAX - MIN), for random pixels streamed one per clock
+-- into both. Both have 5 cycles of latency, so every output is checked in
+-- the cycle it is produced. MAX = MIN is excluded: lpm_divider is undefined
+-- there, the new design outputs 0. The gamma and equalized modes are checked
+-- against a few values computed here.
+
+library ieee;
+use ieee.std_logic_1164.all;
+use ieee.numeric_std.all;
+use ieee.math_real.all;
+
+entity level_adjuster_tb is
+end level_adjuster_tb;
+
+architecture tb of level_adjuster_tb is
+    constant CLK_PERIOD : time     := 20 ns;
+    constant HIST_BINS  : positive := 64;
+    constant LATENCY    : positive := 5;
+    constant NUM_PIXELS : positive := 4800;
+
+    -- Uniform histogram: 75 pixels per bin
+    constant BIN_COUNT : natural := NUM_PIXELS / HIST_BINS;
+
+    signal clk       : std_logic := '0';
+    signal reset     : std_logic := '0';
+    signal sim_ended : boolean   := false;
+
+    signal setup_start     : std_logic                     := '0';
+    signal setup_bank      : std_logic                     := '0';
+    signal setup_min       : std_logic_vector(13 downto 0) := (others => '0');
+    signal setup_max       : std_logic_vector(13 downto 0) := (others => '0');
+    signal setup_done      : std_logic;
+    signal eq_rdaddress    : std_logic_vector(5 downto 0);
+    signal eq_q            : std_logic_vector(15 downto 0) := std_logic_vector(to_unsigned(BIN_COUNT, 16));  -- every bin
+    signal gamma_wraddress : std_logic_vector(9 downto 0)  := (others => '0');
+    signal gamma_wrdata    : std_logic_vector(13 downto 0) := (others => '0');
+    signal gamma_wren      : std_logic                     := '0';
+    signal mode            : std_logic_vector(1 downto 0)  := "00";
+    signal raw_bank        : std_logic                     := '0';
+    signal raw_min         : std_logic_vector(13 downto 0) := (others => '0');
+    signal hist_offset     : std_logic_vector(13 downto 0) := (others => '0');
+    signal hist_shift      : std_logic_vector(3 downto 0)  := "1000";
+    signal raw_pixel       : std_logic_vector(13 downto 0) := (others => '0');
+    signal adjusted_pixel  : std_logic_vector(13 downto 0);
+
+    -- Reference (previous design)
+    signal ref_numer    : std_logic_vector(27 downto 0);
+    signal ref_denom    : std_logic_vector(13 downto 0);
+    signal ref_quotient : std_logic_vector(27 downto 0);
+
+    -- Pixels in flight (compare(i): pixel sent i cycles ago) and results
+    signal compare     : std_logic_vector(0 to LATENCY) := (others => '0');
+    signal mismatches  : natural                        := 0;
+    signal comparisons : natural                        := 0;
+
+begin
+    dut : entity work.level_adjuster
+    generic map(
+        HIST_BINS => HIST_BINS
+    )
+    port map(
+        clk             => clk,
+        reset           => reset,
+        setup_start     => setup_start,
+        setup_bank      => setup_bank,
+        setup_min       => setup_min,
+        setup_max       => setup_max,
+        setup_done      => setup_done,
+        eq_rdaddress    => eq_rdaddress,
+        eq_q            => eq_q,
+        gamma_wraddress => gamma_wraddress,
+        gamma_wrdata    => gamma_wrdata,
+        gamma_wren      => gamma_wren,
+        mode            => mode,
+        raw_bank        => raw_bank,
+        raw_min         => raw_min,
+        hist_offset     => hist_offset,
+        hist_shift      => hist_shift,
+        raw_pixel       => raw_pixel,
+        adjusted_pixel  => adjusted_pixel
+    );
+
+    ref : entity work.lpm_divider
+    port map(
+        clock    => clk,
+        denom    => ref_denom,
+        numer    => ref_numer,
+        quotient => ref_quotient,
+        remain   => open
+    );
+
+    ref_numer <= std_logic_vector((unsigned(raw_pixel) - unsigned(raw_min)) * resize(X"3fff", raw_pixel'length));
+    ref_denom <= std_logic_vector(unsigned(setup_max) - unsigned(setup_min));
+
+    clk <= not clk after CLK_PERIOD / 2 when not sim_ended else '0';
+
+    p_compare : process(clk)
+    begin
+        if rising_edge(clk) then
+            if compare(LATENCY) = '1' then
+                comparisons <= comparisons + 1;
+                if adjusted_pixel /= ref_quotient(13 downto 0) then
+                    mismatches <= mismatches + 1;
+                    report "Mismatch: adjusted = " & integer'image(to_integer(unsigned(adjusted_pixel))) &
+                    ", lpm_divider = " & integer'image(to_integer(unsigned(ref_quotient(13 downto 0))))
+                    severity error;
+                end if;
+            end if;
+        end if;
+    end process p_compare;
+
+    stimuli : process
+        variable seed1, seed2 : positive := 42;
+        variable rand         : real;
+        variable cycles       : natural;
+        variable lo, hi       : natural;
+
+        type range_t is array (0 to 1) of natural;
+        type ranges_t is array (natural range <>) of range_t;
+        constant RANGES : ranges_t := ((0, 16#3fff#), (8000, 8001), (7900, 8400), (0, 1), (100, 16#3fff#), (16#3ffe#, 16#3fff#));
+
+        procedure setup(constant lo, hi : in natural) is
+        begin
+            wait until rising_edge(clk);
+            setup_min   <= std_logic_vector(to_unsigned(lo, setup_min'length));
+            setup_max   <= std_logic_vector(to_unsigned(hi, setup_max'length));
+            raw_min     <= std_logic_vector(to_unsigned(lo, raw_min'length));
+            setup_start <= '1';
+            wait until rising_edge(clk);
+            setup_start <= '0';
+
+            cycles := 1;
+            while setup_done /= '1' loop
+                wait until rising_edge(clk);
+                cycles := cycles + 1;
+            end loop;
+        end procedure setup;
+
+        -- Stream one pixel per clock, compared by p_compare.
+        procedure stream(constant lo, hi : in natural) is
+        begin
+            for i in 0 to NUM_PIXELS - 1 loop
+                uniform(seed1, seed2, rand);
+                -- Mostly in [lo, hi], a few values anywhere.
+                if i mod 16 = 0 then
+                    raw_pixel <= std_logic_vector(to_unsigned(integer(floor(rand * 16384.0)) mod 16384, raw_pixel'length));
+                else
+                    raw_pixel <= std_logic_vector(to_unsigned(lo + integer(floor(rand * real(hi - lo + 1))) mod (hi - lo + 1), raw_pixel'length));
+                end if;
+                compare <= '1' & compare(0 to LATENCY - 1);
+                wait until rising_edge(clk);
+            end loop;
+
+            for i in 0 to LATENCY loop
+                compare <= '0' & compare(0 to LATENCY - 1);
+                wait until rising_edge(clk);
+            end loop;
+        end procedure stream;
+
+        -- Map a single pixel and return the output.
+        procedure map_pixel(constant pixel : in natural; variable value : out natural) is
+        begin
+            raw_pixel <= std_logic_vector(to_unsigned(pixel, raw_pixel'length));
+            for i in 0 to LATENCY loop
+                wait until rising_edge(clk);
+            end loop;
+            value := to_integer(unsigned(adjusted_pixel));
+        end procedure map_pixel;
+
+        variable value : natural;
+
+    begin
+        reset <= '1';
+        wait for 2 * CLK_PERIOD;
+        reset <= '0';
+        wait until rising_edge(clk);
+
+        -- Linear: bit-exactness and throughput
+        for r in RANGES'range loop
+            lo := RANGES(r)(0);
+            hi := RANGES(r)(1);
+
+            setup(lo, hi);
+            report "MIN = " & integer'image(lo) & ", MAX = " & integer'image(hi) & ": setup in " & integer'image(cycles) & " cycles";
+
+            cycles := comparisons;
+            stream(lo, hi);
+            assert comparisons - cycles = NUM_PIXELS
+            report "Not one pixel per clock" severity error;
+        end loop;
+
+        -- MAX = MIN
+        setup(8000, 8000);
+        map_pixel(8000, value);
+        assert value = 0 report "MAX = MIN: unexpected " & integer'image(value) severity error;
+
+        -- Gamma: LUT[i] = 0x3fff - 16 * i
+        for i in 0 to 1023 loop
+            gamma_wraddress <= std_logic_vector(to_unsigned(i, gamma_wraddress'length));
+            gamma_wrdata    <= std_logic_vector(to_unsigned(16#3fff# - 16 * i, gamma_wrdata'length));
+            gamma_wren      <= '1';
+            wait until rising_edge(clk);
+        end loop;
+        gamma_wren <= '0';
+
+        setup(0, 16#3fff#);
+        mode <= "01";
+        for p in 0 to 1023 loop
+            map_pixel(p * 16 + 5, value);
+            assert value = 16#3fff# - 16 * p
+            report "Gamma: unexpected " & integer'image(value) & " for " & integer'image(p * 16 + 5) severity error;
+        end loop;
+
+        -- Equalized: bin b (HIST_SHIFT = 8) has (b + 1) * 75 pixels up to it.
+        mode <= "10";
+        for b in 0 to HIST_BINS - 1 loop
+            map_pixel(b * 256 + 128, value);
+            assert value = ((b + 1) * BIN_COUNT * 16#3fff#) / NUM_PIXELS
+            report "Equalized: unexpected " & integer'image(value) & " for bin " & integer'image(b) severity error;
+        end loop;
+
+        report "Linear: " & integer'image(comparisons) & " pixels compared, " & integer'image(mismatches) & " mismatches";
+        sim_ended <= true;
+        wait;
+    end process stimuli;
+
+end tb;
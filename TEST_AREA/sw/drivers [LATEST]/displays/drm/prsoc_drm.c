@@ -0,0 +1,561 @@
+/*
+ * @file prsoc_drm
+ * @date 19 Oct 2026
+ * @brief DRM/KMS driver for the displays of the PrSoC extension board.
+ *
+ * This driver is an alternative to ../fbdev/prsoc_fbdev.c for the same
+ * hardware (framebuffer_manager + vga_sequencer or LT24 controller) and the
+ * same device tree node ("prsoc,display"). Load one or the other.
+ *
+ * Instead of a single buffer allocated at probe time, the applications
+ * allocate as many buffers as they want (GEM CMA dumb buffers, or buffers
+ * imported from another device through PRIME) and show them with atomic
+ * commits. The display is a single plane/CRTC/connector pipeline, so the
+ * driver is built on the DRM simple display pipe helper.
+ *
+ * Page flips are tear-free: the framebuffer manager raises its IRQ once it
+ * has fetched the last pixel of a frame, and only reloads its start address
+ * at the beginning of the next frame. An atomic commit just records the new
+ * start address and pitch; the vsync ISR writes them to the framebuffer
+ * manager, which is then guaranteed to be done with the previous buffer, and
+ * completes the flip event of the commit. Non-blocking commits and page flip
+ * events (drmModePageFlip, DRM_MODE_PAGE_FLIP_EVENT) therefore work out of
+ * the box.
+ *
+ * The framebuffer manager has no interrupt at the start of a frame, so the
+ * flip event (and its timestamp) comes at the end of the fetch of the last
+ * frame of the old buffer, like the vblank interrupt of most display
+ * controllers: the old buffer may be reused from then on, but the new one
+ * is only shown from the next frame on, after the vertical blanking.
+ *
+ * The only format is XRGB8888 (the framebuffer manager drops the top byte).
+ * The pitch of a buffer may be larger than the screen: the difference is
+ * programmed in FRAME_EOL_BYTE_OFFSET.
+ *
+ * The display mode is fixed by the device tree. The timings themselves are
+ * programmed by 'prsoc,reg-init' as for prsoc_fbdev; the mode only exposes
+ * the visible area ('prsoc,screen-width', 'prsoc,screen-height') and the
+ * optional 'prsoc,refresh-rate' (Hz, defaults to 60). 'prsoc,burst-count'
+ * is used as is. 'prsoc,buffer-width' and 'prsoc,buffer-height' are
+ * ignored.
+ *
+ * This driver is written against the DRM API of Linux 4.9.
+ *
+ * Revisions:
+ *  10/19/2026 Created
+ *  10/19/2026 Latch the pitch with the start address
+ */
+
+#include <linux/module.h>
+#include <linux/kernel.h>
+#include <linux/io.h>
+#include <linux/platform_device.h>
+#include <linux/of_device.h>
+#include <linux/interrupt.h>
+#include <linux/types.h>
+
+#include <drm/drmP.h>
+#include <drm/drm_atomic_helper.h>
+#include <drm/drm_crtc_helper.h>
+#include <drm/drm_fb_cma_helper.h>
+#include <drm/drm_gem_cma_helper.h>
+#include <drm/drm_simple_kms_helper.h>
+
+/* Offsets of the framebuffer manager's registers. */
+#define FM_REG_FRAME_START_ADDRESS 0x00
+#define FM_REG_FRAME_PIX_PER_LINE  0x04
+#define FM_REG_FRAME_NUM_LINES     0x08
+#define FM_REG_FRAME_EOL_BYTE_OFST 0x0C
+#define FM_REG_CONTROL             0x10
+#define FM_REG_BURST_COUNT         0x14
+
+#define FM_CONTROL_ENABLE_DMA_MASK      (1UL << 0)
+#define FM_CONTROL_DISABLE_DMA_MASK     (1UL << 1)
+#define FM_CONTROL_ENABLE_IRQ_MASK      (1UL << 2)
+#define FM_CONTROL_DISABLE_IRQ_MASK     (1UL << 3)
+#define FM_CONTROL_ACKNOWLEDGE_IRQ_MASK (1UL << 4)
+
+/* The framebuffer manager reads 16 bytes (4 pixels) per word. */
+#define FM_WORD_SIZE 16
+
+/* Enclose the driver data. */
+struct prsoc_drm_drvdata {
+  struct drm_device *drm;
+  struct drm_simple_display_pipe pipe;
+  struct drm_connector connector;
+  struct drm_display_mode mode; /* the only mode of the screen */
+
+  uint8_t *fm_regs;      /* a pointer to the frame manager's regs */
+  uint8_t *lcd_int_regs; /* a pointer to the LCD interface's regs */
+  int irq;
+  uint32_t burst_count;  /* in words of the DMA master */
+
+  /* Protected by drm->event_lock. */
+  bool flip_pending;      /* pending_addr/eol must be written at vsync */
+  dma_addr_t pending_addr;
+  uint32_t pending_eol;   /* FRAME_EOL_BYTE_OFFSET of pending_addr */
+  struct drm_pending_vblank_event *pending_event;
+};
+
+#define FM_WR(DRVDATA, REG, VAL) \
+  iowrite32((VAL), (DRVDATA)->fm_regs + (REG))
+#define LCD_INTERFACE_WR(DRVDATA, REG, VAL) \
+  iowrite32((VAL), (DRVDATA)->lcd_int_regs + (REG))
+
+static inline struct prsoc_drm_drvdata *
+pipe_to_prsoc_drm(struct drm_simple_display_pipe *pipe)
+{
+  return container_of(pipe, struct prsoc_drm_drvdata, pipe);
+}
+
+/* ISR called at the end of each frame, once the framebuffer manager has
+ * fetched the last pixel. The start address written here is used from the
+ * next frame on, and the previous buffer isn't read anymore. */
+static irqreturn_t vsync_isr(int irq, void *data)
+{
+  struct prsoc_drm_drvdata *drvdata = data;
+  struct drm_device *drm = drvdata->drm;
+  struct drm_crtc *crtc = &drvdata->pipe.crtc;
+
+  /* Acknowledge the IRQ */
+  FM_WR(drvdata, FM_REG_CONTROL, FM_CONTROL_ACKNOWLEDGE_IRQ_MASK);
+
+  drm_crtc_handle_vblank(crtc);
+
+  spin_lock(&drm->event_lock);
+  if (drvdata->flip_pending) {
+    FM_WR(drvdata, FM_REG_FRAME_EOL_BYTE_OFST, drvdata->pending_eol);
+    FM_WR(drvdata, FM_REG_FRAME_START_ADDRESS, drvdata->pending_addr);
+    drvdata->flip_pending = false;
+  }
+  if (drvdata->pending_event) {
+    drm_crtc_send_vblank_event(crtc, drvdata->pending_event);
+    drvdata->pending_event = NULL;
+    drm_crtc_vblank_put(crtc);
+  }
+  spin_unlock(&drm->event_lock);
+
+  return IRQ_HANDLED;
+}
+
+/* DRM driver */
+
+/* Address of the first visible pixel of a plane state. */
+static dma_addr_t prsoc_drm_scanout_addr(struct drm_plane_state *state)
+{
+  struct drm_framebuffer *fb = state->fb;
+  struct drm_gem_cma_object *obj = drm_fb_cma_get_gem_obj(fb, 0);
+
+  return obj->paddr + fb->offsets[0] +
+    (state->src_y >> 16) * fb->pitches[0] +
+    (state->src_x >> 16) * sizeof(uint32_t);
+}
+
+static int prsoc_drm_pipe_check(struct drm_simple_display_pipe *pipe,
+                                struct drm_plane_state *plane_state,
+                                struct drm_crtc_state *crtc_state)
+{
+  struct prsoc_drm_drvdata *drvdata = pipe_to_prsoc_drm(pipe);
+  struct drm_framebuffer *fb = plane_state->fb;
+
+  if (!fb)
+    return 0;
+
+  /* The framebuffer manager only reads whole, aligned words. */
+  if (fb->pitches[0] < drvdata->mode.hdisplay * sizeof(uint32_t) ||
+      fb->pitches[0] % FM_WORD_SIZE ||
+      prsoc_drm_scanout_addr(plane_state) % FM_WORD_SIZE)
+    return -EINVAL;
+
+  return 0;
+}
+
+static void prsoc_drm_pipe_enable(struct drm_simple_display_pipe *pipe,
+                                  struct drm_crtc_state *crtc_state)
+{
+  struct prsoc_drm_drvdata *drvdata = pipe_to_prsoc_drm(pipe);
+  struct drm_plane_state *plane_state = pipe->plane.state;
+  struct drm_framebuffer *fb = plane_state->fb;
+
+  if (fb) {
+    FM_WR(drvdata, FM_REG_FRAME_START_ADDRESS, prsoc_drm_scanout_addr(plane_state));
+    FM_WR(drvdata, FM_REG_FRAME_EOL_BYTE_OFST,
+          fb->pitches[0] - drvdata->mode.hdisplay * sizeof(uint32_t));
+  }
+
+  FM_WR(drvdata, FM_REG_FRAME_PIX_PER_LINE, drvdata->mode.hdisplay);
+  FM_WR(drvdata, FM_REG_FRAME_NUM_LINES, drvdata->mode.vdisplay);
+  FM_WR(drvdata, FM_REG_BURST_COUNT, drvdata->burst_count);
+  FM_WR(drvdata, FM_REG_CONTROL,
+        FM_CONTROL_ENABLE_DMA_MASK | FM_CONTROL_ENABLE_IRQ_MASK);
+
+  drm_crtc_vblank_on(&pipe->crtc);
+}
+
+static void prsoc_drm_pipe_disable(struct drm_simple_display_pipe *pipe)
+{
+  struct prsoc_drm_drvdata *drvdata = pipe_to_prsoc_drm(pipe);
+  struct drm_device *drm = drvdata->drm;
+  struct drm_crtc *crtc = &pipe->crtc;
+  unsigned long flags;
+
+  FM_WR(drvdata, FM_REG_CONTROL,
+        FM_CONTROL_DISABLE_DMA_MASK | FM_CONTROL_DISABLE_IRQ_MASK);
+
+  /* No more vsync: complete what the ISR would have. */
+  spin_lock_irqsave(&drm->event_lock, flags);
+  drvdata->flip_pending = false;
+  if (drvdata->pending_event) {
+    drm_crtc_send_vblank_event(crtc, drvdata->pending_event);
+    drvdata->pending_event = NULL;
+    drm_crtc_vblank_put(crtc);
+  }
+  if (crtc->state->event) {
+    drm_crtc_send_vblank_event(crtc, crtc->state->event);
+    crtc->state->event = NULL;
+  }
+  spin_unlock_irqrestore(&drm->event_lock, flags);
+
+  drm_crtc_vblank_off(crtc);
+}
+
+static void prsoc_drm_pipe_update(struct drm_simple_display_pipe *pipe,
+                                  struct drm_plane_state *old_state)
+{
+  struct prsoc_drm_drvdata *drvdata = pipe_to_prsoc_drm(pipe);
+  struct drm_device *drm = drvdata->drm;
+  struct drm_crtc *crtc = &pipe->crtc;
+  struct drm_plane_state *state = pipe->plane.state;
+  struct drm_pending_vblank_event *event = crtc->state->event;
+  unsigned long flags;
+
+  spin_lock_irqsave(&drm->event_lock, flags);
+
+  if (state->fb && crtc->state->active) {
+    /* Both are taken by the framebuffer manager at the start of the frame
+     * that follows the ISR. */
+    drvdata->pending_addr = prsoc_drm_scanout_addr(state);
+    drvdata->pending_eol = state->fb->pitches[0] - drvdata->mode.hdisplay * sizeof(uint32_t);
+    drvdata->flip_pending = true;
+  }
+
+  if (event) {
+    crtc->state->event = NULL;
+
+    /* The event is sent by the ISR once the new address is latched. A
+     * commit that replaces a pending one completes both at the same vsync. */
+    if (crtc->state->active && drm_crtc_vblank_get(crtc) == 0) {
+      if (drvdata->pending_event) {
+        drm_crtc_send_vblank_event(crtc, drvdata->pending_event);
+        drm_crtc_vblank_put(crtc);
+      }
+      drvdata->pending_event = event;
+    } else {
+      drm_crtc_send_vblank_event(crtc, event);
+    }
+  }
+
+  spin_unlock_irqrestore(&drm->event_lock, flags);
+}
+
+static const struct drm_simple_display_pipe_funcs prsoc_drm_pipe_funcs = {
+  .check = prsoc_drm_pipe_check,
+  .enable = prsoc_drm_pipe_enable,
+  .disable = prsoc_drm_pipe_disable,
+  .update = prsoc_drm_pipe_update,
+};
+
+static const uint32_t prsoc_drm_formats[] = {
+  DRM_FORMAT_XRGB8888,
+};
+
+/* The vsync IRQ is always on while the pipe is enabled: it is needed for
+ * the flips anyway, and is only raised once per frame. */
+static int prsoc_drm_enable_vblank(struct drm_device *drm, unsigned int pipe)
+{
+  return 0;
+}
+
+static void prsoc_drm_disable_vblank(struct drm_device *drm, unsigned int pipe)
+{
+}
+
+/* The screen is always there and has a single mode. */
+static int prsoc_drm_connector_get_modes(struct drm_connector *connector)
+{
+  struct prsoc_drm_drvdata *drvdata = connector->dev->dev_private;
+  struct drm_display_mode *mode;
+
+  mode = drm_mode_duplicate(connector->dev, &drvdata->mode);
+  if (!mode)
+    return 0;
+
+  mode->type |= DRM_MODE_TYPE_DRIVER | DRM_MODE_TYPE_PREFERRED;
+  drm_mode_set_name(mode);
+  drm_mode_probed_add(connector, mode);
+
+  return 1;
+}
+
+static enum drm_connector_status
+prsoc_drm_connector_detect(struct drm_connector *connector, bool force)
+{
+  return connector_status_connected;
+}
+
+static const struct drm_connector_helper_funcs prsoc_drm_connector_helper_funcs = {
+  .get_modes = prsoc_drm_connector_get_modes,
+};
+
+static const struct drm_connector_funcs prsoc_drm_connector_funcs = {
+  .dpms = drm_atomic_helper_connector_dpms,
+  .reset = drm_atomic_helper_connector_reset,
+  .detect = prsoc_drm_connector_detect,
+  .fill_modes = drm_helper_probe_single_connector_modes,
+  .destroy = drm_connector_cleanup,
+  .atomic_duplicate_state = drm_atomic_helper_connector_duplicate_state,
+  .atomic_destroy_state = drm_atomic_helper_connector_destroy_state,
+};
+
+static const struct drm_mode_config_funcs prsoc_drm_mode_config_funcs = {
+  .fb_create = drm_fb_cma_create,
+  .atomic_check = drm_atomic_helper_check,
+  .atomic_commit = drm_atomic_helper_commit,
+};
+
+static const struct file_operations prsoc_drm_fops = {
+  .owner = THIS_MODULE,
+  .open = drm_open,
+  .release = drm_release,
+  .unlocked_ioctl = drm_ioctl,
+  .compat_ioctl = drm_compat_ioctl,
+  .poll = drm_poll,
+  .read = drm_read,
+  .llseek = no_llseek,
+  .mmap = drm_gem_cma_mmap,
+};
+
+static struct drm_driver prsoc_drm_driver = {
+  .driver_features = DRIVER_GEM | DRIVER_MODESET | DRIVER_PRIME | DRIVER_ATOMIC,
+  .fops = &prsoc_drm_fops,
+
+  .gem_free_object_unlocked = drm_gem_cma_free_object,
+  .gem_vm_ops = &drm_gem_cma_vm_ops,
+  .dumb_create = drm_gem_cma_dumb_create,
+  .dumb_map_offset = drm_gem_cma_dumb_map_offset,
+  .dumb_destroy = drm_gem_dumb_destroy,
+
+  .prime_handle_to_fd = drm_gem_prime_handle_to_fd,
+  .prime_fd_to_handle = drm_gem_prime_fd_to_handle,
+  .gem_prime_import = drm_gem_prime_import,
+  .gem_prime_export = drm_gem_prime_export,
+  .gem_prime_get_sg_table = drm_gem_cma_prime_get_sg_table,
+  .gem_prime_import_sg_table = drm_gem_cma_prime_import_sg_table,
+  .gem_prime_vmap = drm_gem_cma_prime_vmap,
+  .gem_prime_vunmap = drm_gem_cma_prime_vunmap,
+  .gem_prime_mmap = drm_gem_cma_prime_mmap,
+
+  .get_vblank_counter = drm_vblank_no_hw_counter,
+  .enable_vblank = prsoc_drm_enable_vblank,
+  .disable_vblank = prsoc_drm_disable_vblank,
+
+  .name = "prsoc",
+  .desc = "PrSoC extension board displays",
+  .date = "20261019",
+  .major = 1,
+  .minor = 0,
+};
+
+/* Platform driver */
+
+/* Informs the kernel of the corresponding compatible string. */
+static const struct of_device_id prsoc_drm_device_ids[] = {
+  { .compatible = "prsoc,display" },
+  { }
+};
+MODULE_DEVICE_TABLE(of, prsoc_drm_device_ids);
+
+#define EXTRACT_INT_FROM_DT_OR_FAIL(NP, PROP) ({                \
+  const void *property = of_get_property((NP), (PROP), NULL);   \
+  if (!property) {                                              \
+    printk(KERN_ERR "no '" PROP "' in the device tree.");       \
+    return -EINVAL;                                             \
+  }                                                             \
+  be32_to_cpup(property);                                       \
+})
+
+/* Apply configuration from device tree. */
+static int configure_from_dt(struct platform_device *pdev,
+                             struct prsoc_drm_drvdata *drvdata)
+{
+  struct device_node *np = pdev->dev.of_node;
+  struct drm_display_mode *mode = &drvdata->mode;
+  struct resource *rsrc;
+  const __be32 *properties;
+  uint32_t refresh_rate = 60;
+  int len, i;
+
+  uint32_t screen_width  = EXTRACT_INT_FROM_DT_OR_FAIL(np, "prsoc,screen-width");
+  uint32_t screen_height = EXTRACT_INT_FROM_DT_OR_FAIL(np, "prsoc,screen-height");
+  of_property_read_u32(np, "prsoc,refresh-rate", &refresh_rate);
+
+  /* See prsoc_fbdev for the constraints and the calibration. */
+  drvdata->burst_count = 4;
+  of_property_read_u32(np, "prsoc,burst-count", &drvdata->burst_count);
+
+  mode->hdisplay = mode->hsync_start = mode->hsync_end = mode->htotal = screen_width;
+  mode->vdisplay = mode->vsync_start = mode->vsync_end = mode->vtotal = screen_height;
+  mode->clock = DIV_ROUND_UP(screen_width * screen_height * refresh_rate, 1000);
+
+  printk(KERN_INFO "According to the device tree, the screen is %ux%u@%u.\n",
+         screen_width, screen_height, refresh_rate);
+
+  /* Maps the addresses of the registers of the framebuffer manager. */
+  rsrc = platform_get_resource(pdev, IORESOURCE_MEM, 0);
+  drvdata->fm_regs = devm_ioremap_resource(&pdev->dev, rsrc);
+  if (IS_ERR(drvdata->fm_regs))
+    return PTR_ERR(drvdata->fm_regs);
+
+  /* Maps the addresses of the video interface. */
+  rsrc = platform_get_resource(pdev, IORESOURCE_MEM, 1);
+  drvdata->lcd_int_regs = devm_ioremap_resource(&pdev->dev, rsrc);
+  if (IS_ERR(drvdata->lcd_int_regs))
+    return PTR_ERR(drvdata->lcd_int_regs);
+
+  drvdata->irq = platform_get_irq(pdev, 0);
+  if (drvdata->irq < 0) {
+    printk(KERN_ERR "prsoc_drm: no 'interrupts' in the device tree.\n");
+    return drvdata->irq;
+  }
+
+  /* Parse the reg-init sequence */
+  properties = of_get_property(np, "prsoc,reg-init", &len);
+  if (!properties)
+    return 0; // reg-init is optional
+
+  len /= sizeof(__be32);
+  if (len % 2 != 0) {
+    printk(KERN_ERR "'prsoc,reg-init' in Device Tree should have format <ADDR1 VAL1>, <ADDR2 VAL2>, ...\n");
+    return -EINVAL;
+  }
+
+  for (i = 0; i < len; i += 2)
+    LCD_INTERFACE_WR(drvdata, be32_to_cpup(properties + i), be32_to_cpup(properties + i + 1));
+
+  return 0;
+}
+
+/*
+ * The following method is called when the driver is loaded.
+ * It collects information from the device tree.
+ */
+static int
+prsoc_drm_platform_probe(struct platform_device *pdev)
+{
+  struct prsoc_drm_drvdata *drvdata;
+  struct drm_device *drm;
+  int err;
+
+  /* Defensive programming: let's make sure this is the right device. */
+  if (!of_match_device(prsoc_drm_device_ids, &pdev->dev))
+    return -EINVAL;
+
+  drvdata = devm_kzalloc(&pdev->dev, sizeof(*drvdata), GFP_KERNEL);
+  if (!drvdata)
+    return -ENOMEM;
+
+  err = configure_from_dt(pdev, drvdata);
+  if (err)
+    return err;
+
+  /* Stay quiet until the first modeset. */
+  FM_WR(drvdata, FM_REG_CONTROL,
+        FM_CONTROL_DISABLE_DMA_MASK | FM_CONTROL_DISABLE_IRQ_MASK);
+
+  drm = drm_dev_alloc(&prsoc_drm_driver, &pdev->dev);
+  if (IS_ERR(drm))
+    return PTR_ERR(drm);
+
+  drvdata->drm = drm;
+  drm->dev_private = drvdata;
+  platform_set_drvdata(pdev, drvdata);
+
+  drm_mode_config_init(drm);
+  drm->mode_config.min_width = drvdata->mode.hdisplay;
+  drm->mode_config.max_width = 4096;
+  drm->mode_config.min_height = drvdata->mode.vdisplay;
+  drm->mode_config.max_height = 4096;
+  drm->mode_config.funcs = &prsoc_drm_mode_config_funcs;
+
+  drm_connector_helper_add(&drvdata->connector, &prsoc_drm_connector_helper_funcs);
+  err = drm_connector_init(drm, &drvdata->connector, &prsoc_drm_connector_funcs,
+                           DRM_MODE_CONNECTOR_DPI);
+  if (err)
+    goto err_config;
+
+  err = drm_simple_display_pipe_init(drm, &drvdata->pipe, &prsoc_drm_pipe_funcs,
+                                     prsoc_drm_formats, ARRAY_SIZE(prsoc_drm_formats),
+                                     &drvdata->connector);
+  if (err)
+    goto err_config;
+
+  err = drm_vblank_init(drm, 1);
+  if (err)
+    goto err_config;
+
+  /* Register the ISR for vertical blanking notification. */
+  err = devm_request_irq(&pdev->dev, drvdata->irq, vsync_isr, 0, "prsoc-drm", drvdata);
+  if (err) {
+    printk(KERN_ERR "prsoc_drm: couldn't register ISR.\n");
+    goto err_vblank;
+  }
+
+  drm_mode_config_reset(drm);
+
+  err = drm_dev_register(drm, 0);
+  if (err)
+    goto err_vblank;
+
+  printk(KERN_INFO "prsoc_drm: registered /dev/dri/card%d\n", drm->primary->index);
+  return 0;
+
+err_vblank:
+  drm_vblank_cleanup(drm);
+err_config:
+  drm_mode_config_cleanup(drm);
+  drm_dev_unref(drm);
+  return err;
+}
+
+static int prsoc_drm_platform_remove(struct platform_device *pdev)
+{
+  struct prsoc_drm_drvdata *drvdata = platform_get_drvdata(pdev);
+  struct drm_device *drm = drvdata->drm;
+
+  drm_dev_unregister(drm);
+  drm_crtc_force_disable_all(drm);
+
+  /* The ISR is only released after drvdata->drm: silence it now. */
+  FM_WR(drvdata, FM_REG_CONTROL,
+        FM_CONTROL_DISABLE_DMA_MASK | FM_CONTROL_DISABLE_IRQ_MASK);
+  synchronize_irq(drvdata->irq);
+
+  drm_vblank_cleanup(drm);
+  drm_mode_config_cleanup(drm);
+  drm_dev_unref(drm);
+
+  return 0;
+}
+
+static struct platform_driver prsoc_drm_pdriver = {
+  .probe = prsoc_drm_platform_probe,
+  .remove = prsoc_drm_platform_remove,
+  .driver = {
+    .name = "prsoc-drm",
+    .owner = THIS_MODULE,
+    .of_match_table = prsoc_drm_device_ids,
+  },
+};
+
+MODULE_LICENSE("GPL");
+module_platform_driver(prsoc_drm_pdriver);
@@ -33,6 +33,18 @@
  *  5/28/2016 Adapted for TFT043
  *  5/28/2016 Extended with mmap support
  *  6/15/2016 Extend configurability from DT + panning
+ *  10/19/2026 Export the frame buffer as a dma-buf (see prsoc_fbdev.h)
+ *  10/19/2026 fillrect/copyarea through a memory-to-memory mSGDMA
+ *  10/19/2026 Stop the frame manager and the interface while blanked
+ *  10/19/2026 Change the number of buffers at runtime (yres_virtual)
+ *  10/19/2026 Configurable and calibrated burst count, DMA data width
+ *  10/19/2026 Scanout performance counters in debugfs
+ *  10/19/2026 Half and quarter resolutions through pixel replication
+ *  10/19/2026 Flips queued in the frame manager (STATUS.PENDING)
+ *  10/19/2026 Only redo the lines the DMA didn't copy on a timeout
+ *  10/19/2026 Swap the buffers under mm_lock, unwind probe errors
+ *  10/19/2026 Fail the probe on device tree errors, burst count under info->lock
+ *  10/19/2026 Export the dma-buf under mm_lock, stop the frame manager on remove
  */
 
 #include <linux/module.h>
@@ -44,7 +56,25 @@
 #include <linux/of_device.h>
 #include <linux/interrupt.h>
 #include <linux/dma-mapping.h>
+#include <linux/dma-buf.h>
+#include <linux/uaccess.h>
+#include <linux/fcntl.h>
+#include <linux/atomic.h>
+#include <linux/dmaengine.h>
+#include <linux/console.h>
+#include <linux/ktime.h>
+#include <linux/sysfs.h>
+#include <linux/delay.h>
+#include <linux/completion.h>
+#include <linux/spinlock.h>
+#include <linux/mm.h>
 #include <linux/types.h>
+#include <linux/debugfs.h>
+#include <linux/seq_file.h>
+#include <linux/mutex.h>
+#include <linux/math64.h>
+
+#include "prsoc_fbdev.h"
 
 /* Offsets of the framebuffer manager's registers. */
 #define FM_REG_FRAME_START_ADDRESS 0x00
@@ -53,12 +83,42 @@
 #define FM_REG_FRAME_EOL_BYTE_OFST 0x0C
 #define FM_REG_CONTROL             0x10
 #define FM_REG_BURST_COUNT         0x14
+#define FM_REG_UNDERFLOW_COUNT     0x18
+#define FM_REG_DMA_DATA_WIDTH      0x1C
+#define FM_REG_BURSTS              0x20
+#define FM_REG_STALL_CYCLES        0x24
+#define FM_REG_MIN_FIFO_FILL       0x28
+#define FM_REG_FRAMES              0x2C
+#define FM_REG_SCALE               0x30
+#define FM_REG_LINE_BUFFER_DEPTH   0x34
+#define FM_REG_ACTIVE_START_ADDRESS 0x38
+#define FM_REG_STATUS              0x3C
+
+#define FM_MAX_BURST_COUNT   1024
+#define FM_FIFO_DEPTH        256 /* in words of 4 pixels */
 
 
 #define FM_CONTROL_ENABLE_DMA_MASK      (1UL << 0)
+#define FM_CONTROL_DISABLE_DMA_MASK     (1UL << 1)
 #define FM_CONTROL_ENABLE_IRQ_MASK      (1UL << 2)
+#define FM_CONTROL_DISABLE_IRQ_MASK     (1UL << 3)
 #define FM_CONTROL_ACKNOWLEDGE_IRQ_MASK (1UL << 4)
 
+#define FM_STATUS_PENDING_MASK          (1UL << 0)
+#define FM_STATUS_ENABLED_MASK          (1UL << 1)
+
+/* log2 of the horizontal and vertical replication factors */
+#define FM_SCALE(H_LOG2, V_LOG2) ((H_LOG2) | ((V_LOG2) << 2))
+
+
+/* A snapshot of the frame manager's free running counters. */
+struct prsocfb_counters {
+  uint32_t bursts;
+  uint32_t stall_cycles;
+  uint32_t underflows;
+  uint32_t frames;
+  ktime_t time;
+};
 
 /* Enclose the driver data. */
 struct prsoc_display_drvdata {
@@ -67,16 +127,72 @@ struct prsoc_display_drvdata {
 
   uint32_t *front_buffer; /* a dmable frame buffer */
   unsigned long front_buffer_phys; /* physical address of the frame buffer */
+  size_t front_buffer_size; /* size of the frame buffer in bytes */
   int irq;
+
+  struct device *dev; /* the platform device, for the DMA API */
+  struct fb_info *info; /* the framebuffer enclosing this structure */
+  atomic_t num_dmabufs; /* number of dma-bufs currently exported */
+
+  struct dma_chan *dma_chan; /* memory-to-memory DMA, or NULL */
+  uint32_t *fill_line; /* one line of the color being filled */
+  dma_addr_t fill_line_phys;
+  unsigned int dma_threshold; /* smaller rectangles are drawn by the CPU */
+
+  const __be32 *reg_init;  /* 'prsoc,reg-init' <ADDR VAL> pairs, or NULL */
+  int reg_init_len;        /* number of cells in reg_init */
+  const __be32 *reg_blank; /* 'prsoc,reg-blank' <ADDR VAL> pairs, or NULL */
+  int reg_blank_len;       /* number of cells in reg_blank */
+  int blank;               /* current FB_BLANK_* level */
+
+  uint32_t burst_count;    /* in words of the DMA master */
+  uint32_t dma_data_width; /* width of the DMA master, in bits */
+  bool has_counters;       /* the frame manager has UNDERFLOW_COUNT */
+
+  atomic_t num_mmaps;      /* number of user mappings of the frame buffer */
+
+  uint32_t screen_width;   /* size of the screen, in pixels */
+  uint32_t screen_height;
+  uint32_t line_buffer_depth; /* longest line replicated vertically, 0 if
+                                 the frame manager can't replicate pixels */
+  uint32_t scale;          /* FM_SCALE() of the current resolution */
+  bool has_flip_status;    /* the frame manager reports pending flips */
+
+  spinlock_t flip_lock;    /* protects the fields below */
+  bool flip_pending;       /* flip_* must be written at the next vsync */
+  dma_addr_t flip_addr;
+  uint32_t flip_pix_per_line; /* geometry of the frame at flip_addr */
+  uint32_t flip_num_lines;
+  uint32_t flip_scale;
+  uint32_t flip_burst_count;
+  struct completion flip_done;
+
+  struct dentry *debugfs_dir;          /* prsocfb/ in debugfs, or NULL */
+  struct mutex counters_lock;          /* protects last_counters */
+  struct prsocfb_counters last_counters; /* snapshot of the previous read */
 };
 
 #define FM_WR(DRVDATA, REG, VAL) \
   iowrite32((VAL), (DRVDATA)->fm_regs + (REG))
+#define FM_RD(DRVDATA, REG) \
+  ioread32((DRVDATA)->fm_regs + (REG))
 #define LCD_INTERFACE_WR(DRVDATA, REG, VAL) \
   iowrite32((VAL), (DRVDATA)->lcd_int_regs + (REG))
 
 /* Framebuffer driver */
 
+/* Program the frame manager with the frame prepared in the flip_* fields.
+ * It takes them all at its next frame. */
+static void prsocfb_write_flip(struct prsoc_display_drvdata *drvdata)
+{
+  FM_WR(drvdata, FM_REG_FRAME_START_ADDRESS, drvdata->flip_addr);
+  FM_WR(drvdata, FM_REG_FRAME_PIX_PER_LINE, drvdata->flip_pix_per_line);
+  FM_WR(drvdata, FM_REG_FRAME_NUM_LINES, drvdata->flip_num_lines);
+  FM_WR(drvdata, FM_REG_BURST_COUNT, drvdata->flip_burst_count);
+  if (drvdata->line_buffer_depth)
+    FM_WR(drvdata, FM_REG_SCALE, drvdata->flip_scale);
+}
+
 /* ISR called at the end of each frame. Called at the beginning
  * of the vertical back porch, i.e. as soon as possible to avoid
  * tearing effect. */
@@ -89,6 +205,16 @@ static irqreturn_t vsync_isr(int irq, void *data)
 
   /* Acknowledge the IRQ */
   FM_WR(drvdata, FM_REG_CONTROL, FM_CONTROL_ACKNOWLEDGE_IRQ_MASK);
+
+  /* The frame manager is done with the current frame and reloads its start
+   * address at the next frame sync: switching buffers now is safe. */
+  spin_lock(&drvdata->flip_lock);
+  if (drvdata->flip_pending) {
+    prsocfb_write_flip(drvdata);
+    drvdata->flip_pending = false;
+    complete(&drvdata->flip_done);
+  }
+  spin_unlock(&drvdata->flip_lock);
  
   return IRQ_HANDLED;
 }
@@ -148,6 +274,256 @@ int prsocfb_pan_display(struct fb_var_screeninfo *var, struct fb_info *info)
   return 0;
 }
 
+/* Longer than two frames of any supported screen. */
+#define PRSOCFB_DRAIN_MS 40
+
+/* Number of flip buffers that can be requested with yres_virtual. */
+#define PRSOCFB_MAX_BUFFERS 4
+
+/* log2 of the replication factor (1x, 2x or 4x) that shows 'res' pixels
+ * on 'screen' pixels, or -1. */
+static int prsocfb_scale_log2(uint32_t screen, uint32_t res)
+{
+  int log2;
+
+  for (log2 = 0; log2 <= 2; log2++)
+    if (res << log2 == screen)
+      return log2;
+
+  return -1;
+}
+
+/* The screen itself can't change, but it can show a frame buffer of half or
+ * a quarter of its width and/or height, each pixel being replicated by the
+ * frame manager (e.g. fbset -xres 240 -yres 136 on a 480x272 screen). The
+ * number of buffers can change too. */
+static int prsocfb_check_var(struct fb_var_screeninfo *var, struct fb_info *info)
+{
+  struct prsoc_display_drvdata *drvdata = (struct prsoc_display_drvdata *)info->par;
+  uint32_t buffers;
+  int h_log2, v_log2;
+
+  if (var->bits_per_pixel != info->var.bits_per_pixel)
+    return -EINVAL;
+
+  h_log2 = prsocfb_scale_log2(drvdata->screen_width, var->xres);
+  v_log2 = prsocfb_scale_log2(drvdata->screen_height, var->yres);
+  if (h_log2 < 0 || v_log2 < 0)
+    return -EINVAL;
+
+  if (h_log2 || v_log2) {
+    if (!drvdata->line_buffer_depth)
+      return -EINVAL; /* the frame manager can't replicate pixels */
+
+    /* The frame manager reads lines of whole FIFO words (4 pixels) and
+     * keeps a line in its line buffer to repeat it. */
+    if (var->xres % 4 != 0 ||
+        (v_log2 && var->xres > drvdata->line_buffer_depth))
+      return -EINVAL;
+  }
+
+  /* No horizontal panning: the lines are contiguous. */
+  var->xres_virtual = var->xres;
+
+  buffers = DIV_ROUND_UP(max(var->yres_virtual, var->yres), var->yres);
+  if (buffers > PRSOCFB_MAX_BUFFERS)
+    return -EINVAL;
+
+  /* The user may hold pointers to the current buffer. */
+  if ((buffers * var->yres != info->var.yres_virtual ||
+       var->xres != info->var.xres || var->yres != info->var.yres) &&
+      (atomic_read(&drvdata->num_mmaps) || atomic_read(&drvdata->num_dmabufs)))
+    return -EBUSY;
+
+  var->yres_virtual = buffers * var->yres;
+  if (var->yoffset + var->yres > var->yres_virtual)
+    var->yoffset = 0;
+  var->xoffset = 0;
+
+  var->red   = prsocfb_var_defaults.red;
+  var->green = prsocfb_var_defaults.green;
+  var->blue  = prsocfb_var_defaults.blue;
+  var->transp.offset = var->transp.length = 0;
+
+  return 0;
+}
+
+/* Wait until the frame manager reads from the last FRAME_START_ADDRESS
+ * written. It takes it at the start of the next frame by itself. */
+static int prsocfb_wait_flip(struct prsoc_display_drvdata *drvdata)
+{
+  unsigned long timeout = jiffies + msecs_to_jiffies(100);
+
+  while (FM_RD(drvdata, FM_REG_STATUS) & FM_STATUS_PENDING_MASK) {
+    /* Nothing is read while blanked. */
+    if (drvdata->blank)
+      return 0;
+
+    if (time_after(jiffies, timeout))
+      return -ETIMEDOUT;
+
+    usleep_range(500, 1000);
+  }
+
+  return 0;
+}
+
+/* Make the frame manager read from 'addr', with the current resolution,
+ * scale and burst count, from the next frame on. Returns once it doesn't
+ * read the previous buffer anymore. */
+static void prsocfb_flip_at_vsync(struct prsoc_display_drvdata *drvdata, dma_addr_t addr)
+{
+  struct fb_info *info = drvdata->info;
+  unsigned long flags;
+
+  spin_lock_irqsave(&drvdata->flip_lock, flags);
+  drvdata->flip_addr = addr;
+
+  /* Same frame elsewhere: the frame manager queues the flip itself. */
+  if (drvdata->has_flip_status && !drvdata->blank &&
+      drvdata->flip_pix_per_line == info->var.xres &&
+      drvdata->flip_num_lines == info->var.yres &&
+      drvdata->flip_scale == drvdata->scale &&
+      drvdata->flip_burst_count == drvdata->burst_count) {
+    FM_WR(drvdata, FM_REG_FRAME_START_ADDRESS, addr);
+    spin_unlock_irqrestore(&drvdata->flip_lock, flags);
+
+    if (prsocfb_wait_flip(drvdata)) {
+      printk(KERN_ERR "prsocfb: no frame sync, switching buffers anyway.\n");
+      msleep(PRSOCFB_DRAIN_MS);
+    }
+    return;
+  }
+
+  drvdata->flip_pix_per_line = info->var.xres;
+  drvdata->flip_num_lines = info->var.yres;
+  drvdata->flip_scale = drvdata->scale;
+  drvdata->flip_burst_count = drvdata->burst_count;
+
+  /* Without DMA, there is no vsync: write it directly. */
+  if (drvdata->blank) {
+    prsocfb_write_flip(drvdata);
+    spin_unlock_irqrestore(&drvdata->flip_lock, flags);
+    return;
+  }
+
+  reinit_completion(&drvdata->flip_done);
+  drvdata->flip_pending = true;
+  spin_unlock_irqrestore(&drvdata->flip_lock, flags);
+
+  FM_WR(drvdata, FM_REG_CONTROL, FM_CONTROL_ENABLE_IRQ_MASK);
+
+  if (!wait_for_completion_timeout(&drvdata->flip_done, msecs_to_jiffies(100))) {
+    printk(KERN_ERR "prsocfb: no vsync, switching buffers anyway.\n");
+    spin_lock_irqsave(&drvdata->flip_lock, flags);
+    drvdata->flip_pending = false;
+    prsocfb_write_flip(drvdata);
+    spin_unlock_irqrestore(&drvdata->flip_lock, flags);
+    msleep(PRSOCFB_DRAIN_MS);
+  }
+
+  FM_WR(drvdata, FM_REG_CONTROL, FM_CONTROL_DISABLE_IRQ_MASK);
+}
+
+static bool prsocfb_burst_valid(struct prsoc_display_drvdata *drvdata, uint32_t burst);
+
+/* Reallocate the frame buffer if yres_virtual or the resolution changed.
+ * If only the number of buffers changed, the image on screen is copied to
+ * the first buffer of the new one. The new buffer (and resolution) is shown
+ * at the next vsync; the old one is only freed once the frame manager left
+ * it. The frame buffer core calls it under info->lock, which the burst count
+ * attributes take too. */
+static int prsocfb_set_par(struct fb_info *info)
+{
+  struct prsoc_display_drvdata *drvdata = (struct prsoc_display_drvdata *)info->par;
+  uint32_t line_length = info->var.xres * sizeof(uint32_t);
+  size_t size = line_length * info->var.yres_virtual;
+  size_t screen_size = line_length * info->var.yres;
+  uint32_t scale = FM_SCALE(prsocfb_scale_log2(drvdata->screen_width, info->var.xres),
+                            prsocfb_scale_log2(drvdata->screen_height, info->var.yres));
+  uint32_t *old_buffer = drvdata->front_buffer;
+  dma_addr_t old_phys = drvdata->front_buffer_phys;
+  size_t old_size = drvdata->front_buffer_size;
+  void *buffer;
+  dma_addr_t phys, shown;
+
+  if (size == old_size && scale == drvdata->scale)
+    return 0;
+
+  /* prsocfb_mmap() maps the current buffer under mm_lock: check the pins
+   * of check_var() again and swap the buffers without it running. */
+  mutex_lock(&info->mm_lock);
+  if (atomic_read(&drvdata->num_mmaps) || atomic_read(&drvdata->num_dmabufs)) {
+    mutex_unlock(&info->mm_lock);
+    return -EBUSY;
+  }
+
+  if (drvdata->has_flip_status)
+    shown = FM_RD(drvdata, FM_REG_ACTIVE_START_ADDRESS) - old_phys;
+  else
+    shown = ioread32(drvdata->fm_regs + FM_REG_FRAME_START_ADDRESS) - old_phys;
+  if (shown + screen_size > old_size)
+    shown = 0;
+
+  buffer = dmam_alloc_coherent(drvdata->dev, size, &phys, GFP_KERNEL);
+  if (!buffer) {
+    mutex_unlock(&info->mm_lock);
+    printk(KERN_ERR "prsocfb: couldn't allocate %zu bytes.\n", size);
+    return -ENOMEM;
+  }
+
+  memset(buffer, 0, size);
+  if (scale == drvdata->scale)
+    memcpy(buffer, (uint8_t *)old_buffer + shown, screen_size);
+
+  /* Lines must still be a whole number of bursts: take the longest valid
+   * burst that isn't longer than the current one (1 always is). */
+  drvdata->scale = scale;
+  while (!prsocfb_burst_valid(drvdata, drvdata->burst_count))
+    drvdata->burst_count--;
+
+  prsocfb_flip_at_vsync(drvdata, phys);
+
+  drvdata->front_buffer = buffer;
+  drvdata->front_buffer_phys = (unsigned long)phys;
+  drvdata->front_buffer_size = size;
+  info->screen_base = (void *)buffer;
+  info->screen_size = screen_size;
+  info->fix.smem_start = phys;
+  info->fix.smem_len = size;
+  info->fix.line_length = line_length;
+
+  /* The frame buffer core pans to the new yoffset right after. */
+  info->var.yoffset = 0;
+
+  dmam_free_coherent(drvdata->dev, old_size, old_buffer, old_phys);
+  mutex_unlock(&info->mm_lock);
+
+  printk(KERN_INFO "prsocfb: %ux%u (x%u, x%u), %u buffers @ 0x%lx, burst count %u\n",
+         info->var.xres, info->var.yres,
+         drvdata->screen_width / info->var.xres, drvdata->screen_height / info->var.yres,
+         info->var.yres_virtual / info->var.yres, drvdata->front_buffer_phys,
+         drvdata->burst_count);
+  return 0;
+}
+
+/* Count the user mappings, which pin the current frame buffer. */
+static void prsocfb_vm_open(struct vm_area_struct *vma)
+{
+  struct prsoc_display_drvdata *drvdata = vma->vm_private_data;
+  atomic_inc(&drvdata->num_mmaps);
+}
+
+static void prsocfb_vm_close(struct vm_area_struct *vma)
+{
+  struct prsoc_display_drvdata *drvdata = vma->vm_private_data;
+  atomic_dec(&drvdata->num_mmaps);
+}
+
+static const struct vm_operations_struct prsocfb_vm_ops = {
+  .open = prsocfb_vm_open,
+  .close = prsocfb_vm_close,
+};
 
 /* purpose: mmap the front buffer. */
 static int prsocfb_mmap(struct fb_info *info,
@@ -196,17 +572,826 @@ static int prsocfb_mmap(struct fb_info *info,
       size = 0;
   }
 
+  vma->vm_ops = &prsocfb_vm_ops;
+  vma->vm_private_data = drvdata;
+  prsocfb_vm_open(vma);
+
+  return 0;
+}
+
+/* dma-buf exporter
+ *
+ * The whole frame buffer (all the flip buffers) is exported as one dma-buf,
+ * so that other devices can write a frame directly in a back buffer before
+ * panning to it. The memory comes from dma_alloc_coherent(): importers get
+ * it through dma_get_sgtable() and CPU mappings are non-cached.
+ *
+ * Each exported dma-buf holds a reference on this module, so the buffer
+ * can't be freed under the feet of an importer. */
+
+static int prsocfb_dmabuf_attach(struct dma_buf *dmabuf, struct device *dev,
+                                 struct dma_buf_attachment *attach)
+{
+  struct prsoc_display_drvdata *drvdata = dmabuf->priv;
+  struct sg_table *sgt;
+  int err;
+
+  sgt = kzalloc(sizeof(*sgt), GFP_KERNEL);
+  if (!sgt)
+    return -ENOMEM;
+
+  err = dma_get_sgtable(drvdata->dev, sgt, drvdata->front_buffer,
+                        drvdata->front_buffer_phys, drvdata->front_buffer_size);
+  if (err) {
+    kfree(sgt);
+    return err;
+  }
+
+  attach->priv = sgt;
+  return 0;
+}
+
+static void prsocfb_dmabuf_detach(struct dma_buf *dmabuf,
+                                  struct dma_buf_attachment *attach)
+{
+  struct sg_table *sgt = attach->priv;
+
+  sg_free_table(sgt);
+  kfree(sgt);
+}
+
+static struct sg_table *prsocfb_dmabuf_map(struct dma_buf_attachment *attach,
+                                           enum dma_data_direction dir)
+{
+  struct sg_table *sgt = attach->priv;
+
+  if (!dma_map_sg(attach->dev, sgt->sgl, sgt->orig_nents, dir))
+    return ERR_PTR(-ENOMEM);
+
+  return sgt;
+}
+
+static void prsocfb_dmabuf_unmap(struct dma_buf_attachment *attach,
+                                 struct sg_table *sgt,
+                                 enum dma_data_direction dir)
+{
+  dma_unmap_sg(attach->dev, sgt->sgl, sgt->orig_nents, dir);
+}
+
+static void prsocfb_dmabuf_release(struct dma_buf *dmabuf)
+{
+  struct prsoc_display_drvdata *drvdata = dmabuf->priv;
+
+  atomic_dec(&drvdata->num_dmabufs);
+  module_put(THIS_MODULE);
+}
+
+/* The coherent buffer is mapped contiguously in the kernel. */
+static void *prsocfb_dmabuf_kmap(struct dma_buf *dmabuf, unsigned long pgnum)
+{
+  struct prsoc_display_drvdata *drvdata = dmabuf->priv;
+  return (uint8_t *)drvdata->front_buffer + pgnum * PAGE_SIZE;
+}
+
+static void *prsocfb_dmabuf_vmap(struct dma_buf *dmabuf)
+{
+  struct prsoc_display_drvdata *drvdata = dmabuf->priv;
+  return drvdata->front_buffer;
+}
+
+static int prsocfb_dmabuf_mmap(struct dma_buf *dmabuf, struct vm_area_struct *vma)
+{
+  struct prsoc_display_drvdata *drvdata = dmabuf->priv;
+
+  return dma_mmap_coherent(drvdata->dev, vma, drvdata->front_buffer,
+                           drvdata->front_buffer_phys, drvdata->front_buffer_size);
+}
+
+static const struct dma_buf_ops prsocfb_dmabuf_ops = {
+  .attach = prsocfb_dmabuf_attach,
+  .detach = prsocfb_dmabuf_detach,
+  .map_dma_buf = prsocfb_dmabuf_map,
+  .unmap_dma_buf = prsocfb_dmabuf_unmap,
+  .release = prsocfb_dmabuf_release,
+  .kmap = prsocfb_dmabuf_kmap,
+  .kmap_atomic = prsocfb_dmabuf_kmap,
+  .vmap = prsocfb_dmabuf_vmap,
+  .mmap = prsocfb_dmabuf_mmap,
+};
+
+static int prsocfb_export_dmabuf(struct fb_info *info,
+                                 struct prsocfb_dmabuf_export __user *argp)
+{
+  struct prsoc_display_drvdata *drvdata = (struct prsoc_display_drvdata *)info->par;
+  struct prsocfb_dmabuf_export req;
+  struct dma_buf *dmabuf;
+  size_t size;
+  DEFINE_DMA_BUF_EXPORT_INFO(exp_info);
+
+  if (copy_from_user(&req, argp, sizeof(req)))
+    return -EFAULT;
+
+  if (req.flags & ~(O_CLOEXEC | O_ACCMODE))
+    return -EINVAL;
+
+  if (!try_module_get(THIS_MODULE))
+    return -ENODEV;
+
+  /* prsocfb_set_par() checks num_dmabufs and swaps the buffers under
+   * mm_lock: export the current buffer and pin it without it running. */
+  mutex_lock(&info->mm_lock);
+  size = drvdata->front_buffer_size;
+
+  exp_info.ops = &prsocfb_dmabuf_ops;
+  exp_info.size = size;
+  exp_info.flags = O_RDWR;
+  exp_info.priv = drvdata;
+
+  dmabuf = dma_buf_export(&exp_info);
+  if (IS_ERR(dmabuf)) {
+    mutex_unlock(&info->mm_lock);
+    module_put(THIS_MODULE);
+    return PTR_ERR(dmabuf);
+  }
+
+  atomic_inc(&drvdata->num_dmabufs);
+  mutex_unlock(&info->mm_lock);
+
+  req.fd = dma_buf_fd(dmabuf, req.flags);
+  if (req.fd < 0) {
+    dma_buf_put(dmabuf); /* calls prsocfb_dmabuf_release() */
+    return req.fd;
+  }
+
+  req.size = size;
+  req.buffer_size = info->fix.line_length * info->var.yres;
+
+  if (copy_to_user(argp, &req, sizeof(req)))
+    return -EFAULT;
+
+  return 0;
+}
+
+static int prsocfb_ioctl(struct fb_info *info, unsigned int cmd, unsigned long arg)
+{
+  struct prsoc_display_drvdata *drvdata = (struct prsoc_display_drvdata *)info->par;
+
+  switch (cmd) {
+  case PRSOCFB_IOCTL_EXPORT_DMABUF:
+    return prsocfb_export_dmabuf(info, (void __user *)arg);
+
+  case PRSOCFB_IOCTL_WAIT_FLIP:
+    if (!drvdata->has_flip_status)
+      return -ENOTTY;
+    return prsocfb_wait_flip(drvdata);
+  }
+
+  return -ENOTTY;
+}
+
+/* Blanking
+ *
+ * While the screen is blanked, nobody looks at the frame buffer: the frame
+ * manager stops reading it (returning ~50 MB/s of DDR bandwidth at
+ * 480x272x32bpp@60Hz to the other masters) and the video interface is
+ * stopped by writing the optional 'prsoc,reg-blank' <ADDR VAL> pairs, e.g.
+ *   prsoc,reg-blank = <VGA_SEQUENCER_REG_CSR 0>;
+ *
+ * The frame manager finishes the frame it is reading when its DMA loop is
+ * disabled, then goes idle and clears its FIFO at the next frame sync. The
+ * interface must still be running to give that frame sync, so it is only
+ * stopped afterwards. On unblank, the frame manager starts filling its FIFO
+ * from the top of the frame, then 'prsoc,reg-init' is written again: the
+ * interface starts counting on the first valid pixel, so the image comes
+ * back aligned. */
+
+static void write_reg_sequence(struct prsoc_display_drvdata *drvdata,
+                               const __be32 *properties, int len)
+{
+  int i;
+
+  for (i = 0; i + 1 < len; i += 2)
+    LCD_INTERFACE_WR(drvdata, be32_to_cpup(properties + i),
+                     be32_to_cpup(properties + i + 1));
+}
+
+static int prsocfb_blank(int blank, struct fb_info *info)
+{
+  struct prsoc_display_drvdata *drvdata = (struct prsoc_display_drvdata *)info->par;
+
+  if (!blank == !drvdata->blank) {
+    drvdata->blank = blank;
+    return 0;
+  }
+
+  if (blank) {
+    FM_WR(drvdata, FM_REG_CONTROL, FM_CONTROL_DISABLE_DMA_MASK);
+    msleep(PRSOCFB_DRAIN_MS);
+    write_reg_sequence(drvdata, drvdata->reg_blank, drvdata->reg_blank_len);
+  } else {
+    FM_WR(drvdata, FM_REG_CONTROL, FM_CONTROL_ENABLE_DMA_MASK);
+    write_reg_sequence(drvdata, drvdata->reg_init, drvdata->reg_init_len);
+  }
+
+  drvdata->blank = blank;
+  return 0;
+}
+
+/* Acceleration
+ *
+ * fillrect and copyarea are done by a memory-to-memory mSGDMA
+ * (prsoc_msgdma with 'prsoc,dma-mode = <0>') when the device tree gives one:
+ *   dmas = <&msgdma_mm 0>;
+ *   dma-names = "memcpy";
+ * The core only has standard descriptors (no stride), so each line of a
+ * rectangle is a memcpy of its own. They are all queued before waiting;
+ * the dmaengine driver pushes them to the descriptor FIFO back to back and
+ * only interrupts at the end. A fill copies a line of the solid color from
+ * a scratch buffer, so the CPU only writes 'width' pixels instead of
+ * 'width * height'.
+ *
+ * These functions are called by the console with interrupts possibly
+ * disabled, so they busy-wait on the DMA (dma_sync_wait polls the driver).
+ * Setting up the descriptors costs more than the CPU takes to draw small
+ * rectangles: below 'dma_threshold' pixels, the generic cfb_* functions are
+ * used. Reading the 'benchmark' sysfs attribute times both on the screen to
+ * help choosing the threshold. */
+
+#define PRSOCFB_DEFAULT_DMA_THRESHOLD 4096 /* pixels */
+
+/* Cookie assigned by the dmaengine core to the transfer submitted after the
+ * one of 'cookie' on the same channel (see dma_cookie_assign). */
+static inline dma_cookie_t prsocfb_next_cookie(dma_cookie_t cookie)
+{
+  return cookie == INT_MAX ? DMA_MIN_COOKIE : cookie + 1;
+}
+
+/* Number of the 'lines' transfers submitted from 'first' on that are
+ * complete. They complete in order. */
+static unsigned int prsocfb_dma_lines_done(struct dma_chan *chan, dma_cookie_t first,
+                                           unsigned int lines)
+{
+  dma_cookie_t cookie = first, last, used;
+  unsigned int done = 0;
+
+  dma_async_is_tx_complete(chan, first, &last, &used);
+  while (done < lines && dma_async_is_complete(cookie, last, used) == DMA_COMPLETE) {
+    cookie = prsocfb_next_cookie(cookie);
+    done++;
+  }
+
+  return done;
+}
+
+/* Copy 'lines' lines of 'len' bytes from 'src' to 'dst', both with the
+ * pitch of the frame buffer. If 'src_pitch' is 0, the same source line is
+ * copied to every destination line. Returns the number of lines done, in
+ * order (from the last one if 'bottom_up'): the lines after them are left
+ * untouched, or were being written when the DMA got stuck and can be copied
+ * again from their source, which no line done overwrote. */
+static unsigned int prsocfb_dma_lines(struct prsoc_display_drvdata *drvdata,
+                                      dma_addr_t dst, dma_addr_t src,
+                                      uint32_t src_pitch, size_t len,
+                                      unsigned int lines, bool bottom_up)
+{
+  struct dma_chan *chan = drvdata->dma_chan;
+  uint32_t pitch = drvdata->info->fix.line_length;
+  struct dma_async_tx_descriptor *txd;
+  dma_cookie_t first = 0, cookie = 0;
+  unsigned int i, done;
+
+  for (i = 0; i < lines; i++) {
+    unsigned int line = bottom_up ? lines - 1 - i : i;
+
+    txd = dmaengine_prep_dma_memcpy(chan, dst + line * pitch, src + line * src_pitch,
+                                    len, DMA_CTRL_ACK);
+    if (!txd)
+      break;
+
+    cookie = dmaengine_submit(txd);
+    if (dma_submit_error(cookie))
+      break;
+    if (!i)
+      first = cookie;
+  }
+
+  if (!i)
+    return 0;
+
+  dma_async_issue_pending(chan);
+  if (dma_sync_wait(chan, cookie) != DMA_COMPLETE) {
+    /* A DMA that timed out doesn't make progress anymore: what is done
+     * before terminating is all that is done. */
+    done = prsocfb_dma_lines_done(chan, first, i);
+    printk(KERN_ERR "prsocfb: DMA timed out after %u of %u lines.\n", done, lines);
+    dmaengine_terminate_all(chan);
+    return done;
+  }
+
+  return i;
+}
+
+static inline dma_addr_t prsocfb_pixel_phys(struct prsoc_display_drvdata *drvdata,
+                                            uint32_t x, uint32_t y)
+{
+  return drvdata->front_buffer_phys + y * drvdata->info->fix.line_length +
+    x * sizeof(uint32_t);
+}
+
+/* Returns true if the DMA should draw a rectangle. */
+static bool prsocfb_use_dma(struct fb_info *info, uint32_t x, uint32_t y,
+                            uint32_t width, uint32_t height)
+{
+  struct prsoc_display_drvdata *drvdata = (struct prsoc_display_drvdata *)info->par;
+
+  return drvdata->dma_chan &&
+    width * height >= drvdata->dma_threshold &&
+    x + width <= info->var.xres_virtual &&
+    y + height <= info->var.yres_virtual;
+}
+
+static void prsocfb_dma_fillrect(struct fb_info *info, const struct fb_fillrect *rect)
+{
+  struct prsoc_display_drvdata *drvdata = (struct prsoc_display_drvdata *)info->par;
+  struct fb_fillrect rest = *rect;
+  uint32_t color, i;
+
+  if (info->fix.visual == FB_VISUAL_TRUECOLOR ||
+      info->fix.visual == FB_VISUAL_DIRECTCOLOR)
+    color = ((uint32_t *)info->pseudo_palette)[rect->color];
+  else
+    color = rect->color;
+
+  for (i = 0; i < rect->width; i++)
+    drvdata->fill_line[i] = color;
+
+  i = prsocfb_dma_lines(drvdata, prsocfb_pixel_phys(drvdata, rect->dx, rect->dy),
+                        drvdata->fill_line_phys, 0, rect->width * sizeof(uint32_t),
+                        rect->height, false);
+
+  /* Whatever the DMA couldn't do is left to the CPU. */
+  if (i < rect->height) {
+    rest.dy += i;
+    rest.height -= i;
+    cfb_fillrect(info, &rest);
+  }
+}
+
+static void prsocfb_fillrect(struct fb_info *info, const struct fb_fillrect *rect)
+{
+  if (rect->rop != ROP_COPY ||
+      !prsocfb_use_dma(info, rect->dx, rect->dy, rect->width, rect->height)) {
+    cfb_fillrect(info, rect);
+    return;
+  }
+
+  prsocfb_dma_fillrect(info, rect);
+}
+
+static void prsocfb_dma_copyarea(struct fb_info *info, const struct fb_copyarea *area)
+{
+  struct prsoc_display_drvdata *drvdata = (struct prsoc_display_drvdata *)info->par;
+  struct fb_copyarea rest = *area;
+  bool bottom_up = area->dy > area->sy;
+  uint32_t i;
+
+  /* The masters of the mSGDMA copy forward and the read master runs ahead
+   * of the write master, so the lines are copied in the order that never
+   * reads a line that is yet to be written (bottom up when moving down). */
+  i = prsocfb_dma_lines(drvdata, prsocfb_pixel_phys(drvdata, area->dx, area->dy),
+                        prsocfb_pixel_phys(drvdata, area->sx, area->sy),
+                        info->fix.line_length, area->width * sizeof(uint32_t),
+                        area->height, bottom_up);
+
+  if (i < area->height) {
+    if (!bottom_up) {
+      rest.dy += i;
+      rest.sy += i;
+    }
+    rest.height -= i;
+    cfb_copyarea(info, &rest);
+  }
+}
+
+static void prsocfb_copyarea(struct fb_info *info, const struct fb_copyarea *area)
+{
+  uint32_t w = area->width, h = area->height;
+
+  /* Overlapping areas on the same lines would need a backward copy. */
+  if (area->dy == area->sy && area->dx > area->sx && area->dx < area->sx + w) {
+    cfb_copyarea(info, area);
+    return;
+  }
+
+  if (!prsocfb_use_dma(info, area->dx, area->dy, w, h) ||
+      !prsocfb_use_dma(info, area->sx, area->sy, w, h)) {
+    cfb_copyarea(info, area);
+    return;
+  }
+
+  prsocfb_dma_copyarea(info, area);
+}
+
+/* Sysfs attributes */
+
+static ssize_t dma_threshold_show(struct device *dev,
+                                  struct device_attribute *attr, char *buf)
+{
+  struct prsoc_display_drvdata *drvdata = dev_get_drvdata(dev);
+  return sprintf(buf, "%u\n", drvdata->dma_threshold);
+}
+
+static ssize_t dma_threshold_store(struct device *dev,
+                                   struct device_attribute *attr,
+                                   const char *buf, size_t count)
+{
+  struct prsoc_display_drvdata *drvdata = dev_get_drvdata(dev);
+  unsigned int threshold;
+  int err;
+
+  err = kstrtouint(buf, 0, &threshold);
+  if (err)
+    return err;
+
+  drvdata->dma_threshold = threshold;
+  return count;
+}
+
+static DEVICE_ATTR_RW(dma_threshold);
+
+#define PRSOCFB_BENCHMARK_ITERATIONS 16
+
+/* Draw squares of increasing size with the CPU and with the DMA, and print
+ * the average time each took. The console is locked meanwhile. */
+static ssize_t benchmark_show(struct device *dev,
+                              struct device_attribute *attr, char *buf)
+{
+  struct prsoc_display_drvdata *drvdata = dev_get_drvdata(dev);
+  struct fb_info *info = drvdata->info;
+  uint32_t max_size = min(info->var.xres, info->var.yres / 2);
+  struct fb_fillrect rect = { .rop = ROP_COPY, .color = 1 };
+  struct fb_copyarea area = { 0 };
+  s64 cpu_fill, dma_fill, cpu_copy, dma_copy;
+  ktime_t start;
+  uint32_t size;
+  ssize_t len = 0;
+  int i;
+
+  if (!drvdata->dma_chan)
+    return sprintf(buf, "no DMA channel\n");
+
+  len += sprintf(buf + len, "pixels   fill cpu/dma (us)   copy cpu/dma (us)\n");
+
+  console_lock();
+
+  for (size = 8; size <= max_size; size *= 2) {
+    rect.width = rect.height = area.width = area.height = size;
+    area.dy = size; /* copy the filled square just below it */
+
+    start = ktime_get();
+    for (i = 0; i < PRSOCFB_BENCHMARK_ITERATIONS; i++)
+      cfb_fillrect(info, &rect);
+    cpu_fill = ktime_us_delta(ktime_get(), start);
+
+    start = ktime_get();
+    for (i = 0; i < PRSOCFB_BENCHMARK_ITERATIONS; i++)
+      prsocfb_dma_fillrect(info, &rect);
+    dma_fill = ktime_us_delta(ktime_get(), start);
+
+    start = ktime_get();
+    for (i = 0; i < PRSOCFB_BENCHMARK_ITERATIONS; i++)
+      cfb_copyarea(info, &area);
+    cpu_copy = ktime_us_delta(ktime_get(), start);
+
+    start = ktime_get();
+    for (i = 0; i < PRSOCFB_BENCHMARK_ITERATIONS; i++)
+      prsocfb_dma_copyarea(info, &area);
+    dma_copy = ktime_us_delta(ktime_get(), start);
+
+    len += sprintf(buf + len, "%-8u %8lld %8lld   %8lld %8lld\n", size * size,
+                   cpu_fill / PRSOCFB_BENCHMARK_ITERATIONS,
+                   dma_fill / PRSOCFB_BENCHMARK_ITERATIONS,
+                   cpu_copy / PRSOCFB_BENCHMARK_ITERATIONS,
+                   dma_copy / PRSOCFB_BENCHMARK_ITERATIONS);
+  }
+
+  console_unlock();
+
+  return len;
+}
+
+static DEVICE_ATTR_RO(benchmark);
+
+/* Same levels as FBIOBLANK (0: unblank, 1-4: blank). */
+static ssize_t blank_show(struct device *dev,
+                          struct device_attribute *attr, char *buf)
+{
+  struct prsoc_display_drvdata *drvdata = dev_get_drvdata(dev);
+  return sprintf(buf, "%d\n", drvdata->blank);
+}
+
+static ssize_t blank_store(struct device *dev,
+                           struct device_attribute *attr,
+                           const char *buf, size_t count)
+{
+  struct prsoc_display_drvdata *drvdata = dev_get_drvdata(dev);
+  unsigned int blank;
+  int err;
+
+  err = kstrtouint(buf, 0, &blank);
+  if (err)
+    return err;
+
+  if (blank > FB_BLANK_POWERDOWN)
+    return -EINVAL;
+
+  /* Goes through the framebuffer core so that the console knows. */
+  console_lock();
+  err = fb_blank(drvdata->info, blank);
+  console_unlock();
+
+  return err ? err : count;
+}
+
+static DEVICE_ATTR_RW(blank);
+
+/* DMA tuning
+ *
+ * The frame manager reads the frame buffer in bursts of 'burst_count' words
+ * of its DMA master ('prsoc,dma-data-width' bits, 128 or 64 depending on
+ * the fpga2hps bridge it is generated for). The lines must be a whole number
+ * of bursts, and a burst must fit in its FIFO.
+ *
+ * Short bursts let the other masters (capture DMA, CPU) get to the SDRAM
+ * more often, but cost more commands per frame; if they are too short, the
+ * FIFO runs dry under load and the video interface underflows. Writing to
+ * 'calibrate' sweeps the valid burst counts from the smallest one, watches
+ * UNDERFLOW_COUNT for PRSOCFB_CALIBRATION_MS each, and keeps the first one
+ * that never underflowed (or the best one). Run it with the rest of the
+ * system under its usual load. */
+
+#define PRSOCFB_DEFAULT_BURST_COUNT 4
+#define PRSOCFB_CALIBRATION_MS      500
+
+static bool prsocfb_burst_valid(struct prsoc_display_drvdata *drvdata, uint32_t burst)
+{
+  uint32_t pix_per_word = drvdata->dma_data_width / 32;
+  uint32_t words_per_line = drvdata->info->var.xres / pix_per_word;
+
+  return burst >= 1 && burst <= FM_MAX_BURST_COUNT &&
+    words_per_line % burst == 0 &&
+    DIV_ROUND_UP(burst * pix_per_word, 4) <= FM_FIFO_DEPTH;
+}
+
+static ssize_t burst_count_show(struct device *dev,
+                                struct device_attribute *attr, char *buf)
+{
+  struct prsoc_display_drvdata *drvdata = dev_get_drvdata(dev);
+  return sprintf(buf, "%u\n", drvdata->burst_count);
+}
+
+static ssize_t burst_count_store(struct device *dev,
+                                 struct device_attribute *attr,
+                                 const char *buf, size_t count)
+{
+  struct prsoc_display_drvdata *drvdata = dev_get_drvdata(dev);
+  unsigned int burst;
+  int err;
+
+  err = kstrtouint(buf, 0, &burst);
+  if (err)
+    return err;
+
+  /* prsocfb_set_par() changes the resolution and the burst count under
+   * info->lock: check the burst against the current line under it too. */
+  mutex_lock(&drvdata->info->lock);
+  if (!prsocfb_burst_valid(drvdata, burst)) {
+    mutex_unlock(&drvdata->info->lock);
+    return -EINVAL;
+  }
+
+  /* Applied by the frame manager at the next frame. */
+  drvdata->burst_count = burst;
+  FM_WR(drvdata, FM_REG_BURST_COUNT, burst);
+  mutex_unlock(&drvdata->info->lock);
+  return count;
+}
+
+static DEVICE_ATTR_RW(burst_count);
+
+static ssize_t dma_data_width_show(struct device *dev,
+                                   struct device_attribute *attr, char *buf)
+{
+  struct prsoc_display_drvdata *drvdata = dev_get_drvdata(dev);
+  return sprintf(buf, "%u\n", drvdata->dma_data_width);
+}
+
+static DEVICE_ATTR_RO(dma_data_width);
+
+/* Free running, the reader computes differences. */
+static ssize_t underflows_show(struct device *dev,
+                               struct device_attribute *attr, char *buf)
+{
+  struct prsoc_display_drvdata *drvdata = dev_get_drvdata(dev);
+
+  if (!drvdata->has_counters)
+    return -ENODEV;
+
+  return sprintf(buf, "%u\n", FM_RD(drvdata, FM_REG_UNDERFLOW_COUNT));
+}
+
+static DEVICE_ATTR_RO(underflows);
+
+static ssize_t calibrate_store(struct device *dev,
+                               struct device_attribute *attr,
+                               const char *buf, size_t count)
+{
+  struct prsoc_display_drvdata *drvdata = dev_get_drvdata(dev);
+  uint32_t burst, best, best_underflows = U32_MAX;
+  uint32_t start, underflows;
+
+  if (!drvdata->has_counters)
+    return -ENODEV;
+
+  /* Hold info->lock for the whole sweep, so that prsocfb_set_par() can't
+   * change the line length under it (FBIOPUT_VSCREENINFO waits). */
+  mutex_lock(&drvdata->info->lock);
+
+  /* Nothing is read while blanked. */
+  if (drvdata->blank) {
+    mutex_unlock(&drvdata->info->lock);
+    return -EBUSY;
+  }
+
+  best = drvdata->burst_count;
+
+  for (burst = 1; burst <= FM_MAX_BURST_COUNT; burst++) {
+    if (!prsocfb_burst_valid(drvdata, burst))
+      continue;
+
+    FM_WR(drvdata, FM_REG_BURST_COUNT, burst);
+    msleep(PRSOCFB_DRAIN_MS); /* let the frame manager take it */
+
+    start = FM_RD(drvdata, FM_REG_UNDERFLOW_COUNT);
+    msleep(PRSOCFB_CALIBRATION_MS);
+    underflows = FM_RD(drvdata, FM_REG_UNDERFLOW_COUNT) - start;
+
+    printk(KERN_INFO "prsocfb: burst count %u: %u underflows\n", burst, underflows);
+
+    if (underflows < best_underflows) {
+      best = burst;
+      best_underflows = underflows;
+    }
+
+    if (!underflows)
+      break;
+  }
+
+  drvdata->burst_count = best;
+  FM_WR(drvdata, FM_REG_BURST_COUNT, best);
+  mutex_unlock(&drvdata->info->lock);
+
+  printk(KERN_INFO "prsocfb: calibrated burst count: %u\n", best);
+  return count;
+}
+
+static DEVICE_ATTR_WO(calibrate);
+
+static struct attribute *prsocfb_attrs[] = {
+  &dev_attr_dma_threshold.attr,
+  &dev_attr_benchmark.attr,
+  &dev_attr_blank.attr,
+  &dev_attr_burst_count.attr,
+  &dev_attr_dma_data_width.attr,
+  &dev_attr_underflows.attr,
+  &dev_attr_calibrate.attr,
+  NULL,
+};
+
+static const struct attribute_group prsocfb_attr_group = {
+  .attrs = prsocfb_attrs,
+};
+
+/* Scanout performance counters (debugfs)
+ *
+ * /sys/kernel/debug/prsocfb<N>/counters (N as in /dev/fbN) prints the frame manager's free
+ * running counters and their rates per second since the previous read, e.g.
+ *   watch -n 1 cat /sys/kernel/debug/prsocfb0/counters
+ * min_fifo_fill is the lowest FIFO level seen when a burst was issued since
+ * the previous read (in words). It gets close to 0 when other masters load
+ * the SDRAM too much: this is where underflows start.
+ * Writing anything to the file resets the minimum. */
+
+static void prsocfb_read_counters(struct prsoc_display_drvdata *drvdata,
+                                  struct prsocfb_counters *counters)
+{
+  counters->bursts = FM_RD(drvdata, FM_REG_BURSTS);
+  counters->stall_cycles = FM_RD(drvdata, FM_REG_STALL_CYCLES);
+  counters->underflows = FM_RD(drvdata, FM_REG_UNDERFLOW_COUNT);
+  counters->frames = FM_RD(drvdata, FM_REG_FRAMES);
+  counters->time = ktime_get();
+}
+
+/* Counters wrap around: the unsigned difference is still right. */
+static uint64_t prsocfb_rate(uint32_t now, uint32_t before, s64 elapsed_ns)
+{
+  if (elapsed_ns <= 0)
+    return 0;
+
+  return div64_s64((uint64_t)(uint32_t)(now - before) * NSEC_PER_SEC, elapsed_ns);
+}
+
+static int prsocfb_counters_show(struct seq_file *s, void *unused)
+{
+  struct prsoc_display_drvdata *drvdata = s->private;
+  struct prsocfb_counters now, *last = &drvdata->last_counters;
+  uint32_t min_fifo_fill;
+  s64 elapsed_ns;
+
+  mutex_lock(&drvdata->counters_lock);
+
+  prsocfb_read_counters(drvdata, &now);
+  min_fifo_fill = FM_RD(drvdata, FM_REG_MIN_FIFO_FILL);
+  FM_WR(drvdata, FM_REG_MIN_FIFO_FILL, 0); /* restart the minimum */
+  elapsed_ns = ktime_to_ns(ktime_sub(now.time, last->time));
+
+  seq_printf(s, "%-14s %12s %12s\n", "counter", "value", "per second");
+  seq_printf(s, "%-14s %12u %12llu\n", "bursts", now.bursts,
+             prsocfb_rate(now.bursts, last->bursts, elapsed_ns));
+  seq_printf(s, "%-14s %12u %12llu\n", "stall_cycles", now.stall_cycles,
+             prsocfb_rate(now.stall_cycles, last->stall_cycles, elapsed_ns));
+  seq_printf(s, "%-14s %12u %12llu\n", "underflows", now.underflows,
+             prsocfb_rate(now.underflows, last->underflows, elapsed_ns));
+  seq_printf(s, "%-14s %12u %12llu\n", "frames", now.frames,
+             prsocfb_rate(now.frames, last->frames, elapsed_ns));
+  seq_printf(s, "%-14s %12u %12s\n", "min_fifo_fill", min_fifo_fill, "-");
+  seq_printf(s, "interval: %lld ms, burst count: %u, fifo depth: %u\n",
+             div_s64(elapsed_ns, NSEC_PER_MSEC), drvdata->burst_count, FM_FIFO_DEPTH);
+
+  *last = now;
+
+  mutex_unlock(&drvdata->counters_lock);
   return 0;
 }
 
+static int prsocfb_counters_open(struct inode *inode, struct file *file)
+{
+  return single_open(file, prsocfb_counters_show, inode->i_private);
+}
+
+static ssize_t prsocfb_counters_write(struct file *file, const char __user *buf,
+                                      size_t count, loff_t *ppos)
+{
+  struct prsoc_display_drvdata *drvdata = file_inode(file)->i_private;
+
+  FM_WR(drvdata, FM_REG_MIN_FIFO_FILL, 0);
+  return count;
+}
+
+static const struct file_operations prsocfb_counters_fops = {
+  .owner = THIS_MODULE,
+  .open = prsocfb_counters_open,
+  .read = seq_read,
+  .write = prsocfb_counters_write,
+  .llseek = seq_lseek,
+  .release = single_release,
+};
+
+/* Not fatal: the display works without debugfs. Called once the frame
+ * buffer is registered (for its number). */
+static void prsocfb_debugfs_init(struct prsoc_display_drvdata *drvdata)
+{
+  char name[16];
+
+  if (!drvdata->has_counters)
+    return;
+
+  mutex_init(&drvdata->counters_lock);
+  prsocfb_read_counters(drvdata, &drvdata->last_counters);
+
+  snprintf(name, sizeof(name), "prsocfb%d", drvdata->info->node);
+  drvdata->debugfs_dir = debugfs_create_dir(name, NULL);
+  if (IS_ERR_OR_NULL(drvdata->debugfs_dir)) {
+    drvdata->debugfs_dir = NULL;
+    return;
+  }
+
+  debugfs_create_file("counters", 0644, drvdata->debugfs_dir, drvdata,
+                      &prsocfb_counters_fops);
+}
+
 static struct fb_ops prsocfb_ops = {
   .owner = THIS_MODULE,
   .fb_setcolreg = prsocfb_setcoloreg,
-  .fb_fillrect = cfb_fillrect,
-  .fb_copyarea = cfb_copyarea,
+  .fb_check_var = prsocfb_check_var,
+  .fb_set_par = prsocfb_set_par,
+  .fb_fillrect = prsocfb_fillrect,
+  .fb_copyarea = prsocfb_copyarea,
   .fb_imageblit = cfb_imageblit,
   .fb_mmap = prsocfb_mmap,
-  .fb_pan_display = prsocfb_pan_display
+  .fb_pan_display = prsocfb_pan_display,
+  .fb_blank = prsocfb_blank,
+  .fb_ioctl = prsocfb_ioctl
 };
 
 /* Platform driver */
@@ -247,6 +1432,7 @@ static int configure_from_dt(
   /* Extract a pointer to the device node. */
   struct device_node *np = pdev->dev.of_node;
   dma_addr_t phys;
+  uint32_t hw_data_width;
 
   /* Get the width and height properties. */
   uint32_t screen_width  = EXTRACT_INT_FROM_DT_OR_FAIL(np, "prsoc,screen-width");
@@ -265,6 +1451,35 @@ static int configure_from_dt(
 
   printk(KERN_INFO "Framebuffer manager regs @ 0x%x-0x%x\n",
          rsrc->start, rsrc->end);
+
+  /* DMA parameters. Frame managers that know their data width report it
+   * (and have the underflow counter); older ones read as 0. */
+  drvdata->burst_count = PRSOCFB_DEFAULT_BURST_COUNT;
+  of_property_read_u32(np, "prsoc,burst-count", &drvdata->burst_count);
+  drvdata->dma_data_width = 128;
+  of_property_read_u32(np, "prsoc,dma-data-width", &drvdata->dma_data_width);
+
+  hw_data_width = FM_RD(drvdata, FM_REG_DMA_DATA_WIDTH);
+  drvdata->has_counters = hw_data_width != 0;
+  if (hw_data_width && hw_data_width != drvdata->dma_data_width) {
+    printk(KERN_ERR "prsoc_fbdev: 'prsoc,dma-data-width' is %u but the frame manager has %u bits.\n",
+           drvdata->dma_data_width, hw_data_width);
+    drvdata->dma_data_width = hw_data_width;
+  }
+
+  if (drvdata->dma_data_width != 64 && drvdata->dma_data_width != 128) {
+    printk(KERN_ERR "prsoc_fbdev: 'prsoc,dma-data-width' must be 64 or 128.\n");
+    return -EINVAL;
+  }
+
+  /* Smaller resolutions need a frame manager that replicates pixels (older
+   * ones read as 0). */
+  drvdata->screen_width = screen_width;
+  drvdata->screen_height = screen_height;
+  drvdata->line_buffer_depth = FM_RD(drvdata, FM_REG_LINE_BUFFER_DEPTH);
+  if (drvdata->line_buffer_depth)
+    printk(KERN_INFO "prsoc_fbdev: pixel replication, lines of up to %u pixels.\n",
+           drvdata->line_buffer_depth);
  
   /* Maps the addresses of the video interface. */
   rsrc = platform_get_resource(pdev, IORESOURCE_MEM, 1);
@@ -311,8 +1526,21 @@ static int configure_from_dt(
   }
  
   drvdata->front_buffer_phys = (unsigned long)phys;
+  drvdata->front_buffer_size = buffer_width * buffer_height * sizeof(uint32_t);
   printk(KERN_INFO "DMABLE BUFFER @ 0x%lx\n", drvdata->front_buffer_phys);
 
+  /* Parse the optional reg-blank sequence, written by prsocfb_blank(). */
+  properties = of_get_property(pdev->dev.of_node, "prsoc,reg-blank", &len);
+  if (properties) {
+    len /= sizeof(__be32);
+    if (len % 2 != 0) {
+      printk(KERN_ERR "'prsoc,reg-blank' in Device Tree should have format <ADDR1 VAL1>, <ADDR2 VAL2>, ...\n");
+      return -EINVAL;
+    }
+    drvdata->reg_blank = properties;
+    drvdata->reg_blank_len = len;
+  }
+
   /* Parse the reg-init sequence */
   properties = of_get_property(pdev->dev.of_node, "prsoc,reg-init", &len);
 
@@ -328,6 +1556,10 @@ static int configure_from_dt(
     return -EINVAL;
   }
 
+  /* Kept to restart the interface on unblank. */
+  drvdata->reg_init = properties;
+  drvdata->reg_init_len = len;
+
   printk(KERN_INFO "Initialize registers as specified in Device Tree:\n");
   for (i = 0; i < len; i += 2) {
     uint32_t offset = be32_to_cpup(properties + i);
@@ -339,6 +1571,46 @@ static int configure_from_dt(
   return 0;
 }
 
+/* Request the optional memory-to-memory DMA channel. */
+static int configure_acceleration(struct platform_device *pdev,
+                                  struct prsoc_display_drvdata *drvdata,
+                                  struct fb_info *info)
+{
+  struct dma_chan *chan;
+
+  drvdata->dma_threshold = PRSOCFB_DEFAULT_DMA_THRESHOLD;
+
+  chan = dma_request_slave_channel_reason(&pdev->dev, "memcpy");
+  if (IS_ERR(chan)) {
+    if (PTR_ERR(chan) == -EPROBE_DEFER)
+      return -EPROBE_DEFER;
+
+    printk(KERN_INFO "prsocfb: no 'memcpy' DMA channel, drawing with the CPU.\n");
+    return 0;
+  }
+
+  if (!dma_has_cap(DMA_MEMCPY, chan->device->cap_mask)) {
+    printk(KERN_ERR "prsocfb: the 'memcpy' DMA channel can't do memcpy.\n");
+    dma_release_channel(chan);
+    return 0;
+  }
+
+  drvdata->fill_line = dmam_alloc_coherent(&pdev->dev,
+                                           info->var.xres_virtual * sizeof(uint32_t),
+                                           &drvdata->fill_line_phys, GFP_KERNEL);
+  if (!drvdata->fill_line) {
+    dma_release_channel(chan);
+    return -ENOMEM;
+  }
+
+  drvdata->dma_chan = chan;
+  info->flags |= FBINFO_HWACCEL_FILLRECT | FBINFO_HWACCEL_COPYAREA;
+
+  printk(KERN_INFO "prsocfb: fillrect and copyarea through %s.\n",
+         dma_chan_name(chan));
+  return 0;
+}
+
 /*
  * The following method is called when the driver is loaded.
  * It collects information from the device tree.
@@ -348,6 +1620,7 @@ prsoc_display_platform_probe(struct platform_device *pdev)
 {
   struct prsoc_display_drvdata *drvdata;
   struct fb_info *info;
+  int err;
  
   /* Defensive programming: let's make sure this is the right device. */
   if (!of_match_device(prsoc_display_device_ids, &pdev->dev))
@@ -363,40 +1636,107 @@ prsoc_display_platform_probe(struct platform_device *pdev)
   drvdata = (struct prsoc_display_drvdata *)info->par;
  
   platform_set_drvdata(pdev, drvdata);
+  drvdata->dev = &pdev->dev;
+  drvdata->info = info;
+  atomic_set(&drvdata->num_dmabufs, 0);
+  atomic_set(&drvdata->num_mmaps, 0);
+  spin_lock_init(&drvdata->flip_lock);
+  init_completion(&drvdata->flip_done);
 
   printk(KERN_INFO "Configure from Device Tree.\n");
-  configure_from_dt(pdev, drvdata, &info->fix, &info->var);
+  err = configure_from_dt(pdev, drvdata, &info->fix, &info->var);
+  if (err)
+    goto err_release;
 
   printk(KERN_INFO "Initialize the Frame Manager.\n");
   FM_WR(drvdata, FM_REG_FRAME_START_ADDRESS, drvdata->front_buffer_phys);
   FM_WR(drvdata, FM_REG_FRAME_PIX_PER_LINE, info->var.xres);
   FM_WR(drvdata, FM_REG_FRAME_NUM_LINES, info->var.yres);
   FM_WR(drvdata, FM_REG_FRAME_EOL_BYTE_OFST, 0);
-  FM_WR(drvdata, FM_REG_BURST_COUNT, 4);
+  if (!prsocfb_burst_valid(drvdata, drvdata->burst_count)) {
+    printk(KERN_ERR "prsoc_fbdev: invalid burst count %u, using %u.\n",
+           drvdata->burst_count, PRSOCFB_DEFAULT_BURST_COUNT);
+    drvdata->burst_count = PRSOCFB_DEFAULT_BURST_COUNT;
+  }
+  FM_WR(drvdata, FM_REG_BURST_COUNT, drvdata->burst_count);
+  drvdata->scale = FM_SCALE(0, 0);
+  if (drvdata->line_buffer_depth)
+    FM_WR(drvdata, FM_REG_SCALE, drvdata->scale);
   FM_WR(drvdata, FM_REG_CONTROL, FM_CONTROL_ENABLE_DMA_MASK);
 
+  /* Frame managers that queue flips report it (older ones read as 0). */
+  drvdata->has_flip_status = FM_RD(drvdata, FM_REG_STATUS) & FM_STATUS_ENABLED_MASK;
+  drvdata->flip_addr = drvdata->front_buffer_phys;
+  drvdata->flip_pix_per_line = info->var.xres;
+  drvdata->flip_num_lines = info->var.yres;
+  drvdata->flip_scale = drvdata->scale;
+  drvdata->flip_burst_count = drvdata->burst_count;
+
   /* Enable IRQ */
   // FM_WR(drvdata, FM_REG_CONTROL, FM_CONTROL_ENABLE_IRQ_MASK);
 
   /* Configure the framebuffer */
   info->screen_base = (void *)drvdata->front_buffer;
   info->screen_size = info->var.xres * info->var.yres * sizeof(uint32_t);
+  info->fix.smem_start = drvdata->front_buffer_phys;
+  info->fix.smem_len = drvdata->front_buffer_size;
   info->fbops = &prsocfb_ops;
   info->pseudo_palette = pseudo_palette;
   info->flags = FBINFO_DEFAULT;
+
+  err = configure_acceleration(pdev, drvdata, info);
+  if (err)
+    goto err_disable;
  
-  if (fb_alloc_cmap(&info->cmap, 256, 0))
-      return -ENOMEM;
+  if (fb_alloc_cmap(&info->cmap, 256, 0)) {
+    err = -ENOMEM;
+    goto err_accel;
+  }
+
+  err = sysfs_create_group(&pdev->dev.kobj, &prsocfb_attr_group);
+  if (err)
+    goto err_cmap;
  
-  return register_framebuffer(info);
+  err = register_framebuffer(info);
+  if (err)
+    goto err_sysfs;
+
+  prsocfb_debugfs_init(drvdata);
+  return 0;
+
+err_sysfs:
+  sysfs_remove_group(&pdev->dev.kobj, &prsocfb_attr_group);
+err_cmap:
+  fb_dealloc_cmap(&info->cmap);
+err_accel:
+  if (drvdata->dma_chan)
+    dma_release_channel(drvdata->dma_chan);
+err_disable:
+  /* The frame buffer is freed by devres once probe returned: the frame
+   * manager must not read it anymore (e.g. -EPROBE_DEFER of the DMA). */
+  FM_WR(drvdata, FM_REG_CONTROL, FM_CONTROL_DISABLE_DMA_MASK);
+err_release:
+  /* configure_from_dt() failed before the frame manager was started (its
+   * registers may not even be mapped). */
+  framebuffer_release(info);
+  return err;
 }
 
 int prsoc_display_platform_remove(struct platform_device *pdev)
 {
   struct prsoc_display_drvdata *drvdata = platform_get_drvdata(pdev);
-  struct fb_info *info = container_of((void *)drvdata, struct fb_info, par);
+  struct fb_info *info = drvdata->info;
 
+  debugfs_remove_recursive(drvdata->debugfs_dir);
   unregister_framebuffer(info);
+  sysfs_remove_group(&pdev->dev.kobj, &prsocfb_attr_group);
+
+  /* devres frees the frame buffer right after: stop the frame manager
+   * reading it and let the last burst finish. */
+  FM_WR(drvdata, FM_REG_CONTROL, FM_CONTROL_DISABLE_DMA_MASK);
+  msleep(PRSOCFB_DRAIN_MS);
+  if (drvdata->dma_chan)
+    dma_release_channel(drvdata->dma_chan);
   fb_dealloc_cmap(&info->cmap);
   framebuffer_release(info);
 
@@ -405,6 +1745,7 @@ int prsoc_display_platform_remove(struct platform_device *pdev)
 
 static struct platform_driver prsoc_display_pdriver = {
   .probe = prsoc_display_platform_probe,
+  .remove = prsoc_display_platform_remove,
   .driver = {
     .name = "PrSoC displays",
     .owner = THIS_MODULE,
@@ -0,0 +1,40 @@
+/*
+ * @file prsoc_fbdev.h
+ * @brief ioctls of the PrSoC framebuffer driver (in addition to linux/fb.h).
+ *
+ * This header is shared by the driver and the applications.
+ */
+
+#ifndef __PRSOC_FBDEV_H__
+#define __PRSOC_FBDEV_H__
+
+#include <linux/ioctl.h>
+#include <linux/types.h>
+
+/*
+ * Export the frame buffer (all the yres_virtual lines, i.e. every flip
+ * buffer) as a dma-buf file descriptor. Buffer i starts at byte offset
+ * i * buffer_size in the dma-buf; pan to yoffset = i * yres to show it.
+ *
+ * The frame buffer cannot be reallocated while a dma-buf is exported.
+ */
+struct prsocfb_dmabuf_export {
+  __u32 flags;       /* in:  O_CLOEXEC and/or O_RDWR for the new fd */
+  __s32 fd;          /* out: dma-buf file descriptor */
+  __u32 size;        /* out: size of the dma-buf in bytes */
+  __u32 buffer_size; /* out: size of one flip buffer (line_length * yres) */
+};
+
+#define PRSOCFB_IOCTL_EXPORT_DMABUF _IOWR('F', 0x40, struct prsocfb_dmabuf_export)
+
+/*
+ * Wait until the buffer of the last FBIOPAN_DISPLAY is shown, i.e. the
+ * previous one is not read anymore and can be drawn into. FBIOPAN_DISPLAY
+ * itself doesn't wait: the frame manager switches buffers at its next frame.
+ *
+ * Returns -1 with errno ENOTTY if the frame manager can't tell (older
+ * hardware), ETIMEDOUT if it didn't switch within 100 ms.
+ */
+#define PRSOCFB_IOCTL_WAIT_FLIP _IO('F', 0x41)
+
+#endif /* __PRSOC_FBDEV_H__ */
@@ -0,0 +1,369 @@
+/*
+ * @file prsoc_joysticks
+ * @date 19 Oct 2026
+ * @brief Input subsystem (evdev) Linux driver for the PrSoC joysticks.
+ *
+ * The two analog joysticks of the PrSoC extension board are wired to the
+ * four channels of the MCP3204 ADC. This driver polls these channels at a
+ * fixed rate from the kernel and reports them as a 4-axis input device:
+ *   - ABS_X  / ABS_Y  : left joystick (horizontal / vertical)
+ *   - ABS_RX / ABS_RY : right joystick (horizontal / vertical)
+ *
+ * The ADC itself is handled by the IIO driver of the mcp3204 component
+ * (see ../mcp3204/iio). This driver is an IIO consumer: the device tree
+ * node lists the four IIO channels in the order x, y, rx, ry, so the
+ * channel mapping lives in the device tree instead of in the code:
+ *
+ *   joysticks {
+ *     compatible = "prsoc,joysticks";
+ *     io-channels = <&mcp3204 3>, <&mcp3204 2>, <&mcp3204 1>, <&mcp3204 0>;
+ *     io-channel-names = "x", "y", "rx", "ry";
+ *     poll-interval = <10>;               // ms
+ *     prsoc,inverted-axes = <0 1 0 1>;    // 90 degree rotation of the sticks
+ *     prsoc,dead-zone = <48>;             // in ADC LSBs around the center
+ *   };
+ *
+ * Every poll, each raw value goes through:
+ *   1. rotation compensation (value = MAX - value on inverted axes),
+ *   2. calibration (the range [min, center] and [center, max] are
+ *      independently stretched to [0, 2048] and [2048, 4095]),
+ *   3. dead-zone (anything closer than dead-zone to the center is the center).
+ *
+ * The input core drops events that do not change the value of an axis (and
+ * values within 'fuzz' of the previous one), and does not deliver a
+ * SYN_REPORT that closes an empty packet. Readers therefore only wake up
+ * when a stick actually moved.
+ *
+ * The center of each axis is calibrated at probe time (the sticks are
+ * assumed to be at rest) and can be re-calibrated at any time with:
+ *   echo 1 > /sys/devices/.../calibrate
+ *
+ * Revisions:
+ *  10/19/2026 Created
+ */
+
+#include <linux/module.h>
+#include <linux/kernel.h>
+#include <linux/platform_device.h>
+#include <linux/of_device.h>
+#include <linux/input.h>
+#include <linux/input-polldev.h>
+#include <linux/iio/consumer.h>
+#include <linux/mutex.h>
+#include <linux/types.h>
+
+#define JOYSTICKS_NUM_AXES  4
+#define JOYSTICKS_MIN_VALUE 0
+#define JOYSTICKS_MAX_VALUE 4095
+#define JOYSTICKS_CENTER    ((JOYSTICKS_MAX_VALUE + 1) / 2)
+
+#define JOYSTICKS_DEFAULT_POLL_INTERVAL_MS 10
+#define JOYSTICKS_DEFAULT_DEAD_ZONE        48
+#define JOYSTICKS_MAX_DEAD_ZONE            (JOYSTICKS_CENTER / 2 - 1)
+#define JOYSTICKS_FUZZ                     8
+
+/* One analog axis. */
+struct prsoc_joysticks_axis {
+  struct iio_channel *channel;
+  unsigned int code;  /* ABS_* code reported for this axis */
+  bool inverted;      /* compensates the rotation of the stick on the PCB */
+
+  /* Calibration, in (rotation compensated) ADC LSBs. */
+  int min;
+  int center;
+  int max;
+};
+
+/* Enclose the driver data. */
+struct prsoc_joysticks_drvdata {
+  struct input_polled_dev *poll_dev;
+  struct prsoc_joysticks_axis axes[JOYSTICKS_NUM_AXES];
+  int dead_zone;
+  struct mutex lock; /* protects the calibration against the poll */
+};
+
+static const char * const axis_names[JOYSTICKS_NUM_AXES] = {
+  "x", "y", "rx", "ry"
+};
+
+static const unsigned int axis_codes[JOYSTICKS_NUM_AXES] = {
+  ABS_X, ABS_Y, ABS_RX, ABS_RY
+};
+
+/* Read an axis and compensate its rotation. */
+static int read_axis(struct prsoc_joysticks_axis *axis, int *value)
+{
+  int err = iio_read_channel_raw(axis->channel, value);
+  if (err < 0)
+    return err;
+
+  if (axis->inverted)
+    *value = JOYSTICKS_MAX_VALUE - *value;
+
+  return 0;
+}
+
+/* Apply calibration and dead-zone to a rotation compensated value. */
+static int calibrate_value(struct prsoc_joysticks_drvdata *drvdata,
+                           struct prsoc_joysticks_axis *axis, int value)
+{
+  int delta = value - axis->center;
+  int span;
+
+  if (abs(delta) <= drvdata->dead_zone)
+    return JOYSTICKS_CENTER;
+
+  if (delta < 0) {
+    span = axis->center - axis->min - drvdata->dead_zone;
+    if (span <= 0)
+      return JOYSTICKS_MIN_VALUE;
+    delta = (delta + drvdata->dead_zone) * JOYSTICKS_CENTER / span;
+  } else {
+    span = axis->max - axis->center - drvdata->dead_zone;
+    if (span <= 0)
+      return JOYSTICKS_MAX_VALUE;
+    delta = (delta - drvdata->dead_zone) * (JOYSTICKS_MAX_VALUE - JOYSTICKS_CENTER) / span;
+  }
+
+  return clamp(JOYSTICKS_CENTER + delta, JOYSTICKS_MIN_VALUE, JOYSTICKS_MAX_VALUE);
+}
+
+/* Take the current position of every axis as its center. */
+static int calibrate_centers(struct prsoc_joysticks_drvdata *drvdata)
+{
+  int i, err, value;
+
+  for (i = 0; i < JOYSTICKS_NUM_AXES; i++) {
+    struct prsoc_joysticks_axis *axis = &drvdata->axes[i];
+
+    err = read_axis(axis, &value);
+    if (err)
+      return err;
+
+    /* A center too close to an end would make one half of the axis
+     * unusable: the stick was obviously not at rest. */
+    if (value - axis->min <= 2 * drvdata->dead_zone ||
+        axis->max - value <= 2 * drvdata->dead_zone)
+      return -ERANGE;
+
+    axis->center = value;
+  }
+
+  return 0;
+}
+
+/* Input driver */
+
+/* Called by the input-polldev workqueue every poll-interval ms. */
+static void prsoc_joysticks_poll(struct input_polled_dev *poll_dev)
+{
+  struct prsoc_joysticks_drvdata *drvdata = poll_dev->private;
+  struct input_dev *input = poll_dev->input;
+  int i, value;
+
+  mutex_lock(&drvdata->lock);
+
+  for (i = 0; i < JOYSTICKS_NUM_AXES; i++) {
+    struct prsoc_joysticks_axis *axis = &drvdata->axes[i];
+
+    if (read_axis(axis, &value))
+      continue;
+
+    /* Unchanged values are filtered out by the input core. */
+    input_report_abs(input, axis->code, calibrate_value(drvdata, axis, value));
+  }
+
+  mutex_unlock(&drvdata->lock);
+
+  input_sync(input);
+}
+
+/* sysfs attributes */
+
+static ssize_t calibrate_store(struct device *dev, struct device_attribute *attr,
+                               const char *buf, size_t count)
+{
+  struct prsoc_joysticks_drvdata *drvdata = dev_get_drvdata(dev);
+  int err;
+
+  mutex_lock(&drvdata->lock);
+  err = calibrate_centers(drvdata);
+  mutex_unlock(&drvdata->lock);
+
+  return err ? err : count;
+}
+static DEVICE_ATTR_WO(calibrate);
+
+static ssize_t dead_zone_show(struct device *dev, struct device_attribute *attr,
+                              char *buf)
+{
+  struct prsoc_joysticks_drvdata *drvdata = dev_get_drvdata(dev);
+  return sprintf(buf, "%d\n", drvdata->dead_zone);
+}
+
+static ssize_t dead_zone_store(struct device *dev, struct device_attribute *attr,
+                               const char *buf, size_t count)
+{
+  struct prsoc_joysticks_drvdata *drvdata = dev_get_drvdata(dev);
+  unsigned int dead_zone;
+  int err = kstrtouint(buf, 0, &dead_zone);
+  if (err)
+    return err;
+
+  if (dead_zone > JOYSTICKS_MAX_DEAD_ZONE)
+    return -EINVAL;
+
+  mutex_lock(&drvdata->lock);
+  drvdata->dead_zone = dead_zone;
+  mutex_unlock(&drvdata->lock);
+
+  return count;
+}
+static DEVICE_ATTR_RW(dead_zone);
+
+static struct attribute *prsoc_joysticks_attrs[] = {
+  &dev_attr_calibrate.attr,
+  &dev_attr_dead_zone.attr,
+  NULL
+};
+
+static const struct attribute_group prsoc_joysticks_attr_group = {
+  .attrs = prsoc_joysticks_attrs,
+};
+
+/* Platform driver */
+
+/* Informs the kernel of the corresponding compatible string. */
+static const struct of_device_id prsoc_joysticks_device_ids[] = {
+  { .compatible = "prsoc,joysticks" },
+  { }
+};
+MODULE_DEVICE_TABLE(of, prsoc_joysticks_device_ids);
+
+/* Apply configuration from device tree. */
+static int configure_from_dt(struct platform_device *pdev,
+                             struct prsoc_joysticks_drvdata *drvdata)
+{
+  struct device_node *np = pdev->dev.of_node;
+  uint32_t inverted[JOYSTICKS_NUM_AXES] = { 0 };
+  uint32_t value;
+  int i;
+
+  for (i = 0; i < JOYSTICKS_NUM_AXES; i++) {
+    struct prsoc_joysticks_axis *axis = &drvdata->axes[i];
+
+    /* The IIO channel may not be available yet if the mcp3204 driver is
+     * not loaded: IIO returns -EPROBE_DEFER in that case. */
+    axis->channel = devm_iio_channel_get(&pdev->dev, axis_names[i]);
+    if (IS_ERR(axis->channel))
+      return PTR_ERR(axis->channel);
+
+    axis->code = axis_codes[i];
+    axis->min = JOYSTICKS_MIN_VALUE;
+    axis->center = JOYSTICKS_CENTER;
+    axis->max = JOYSTICKS_MAX_VALUE;
+  }
+
+  /* All the remaining properties are optional. */
+  of_property_read_u32_array(np, "prsoc,inverted-axes", inverted, JOYSTICKS_NUM_AXES);
+  for (i = 0; i < JOYSTICKS_NUM_AXES; i++)
+    drvdata->axes[i].inverted = inverted[i];
+
+  drvdata->dead_zone = JOYSTICKS_DEFAULT_DEAD_ZONE;
+  if (!of_property_read_u32(np, "prsoc,dead-zone", &value)) {
+    /* Same range as the dead_zone sysfs attribute. */
+    if (value > JOYSTICKS_MAX_DEAD_ZONE) {
+      dev_warn(&pdev->dev, "prsoc,dead-zone = %u is too large, using %d.\n",
+               value, JOYSTICKS_MAX_DEAD_ZONE);
+      value = JOYSTICKS_MAX_DEAD_ZONE;
+    }
+    drvdata->dead_zone = value;
+  }
+
+  drvdata->poll_dev->poll_interval = JOYSTICKS_DEFAULT_POLL_INTERVAL_MS;
+  if (!of_property_read_u32(np, "poll-interval", &value))
+    drvdata->poll_dev->poll_interval = value;
+
+  return 0;
+}
+
+/*
+ * The following method is called when the driver is loaded.
+ * It collects information from the device tree.
+ */
+static int
+prsoc_joysticks_platform_probe(struct platform_device *pdev)
+{
+  struct prsoc_joysticks_drvdata *drvdata;
+  struct input_polled_dev *poll_dev;
+  struct input_dev *input;
+  int i, err;
+
+  /* Defensive programming: let's make sure this is the right device. */
+  if (!of_match_device(prsoc_joysticks_device_ids, &pdev->dev))
+    return -EINVAL;
+
+  drvdata = devm_kzalloc(&pdev->dev, sizeof(*drvdata), GFP_KERNEL);
+  if (!drvdata)
+    return -ENOMEM;
+
+  mutex_init(&drvdata->lock);
+  platform_set_drvdata(pdev, drvdata);
+
+  poll_dev = devm_input_allocate_polled_device(&pdev->dev);
+  if (!poll_dev)
+    return -ENOMEM;
+
+  drvdata->poll_dev = poll_dev;
+  poll_dev->private = drvdata;
+  poll_dev->poll = prsoc_joysticks_poll;
+
+  err = configure_from_dt(pdev, drvdata);
+  if (err)
+    return err;
+
+  err = calibrate_centers(drvdata);
+  if (err)
+    dev_warn(&pdev->dev, "couldn't calibrate the centers (%d), using defaults.\n", err);
+
+  input = poll_dev->input;
+  input->name = "PrSoC joysticks";
+  input->phys = "prsoc-joysticks/input0";
+  input->id.bustype = BUS_HOST;
+
+  __set_bit(EV_ABS, input->evbit);
+  for (i = 0; i < JOYSTICKS_NUM_AXES; i++)
+    input_set_abs_params(input, drvdata->axes[i].code,
+                         JOYSTICKS_MIN_VALUE, JOYSTICKS_MAX_VALUE,
+                         JOYSTICKS_FUZZ, 0);
+
+  err = sysfs_create_group(&pdev->dev.kobj, &prsoc_joysticks_attr_group);
+  if (err)
+    return err;
+
+  err = input_register_polled_device(poll_dev);
+  if (err)
+    sysfs_remove_group(&pdev->dev.kobj, &prsoc_joysticks_attr_group);
+
+  return err;
+}
+
+static int prsoc_joysticks_platform_remove(struct platform_device *pdev)
+{
+  /* The polled device is unregistered by devres. */
+  sysfs_remove_group(&pdev->dev.kobj, &prsoc_joysticks_attr_group);
+  return 0;
+}
+
+static struct platform_driver prsoc_joysticks_pdriver = {
+  .probe = prsoc_joysticks_platform_probe,
+  .remove = prsoc_joysticks_platform_remove,
+  .driver = {
+    .name = "prsoc-joysticks",
+    .owner = THIS_MODULE,
+    .of_match_table = prsoc_joysticks_device_ids,
+  },
+};
+
+MODULE_LICENSE("GPL");
+module_platform_driver(prsoc_joysticks_pdriver);
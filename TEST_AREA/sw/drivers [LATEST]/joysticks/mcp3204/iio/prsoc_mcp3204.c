@@ -0,0 +1,223 @@
+/*
+ * @file prsoc_mcp3204
+ * @date 19 Oct 2026
+ * @brief Industrial I/O (IIO) Linux driver for the mcp3204 component.
+ *
+ * The mcp3204 component continuously converts the four channels of the
+ * MCP3204 ADC of the PrSoC extension board and exposes the latest 12-bit
+ * value of each channel in a read-only register (see mcp3204_regs.h).
+ *
+ * This driver exposes these four channels as an IIO device. Individual
+ * values can be read from sysfs (in_voltageN_raw), but the interesting part
+ * is the triggered buffer: once a trigger is attached, each trigger event
+ * reads the enabled channels, timestamps them and pushes the resulting scan
+ * into a kfifo that user space reads as blocks from /dev/iio:deviceN.
+ *
+ * The component has no "conversion done" interrupt, so the trigger is an
+ * external one. The usual choice is the hrtimer trigger:
+ *
+ *   mkdir /sys/kernel/config/iio/triggers/hrtimer/joy_trig
+ *   echo 1000 > /sys/bus/iio/devices/triggerX/sampling_frequency
+ *   echo joy_trig > /sys/bus/iio/devices/iio:deviceN/trigger/current_trigger
+ *   echo 1 > /sys/bus/iio/devices/iio:deviceN/scan_elements/in_voltage0_en
+ *   echo 1 > /sys/bus/iio/devices/iio:deviceN/scan_elements/in_timestamp_en
+ *   echo 1 > /sys/bus/iio/devices/iio:deviceN/buffer/enable
+ *
+ * Each scan is made of one 16-bit word per enabled channel (12 valid bits),
+ * padded to 8 bytes, followed by a 64-bit timestamp in nanoseconds.
+ *
+ * The component samples a channel every ~25 us (1 MHz SPI clock), so trigger
+ * rates up to a few kHz always read fresh values.
+ *
+ * Revisions:
+ *  10/19/2026 Created
+ */
+
+#include <linux/module.h>
+#include <linux/kernel.h>
+#include <linux/io.h>
+#include <linux/platform_device.h>
+#include <linux/of_device.h>
+#include <linux/bitops.h>
+#include <linux/types.h>
+
+#include <linux/iio/iio.h>
+#include <linux/iio/buffer.h>
+#include <linux/iio/trigger_consumer.h>
+#include <linux/iio/triggered_buffer.h>
+
+#include "../mcp3204_regs.h"
+
+#define MCP3204_NUM_CHANNELS 4
+#define MCP3204_RESOLUTION   12
+#define MCP3204_MAX_VALUE    ((1 << MCP3204_RESOLUTION) - 1)
+
+/* Enclose the driver data. */
+struct prsoc_mcp3204_drvdata {
+  uint8_t *regs; /* a pointer to the mcp3204's regs */
+  int vref_mv;   /* reference voltage in mV (0 if unknown) */
+
+  /* One scan: the enabled channels packed at the beginning, followed by the
+   * timestamp aligned on 8 bytes (iio_push_to_buffers_with_timestamp() puts
+   * it there). */
+  struct {
+    uint16_t channels[MCP3204_NUM_CHANNELS];
+    int64_t  timestamp;
+  } scan;
+};
+
+#define MCP3204_RD(DRVDATA, CHANNEL) \
+  (ioread32((DRVDATA)->regs + MCP3204_CHANNEL_0_OFST + 4 * (CHANNEL)) & MCP3204_MAX_VALUE)
+
+#define MCP3204_CHANNEL(INDEX) {                                \
+  .type = IIO_VOLTAGE,                                          \
+  .indexed = 1,                                                 \
+  .channel = (INDEX),                                           \
+  .info_mask_separate = BIT(IIO_CHAN_INFO_RAW),                 \
+  .info_mask_shared_by_type = BIT(IIO_CHAN_INFO_SCALE),         \
+  .scan_index = (INDEX),                                        \
+  .scan_type = {                                                \
+    .sign = 'u',                                                \
+    .realbits = MCP3204_RESOLUTION,                             \
+    .storagebits = 16,                                          \
+    .endianness = IIO_CPU,                                      \
+  },                                                            \
+}
+
+static const struct iio_chan_spec prsoc_mcp3204_channels[] = {
+  MCP3204_CHANNEL(0),
+  MCP3204_CHANNEL(1),
+  MCP3204_CHANNEL(2),
+  MCP3204_CHANNEL(3),
+  IIO_CHAN_SOFT_TIMESTAMP(MCP3204_NUM_CHANNELS)
+};
+
+/* IIO driver */
+
+static int prsoc_mcp3204_read_raw(struct iio_dev *indio_dev,
+                                  struct iio_chan_spec const *chan,
+                                  int *val, int *val2, long mask)
+{
+  struct prsoc_mcp3204_drvdata *drvdata = iio_priv(indio_dev);
+
+  switch (mask) {
+  case IIO_CHAN_INFO_RAW:
+    /* The component converts continuously, so a direct read never has to
+     * wait and can safely coexist with an enabled buffer. */
+    *val = MCP3204_RD(drvdata, chan->channel);
+    return IIO_VAL_INT;
+
+  case IIO_CHAN_INFO_SCALE:
+    if (!drvdata->vref_mv)
+      return -EINVAL;
+
+    /* mV per LSB = vref / 2^12 */
+    *val = drvdata->vref_mv;
+    *val2 = MCP3204_RESOLUTION;
+    return IIO_VAL_FRACTIONAL_LOG2;
+  }
+
+  return -EINVAL;
+}
+
+static const struct iio_info prsoc_mcp3204_info = {
+  .driver_module = THIS_MODULE,
+  .read_raw = prsoc_mcp3204_read_raw,
+};
+
+/* Bottom half of the trigger: called in a thread for every trigger event.
+ * The timestamp was captured in the top half (iio_pollfunc_store_time) as
+ * close as possible to the trigger event itself. */
+static irqreturn_t prsoc_mcp3204_trigger_handler(int irq, void *p)
+{
+  struct iio_poll_func *pf = p;
+  struct iio_dev *indio_dev = pf->indio_dev;
+  struct prsoc_mcp3204_drvdata *drvdata = iio_priv(indio_dev);
+  int bit, i = 0;
+
+  for_each_set_bit(bit, indio_dev->active_scan_mask, MCP3204_NUM_CHANNELS)
+    drvdata->scan.channels[i++] = MCP3204_RD(drvdata, bit);
+
+  iio_push_to_buffers_with_timestamp(indio_dev, &drvdata->scan, pf->timestamp);
+  iio_trigger_notify_done(indio_dev->trig);
+
+  return IRQ_HANDLED;
+}
+
+/* Platform driver */
+
+/* Informs the kernel of the corresponding compatible string. */
+static const struct of_device_id prsoc_mcp3204_device_ids[] = {
+  { .compatible = "prsoc,mcp3204" },
+  { }
+};
+MODULE_DEVICE_TABLE(of, prsoc_mcp3204_device_ids);
+
+/*
+ * The following method is called when the driver is loaded.
+ * It collects information from the device tree.
+ */
+static int
+prsoc_mcp3204_platform_probe(struct platform_device *pdev)
+{
+  struct prsoc_mcp3204_drvdata *drvdata;
+  struct iio_dev *indio_dev;
+  struct resource *rsrc;
+  uint32_t vref_mv;
+  int err;
+
+  /* Defensive programming: let's make sure this is the right device. */
+  if (!of_match_device(prsoc_mcp3204_device_ids, &pdev->dev))
+    return -EINVAL;
+
+  indio_dev = devm_iio_device_alloc(&pdev->dev, sizeof(*drvdata));
+  if (!indio_dev)
+    return -ENOMEM;
+
+  drvdata = iio_priv(indio_dev);
+  platform_set_drvdata(pdev, indio_dev);
+
+  /* Maps the addresses of the registers of the mcp3204 component. */
+  rsrc = platform_get_resource(pdev, IORESOURCE_MEM, 0);
+  drvdata->regs = devm_ioremap_resource(&pdev->dev, rsrc);
+  if (IS_ERR(drvdata->regs))
+    return PTR_ERR(drvdata->regs);
+
+  printk(KERN_INFO "mcp3204 regs @ 0x%x-0x%x\n", rsrc->start, rsrc->end);
+
+  /* The reference voltage is optional. Without it, only raw values are
+   * reported. */
+  if (!of_property_read_u32(pdev->dev.of_node, "prsoc,vref-mv", &vref_mv))
+    drvdata->vref_mv = vref_mv;
+
+  indio_dev->name = "mcp3204";
+  indio_dev->dev.parent = &pdev->dev;
+  indio_dev->dev.of_node = pdev->dev.of_node;
+  indio_dev->info = &prsoc_mcp3204_info;
+  indio_dev->modes = INDIO_DIRECT_MODE;
+  indio_dev->channels = prsoc_mcp3204_channels;
+  indio_dev->num_channels = ARRAY_SIZE(prsoc_mcp3204_channels);
+
+  err = devm_iio_triggered_buffer_setup(&pdev->dev, indio_dev,
+                                        iio_pollfunc_store_time,
+                                        prsoc_mcp3204_trigger_handler,
+                                        NULL);
+  if (err) {
+    printk(KERN_ERR "prsoc_mcp3204: couldn't setup the triggered buffer.\n");
+    return err;
+  }
+
+  return devm_iio_device_register(&pdev->dev, indio_dev);
+}
+
+static struct platform_driver prsoc_mcp3204_pdriver = {
+  .probe = prsoc_mcp3204_platform_probe,
+  .driver = {
+    .name = "prsoc-mcp3204",
+    .owner = THIS_MODULE,
+    .of_match_table = prsoc_mcp3204_device_ids,
+  },
+};
+
+MODULE_LICENSE("GPL");
+module_platform_driver(prsoc_mcp3204_pdriver);
@@ -1,4 +1,5 @@
 #include <assert.h>
+#include <errno.h>
 #include <inttypes.h>
 #include <stdio.h>
 #include <unistd.h>
@@ -7,6 +8,10 @@
 #include "lepton.h"
 #include "io_custom.h"
 
+#ifdef LEPTON_MSGDMA
+#include "msgdma_csr_regs.h"
+#endif
+
 /**
  * lepton_inst
  *
@@ -43,6 +48,211 @@ void lepton_start_capture(lepton_dev *dev) {
     ioc_write_16(dev->base, LEPTON_REGS_COMMAND_OFST, LEPTON_COMMAND_START);
 }
 
+/**
+ * lepton_start_continuous
+ *
+ * Instructs the device to capture frames back to back, alternately in its two
+ * frame banks, until lepton_stop_capture() takes effect. Use
+ * lepton_wait_frame() and lepton_release_frame() to read them.
+ *
+ * @param dev lepton device structure.
+ */
+void lepton_start_continuous(lepton_dev *dev) {
+    ioc_write_16(dev->base, LEPTON_REGS_COMMAND_OFST, LEPTON_COMMAND_START | LEPTON_COMMAND_CONTINUOUS);
+}
+
+/**
+ * lepton_stop_capture
+ *
+ * Leaves continuous mode. The capture doesn't stop right away: the frame being
+ * captured (if any) is completed, and becomes ready like the others. The
+ * device is idle once lepton_wait_until_eof() returns.
+ *
+ * @param dev lepton device structure.
+ */
+void lepton_stop_capture(lepton_dev *dev) {
+    ioc_write_16(dev->base, LEPTON_REGS_COMMAND_OFST, 0);
+}
+
+/**
+ * lepton_frame_ready
+ *
+ * @param dev lepton device structure.
+ * @return true if a frame was completed since the last lepton_acquire_frame().
+ */
+bool lepton_frame_ready(lepton_dev *dev) {
+    uint16_t bank_reg = ioc_read_16(dev->base, LEPTON_REGS_BANK_OFST);
+    return (bank_reg & LEPTON_BANK_FRAME_READY_MASK) != 0;
+}
+
+/**
+ * lepton_acquire_frame
+ *
+ * Makes the newest complete frame the one seen through the buffers and the
+ * statistics registers, and holds it: the device captures the next frames in
+ * the other bank until lepton_release_frame() or the next
+ * lepton_acquire_frame(). If no new frame is ready, the current one is held.
+ *
+ * @param dev lepton device structure.
+ * @return the bank being read (0 or 1).
+ */
+uint8_t lepton_acquire_frame(lepton_dev *dev) {
+    ioc_write_16(dev->base, LEPTON_REGS_BANK_OFST, LEPTON_BANK_ACQUIRE);
+    return ioc_read_16(dev->base, LEPTON_REGS_BANK_OFST) & LEPTON_BANK_READ_BANK_MASK;
+}
+
+/**
+ * lepton_wait_frame
+ *
+ * Waits until a new frame is complete, then acquires it (see
+ * lepton_acquire_frame()). Nothing is acquired if the device reports an error
+ * or if no frame comes within LEPTON_FRAME_TIMEOUT_US.
+ *
+ * @param dev lepton device structure.
+ * @return the bank being read (0 or 1), -EIO if the capture failed (see
+ *         lepton_error_check()), -ETIME on timeout.
+ */
+int lepton_wait_frame(lepton_dev *dev) {
+    uint32_t waited_us = 0;
+
+    while (!lepton_frame_ready(dev)) {
+        if (lepton_error_check(dev)) {
+            return -EIO;
+        }
+        if (waited_us >= LEPTON_FRAME_TIMEOUT_US) {
+            return -ETIME;
+        }
+
+        usleep(LEPTON_FRAME_POLL_US);
+        waited_us += LEPTON_FRAME_POLL_US;
+    }
+
+    return lepton_acquire_frame(dev);
+}
+
+/**
+ * lepton_release_frame
+ *
+ * Stops holding the frame being read. The device shows every new frame as
+ * soon as it is complete again (single buffer behaviour).
+ *
+ * @param dev lepton device structure.
+ */
+void lepton_release_frame(lepton_dev *dev) {
+    ioc_write_16(dev->base, LEPTON_REGS_BANK_OFST, LEPTON_BANK_RELEASE);
+}
+
+/**
+ * lepton_dropped_frames
+ *
+ * @param dev lepton device structure.
+ * @return the number of frames replaced before being acquired (modulo 256).
+ */
+uint8_t lepton_dropped_frames(lepton_dev *dev) {
+    uint16_t bank_reg = ioc_read_16(dev->base, LEPTON_REGS_BANK_OFST);
+    return (bank_reg & LEPTON_BANK_DROPPED_MASK) >> LEPTON_BANK_DROPPED_SHIFT;
+}
+
+/**
+ * lepton_read_statistics
+ *
+ * Reads the minimum, maximum and sum of the pixels of the captured frame,
+ * computed by the device during the capture.
+ *
+ * @param dev lepton device structure.
+ * @param min minimum pixel value.
+ * @param max maximum pixel value.
+ * @param sum sum of the pixel values.
+ */
+void lepton_read_statistics(lepton_dev *dev, uint16_t *min, uint16_t *max, uint32_t *sum) {
+    *min = ioc_read_16(dev->base, LEPTON_REGS_MIN_OFST);
+    *max = ioc_read_16(dev->base, LEPTON_REGS_MAX_OFST);
+    *sum = ((uint32_t) ioc_read_16(dev->base, LEPTON_REGS_SUM_MSB_OFST) << 16) |
+           ioc_read_16(dev->base, LEPTON_REGS_SUM_LSB_OFST);
+}
+
+/**
+ * lepton_set_histogram_range
+ *
+ * Sets the pixel values counted in each bin of the histogram computed by the
+ * device: pixel p goes in bin (p - offset) >> shift, saturated to the last bin
+ * (pixels below offset go in bin 0). Takes effect from the next frame.
+ *
+ * @param dev lepton device structure.
+ * @param offset first pixel value of bin 0.
+ * @param shift log2 of the width of a bin (0 to 15).
+ */
+void lepton_set_histogram_range(lepton_dev *dev, uint16_t offset, uint8_t shift) {
+    ioc_write_16(dev->base, LEPTON_REGS_HIST_OFFSET_OFST, offset);
+    ioc_write_16(dev->base, LEPTON_REGS_HIST_SHIFT_OFST, shift & LEPTON_HIST_SHIFT_MASK);
+}
+
+/**
+ * lepton_histogram_bins
+ *
+ * @param dev lepton device structure.
+ * @return the number of bins of the histogram (at most LEPTON_HIST_MAX_BINS).
+ */
+uint16_t lepton_histogram_bins(lepton_dev *dev) {
+    return ioc_read_16(dev->base, LEPTON_REGS_HIST_BINS_OFST);
+}
+
+/**
+ * lepton_read_histogram
+ *
+ * Copies the histogram of the captured frame, computed by the device during
+ * the capture.
+ *
+ * @param dev lepton device structure.
+ * @param bins destination buffer of lepton_histogram_bins() elements (or
+ *             LEPTON_HIST_MAX_BINS).
+ * @return the number of bins copied.
+ */
+uint16_t lepton_read_histogram(lepton_dev *dev, uint16_t *bins) {
+    uint16_t num_bins = lepton_histogram_bins(dev);
+
+    uint16_t i = 0;
+    for (i = 0; i < num_bins; ++i) {
+        bins[i] = ioc_read_16(dev->base, LEPTON_REGS_HISTOGRAM_OFST + i * sizeof(uint16_t));
+    }
+
+    return num_bins;
+}
+
+/**
+ * lepton_set_adjust_mode
+ *
+ * Selects how the device maps the pixels of the adjusted buffer to 0 - 0x3fff:
+ * - LEPTON_ADJUST_MODE_LINEAR: linearly between the minimum and the maximum
+ *   of the frame.
+ * - LEPTON_ADJUST_MODE_GAMMA: through the table of lepton_set_gamma_lut(),
+ *   indexed by the linear value >> 4.
+ * - LEPTON_ADJUST_MODE_EQUALIZED: histogram equalization, from the histogram
+ *   of the frame (see lepton_set_histogram_range()).
+ *
+ * @param dev lepton device structure.
+ * @param mode one of the LEPTON_ADJUST_MODE_* values.
+ */
+void lepton_set_adjust_mode(lepton_dev *dev, uint16_t mode) {
+    ioc_write_16(dev->base, LEPTON_REGS_ADJUST_MODE_OFST, mode);
+}
+
+/**
+ * lepton_set_gamma_lut
+ *
+ * Writes the table of LEPTON_ADJUST_MODE_GAMMA.
+ *
+ * @param dev lepton device structure.
+ * @param lut LEPTON_GAMMA_LUT_NUM_ENTRIES output values (0 - 0x3fff), entry i
+ *            for the linear values 16 * i to 16 * i + 15.
+ */
+void lepton_set_gamma_lut(lepton_dev *dev, const uint16_t *lut) {
+    uint16_t i = 0;
+    for (i = 0; i < LEPTON_GAMMA_LUT_NUM_ENTRIES; ++i) {
+        ioc_write_16(dev->base, LEPTON_REGS_GAMMA_LUT_OFST + i * sizeof(uint16_t), lut[i]);
+    }
+}
+
 /**
  * lepton_error_check
  *
@@ -168,3 +378,124 @@ void lepton_print_capture(lepton_dev *dev, bool adjusted) {
         }
     }
 }
+
+/**
+ * lepton_read_capture
+ *
+ * Copies the captured frame to memory, one pixel per 16-bit access through the
+ * bridge (see lepton_dma_start_readout() for a readout that doesn't keep the
+ * CPU busy).
+ *
+ * @param dev lepton device structure.
+ * @param adjusted Setting this parameter to false will cause RAW sensor data to
+ *                 be copied.
+ *                 Setting this parameter to true will cause the preprocessed
+ *                 image (with a stretched dynamic range) to be copied.
+ * @param dest destination buffer of LEPTON_REGS_BUFFER_NUM_PIXELS pixels.
+ */
+void lepton_read_capture(lepton_dev *dev, bool adjusted, uint16_t *dest) {
+    uint16_t offset = adjusted ? LEPTON_REGS_ADJUSTED_BUFFER_OFST : LEPTON_REGS_RAW_BUFFER_OFST;
+
+    uint16_t i = 0;
+    for (i = 0; i < LEPTON_REGS_BUFFER_NUM_PIXELS; ++i) {
+        dest[i] = ioc_read_16(dev->base, offset + i * sizeof(uint16_t));
+    }
+}
+
+#ifdef LEPTON_MSGDMA
+/**
+ * lepton_dma_inst
+ *
+ * Instantiate a lepton DMA readout structure.
+ *
+ * @param dma msgdma device structure (memory-mapped to memory-mapped mode),
+ *            initialized with msgdma_init().
+ * @param dma_base Base address of the lepton component, as seen by the read
+ *                 master of the msgdma.
+ * @param dma_dest Address of the destination buffer, as seen by the write
+ *                 master of the msgdma (use the ACP window of the FPGA-to-HPS
+ *                 bridge for a coherent transfer).
+ * @param dest The same destination buffer, as seen by the CPU. It must hold
+ *             LEPTON_REGS_BUFFER_NUM_PIXELS pixels.
+ */
+lepton_dma lepton_dma_inst(msgdma_dev *dma, void *dma_base, void *dma_dest, uint16_t *dest) {
+    lepton_dma ldma;
+    ldma.dma = dma;
+    ldma.dma_base = dma_base;
+    ldma.dma_dest = dma_dest;
+    ldma.dest = dest;
+
+    return ldma;
+}
+
+/**
+ * lepton_dma_start_readout
+ *
+ * Starts copying the captured frame to the destination buffer and returns
+ * without waiting: the CPU can work on the previous frame meanwhile. The frame
+ * must not change during the transfer, i.e. it must be held (see
+ * lepton_wait_frame()) or the capture must be stopped.
+ *
+ * @param ldma lepton DMA readout structure.
+ * @param adjusted Setting this parameter to false will cause RAW sensor data to
+ *                 be copied.
+ *                 Setting this parameter to true will cause the preprocessed
+ *                 image (with a stretched dynamic range) to be copied.
+ * @return 0 on success, a negative error code of msgdma.c otherwise.
+ */
+int lepton_dma_start_readout(lepton_dma *ldma, bool adjusted) {
+    msgdma_standard_descriptor desc;
+    uint16_t offset = adjusted ? LEPTON_REGS_ADJUSTED_BUFFER_OFST : LEPTON_REGS_RAW_BUFFER_OFST;
+
+    int ret = msgdma_construct_standard_mm_to_mm_descriptor(ldma->dma, &desc,
+                                                            (uint8_t *) ldma->dma_base + offset, ldma->dma_dest,
+                                                            LEPTON_REGS_BUFFER_BYTELENGTH,
+                                                            MSGDMA_DESCRIPTOR_CONTROL_TRANSFER_COMPLETE_IRQ_MASK);
+    if (ret < 0) {
+        return ret;
+    }
+
+    /* The transfer complete IRQ bit of the CSR status is the end of this
+     * transfer: async_transfer clears the status before starting it, and the
+     * bit is set even though the interrupt itself is not enabled. */
+    return msgdma_standard_descriptor_async_transfer(ldma->dma, &desc);
+}
+
+/**
+ * lepton_dma_readout_done
+ *
+ * Unlike the busy bit, which is still clear right after
+ * lepton_dma_start_readout() if the msgdma didn't pick the descriptor yet,
+ * this only reports the end of the transfer.
+ *
+ * @param ldma lepton DMA readout structure.
+ * @return 1 if the transfer started by lepton_dma_start_readout() is complete,
+ *         0 if it is still in progress, -EIO if the msgdma stopped on an error.
+ */
+int lepton_dma_readout_done(lepton_dma *ldma) {
+    uint32_t status = MSGDMA_RD_CSR_STATUS(ldma->dma->csr_base);
+
+    if (status & (MSGDMA_CSR_STOPPED_ON_ERROR_MASK | MSGDMA_CSR_STOPPED_ON_EARLY_TERMINATION_MASK)) {
+        return -EIO;
+    }
+
+    return (status & MSGDMA_CSR_IRQ_SET_MASK) ? 1 : 0;
+}
+
+/**
+ * lepton_dma_wait_readout
+ *
+ * Waits until the transfer started by lepton_dma_start_readout() is complete.
+ *
+ * @param ldma lepton DMA readout structure.
+ * @return the destination buffer, NULL if the transfer failed.
+ */
+uint16_t *lepton_dma_wait_readout(lepton_dma *ldma) {
+    int done = 0;
+
+    while ((done = lepton_dma_readout_done(ldma)) == 0) {
+    }
+
+    return (done < 0) ? NULL : ldma->dest;
+}
+#endif
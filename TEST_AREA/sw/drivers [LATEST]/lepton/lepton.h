@@ -2,12 +2,40 @@
 #define __LEPTON_H__
 
 #include <stdbool.h>
+#include <stdint.h>
+
+#ifdef LEPTON_MSGDMA
+#include "msgdma.h"
+#endif
+
+/* lepton_wait_frame(): frames come every 200 ms (sync delay) + the transfer */
+#define LEPTON_FRAME_TIMEOUT_US (1000000)
+#define LEPTON_FRAME_POLL_US    (100)
 
 /* lepton device structure */
 typedef struct {
     void *base; /* Base address of the component */
 } lepton_dev;
 
+#ifdef LEPTON_MSGDMA
+/*
+ * lepton DMA readout structure (build with -DLEPTON_MSGDMA and msgdma.c)
+ *
+ * The msgdma must be generated in memory-mapped to memory-mapped mode, with
+ * its read master connected to the lepton slave and its write master to the
+ * FPGA-to-HPS bridge. Through the ACP window of the bridge (0x80000000 +
+ * physical address), the writes are coherent with the CPU caches, so the
+ * destination buffer can be mapped cached (by a kernel driver: /dev/mem maps
+ * reserved memory uncached) and read without any cache maintenance.
+ */
+typedef struct {
+    msgdma_dev *dma;        /* msgdma used for the readout */
+    void       *dma_base;   /* Address of the lepton slave seen by the msgdma read master */
+    void       *dma_dest;   /* Address of the destination buffer seen by the msgdma write master */
+    uint16_t   *dest;       /* Destination buffer seen by the CPU */
+} lepton_dma;
+#endif
+
 /*******************************************************************************
  *  Public API
  ******************************************************************************/
@@ -16,9 +44,30 @@ lepton_dev lepton_inst(void *base);
 
 void lepton_init(lepton_dev *dev);
 void lepton_start_capture(lepton_dev *dev);
+void lepton_start_continuous(lepton_dev *dev);
+void lepton_stop_capture(lepton_dev *dev);
 void lepton_wait_until_eof(lepton_dev *dev);
 bool lepton_error_check(lepton_dev *dev);
+bool lepton_frame_ready(lepton_dev *dev);
+uint8_t lepton_acquire_frame(lepton_dev *dev);
+int lepton_wait_frame(lepton_dev *dev);
+void lepton_release_frame(lepton_dev *dev);
+uint8_t lepton_dropped_frames(lepton_dev *dev);
+void lepton_read_statistics(lepton_dev *dev, uint16_t *min, uint16_t *max, uint32_t *sum);
+void lepton_set_histogram_range(lepton_dev *dev, uint16_t offset, uint8_t shift);
+uint16_t lepton_histogram_bins(lepton_dev *dev);
+uint16_t lepton_read_histogram(lepton_dev *dev, uint16_t *bins);
+void lepton_set_adjust_mode(lepton_dev *dev, uint16_t mode);
+void lepton_set_gamma_lut(lepton_dev *dev, const uint16_t *lut);
 void lepton_save_capture(lepton_dev *dev, bool adjusted, const char *fname);
 void lepton_print_capture(lepton_dev *dev, bool adjusted);
+void lepton_read_capture(lepton_dev *dev, bool adjusted, uint16_t *dest);
+
+#ifdef LEPTON_MSGDMA
+lepton_dma lepton_dma_inst(msgdma_dev *dma, void *dma_base, void *dma_dest, uint16_t *dest);
+int lepton_dma_start_readout(lepton_dma *ldma, bool adjusted);
+int lepton_dma_readout_done(lepton_dma *ldma);
+uint16_t *lepton_dma_wait_readout(lepton_dma *ldma);
+#endif
 
 #endif /* __LEPTON_H__ */
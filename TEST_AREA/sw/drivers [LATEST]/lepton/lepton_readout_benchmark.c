@@ -0,0 +1,176 @@
+/**
+ * @brief Compares the CPU time spent per frame by the two lepton readouts:
+ *        - PIO: lepton_read_capture(), 4800 uncached 16-bit reads through the
+ *          lightweight bridge;
+ *        - DMA: lepton_dma_start_readout() into a reserved DDR buffer, the
+ *          CPU sleeping until the msgdma is done, then a memcpy() of the
+ *          frame to a normal (cached) buffer.
+ *        Both are followed by the same post-processing (sum of the pixels),
+ *        done from the cached copy of the frame.
+ *
+ * /dev/mem maps physical memory the kernel doesn't manage (registers, the
+ * reserved DDR) uncached whether or not it is opened with O_SYNC, so the
+ * copy is part of the cost of the DMA readout for software that works on the
+ * frame afterwards.
+ *
+ * The hardware needs a memory-mapped to memory-mapped msgdma next to the
+ * lepton (see lepton.h), named lepton_msgdma in Qsys. Generate the hps_0.h of
+ * the system in this directory (sopc-create-header-files). DESTINATION_BUFFER
+ * must be a DDR region the kernel doesn't use.
+ *
+ * arm-linux-gnueabihf-gcc -O2 -DLEPTON_MSGDMA -I. -I.. -I../tw9912 \
+ *     lepton_readout_benchmark.c lepton.c ../tw9912/msgdma.c -o lepton_readout_benchmark
+ *
+ * Usage: lepton_readout_benchmark [num_frames]
+ */
+
+#include <assert.h>
+#include <fcntl.h>
+#include <inttypes.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "hps_0.h" // MIGHT NEED TO BE REPLACED IF THE HARDWARE IS MODIFIED
+#include "lepton_regs.h"
+#include "lepton.h"
+#include "msgdma.h"
+
+#define HPS_LH2F_BRIDGE_BASE 0xff200000
+#define HPS_LH2F_BRIDGE_SPAN 0x00200000
+#define HPS_F2H_ACP_BASE     0x80000000
+
+/* Physical address of the (reserved) destination buffer */
+#define DESTINATION_BUFFER (0x4C80000)
+
+/* Base of the lepton as seen by the read master of the msgdma */
+#ifndef LEPTON_DMA_READ_BASE
+#define LEPTON_DMA_READ_BASE (LEPTON_0_BASE)
+#endif
+
+#define MSGDMA_DEV_CREATE(CSR, DESC, PREFIX) \
+    msgdma_csr_descriptor_inst( \
+        (void *) (CSR), \
+        (void *) (DESC), \
+        PREFIX ## _DESCRIPTOR_SLAVE_DESCRIPTOR_FIFO_DEPTH, \
+        PREFIX ## _CSR_BURST_ENABLE, \
+        PREFIX ## _CSR_BURST_WRAPPING_SUPPORT, \
+        PREFIX ## _CSR_DATA_FIFO_DEPTH, \
+        PREFIX ## _CSR_DATA_WIDTH, \
+        PREFIX ## _CSR_MAX_BURST_COUNT, \
+        PREFIX ## _CSR_MAX_BYTE, \
+        PREFIX ## _CSR_MAX_STRIDE, \
+        PREFIX ## _CSR_PROGRAMMABLE_BURST_ENABLE, \
+        PREFIX ## _CSR_STRIDE_ENABLE, \
+        PREFIX ## _CSR_ENHANCED_FEATURES, \
+        PREFIX ## _CSR_RESPONSE_PORT)
+
+/* Time elapsed on 'clock' since 'start', in microseconds */
+static double elapsed_us(clockid_t clock, const struct timespec *start) {
+    struct timespec now;
+    clock_gettime(clock, &now);
+
+    return (now.tv_sec - start->tv_sec) * 1e6 + (now.tv_nsec - start->tv_nsec) / 1e3;
+}
+
+static uint64_t sum_pixels(const uint16_t *frame) {
+    uint64_t sum = 0;
+
+    uint16_t i = 0;
+    for (i = 0; i < LEPTON_REGS_BUFFER_NUM_PIXELS; ++i) {
+        sum += frame[i];
+    }
+
+    return sum;
+}
+
+int main(int argc, char **argv) {
+    int num_frames = (argc > 1) ? atoi(argv[1]) : 100;
+    assert(num_frames > 0);
+
+    /* Registers and destination buffer: both uncached */
+    int mem_fd = open("/dev/mem", O_RDWR | O_SYNC);
+    assert(mem_fd >= 0);
+    void *lh2fbridge = mmap(NULL, HPS_LH2F_BRIDGE_SPAN, PROT_READ | PROT_WRITE, MAP_SHARED, mem_fd, HPS_LH2F_BRIDGE_BASE);
+    assert(lh2fbridge != MAP_FAILED);
+
+    uint16_t *dest = mmap(NULL, LEPTON_REGS_BUFFER_BYTELENGTH, PROT_READ | PROT_WRITE, MAP_SHARED, mem_fd, DESTINATION_BUFFER);
+    assert(dest != MAP_FAILED);
+
+    static uint16_t pio_frame[LEPTON_REGS_BUFFER_NUM_PIXELS];
+    static uint16_t dma_frame[LEPTON_REGS_BUFFER_NUM_PIXELS];
+
+    lepton_dev lepton = lepton_inst(lh2fbridge + LEPTON_0_BASE);
+    lepton_init(&lepton);
+
+    msgdma_dev dma = MSGDMA_DEV_CREATE(lh2fbridge + LEPTON_MSGDMA_CSR_BASE,
+                                       lh2fbridge + LEPTON_MSGDMA_DESCRIPTOR_SLAVE_BASE,
+                                       LEPTON_MSGDMA);
+    msgdma_init(&dma);
+
+    lepton_dma ldma = lepton_dma_inst(&dma, (void *) LEPTON_DMA_READ_BASE,
+                                      (void *) (HPS_F2H_ACP_BASE + DESTINATION_BUFFER), dest);
+
+    double pio_cpu_us = 0, pio_wall_us = 0;
+    double dma_cpu_us = 0, dma_wall_us = 0;
+    uint64_t mismatches = 0;
+
+    lepton_start_continuous(&lepton);
+
+    int frame = 0;
+    for (frame = 0; frame < num_frames; ++frame) {
+        struct timespec cpu_start, wall_start;
+
+        /* Both readouts copy the same (held) frame */
+        int bank = lepton_wait_frame(&lepton);
+        assert(bank >= 0);
+
+        /* PIO */
+        clock_gettime(CLOCK_THREAD_CPUTIME_ID, &cpu_start);
+        clock_gettime(CLOCK_MONOTONIC, &wall_start);
+
+        lepton_read_capture(&lepton, false, pio_frame);
+        uint64_t pio_sum = sum_pixels(pio_frame);
+
+        pio_cpu_us += elapsed_us(CLOCK_THREAD_CPUTIME_ID, &cpu_start);
+        pio_wall_us += elapsed_us(CLOCK_MONOTONIC, &wall_start);
+
+        /* DMA */
+        clock_gettime(CLOCK_THREAD_CPUTIME_ID, &cpu_start);
+        clock_gettime(CLOCK_MONOTONIC, &wall_start);
+
+        int ret = lepton_dma_start_readout(&ldma, false);
+        assert(ret == 0);
+        while ((ret = lepton_dma_readout_done(&ldma)) == 0) {
+            usleep(20);
+        }
+        assert(ret == 1);
+        memcpy(dma_frame, ldma.dest, LEPTON_REGS_BUFFER_BYTELENGTH);
+        uint64_t dma_sum = sum_pixels(dma_frame);
+
+        dma_cpu_us += elapsed_us(CLOCK_THREAD_CPUTIME_ID, &cpu_start);
+        dma_wall_us += elapsed_us(CLOCK_MONOTONIC, &wall_start);
+
+        if (pio_sum != dma_sum) {
+            mismatches++;
+        }
+    }
+
+    lepton_release_frame(&lepton);
+    lepton_stop_capture(&lepton);
+
+    printf("%d frames of %d pixels\n", num_frames, LEPTON_REGS_BUFFER_NUM_PIXELS);
+    printf("PIO: %8.1f us CPU, %8.1f us elapsed per frame\n", pio_cpu_us / num_frames, pio_wall_us / num_frames);
+    printf("DMA: %8.1f us CPU, %8.1f us elapsed per frame\n", dma_cpu_us / num_frames, dma_wall_us / num_frames);
+    printf("Frames that differ between PIO and DMA: %" PRIu64 "\n", mismatches);
+    printf("Dropped frames: %" PRIu8 "\n", lepton_dropped_frames(&lepton));
+
+    munmap(dest, LEPTON_REGS_BUFFER_BYTELENGTH);
+    munmap(lh2fbridge, HPS_LH2F_BRIDGE_SPAN);
+    close(mem_fd);
+
+    return mismatches != 0;
+}
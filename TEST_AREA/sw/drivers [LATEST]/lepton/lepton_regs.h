@@ -9,16 +9,47 @@
 #define LEPTON_REGS_SUM_LSB_OFST         (   4 * 2)  /* RO */
 #define LEPTON_REGS_SUM_MSB_OFST         (   5 * 2)  /* RO */
 #define LEPTON_REGS_ROW_IDX_OFST         (   6 * 2)  /* RO */
+#define LEPTON_REGS_BANK_OFST            (   7 * 2)  /* RW */
 #define LEPTON_REGS_RAW_BUFFER_OFST      (   8 * 2)  /* RO */
+#define LEPTON_REGS_HIST_OFFSET_OFST     (4864 * 2)  /* RW */
+#define LEPTON_REGS_HIST_SHIFT_OFST      (4865 * 2)  /* RW */
+#define LEPTON_REGS_HIST_BINS_OFST       (4866 * 2)  /* RO */
+#define LEPTON_REGS_ADJUST_MODE_OFST     (4867 * 2)  /* RW */
+#define LEPTON_REGS_HISTOGRAM_OFST       (5120 * 2)  /* RO */
 #define LEPTON_REGS_ADJUSTED_BUFFER_OFST (8192 * 2)  /* RO */
+#define LEPTON_REGS_GAMMA_LUT_OFST       (15360 * 2) /* WO */
 
 /* Command register */
-#define LEPTON_COMMAND_START (0x0001)
+#define LEPTON_COMMAND_START      (0x0001)
+#define LEPTON_COMMAND_CONTINUOUS (0x0002)
 
 /* Status register */
 #define LEPTON_STATUS_CAPTURE_IN_PROGRESS_MASK (1 << 0)
 #define LEPTON_STATUS_ERROR_MASK               (1 << 1)
 
+/* Bank register (read) */
+#define LEPTON_BANK_READ_BANK_MASK   (1 << 0)
+#define LEPTON_BANK_WRITE_BANK_MASK  (1 << 1)
+#define LEPTON_BANK_FRAME_READY_MASK (1 << 2)
+#define LEPTON_BANK_HOLD_MASK        (1 << 3)
+#define LEPTON_BANK_DROPPED_SHIFT    (8)
+#define LEPTON_BANK_DROPPED_MASK     (0xff << LEPTON_BANK_DROPPED_SHIFT)
+
+/* Bank register (write) */
+#define LEPTON_BANK_ACQUIRE (0x0001)
+#define LEPTON_BANK_RELEASE (0x0002)
+
+/* Histogram: HIST_BINS of the core is a power of 2 from 64 to 2048 */
+#define LEPTON_HIST_SHIFT_MASK (0x000f)
+#define LEPTON_HIST_MAX_BINS   (2048)
+
+/* Adjust mode register */
+#define LEPTON_ADJUST_MODE_LINEAR    (0x0000)
+#define LEPTON_ADJUST_MODE_GAMMA     (0x0001)
+#define LEPTON_ADJUST_MODE_EQUALIZED (0x0002)
+
+#define LEPTON_GAMMA_LUT_NUM_ENTRIES (1024)
+
 #define LEPTON_REGS_BUFFER_NUM_PIXELS (80 * 60)
 #define LEPTON_REGS_BUFFER_BYTELENGTH (LEPTON_REGS_BUFFER_NUM_PIXELS * 2)
 
@@ -0,0 +1,400 @@
+/*
+ * @file prsoc_pantilt
+ * @date 19 Oct 2026
+ * @brief Pan-tilt kernel helper executing queued servo trajectories.
+ *
+ * The two servos of the pan-tilt are driven by two pwm components, handled
+ * by the PWM framework driver in ../pwm/pwmchip. This helper requests both
+ * PWM outputs and moves the servos along queued ramps: each ramp goes
+ * linearly from the current position to a target position in a given time.
+ *
+ * Ramps are executed by a kernel thread woken up on an absolute 25 ms grid
+ * (the servo period) by an hrtimer. Each wake-up computes the next position
+ * of both axes and writes it to the pwm components through the PWM API,
+ * from process context. The components apply a new position at the end of
+ * their current period, so a pulse is never glitched, and the motion stays
+ * smooth even when the user-space process that queued the ramps is
+ * descheduled.
+ *
+ * The pwm components have no interrupt and no readable phase, so the grid
+ * is not phase-locked to their periods: there is one new position per
+ * servo period on average, but as the two clocks drift (or the thread is
+ * late), a pulse occasionally sees 0 or 2 new positions. A ramp then holds
+ * one step for an extra period or skips one step.
+ *
+ * Everything is controlled from sysfs (positions are pulse widths in us,
+ * using the same convention as pantilt.c):
+ *   echo "1800 500" > .../vertical_ramp    # go to 1800 us in 500 ms
+ *   echo "1200 0" > .../horizontal_ramp    # jump to 1200 us
+ *   cat .../vertical_position              # current position in us
+ *   echo 1 > .../flush                     # drop all queued ramps
+ *
+ *   pantilt {
+ *     compatible = "prsoc,pantilt";
+ *     pwms = <&pwm0 0 25000000>, <&pwm1 0 25000000>;
+ *     pwm-names = "vertical", "horizontal";
+ *     prsoc,vertical-range-us = <950 2150>;
+ *     prsoc,horizontal-range-us = <1000 2000>;
+ *   };
+ *
+ * Revisions:
+ *  10/19/2026 Created
+ *  10/19/2026 Steps executed by a kernel thread instead of in hardirq context
+ */
+
+#include <linux/module.h>
+#include <linux/kernel.h>
+#include <linux/platform_device.h>
+#include <linux/of_device.h>
+#include <linux/pwm.h>
+#include <linux/hrtimer.h>
+#include <linux/kthread.h>
+#include <linux/ktime.h>
+#include <linux/kfifo.h>
+#include <linux/mutex.h>
+#include <linux/sched.h>
+#include <linux/wait.h>
+#include <linux/types.h>
+
+#define PANTILT_NUM_AXES 2
+
+#define PANTILT_PWM_PERIOD_US  25000 /* 25.00 ms */
+#define PANTILT_RAMP_QUEUE_LEN 16    /* must be a power of 2 */
+
+/* A queued position ramp. */
+struct pantilt_ramp {
+  uint32_t target_us;
+  uint32_t duration_ms;
+};
+
+/* One servo. */
+struct pantilt_axis {
+  struct pwm_device *pwm;
+  uint32_t min_us;
+  uint32_t max_us;
+
+  DECLARE_KFIFO(ramps, struct pantilt_ramp, PANTILT_RAMP_QUEUE_LEN);
+
+  /* Ramp being executed. */
+  bool     moving;
+  uint32_t start_us;
+  uint32_t target_us;
+  uint32_t step;
+  uint32_t num_steps;
+
+  uint32_t position_us; /* last position written to the pwm */
+};
+
+/* Enclose the driver data. */
+struct prsoc_pantilt_drvdata {
+  struct pantilt_axis axes[PANTILT_NUM_AXES];
+  struct task_struct *thread;
+  wait_queue_head_t wait; /* the thread waits for ramps here */
+  ktime_t period;
+  bool running;           /* the thread is executing ramps */
+  struct mutex lock;      /* protects the axes against the thread */
+};
+
+static const char * const axis_names[PANTILT_NUM_AXES] = {
+  "vertical", "horizontal"
+};
+
+/* Write a position to the pwm of an axis. The servos are mounted such that
+ * the duty cycle has to be inverted (see pantilt_configure_vertical()). */
+static void axis_write(struct pantilt_axis *axis, uint32_t position_us)
+{
+  uint32_t duty_us = axis->max_us - position_us + axis->min_us;
+
+  axis->position_us = position_us;
+  pwm_config(axis->pwm, duty_us * NSEC_PER_USEC, PANTILT_PWM_PERIOD_US * NSEC_PER_USEC);
+}
+
+/* Advance the trajectory of an axis by one servo period. Returns whether
+ * the axis still has work to do. */
+static bool axis_step(struct pantilt_axis *axis)
+{
+  struct pantilt_ramp ramp;
+  int32_t delta;
+
+  if (!axis->moving) {
+    if (!kfifo_get(&axis->ramps, &ramp))
+      return false;
+
+    axis->moving    = true;
+    axis->start_us  = axis->position_us;
+    axis->target_us = ramp.target_us;
+    axis->step      = 0;
+    axis->num_steps = max_t(uint32_t, 1, ramp.duration_ms * USEC_PER_MSEC / PANTILT_PWM_PERIOD_US);
+  }
+
+  axis->step++;
+  delta = (int32_t)axis->target_us - (int32_t)axis->start_us;
+  axis_write(axis, axis->start_us + delta * (int32_t)axis->step / (int32_t)axis->num_steps);
+
+  if (axis->step == axis->num_steps)
+    axis->moving = false;
+
+  return true;
+}
+
+/* Advance both axes by one servo period. Returns whether an axis still
+ * has work to do. */
+static bool pantilt_step(struct prsoc_pantilt_drvdata *drvdata)
+{
+  bool busy = false;
+  int i;
+
+  mutex_lock(&drvdata->lock);
+  for (i = 0; i < PANTILT_NUM_AXES; i++)
+    busy |= axis_step(&drvdata->axes[i]);
+  drvdata->running = busy;
+  mutex_unlock(&drvdata->lock);
+
+  return busy;
+}
+
+/* Executes the ramps once per servo period while some are queued, then
+ * sleeps until ramp_store() queues new ones. */
+static int pantilt_thread(void *data)
+{
+  struct prsoc_pantilt_drvdata *drvdata = data;
+  ktime_t next;
+
+  while (!kthread_should_stop()) {
+    wait_event_interruptible(drvdata->wait,
+                             READ_ONCE(drvdata->running) || kthread_should_stop());
+    if (kthread_should_stop())
+      break;
+
+    /* The first step is taken one period from now, leaving the position
+     * written by the previous step in place for a full servo pulse. */
+    next = ktime_add(ktime_get(), drvdata->period);
+
+    do {
+      set_current_state(TASK_UNINTERRUPTIBLE);
+      schedule_hrtimeout(&next, HRTIMER_MODE_ABS);
+      if (kthread_should_stop())
+        break;
+
+      /* Absolute expiries keep the steps on the servo period grid
+       * whatever the latency of the wake-ups, unless a full period was
+       * missed. */
+      next = ktime_add(next, drvdata->period);
+      if (ktime_before(next, ktime_get()))
+        next = ktime_add(ktime_get(), drvdata->period);
+    } while (pantilt_step(drvdata));
+  }
+
+  return 0;
+}
+
+/* sysfs attributes */
+
+static int axis_from_attr_name(const char *name)
+{
+  int i;
+  for (i = 0; i < PANTILT_NUM_AXES; i++)
+    if (!strncmp(name, axis_names[i], strlen(axis_names[i])))
+      return i;
+  return -1;
+}
+
+static ssize_t ramp_store(struct device *dev, struct device_attribute *attr,
+                          const char *buf, size_t count)
+{
+  struct prsoc_pantilt_drvdata *drvdata = dev_get_drvdata(dev);
+  struct pantilt_axis *axis = &drvdata->axes[axis_from_attr_name(attr->attr.name)];
+  struct pantilt_ramp ramp;
+  bool start = false;
+  int queued;
+
+  if (sscanf(buf, "%u %u", &ramp.target_us, &ramp.duration_ms) != 2)
+    return -EINVAL;
+
+  if (ramp.target_us < axis->min_us || ramp.target_us > axis->max_us)
+    return -ERANGE;
+
+  mutex_lock(&drvdata->lock);
+  queued = kfifo_put(&axis->ramps, ramp);
+  if (queued && !drvdata->running)
+    drvdata->running = start = true;
+  mutex_unlock(&drvdata->lock);
+
+  if (!queued)
+    return -EBUSY;
+
+  if (start)
+    wake_up(&drvdata->wait);
+
+  return count;
+}
+
+static ssize_t position_show(struct device *dev, struct device_attribute *attr,
+                             char *buf)
+{
+  struct prsoc_pantilt_drvdata *drvdata = dev_get_drvdata(dev);
+  struct pantilt_axis *axis = &drvdata->axes[axis_from_attr_name(attr->attr.name)];
+
+  return sprintf(buf, "%u\n", READ_ONCE(axis->position_us));
+}
+
+static ssize_t flush_store(struct device *dev, struct device_attribute *attr,
+                           const char *buf, size_t count)
+{
+  struct prsoc_pantilt_drvdata *drvdata = dev_get_drvdata(dev);
+  int i;
+
+  /* The axes stop where they are. */
+  mutex_lock(&drvdata->lock);
+  for (i = 0; i < PANTILT_NUM_AXES; i++) {
+    kfifo_reset(&drvdata->axes[i].ramps);
+    drvdata->axes[i].moving = false;
+  }
+  mutex_unlock(&drvdata->lock);
+
+  return count;
+}
+
+static DEVICE_ATTR(vertical_ramp, S_IWUSR, NULL, ramp_store);
+static DEVICE_ATTR(horizontal_ramp, S_IWUSR, NULL, ramp_store);
+static DEVICE_ATTR(vertical_position, S_IRUGO, position_show, NULL);
+static DEVICE_ATTR(horizontal_position, S_IRUGO, position_show, NULL);
+static DEVICE_ATTR_WO(flush);
+
+static struct attribute *prsoc_pantilt_attrs[] = {
+  &dev_attr_vertical_ramp.attr,
+  &dev_attr_horizontal_ramp.attr,
+  &dev_attr_vertical_position.attr,
+  &dev_attr_horizontal_position.attr,
+  &dev_attr_flush.attr,
+  NULL
+};
+
+static const struct attribute_group prsoc_pantilt_attr_group = {
+  .attrs = prsoc_pantilt_attrs,
+};
+
+/* Platform driver */
+
+/* Informs the kernel of the corresponding compatible string. */
+static const struct of_device_id prsoc_pantilt_device_ids[] = {
+  { .compatible = "prsoc,pantilt" },
+  { }
+};
+MODULE_DEVICE_TABLE(of, prsoc_pantilt_device_ids);
+
+/* Apply configuration from device tree. */
+static int configure_from_dt(struct platform_device *pdev,
+                             struct prsoc_pantilt_drvdata *drvdata)
+{
+  char property[32];
+  uint32_t range[2];
+  int i;
+
+  for (i = 0; i < PANTILT_NUM_AXES; i++) {
+    struct pantilt_axis *axis = &drvdata->axes[i];
+
+    /* -EPROBE_DEFER if the pwm driver isn't loaded yet. */
+    axis->pwm = devm_pwm_get(&pdev->dev, axis_names[i]);
+    if (IS_ERR(axis->pwm))
+      return PTR_ERR(axis->pwm);
+
+    snprintf(property, sizeof(property), "prsoc,%s-range-us", axis_names[i]);
+    if (of_property_read_u32_array(pdev->dev.of_node, property, range, 2) ||
+        range[0] >= range[1]) {
+      printk(KERN_ERR "no valid '%s' in the device tree.\n", property);
+      return -EINVAL;
+    }
+
+    axis->min_us = range[0];
+    axis->max_us = range[1];
+    INIT_KFIFO(axis->ramps);
+  }
+
+  return 0;
+}
+
+/*
+ * The following method is called when the driver is loaded.
+ * It collects information from the device tree.
+ */
+static int
+prsoc_pantilt_platform_probe(struct platform_device *pdev)
+{
+  struct prsoc_pantilt_drvdata *drvdata;
+  int i, err;
+
+  /* Defensive programming: let's make sure this is the right device. */
+  if (!of_match_device(prsoc_pantilt_device_ids, &pdev->dev))
+    return -EINVAL;
+
+  drvdata = devm_kzalloc(&pdev->dev, sizeof(*drvdata), GFP_KERNEL);
+  if (!drvdata)
+    return -ENOMEM;
+
+  mutex_init(&drvdata->lock);
+  init_waitqueue_head(&drvdata->wait);
+  platform_set_drvdata(pdev, drvdata);
+
+  err = configure_from_dt(pdev, drvdata);
+  if (err)
+    return err;
+
+  /* Center both servos and start the pulses. */
+  for (i = 0; i < PANTILT_NUM_AXES; i++) {
+    struct pantilt_axis *axis = &drvdata->axes[i];
+
+    axis_write(axis, (axis->min_us + axis->max_us) / 2);
+    err = pwm_enable(axis->pwm);
+    if (err)
+      goto err_disable;
+  }
+
+  drvdata->period = ktime_set(0, PANTILT_PWM_PERIOD_US * NSEC_PER_USEC);
+  drvdata->thread = kthread_run(pantilt_thread, drvdata, "prsoc-pantilt");
+  if (IS_ERR(drvdata->thread)) {
+    err = PTR_ERR(drvdata->thread);
+    goto err_disable;
+  }
+
+  err = sysfs_create_group(&pdev->dev.kobj, &prsoc_pantilt_attr_group);
+  if (err)
+    goto err_stop;
+
+  return 0;
+
+err_stop:
+  kthread_stop(drvdata->thread);
+err_disable:
+  /* Only the outputs enabled above. */
+  while (i-- > 0)
+    pwm_disable(drvdata->axes[i].pwm);
+  return err;
+}
+
+static int prsoc_pantilt_platform_remove(struct platform_device *pdev)
+{
+  struct prsoc_pantilt_drvdata *drvdata = platform_get_drvdata(pdev);
+  int i;
+
+  sysfs_remove_group(&pdev->dev.kobj, &prsoc_pantilt_attr_group);
+  kthread_stop(drvdata->thread);
+
+  for (i = 0; i < PANTILT_NUM_AXES; i++)
+    pwm_disable(drvdata->axes[i].pwm);
+
+  return 0;
+}
+
+static struct platform_driver prsoc_pantilt_pdriver = {
+  .probe = prsoc_pantilt_platform_probe,
+  .remove = prsoc_pantilt_platform_remove,
+  .driver = {
+    .name = "prsoc-pantilt",
+    .owner = THIS_MODULE,
+    .of_match_table = prsoc_pantilt_device_ids,
+  },
+};
+
+MODULE_LICENSE("GPL");
+module_platform_driver(prsoc_pantilt_pdriver);
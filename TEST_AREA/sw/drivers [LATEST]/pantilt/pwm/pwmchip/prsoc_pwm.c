@@ -0,0 +1,203 @@
+/*
+ * @file prsoc_pwm
+ * @date 19 Oct 2026
+ * @brief Linux PWM framework driver for the pwm component.
+ *
+ * Each instance of the pwm component drives a single output, so each device
+ * tree node registers a pwm_chip with one channel. Once loaded, the outputs
+ * appear under /sys/class/pwm/pwmchipN and can be requested by other drivers
+ * with the standard 'pwms' device tree property (see ../../kernel for the
+ * pan-tilt helper).
+ *
+ * The component counts cycles of its clock, so the driver converts the
+ * nanoseconds of the PWM API into ticks of that clock. Its frequency comes
+ * from the 'clock-frequency' property of the device tree node.
+ *
+ * The component only applies a new period and duty cycle at the end of the
+ * current period, so reconfiguring a running output never produces a
+ * glitch. Writing the registers never sleeps, which lets consumers
+ * reconfigure the output from atomic context (e.g. an hrtimer).
+ *
+ * The component needs a period of at least 2 ticks and a duty cycle of at
+ * least 1 (see pwm_constants.vhd): a duty cycle of 0 would still give a
+ * one-tick pulse. A duty cycle below one tick stops the output instead,
+ * which stays low until a non-zero duty cycle is configured.
+ *
+ * Revisions:
+ *  10/19/2026 Created
+ *  10/19/2026 Period of at least 2 ticks, duty cycle of 0 stops the output
+ */
+
+#include <linux/module.h>
+#include <linux/kernel.h>
+#include <linux/io.h>
+#include <linux/math64.h>
+#include <linux/platform_device.h>
+#include <linux/of_device.h>
+#include <linux/pwm.h>
+#include <linux/types.h>
+
+#include "../pwm_regs.h"
+
+/* Enclose the driver data. */
+struct prsoc_pwm_drvdata {
+  struct pwm_chip chip;
+  uint8_t *regs;        /* a pointer to the pwm's regs */
+  uint32_t clock_freq;  /* frequency of the component's clock in Hz */
+  bool enabled;         /* enabled by the consumer */
+  bool idle;            /* duty cycle of 0: the output is stopped */
+};
+
+#define PWM_WR(DRVDATA, REG, VAL) \
+  iowrite32((VAL), (DRVDATA)->regs + (REG))
+
+static inline struct prsoc_pwm_drvdata *to_prsoc_pwm(struct pwm_chip *chip)
+{
+  return container_of(chip, struct prsoc_pwm_drvdata, chip);
+}
+
+/* Convert nanoseconds to ticks of the component's clock. */
+static inline uint64_t ns_to_ticks(struct prsoc_pwm_drvdata *drvdata, int ns)
+{
+  return div_u64((uint64_t)ns * drvdata->clock_freq, NSEC_PER_SEC);
+}
+
+/* PWM driver */
+
+static int prsoc_pwm_config(struct pwm_chip *chip, struct pwm_device *pwm,
+                            int duty_ns, int period_ns)
+{
+  struct prsoc_pwm_drvdata *drvdata = to_prsoc_pwm(chip);
+  uint64_t period = ns_to_ticks(drvdata, period_ns);
+  uint64_t duty = ns_to_ticks(drvdata, duty_ns);
+
+  /* The counter of the component goes from 1 to period included. */
+  if (period < 2 || period > U32_MAX)
+    return -EINVAL;
+
+  PWM_WR(drvdata, PWM_PERIOD_OFST, (uint32_t)period);
+
+  /* The component can't do 0 %: stop it, the output stays low after the
+   * current pulse. */
+  if (!duty) {
+    drvdata->idle = true;
+    PWM_WR(drvdata, PWM_CTRL_OFST, PWM_CTRL_STOP_MASK);
+    return 0;
+  }
+
+  PWM_WR(drvdata, PWM_DUTY_CYCLE_OFST, (uint32_t)duty);
+
+  if (drvdata->idle && drvdata->enabled)
+    PWM_WR(drvdata, PWM_CTRL_OFST, PWM_CTRL_START_MASK);
+  drvdata->idle = false;
+
+  return 0;
+}
+
+static int prsoc_pwm_enable(struct pwm_chip *chip, struct pwm_device *pwm)
+{
+  struct prsoc_pwm_drvdata *drvdata = to_prsoc_pwm(chip);
+
+  drvdata->enabled = true;
+  if (!drvdata->idle)
+    PWM_WR(drvdata, PWM_CTRL_OFST, PWM_CTRL_START_MASK);
+  return 0;
+}
+
+static void prsoc_pwm_disable(struct pwm_chip *chip, struct pwm_device *pwm)
+{
+  struct prsoc_pwm_drvdata *drvdata = to_prsoc_pwm(chip);
+
+  /* The current pulse completes, then the output stays low. */
+  drvdata->enabled = false;
+  PWM_WR(drvdata, PWM_CTRL_OFST, PWM_CTRL_STOP_MASK);
+}
+
+static const struct pwm_ops prsoc_pwm_ops = {
+  .config = prsoc_pwm_config,
+  .enable = prsoc_pwm_enable,
+  .disable = prsoc_pwm_disable,
+  .owner = THIS_MODULE,
+};
+
+/* Platform driver */
+
+/* Informs the kernel of the corresponding compatible string. */
+static const struct of_device_id prsoc_pwm_device_ids[] = {
+  { .compatible = "prsoc,pwm" },
+  { }
+};
+MODULE_DEVICE_TABLE(of, prsoc_pwm_device_ids);
+
+/*
+ * The following method is called when the driver is loaded.
+ * It collects information from the device tree.
+ */
+static int
+prsoc_pwm_platform_probe(struct platform_device *pdev)
+{
+  struct prsoc_pwm_drvdata *drvdata;
+  struct resource *rsrc;
+  int err;
+
+  /* Defensive programming: let's make sure this is the right device. */
+  if (!of_match_device(prsoc_pwm_device_ids, &pdev->dev))
+    return -EINVAL;
+
+  drvdata = devm_kzalloc(&pdev->dev, sizeof(*drvdata), GFP_KERNEL);
+  if (!drvdata)
+    return -ENOMEM;
+
+  /* Maps the addresses of the registers of the pwm component. */
+  rsrc = platform_get_resource(pdev, IORESOURCE_MEM, 0);
+  drvdata->regs = devm_ioremap_resource(&pdev->dev, rsrc);
+  if (IS_ERR(drvdata->regs))
+    return PTR_ERR(drvdata->regs);
+
+  if (of_property_read_u32(pdev->dev.of_node, "clock-frequency", &drvdata->clock_freq) ||
+      !drvdata->clock_freq) {
+    printk(KERN_ERR "no 'clock-frequency' in the device tree.\n");
+    return -EINVAL;
+  }
+
+  printk(KERN_INFO "pwm regs @ 0x%x-0x%x, clocked at %u Hz\n",
+         rsrc->start, rsrc->end, drvdata->clock_freq);
+
+  /* Leave the output stopped until a consumer enables it. */
+  PWM_WR(drvdata, PWM_CTRL_OFST, PWM_CTRL_STOP_MASK);
+
+  drvdata->chip.dev = &pdev->dev;
+  drvdata->chip.ops = &prsoc_pwm_ops;
+  drvdata->chip.base = -1;
+  drvdata->chip.npwm = 1;
+
+  err = pwmchip_add(&drvdata->chip);
+  if (err) {
+    printk(KERN_ERR "prsoc_pwm: couldn't register the pwm chip.\n");
+    return err;
+  }
+
+  platform_set_drvdata(pdev, drvdata);
+  return 0;
+}
+
+static int prsoc_pwm_platform_remove(struct platform_device *pdev)
+{
+  struct prsoc_pwm_drvdata *drvdata = platform_get_drvdata(pdev);
+
+  PWM_WR(drvdata, PWM_CTRL_OFST, PWM_CTRL_STOP_MASK);
+  return pwmchip_remove(&drvdata->chip);
+}
+
+static struct platform_driver prsoc_pwm_pdriver = {
+  .probe = prsoc_pwm_platform_probe,
+  .remove = prsoc_pwm_platform_remove,
+  .driver = {
+    .name = "prsoc-pwm",
+    .owner = THIS_MODULE,
+    .of_match_table = prsoc_pwm_device_ids,
+  },
+};
+
+MODULE_LICENSE("GPL");
+module_platform_driver(prsoc_pwm_pdriver);
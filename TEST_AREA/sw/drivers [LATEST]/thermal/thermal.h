@@ -0,0 +1,24 @@
+#ifndef __THERMAL_H__
+#define __THERMAL_H__
+
+/*
+ * Frame processing for the raw lepton frames (LEPTON_REGS_RAW_BUFFER_OFST):
+ * 80 x 60 pixels of 14 bits, row-major, in uint16_t[THERMAL_FRAME_NUM_PIXELS].
+ * The modules only work on frames in memory (see lepton_read_capture() and
+ * lepton_dma_start_readout()), they do not access the hardware.
+ *
+ * The inner loops use NEON when the compiler targets it (-mfpu=neon on the
+ * Cortex-A9), and a scalar version giving the same results otherwise. Build
+ * with -DTHERMAL_NO_NEON to force the scalar version.
+ */
+
+#define THERMAL_FRAME_WIDTH      (80)
+#define THERMAL_FRAME_HEIGHT     (60)
+#define THERMAL_FRAME_NUM_PIXELS (THERMAL_FRAME_WIDTH * THERMAL_FRAME_HEIGHT)
+#define THERMAL_PIXEL_MAX        (0x3fff)
+
+#if (defined(__ARM_NEON) || defined(__ARM_NEON__)) && !defined(THERMAL_NO_NEON)
+#define THERMAL_NEON
+#endif
+
+#endif /* __THERMAL_H__ */
@@ -0,0 +1,392 @@
+#include <math.h>
+#include <string.h>
+
+#include "thermal_agc.h"
+
+#ifdef THERMAL_NEON
+#include <arm_neon.h>
+#endif
+
+/*
+ * Computes the tile before each pixel of a row (or column) and the weight of
+ * the next tile, from the distance of the pixel to the tile centres. Pixels
+ * before the first centre or after the last one only use the nearest tile.
+ */
+static void clahe_weights(uint8_t *tile, uint8_t *weight, uint16_t length, uint16_t tile_length, uint16_t num_tiles) {
+    uint16_t i = 0;
+    for (i = 0; i < length; ++i) {
+        /* Position from the centre of the first tile, in 1/256 of a tile */
+        int32_t pos = ((2 * i + 1 - tile_length) * 256) / (2 * tile_length);
+
+        if (pos < 0) {
+            tile[i] = 0;
+            weight[i] = 0;
+        } else if (pos >= (num_tiles - 1) * 256) {
+            tile[i] = num_tiles - 1;
+            weight[i] = 0;
+        } else {
+            tile[i] = pos >> 8;
+            weight[i] = pos & 0xff;
+        }
+    }
+}
+
+/**
+ * thermal_agc_init
+ *
+ * Initializes the AGC structure with the default settings: percentiles 1% and
+ * 99%, a CLAHE clip limit of 4 pixels per bin and no gamma correction.
+ *
+ * @param agc AGC structure.
+ */
+void thermal_agc_init(thermal_agc *agc) {
+    memset(agc, 0, sizeof(*agc));
+
+    thermal_agc_set_percentiles(agc, 10, 990);
+    thermal_agc_set_clip_limit(agc, 4);
+    thermal_agc_set_gamma(agc, 1.0);
+
+    clahe_weights(agc->col_tile, agc->col_weight, THERMAL_FRAME_WIDTH, THERMAL_AGC_TILE_WIDTH, THERMAL_AGC_TILES_X);
+    clahe_weights(agc->row_tile, agc->row_weight, THERMAL_FRAME_HEIGHT, THERMAL_AGC_TILE_HEIGHT, THERMAL_AGC_TILES_Y);
+}
+
+/**
+ * thermal_agc_set_percentiles
+ *
+ * Sets the range of thermal_agc_percentile(): the darkest low_permille
+ * pixels of a frame map to 0, the brightest (1000 - high_permille) to 255.
+ *
+ * @param agc AGC structure.
+ * @param low_permille Black point, in 1/1000 of the pixels.
+ * @param high_permille White point, in 1/1000 of the pixels (> low_permille).
+ */
+void thermal_agc_set_percentiles(thermal_agc *agc, uint16_t low_permille, uint16_t high_permille) {
+    if (high_permille > 1000) {
+        high_permille = 1000;
+    }
+    if (low_permille >= high_permille) {
+        low_permille = high_permille - 1;
+    }
+
+    agc->low_permille = low_permille;
+    agc->high_permille = high_permille;
+}
+
+/**
+ * thermal_agc_set_clip_limit
+ *
+ * Sets the maximum count of a bin of the 256-bin tile histograms of
+ * thermal_agc_clahe(). A tile has THERMAL_AGC_TILE_NUM_PIXELS (400) pixels,
+ * 1.6 per bin on average: lower limits give less contrast and noise, a limit
+ * of THERMAL_AGC_TILE_NUM_PIXELS is plain tiled equalization.
+ *
+ * @param agc AGC structure.
+ * @param clip_limit Maximum count of a bin (at least 2).
+ */
+void thermal_agc_set_clip_limit(thermal_agc *agc, uint16_t clip_limit) {
+    agc->clip_limit = (clip_limit < 2) ? 2 : clip_limit;
+}
+
+/**
+ * thermal_agc_set_gamma
+ *
+ * Builds the table of thermal_agc_gamma(): out = 255 * (in / 255)^gamma.
+ * Values below 1 brighten the dark (cold) pixels.
+ *
+ * @param agc AGC structure.
+ * @param gamma Exponent (> 0).
+ */
+void thermal_agc_set_gamma(thermal_agc *agc, double gamma) {
+    uint16_t i = 0;
+    for (i = 0; i < 256; ++i) {
+        agc->gamma_lut[i] = (uint8_t) (255.0 * pow(i / 255.0, gamma) + 0.5);
+    }
+}
+
+/**
+ * thermal_agc_range
+ *
+ * Computes the minimum and maximum of a raw frame. The lepton computes them
+ * too (LEPTON_REGS_MIN_OFST, LEPTON_REGS_MAX_OFST) when the frame comes
+ * straight from the device.
+ *
+ * @param raw Raw frame.
+ * @param min Minimum of the frame.
+ * @param max Maximum of the frame.
+ */
+void thermal_agc_range(const uint16_t *raw, uint16_t *min, uint16_t *max) {
+    uint16_t i = 0;
+
+#ifdef THERMAL_NEON
+    uint16x8_t vmin = vdupq_n_u16(0xffff);
+    uint16x8_t vmax = vdupq_n_u16(0);
+
+    for (i = 0; i < THERMAL_FRAME_NUM_PIXELS; i += 8) {
+        uint16x8_t pixels = vld1q_u16(raw + i);
+        vmin = vminq_u16(vmin, pixels);
+        vmax = vmaxq_u16(vmax, pixels);
+    }
+
+    uint16x4_t min4 = vpmin_u16(vget_low_u16(vmin), vget_high_u16(vmin));
+    uint16x4_t max4 = vpmax_u16(vget_low_u16(vmax), vget_high_u16(vmax));
+    min4 = vpmin_u16(min4, min4);
+    max4 = vpmax_u16(max4, max4);
+    min4 = vpmin_u16(min4, min4);
+    max4 = vpmax_u16(max4, max4);
+
+    *min = vget_lane_u16(min4, 0);
+    *max = vget_lane_u16(max4, 0);
+#else
+    uint16_t frame_min = 0xffff;
+    uint16_t frame_max = 0;
+
+    for (i = 0; i < THERMAL_FRAME_NUM_PIXELS; ++i) {
+        uint16_t pixel = raw[i];
+        frame_min = (pixel < frame_min) ? pixel : frame_min;
+        frame_max = (pixel > frame_max) ? pixel : frame_max;
+    }
+
+    *min = frame_min;
+    *max = frame_max;
+#endif
+}
+
+/**
+ * thermal_agc_linear_range
+ *
+ * Maps [low, high] of a raw frame linearly to 0 - 255, clipping the pixels
+ * outside. With the MIN and MAX registers of the lepton, this is the whole
+ * linear AGC in one pass over the frame.
+ *
+ * @param agc AGC structure.
+ * @param raw Raw frame.
+ * @param out Output frame (8 bits per pixel).
+ * @param low Raw value mapped to 0.
+ * @param high Raw value mapped to 255.
+ */
+void thermal_agc_linear_range(thermal_agc *agc, const uint16_t *raw, uint8_t *out, uint16_t low, uint16_t high) {
+    if (high < low) {
+        high = low;
+    }
+
+    /*
+     * out = ((p - low) * scale) >> 16, with scale = ceil(255 * 2^16 / range)
+     * so that high maps to 255. The product is below 2^24.
+     */
+    uint32_t range = high - low;
+    uint32_t scale = (range == 0) ? 0 : (255 * 65536 + range - 1) / range;
+
+    agc->low = low;
+    agc->high = high;
+
+    uint16_t i = 0;
+
+#ifdef THERMAL_NEON
+    uint16x8_t vlow = vdupq_n_u16(low);
+    uint16x8_t vhigh = vdupq_n_u16(high);
+    uint32x4_t vscale = vdupq_n_u32(scale);
+
+    for (i = 0; i < THERMAL_FRAME_NUM_PIXELS; i += 8) {
+        uint16x8_t pixels = vld1q_u16(raw + i);
+        pixels = vminq_u16(vmaxq_u16(pixels, vlow), vhigh);
+        pixels = vsubq_u16(pixels, vlow);
+
+        uint32x4_t lo = vmulq_u32(vmovl_u16(vget_low_u16(pixels)), vscale);
+        uint32x4_t hi = vmulq_u32(vmovl_u16(vget_high_u16(pixels)), vscale);
+        uint16x8_t mapped = vcombine_u16(vshrn_n_u32(lo, 16), vshrn_n_u32(hi, 16));
+
+        vst1_u8(out + i, vmovn_u16(mapped));
+    }
+#else
+    for (i = 0; i < THERMAL_FRAME_NUM_PIXELS; ++i) {
+        uint16_t pixel = raw[i];
+        pixel = (pixel < low) ? low : pixel;
+        pixel = (pixel > high) ? high : pixel;
+
+        out[i] = ((pixel - low) * scale) >> 16;
+    }
+#endif
+}
+
+/**
+ * thermal_agc_linear
+ *
+ * Maps [MIN, MAX] of a raw frame linearly to 0 - 255 (like the ADJUSTED
+ * buffer of the lepton).
+ *
+ * @param agc AGC structure.
+ * @param raw Raw frame.
+ * @param out Output frame (8 bits per pixel).
+ */
+void thermal_agc_linear(thermal_agc *agc, const uint16_t *raw, uint8_t *out) {
+    uint16_t min = 0;
+    uint16_t max = 0;
+
+    thermal_agc_range(raw, &min, &max);
+    thermal_agc_linear_range(agc, raw, out, min, max);
+}
+
+/**
+ * thermal_agc_percentile
+ *
+ * Maps a raw frame linearly to 0 - 255 between two percentiles (see
+ * thermal_agc_set_percentiles()), so that a few very hot or cold pixels do not
+ * compress the rest of the image. The percentiles are found in a histogram of
+ * THERMAL_AGC_PERCENTILE_BINS bins over [MIN, MAX].
+ *
+ * @param agc AGC structure.
+ * @param raw Raw frame.
+ * @param out Output frame (8 bits per pixel).
+ */
+void thermal_agc_percentile(thermal_agc *agc, const uint16_t *raw, uint8_t *out) {
+    uint16_t min = 0;
+    uint16_t max = 0;
+    thermal_agc_range(raw, &min, &max);
+
+    uint8_t shift = 0;
+    while (((max - min) >> shift) >= THERMAL_AGC_PERCENTILE_BINS) {
+        shift++;
+    }
+    uint16_t last_bin = (max - min) >> shift;
+
+    memset(agc->hist, 0, (last_bin + 1) * sizeof(agc->hist[0]));
+
+    uint16_t i = 0;
+    for (i = 0; i < THERMAL_FRAME_NUM_PIXELS; ++i) {
+        agc->hist[(raw[i] - min) >> shift]++;
+    }
+
+    /* Pixels to clip at each end */
+    uint32_t num_low = (uint32_t) agc->low_permille * THERMAL_FRAME_NUM_PIXELS / 1000;
+    uint32_t num_high = (uint32_t) (1000 - agc->high_permille) * THERMAL_FRAME_NUM_PIXELS / 1000;
+
+    uint32_t count = 0;
+    uint16_t low_bin = 0;
+    for (low_bin = 0; low_bin < last_bin; ++low_bin) {
+        count += agc->hist[low_bin];
+        if (count > num_low) {
+            break;
+        }
+    }
+
+    count = 0;
+    uint16_t high_bin = last_bin;
+    for (high_bin = last_bin; high_bin > low_bin; --high_bin) {
+        count += agc->hist[high_bin];
+        if (count > num_high) {
+            break;
+        }
+    }
+
+    uint32_t low = min + ((uint32_t) low_bin << shift);
+    uint32_t high = min + (((uint32_t) high_bin + 1) << shift) - 1;
+    if (high > max) {
+        high = max;
+    }
+
+    thermal_agc_linear_range(agc, raw, out, low, high);
+}
+
+/*
+ * Builds the mapping of one CLAHE tile from the 8-bit linear frame: clipped
+ * histogram, excess spread over all the bins, then cumulative histogram.
+ */
+static void clahe_tile_lut(thermal_agc *agc, uint8_t tx, uint8_t ty) {
+    uint16_t *hist = agc->tile_hist;
+    uint8_t *lut = agc->tile_lut[ty][tx];
+
+    memset(hist, 0, sizeof(agc->tile_hist));
+
+    const uint8_t *row = agc->linear + ty * THERMAL_AGC_TILE_HEIGHT * THERMAL_FRAME_WIDTH + tx * THERMAL_AGC_TILE_WIDTH;
+    uint16_t x = 0;
+    uint16_t y = 0;
+    for (y = 0; y < THERMAL_AGC_TILE_HEIGHT; ++y) {
+        for (x = 0; x < THERMAL_AGC_TILE_WIDTH; ++x) {
+            hist[row[x]]++;
+        }
+        row += THERMAL_FRAME_WIDTH;
+    }
+
+    uint32_t excess = 0;
+    uint16_t v = 0;
+    for (v = 0; v < 256; ++v) {
+        if (hist[v] > agc->clip_limit) {
+            excess += hist[v] - agc->clip_limit;
+            hist[v] = agc->clip_limit;
+        }
+    }
+
+    uint16_t spread = excess / 256;
+    uint16_t remainder = excess % 256;
+
+    /* The total stays THERMAL_AGC_TILE_NUM_PIXELS */
+    uint32_t cumulative = 0;
+    for (v = 0; v < 256; ++v) {
+        cumulative += hist[v] + spread + (v < remainder);
+        lut[v] = (cumulative * 255 + THERMAL_AGC_TILE_NUM_PIXELS / 2) / THERMAL_AGC_TILE_NUM_PIXELS;
+    }
+}
+
+/**
+ * thermal_agc_clahe
+ *
+ * Contrast-limited adaptive histogram equalization: the frame is mapped
+ * linearly to 8 bits, then equalized on THERMAL_AGC_TILES_X x
+ * THERMAL_AGC_TILES_Y tiles with clipped histograms (see
+ * thermal_agc_set_clip_limit()). Each pixel interpolates bilinearly the
+ * mappings of the 4 nearest tiles, so that the tile borders do not show.
+ *
+ * @param agc AGC structure.
+ * @param raw Raw frame.
+ * @param out Output frame (8 bits per pixel).
+ */
+void thermal_agc_clahe(thermal_agc *agc, const uint16_t *raw, uint8_t *out) {
+    thermal_agc_linear(agc, raw, agc->linear);
+
+    uint8_t tx = 0;
+    uint8_t ty = 0;
+    for (ty = 0; ty < THERMAL_AGC_TILES_Y; ++ty) {
+        for (tx = 0; tx < THERMAL_AGC_TILES_X; ++tx) {
+            clahe_tile_lut(agc, tx, ty);
+        }
+    }
+
+    uint16_t x = 0;
+    uint16_t y = 0;
+    for (y = 0; y < THERMAL_FRAME_HEIGHT; ++y) {
+        uint8_t ty0 = agc->row_tile[y];
+        uint8_t ty1 = (ty0 < THERMAL_AGC_TILES_Y - 1) ? ty0 + 1 : ty0;
+        uint32_t wy = agc->row_weight[y];
+
+        const uint8_t *in_row = agc->linear + y * THERMAL_FRAME_WIDTH;
+        uint8_t *out_row = out + y * THERMAL_FRAME_WIDTH;
+
+        for (x = 0; x < THERMAL_FRAME_WIDTH; ++x) {
+            uint8_t tx0 = agc->col_tile[x];
+            uint8_t tx1 = (tx0 < THERMAL_AGC_TILES_X - 1) ? tx0 + 1 : tx0;
+            uint32_t wx = agc->col_weight[x];
+            uint8_t v = in_row[x];
+
+            uint32_t top = agc->tile_lut[ty0][tx0][v] * (256 - wx) + agc->tile_lut[ty0][tx1][v] * wx;
+            uint32_t bottom = agc->tile_lut[ty1][tx0][v] * (256 - wx) + agc->tile_lut[ty1][tx1][v] * wx;
+
+            out_row[x] = (top * (256 - wy) + bottom * wy + 32768) >> 16;
+        }
+    }
+}
+
+/**
+ * thermal_agc_gamma
+ *
+ * Applies the gamma correction of thermal_agc_set_gamma() to an 8-bit frame,
+ * in place.
+ *
+ * @param agc AGC structure.
+ * @param frame 8-bit frame (output of the other kernels).
+ */
+void thermal_agc_gamma(thermal_agc *agc, uint8_t *frame) {
+    uint16_t i = 0;
+    for (i = 0; i < THERMAL_FRAME_NUM_PIXELS; ++i) {
+        frame[i] = agc->gamma_lut[frame[i]];
+    }
+}
@@ -0,0 +1,61 @@
+#ifndef __THERMAL_AGC_H__
+#define __THERMAL_AGC_H__
+
+#include <stdint.h>
+
+#include "thermal.h"
+
+/* Histogram of the percentile AGC, over [MIN, MAX] of the frame */
+#define THERMAL_AGC_PERCENTILE_BINS (1024)
+
+/* Tiles of the CLAHE AGC */
+#define THERMAL_AGC_TILES_X         (4)
+#define THERMAL_AGC_TILES_Y         (3)
+#define THERMAL_AGC_TILE_WIDTH      (THERMAL_FRAME_WIDTH / THERMAL_AGC_TILES_X)
+#define THERMAL_AGC_TILE_HEIGHT     (THERMAL_FRAME_HEIGHT / THERMAL_AGC_TILES_Y)
+#define THERMAL_AGC_TILE_NUM_PIXELS (THERMAL_AGC_TILE_WIDTH * THERMAL_AGC_TILE_HEIGHT)
+
+/*
+ * AGC structure: settings and the scratch memory of the kernels, so that no
+ * kernel allocates anything. The output frames are 8 bits per pixel.
+ */
+typedef struct {
+    /* Settings */
+    uint16_t low_permille;  /* Percentile AGC: pixels clipped to 0 */
+    uint16_t high_permille; /* Percentile AGC: pixels below the white point */
+    uint16_t clip_limit;    /* CLAHE: maximum count of a tile histogram bin */
+    uint8_t  gamma_lut[256];
+
+    /* Raw range mapped to 0 - 255 by the last kernel */
+    uint16_t low;
+    uint16_t high;
+
+    /* Scratch */
+    uint16_t hist[THERMAL_AGC_PERCENTILE_BINS];
+    uint16_t tile_hist[256];
+    uint8_t  tile_lut[THERMAL_AGC_TILES_Y][THERMAL_AGC_TILES_X][256];
+    uint8_t  linear[THERMAL_FRAME_NUM_PIXELS];
+
+    /* CLAHE: tile before each column/row and weight (/256) of the next one */
+    uint8_t col_tile[THERMAL_FRAME_WIDTH];
+    uint8_t col_weight[THERMAL_FRAME_WIDTH];
+    uint8_t row_tile[THERMAL_FRAME_HEIGHT];
+    uint8_t row_weight[THERMAL_FRAME_HEIGHT];
+} thermal_agc;
+
+/*******************************************************************************
+ *  Public API
+ ******************************************************************************/
+
+void thermal_agc_init(thermal_agc *agc);
+void thermal_agc_set_percentiles(thermal_agc *agc, uint16_t low_permille, uint16_t high_permille);
+void thermal_agc_set_clip_limit(thermal_agc *agc, uint16_t clip_limit);
+void thermal_agc_set_gamma(thermal_agc *agc, double gamma);
+void thermal_agc_range(const uint16_t *raw, uint16_t *min, uint16_t *max);
+void thermal_agc_linear_range(thermal_agc *agc, const uint16_t *raw, uint8_t *out, uint16_t low, uint16_t high);
+void thermal_agc_linear(thermal_agc *agc, const uint16_t *raw, uint8_t *out);
+void thermal_agc_percentile(thermal_agc *agc, const uint16_t *raw, uint8_t *out);
+void thermal_agc_clahe(thermal_agc *agc, const uint16_t *raw, uint8_t *out);
+void thermal_agc_gamma(thermal_agc *agc, uint8_t *frame);
+
+#endif /* __THERMAL_AGC_H__ */
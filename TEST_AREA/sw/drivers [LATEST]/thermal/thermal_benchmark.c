@@ -0,0 +1,395 @@
+/**
+ * @brief Measures the time per frame of the thermal kernels on synthetic raw
+ *        frames, on the DE0-Nano-SoC or on the host (see Makefile):
+ *        - AGC: linear, percentile, CLAHE and linear + gamma;
+ *        - flat-field correction, alone and fused with the linear AGC;
+ *        - temporal filters: mean of 4 and 16 frames, EMA and median of 3;
+ *        - statistics: single pass, summed-area tables and ROI queries;
+ *        - hot-blob detection, on the hot blob and on the noise of the
+ *          background (worst case, many small blobs);
+ *        - radiometry: whole frame, and ROI and blob temperatures;
+ *        - hot-spot tracking (open loop);
+ *        - the whole pipeline of a frame: AGC, blobs and tracking.
+ *
+ * The checksum of the results of each kernel must be the same on every
+ * machine and with or without NEON.
+ *
+ * Usage: thermal_benchmark [iterations]
+ */
+
+#include <assert.h>
+#include <inttypes.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+
+#include "thermal.h"
+#include "thermal_agc.h"
+#include "thermal_blobs.h"
+#include "thermal_denoise.h"
+#include "thermal_flatfield.h"
+#include "thermal_radiometry.h"
+#include "thermal_stats.h"
+#include "thermal_track.h"
+
+/* Synthetic frames, used round-robin */
+#define NUM_FRAMES (16)
+
+/* The lepton outputs 9 frames per second */
+#define LEPTON_FRAME_PERIOD_US (1e6 / 9)
+
+/* ROI probes: a grid of 8 x 8 regions of 10 x 7 pixels */
+#define NUM_ROIS (64)
+
+/* A kernel processes a frame, a digest adds its results to a checksum. */
+typedef void (*kernel_fn)(const uint16_t *raw);
+typedef uint32_t (*digest_fn)(uint32_t hash);
+
+static uint16_t frames[NUM_FRAMES][THERMAL_FRAME_NUM_PIXELS];
+static uint8_t out[THERMAL_FRAME_NUM_PIXELS];
+static uint16_t filtered[THERMAL_FRAME_NUM_PIXELS];
+static thermal_agc agc;
+static thermal_stats stats;
+static thermal_sat sat;
+static thermal_roi rois[NUM_ROIS];
+static uint32_t roi_sums[NUM_ROIS];
+static thermal_blobs blobs;
+static thermal_denoise denoise;
+static thermal_flatfield flatfield;
+static thermal_radiometry radiometry;
+static uint16_t temperatures[NUM_ROIS + THERMAL_BLOBS_MAX_BLOBS * 2];
+static thermal_track track;
+static uint64_t track_time_us;
+
+/* Small deterministic generator, so that the frames are the same everywhere */
+static uint32_t random_state = 12345;
+static uint32_t random_next(void) {
+    random_state = random_state * 1103515245 + 12345;
+    return (random_state >> 16) & 0x7fff;
+}
+
+/*
+ * Room-temperature background with a vertical gradient and noise, a hot blob
+ * moving from frame to frame, and a dead and a saturated pixel.
+ */
+static void make_frames(void) {
+    int f = 0;
+    for (f = 0; f < NUM_FRAMES; ++f) {
+        int blob_x = 10 + 4 * f;
+        int blob_y = 15 + 2 * f;
+
+        int x = 0;
+        int y = 0;
+        for (y = 0; y < THERMAL_FRAME_HEIGHT; ++y) {
+            for (x = 0; x < THERMAL_FRAME_WIDTH; ++x) {
+                int32_t value = 7900 + 3 * y + (int32_t) (random_next() % 41) - 20;
+
+                int32_t d2 = (x - blob_x) * (x - blob_x) + (y - blob_y) * (y - blob_y);
+                if (d2 < 64) {
+                    value += 1500 - 20 * d2;
+                }
+
+                frames[f][y * THERMAL_FRAME_WIDTH + x] = value;
+            }
+        }
+
+        frames[f][(7 * f + 3) % THERMAL_FRAME_NUM_PIXELS] = 0;
+        frames[f][(13 * f + 1000) % THERMAL_FRAME_NUM_PIXELS] = THERMAL_PIXEL_MAX;
+    }
+}
+
+static void make_rois(void) {
+    int i = 0;
+    for (i = 0; i < NUM_ROIS; ++i) {
+        rois[i].x = (i % 8) * 10;
+        rois[i].y = (i / 8) * 7 + 2;
+        rois[i].width = 10;
+        rois[i].height = 7;
+    }
+}
+
+/* Offsets flattening the background of the frames, and a few bad pixels */
+static void make_flatfield(void) {
+    thermal_flatfield_init(&flatfield);
+    thermal_flatfield_calibration_start(&flatfield);
+
+    int f = 0;
+    for (f = 0; f < NUM_FRAMES; ++f) {
+        thermal_flatfield_calibration_add(&flatfield, frames[f], false);
+    }
+    thermal_flatfield_calibration_finish(&flatfield, 20);
+
+    int i = 0;
+    for (i = 0; i < 32; ++i) {
+        thermal_flatfield_set_bad_pixel(&flatfield, (i * 37) % THERMAL_FRAME_WIDTH, (i * 11) % THERMAL_FRAME_HEIGHT);
+    }
+}
+
+/* FNV-1a */
+static uint32_t fnv(uint32_t hash, const uint8_t *data, size_t size) {
+    size_t i = 0;
+    for (i = 0; i < size; ++i) {
+        hash = (hash ^ data[i]) * 16777619u;
+    }
+
+    return hash;
+}
+
+static uint32_t fnv_32(uint32_t hash, uint32_t value) {
+    uint8_t bytes[4] = {value, value >> 8, value >> 16, value >> 24};
+    return fnv(hash, bytes, sizeof(bytes));
+}
+
+static void agc_linear(const uint16_t *raw) {
+    thermal_agc_linear(&agc, raw, out);
+}
+
+static void agc_percentile(const uint16_t *raw) {
+    thermal_agc_percentile(&agc, raw, out);
+}
+
+static void agc_clahe(const uint16_t *raw) {
+    thermal_agc_clahe(&agc, raw, out);
+}
+
+static void agc_linear_gamma(const uint16_t *raw) {
+    thermal_agc_linear(&agc, raw, out);
+    thermal_agc_gamma(&agc, out);
+}
+
+static uint32_t digest_out(uint32_t hash) {
+    return fnv(hash, out, sizeof(out));
+}
+
+static void flatfield_apply(const uint16_t *raw) {
+    thermal_flatfield_apply(&flatfield, raw, filtered);
+}
+
+static void flatfield_agc_linear(const uint16_t *raw) {
+    thermal_flatfield_agc_linear(&flatfield, &agc, raw, out);
+}
+
+static void denoise_push(const uint16_t *raw) {
+    thermal_denoise_push(&denoise, raw, filtered);
+}
+
+static uint32_t digest_filtered(uint32_t hash) {
+    return fnv(hash, (const uint8_t *) filtered, sizeof(filtered));
+}
+
+static void stats_compute(const uint16_t *raw) {
+    thermal_stats_compute(&stats, raw);
+}
+
+static uint32_t digest_stats(uint32_t hash) {
+    hash = fnv_32(hash, stats.min);
+    hash = fnv_32(hash, stats.max);
+    hash = fnv_32(hash, stats.sum);
+    hash = fnv_32(hash, stats.sum_sq);
+    hash = fnv_32(hash, stats.sum_sq >> 32);
+    hash = fnv_32(hash, stats.min_y * THERMAL_FRAME_WIDTH + stats.min_x);
+    return fnv_32(hash, stats.max_y * THERMAL_FRAME_WIDTH + stats.max_x);
+}
+
+static void sat_build(const uint16_t *raw) {
+    thermal_sat_build(&sat, raw);
+}
+
+static uint32_t digest_sat(uint32_t hash) {
+    hash = fnv_32(hash, sat.sum[THERMAL_FRAME_HEIGHT][THERMAL_FRAME_WIDTH]);
+    return fnv_32(hash, sat.sum_sq[THERMAL_FRAME_HEIGHT][THERMAL_FRAME_WIDTH]);
+}
+
+/* Queries the tables of the last sat_build(), whatever the frame. */
+static void sat_probes(const uint16_t *raw) {
+    (void) raw;
+
+    int i = 0;
+    for (i = 0; i < NUM_ROIS; ++i) {
+        roi_sums[i] = thermal_sat_sum(&sat, &rois[i]);
+    }
+}
+
+static void sat_build_probes(const uint16_t *raw) {
+    sat_build(raw);
+    sat_probes(raw);
+}
+
+static uint32_t digest_probes(uint32_t hash) {
+    int i = 0;
+    for (i = 0; i < NUM_ROIS; ++i) {
+        hash = fnv_32(hash, roi_sums[i]);
+    }
+
+    return hash;
+}
+
+static void blobs_detect(const uint16_t *raw) {
+    thermal_blobs_detect(&blobs, raw);
+}
+
+static uint32_t digest_blobs(uint32_t hash) {
+    hash = fnv_32(hash, blobs.num_found);
+
+    int i = 0;
+    for (i = 0; i < blobs.num_blobs; ++i) {
+        thermal_blob *blob = &blobs.blobs[i];
+        hash = fnv_32(hash, blob->area);
+        hash = fnv_32(hash, (blob->x_min << 16) | blob->y_min);
+        hash = fnv_32(hash, (blob->x_max << 16) | blob->y_max);
+        hash = fnv_32(hash, blob->centroid_x);
+        hash = fnv_32(hash, blob->centroid_y);
+        hash = fnv_32(hash, blob->peak);
+        hash = fnv_32(hash, (blob->peak_x << 16) | blob->peak_y);
+    }
+
+    return hash;
+}
+
+static void radiometry_frame(const uint16_t *raw) {
+    thermal_radiometry_frame(&radiometry, raw, filtered);
+}
+
+/* ROI and blob temperatures, on the summed-area tables and the blobs of the frame */
+static void radiometry_queries(const uint16_t *raw) {
+    thermal_sat_build(&sat, raw);
+    thermal_blobs_detect(&blobs, raw);
+
+    int i = 0;
+    for (i = 0; i < NUM_ROIS; ++i) {
+        temperatures[i] = thermal_radiometry_roi_mean(&radiometry, &sat, &rois[i]);
+    }
+    for (i = 0; i < blobs.num_blobs; ++i) {
+        temperatures[NUM_ROIS + 2 * i] = thermal_radiometry_blob_mean(&radiometry, &blobs.blobs[i]);
+        temperatures[NUM_ROIS + 2 * i + 1] = thermal_radiometry_blob_peak(&radiometry, &blobs.blobs[i]);
+    }
+}
+
+static uint32_t digest_temperatures(uint32_t hash) {
+    int i = 0;
+    for (i = 0; i < NUM_ROIS + 2 * blobs.num_blobs; ++i) {
+        hash = fnv_32(hash, temperatures[i]);
+    }
+
+    return hash;
+}
+
+static void track_update(const uint16_t *raw) {
+    track_time_us += LEPTON_FRAME_PERIOD_US;
+    thermal_track_update(&track, raw, track_time_us);
+}
+
+static uint32_t digest_track(uint32_t hash) {
+    hash = fnv_32(hash, track.centroid_x);
+    hash = fnv_32(hash, track.centroid_y);
+    hash = fnv_32(hash, track.h.duty);
+    return fnv_32(hash, track.v.duty);
+}
+
+static void pipeline(const uint16_t *raw) {
+    thermal_agc_linear(&agc, raw, out);
+    thermal_blobs_detect(&blobs, raw);
+    track_update(raw);
+}
+
+static uint32_t digest_pipeline(uint32_t hash) {
+    hash = digest_out(hash);
+    hash = digest_blobs(hash);
+    return digest_track(hash);
+}
+
+/* Checksum of the results of one pass over the frames */
+static uint32_t checksum(kernel_fn kernel, digest_fn digest) {
+    uint32_t hash = 2166136261u;
+
+    int f = 0;
+    for (f = 0; f < NUM_FRAMES; ++f) {
+        kernel(frames[f]);
+        hash = digest(hash);
+    }
+
+    return hash;
+}
+
+static double time_per_frame_us(kernel_fn kernel, int iterations) {
+    struct timespec start, end;
+
+    clock_gettime(CLOCK_MONOTONIC, &start);
+
+    int i = 0;
+    for (i = 0; i < iterations; ++i) {
+        kernel(frames[i % NUM_FRAMES]);
+    }
+
+    clock_gettime(CLOCK_MONOTONIC, &end);
+
+    return ((end.tv_sec - start.tv_sec) * 1e6 + (end.tv_nsec - start.tv_nsec) / 1e3) / iterations;
+}
+
+static void run(const char *name, kernel_fn kernel, digest_fn digest, int iterations) {
+    uint32_t hash = checksum(kernel, digest);
+    double us = time_per_frame_us(kernel, iterations);
+
+    printf("%-20s %9.2f us %7.3f %%   %08" PRIx32 "\n", name, us, 100 * us / LEPTON_FRAME_PERIOD_US, hash);
+}
+
+int main(int argc, char **argv) {
+    int iterations = (argc > 1) ? atoi(argv[1]) : 2000;
+    assert(iterations > 0);
+
+    make_frames();
+    make_rois();
+    make_flatfield();
+    thermal_agc_init(&agc);
+    thermal_track_init(&track, 1000, 2000, 950, 2150);
+
+#ifdef THERMAL_NEON
+    printf("NEON, %d iterations\n", iterations);
+#else
+    printf("scalar, %d iterations\n", iterations);
+#endif
+    printf("%-20s %12s %9s   %s\n", "kernel", "per frame", "of 9 Hz", "checksum");
+
+    run("agc linear", agc_linear, digest_out, iterations);
+    run("agc percentile", agc_percentile, digest_out, iterations);
+    run("agc clahe", agc_clahe, digest_out, iterations);
+
+    thermal_agc_set_gamma(&agc, 0.6);
+    run("agc linear + gamma", agc_linear_gamma, digest_out, iterations);
+
+    run("flatfield", flatfield_apply, digest_filtered, iterations);
+    run("flatfield + agc", flatfield_agc_linear, digest_out, iterations);
+
+    thermal_denoise_init(&denoise, THERMAL_DENOISE_MEAN, 4);
+    run("denoise mean 4", denoise_push, digest_filtered, iterations);
+    thermal_denoise_init(&denoise, THERMAL_DENOISE_MEAN, 16);
+    run("denoise mean 16", denoise_push, digest_filtered, iterations);
+    thermal_denoise_init(&denoise, THERMAL_DENOISE_EMA, 1);
+    run("denoise ema", denoise_push, digest_filtered, iterations);
+    thermal_denoise_init(&denoise, THERMAL_DENOISE_MEDIAN3, 1);
+    run("denoise median 3", denoise_push, digest_filtered, iterations);
+
+    run("stats", stats_compute, digest_stats, iterations);
+    run("sat build", sat_build, digest_sat, iterations);
+    run("sat + 64 roi sums", sat_build_probes, digest_probes, iterations);
+    run("64 roi sums", sat_probes, digest_probes, iterations);
+
+    /* The hot blob, then the background noise above its mean */
+    thermal_blobs_init(&blobs, 8600, 1);
+    run("blobs", blobs_detect, digest_blobs, iterations);
+    thermal_blobs_set_threshold(&blobs, 7990);
+    run("blobs (noise)", blobs_detect, digest_blobs, iterations);
+
+    thermal_blobs_set_threshold(&blobs, 8600);
+    thermal_radiometry_params params;
+    thermal_radiometry_default_params(&params);
+    thermal_radiometry_init(&radiometry, &params);
+    run("radiometry frame", radiometry_frame, digest_filtered, iterations);
+    run("radiometry queries", radiometry_queries, digest_temperatures, iterations);
+
+    run("track", track_update, digest_track, iterations);
+
+    run("pipeline", pipeline, digest_pipeline, iterations);
+
+    return EXIT_SUCCESS;
+}
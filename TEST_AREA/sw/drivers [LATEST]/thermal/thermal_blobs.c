@@ -0,0 +1,262 @@
+#include <string.h>
+
+#include "thermal_blobs.h"
+
+#ifdef THERMAL_NEON
+#include <arm_neon.h>
+#endif
+
+/**
+ * thermal_blobs_init
+ *
+ * Initializes the blob detector, with 8-connectivity.
+ *
+ * @param blobs Blob detector.
+ * @param threshold Pixels >= threshold belong to blobs.
+ * @param min_area Blobs of fewer pixels are ignored.
+ */
+void thermal_blobs_init(thermal_blobs *blobs, uint16_t threshold, uint16_t min_area) {
+    memset(blobs, 0, sizeof(*blobs));
+
+    blobs->threshold = threshold;
+    blobs->min_area = (min_area == 0) ? 1 : min_area;
+    blobs->connect_8 = true;
+}
+
+/**
+ * thermal_blobs_set_threshold
+ *
+ * @param blobs Blob detector.
+ * @param threshold Pixels >= threshold belong to blobs.
+ */
+void thermal_blobs_set_threshold(thermal_blobs *blobs, uint16_t threshold) {
+    blobs->threshold = threshold;
+}
+
+/**
+ * thermal_blobs_set_connectivity
+ *
+ * @param blobs Blob detector.
+ * @param connect_8 true if diagonal neighbours are connected (8-connectivity),
+ *                  false otherwise (4-connectivity).
+ */
+void thermal_blobs_set_connectivity(thermal_blobs *blobs, bool connect_8) {
+    blobs->connect_8 = connect_8;
+}
+
+/* true if a pixel of the row is >= threshold, so that cold rows are skipped */
+static bool row_is_hot(const uint16_t *row, uint16_t threshold) {
+    uint16_t x = 0;
+
+#ifdef THERMAL_NEON
+    uint16x8_t vmax = vld1q_u16(row);
+    for (x = 8; x < THERMAL_FRAME_WIDTH; x += 8) {
+        vmax = vmaxq_u16(vmax, vld1q_u16(row + x));
+    }
+
+    uint16x4_t max4 = vpmax_u16(vget_low_u16(vmax), vget_high_u16(vmax));
+    max4 = vpmax_u16(max4, max4);
+    max4 = vpmax_u16(max4, max4);
+
+    return vget_lane_u16(max4, 0) >= threshold;
+#else
+    uint16_t max = 0;
+    for (x = 0; x < THERMAL_FRAME_WIDTH; ++x) {
+        max = (row[x] > max) ? row[x] : max;
+    }
+
+    return max >= threshold;
+#endif
+}
+
+static uint16_t find_root(thermal_blobs_run *runs, uint16_t i) {
+    while (runs[i].parent != i) {
+        /* Path halving */
+        runs[i].parent = runs[runs[i].parent].parent;
+        i = runs[i].parent;
+    }
+
+    return i;
+}
+
+/*
+ * Merges the sets of runs a and b. The root is the first run of the blob, so
+ * it holds its top row, and it accumulates the statistics of the blob.
+ */
+static void union_runs(thermal_blobs_run *runs, uint16_t a, uint16_t b) {
+    a = find_root(runs, a);
+    b = find_root(runs, b);
+    if (a == b) {
+        return;
+    }
+    if (b < a) {
+        uint16_t tmp = a;
+        a = b;
+        b = tmp;
+    }
+
+    thermal_blobs_run *root = &runs[a];
+    thermal_blobs_run *child = &runs[b];
+
+    child->parent = a;
+    root->area += child->area;
+    root->sum += child->sum;
+    root->sum_x += child->sum_x;
+    root->sum_y += child->sum_y;
+    root->x_min = (child->x_min < root->x_min) ? child->x_min : root->x_min;
+    root->x_max = (child->x_max > root->x_max) ? child->x_max : root->x_max;
+    root->y_max = (child->y_max > root->y_max) ? child->y_max : root->y_max;
+    if (child->peak > root->peak || (child->peak == root->peak && child->peak_index < root->peak_index)) {
+        root->peak = child->peak;
+        root->peak_index = child->peak_index;
+    }
+}
+
+/* Adds a blob to the list, keeping the THERMAL_BLOBS_MAX_BLOBS largest ones. */
+static void add_blob(thermal_blobs *blobs, const thermal_blobs_run *root) {
+    thermal_blob *blob = NULL;
+
+    if (blobs->num_blobs < THERMAL_BLOBS_MAX_BLOBS) {
+        blob = &blobs->blobs[blobs->num_blobs++];
+    } else {
+        uint16_t smallest = 0;
+        uint16_t i = 0;
+        for (i = 1; i < THERMAL_BLOBS_MAX_BLOBS; ++i) {
+            if (blobs->blobs[i].area < blobs->blobs[smallest].area) {
+                smallest = i;
+            }
+        }
+
+        if (root->area <= blobs->blobs[smallest].area) {
+            return;
+        }
+        blob = &blobs->blobs[smallest];
+    }
+
+    blob->area = root->area;
+    blob->sum = root->sum;
+    blob->x_min = root->x_min;
+    blob->y_min = root->y;
+    blob->x_max = root->x_max;
+    blob->y_max = root->y_max;
+    blob->centroid_x = ((root->sum_x << 8) + root->area / 2) / root->area;
+    blob->centroid_y = ((root->sum_y << 8) + root->area / 2) / root->area;
+    blob->peak = root->peak;
+    blob->peak_x = root->peak_index % THERMAL_FRAME_WIDTH;
+    blob->peak_y = root->peak_index / THERMAL_FRAME_WIDTH;
+}
+
+/**
+ * thermal_blobs_detect
+ *
+ * Finds the blobs of pixels >= threshold of a frame, in a single pass over
+ * it: the runs of hot pixels of each row are connected to the runs of the
+ * previous row with a union-find, which accumulates the area, sum, bounding
+ * box, centroid and peak of each blob. The results are in blobs->blobs,
+ * largest first.
+ *
+ * @param blobs Blob detector.
+ * @param raw Raw frame.
+ * @return the number of blobs in blobs->blobs.
+ */
+uint16_t thermal_blobs_detect(thermal_blobs *blobs, const uint16_t *raw) {
+    thermal_blobs_run *runs = blobs->runs;
+    uint16_t threshold = blobs->threshold;
+    uint16_t gap = blobs->connect_8 ? 1 : 0;
+
+    uint16_t num_runs = 0;
+    uint16_t prev_start = 0;
+    uint16_t prev_end = 0;
+
+    uint16_t y = 0;
+    for (y = 0; y < THERMAL_FRAME_HEIGHT; ++y) {
+        const uint16_t *row = raw + y * THERMAL_FRAME_WIDTH;
+        uint16_t row_start = num_runs;
+
+        if (row_is_hot(row, threshold)) {
+            uint16_t x = 0;
+            while (x < THERMAL_FRAME_WIDTH) {
+                if (row[x] < threshold) {
+                    x++;
+                    continue;
+                }
+
+                thermal_blobs_run *run = &runs[num_runs];
+                run->parent = num_runs;
+                run->y = y;
+                run->y_max = y;
+                run->x0 = x;
+                run->x_min = x;
+                run->peak = row[x];
+                run->peak_index = y * THERMAL_FRAME_WIDTH + x;
+
+                uint32_t sum = 0;
+                uint32_t sum_x = 0;
+                for (; x < THERMAL_FRAME_WIDTH && row[x] >= threshold; ++x) {
+                    sum += row[x];
+                    sum_x += x;
+                    if (row[x] > run->peak) {
+                        run->peak = row[x];
+                        run->peak_index = y * THERMAL_FRAME_WIDTH + x;
+                    }
+                }
+
+                run->x1 = x - 1;
+                run->x_max = x - 1;
+                run->area = x - run->x0;
+                run->sum = sum;
+                run->sum_x = sum_x;
+                run->sum_y = (uint32_t) y * run->area;
+
+                num_runs++;
+            }
+        }
+
+        /*
+         * Connect to the runs of the previous row: both lists are sorted, so
+         * the first candidate only moves forward.
+         */
+        uint16_t first = prev_start;
+        uint16_t r = 0;
+        for (r = row_start; r < num_runs; ++r) {
+            while (first < prev_end && runs[first].x1 + gap < runs[r].x0) {
+                first++;
+            }
+
+            uint16_t p = 0;
+            for (p = first; p < prev_end && runs[p].x0 <= runs[r].x1 + gap; ++p) {
+                union_runs(runs, p, r);
+            }
+        }
+
+        prev_start = row_start;
+        prev_end = num_runs;
+    }
+
+    blobs->num_runs = num_runs;
+    blobs->num_blobs = 0;
+    blobs->num_found = 0;
+
+    uint16_t i = 0;
+    for (i = 0; i < num_runs; ++i) {
+        if (runs[i].parent == i) {
+            blobs->num_found++;
+            if (runs[i].area >= blobs->min_area) {
+                add_blob(blobs, &runs[i]);
+            }
+        }
+    }
+
+    /* Largest first (insertion sort, at most THERMAL_BLOBS_MAX_BLOBS) */
+    for (i = 1; i < blobs->num_blobs; ++i) {
+        thermal_blob blob = blobs->blobs[i];
+        uint16_t j = i;
+        while (j > 0 && blobs->blobs[j - 1].area < blob.area) {
+            blobs->blobs[j] = blobs->blobs[j - 1];
+            j--;
+        }
+        blobs->blobs[j] = blob;
+    }
+
+    return blobs->num_blobs;
+}
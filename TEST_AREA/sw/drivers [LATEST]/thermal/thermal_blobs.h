@@ -0,0 +1,73 @@
+#ifndef __THERMAL_BLOBS_H__
+#define __THERMAL_BLOBS_H__
+
+#include <stdbool.h>
+#include <stdint.h>
+
+#include "thermal.h"
+
+/* At most a run every other pixel */
+#define THERMAL_BLOBS_MAX_RUNS (THERMAL_FRAME_NUM_PIXELS / 2)
+
+/* Blobs reported per frame (the largest ones) */
+#define THERMAL_BLOBS_MAX_BLOBS (64)
+
+/* Connected pixels above the threshold */
+typedef struct {
+    uint16_t area;       /* Number of pixels */
+    uint32_t sum;        /* Sum of the pixel values */
+    uint16_t x_min;      /* Bounding box */
+    uint16_t y_min;
+    uint16_t x_max;
+    uint16_t y_max;
+    int32_t  centroid_x; /* Q8 */
+    int32_t  centroid_y; /* Q8 */
+    uint16_t peak;       /* Hottest pixel (first one in row-major order) */
+    uint16_t peak_x;
+    uint16_t peak_y;
+} thermal_blob;
+
+/* Horizontal run of pixels above the threshold, node of the union-find */
+typedef struct {
+    uint16_t parent;
+    uint16_t area;
+    uint8_t  y;
+    uint8_t  x0;
+    uint8_t  x1;
+    uint8_t  y_max;
+    uint8_t  x_min;
+    uint8_t  x_max;
+    uint16_t peak;
+    uint16_t peak_index;
+    uint32_t sum;
+    uint32_t sum_x;
+    uint32_t sum_y;
+} thermal_blobs_run;
+
+/* Blob detector: settings, scratch memory and the blobs of the last frame */
+typedef struct {
+    /* Settings */
+    uint16_t threshold; /* Pixels >= threshold belong to blobs */
+    uint16_t min_area;  /* Smaller blobs are ignored */
+    bool     connect_8; /* Diagonal neighbours are connected */
+
+    /* Scratch */
+    thermal_blobs_run runs[THERMAL_BLOBS_MAX_RUNS];
+    uint16_t          num_runs;
+
+    /* Blobs of the last frame, largest first */
+    thermal_blob blobs[THERMAL_BLOBS_MAX_BLOBS];
+    uint16_t     num_blobs;
+    uint16_t     num_found; /* Including the ones not reported */
+} thermal_blobs;
+
+/*******************************************************************************
+ *  Public API
+ ******************************************************************************/
+
+void thermal_blobs_init(thermal_blobs *blobs, uint16_t threshold, uint16_t min_area);
+void thermal_blobs_set_threshold(thermal_blobs *blobs, uint16_t threshold);
+void thermal_blobs_set_connectivity(thermal_blobs *blobs, bool connect_8);
+uint16_t thermal_blobs_detect(thermal_blobs *blobs, const uint16_t *raw);
+
+#endif /* __THERMAL_BLOBS_H__ */
@@ -0,0 +1,244 @@
+#include <string.h>
+
+#include "thermal_denoise.h"
+
+#ifdef THERMAL_NEON
+#include <arm_neon.h>
+#endif
+
+/**
+ * thermal_denoise_init
+ *
+ * Initializes the temporal filter, with an EMA weight of 1/4 for new frames.
+ *
+ * @param denoise Temporal filter.
+ * @param mode Output of thermal_denoise_push().
+ * @param num_frames Frames averaged by THERMAL_DENOISE_MEAN (1 to
+ *                   THERMAL_DENOISE_MAX_FRAMES).
+ */
+void thermal_denoise_init(thermal_denoise *denoise, thermal_denoise_mode mode, uint16_t num_frames) {
+    if (num_frames < 1) {
+        num_frames = 1;
+    } else if (num_frames > THERMAL_DENOISE_MAX_FRAMES) {
+        num_frames = THERMAL_DENOISE_MAX_FRAMES;
+    }
+
+    denoise->mode = mode;
+    denoise->num_frames = num_frames;
+    thermal_denoise_set_ema_shift(denoise, 2);
+
+    thermal_denoise_reset(denoise);
+}
+
+/**
+ * thermal_denoise_set_ema_shift
+ *
+ * Sets the weight of a new frame in the exponential moving average to
+ * 2^-ema_shift: the noise is divided by about sqrt(2^(ema_shift + 1)), and a
+ * change of the scene takes about 2^ema_shift frames to show.
+ *
+ * @param denoise Temporal filter.
+ * @param ema_shift 0 (no filtering) to THERMAL_DENOISE_EMA_FRACTION.
+ */
+void thermal_denoise_set_ema_shift(thermal_denoise *denoise, uint16_t ema_shift) {
+    if (ema_shift > THERMAL_DENOISE_EMA_FRACTION) {
+        ema_shift = THERMAL_DENOISE_EMA_FRACTION;
+    }
+
+    denoise->ema_shift = ema_shift;
+}
+
+/**
+ * thermal_denoise_reset
+ *
+ * Forgets the previous frames, e.g. after the camera moved. Until the ring is
+ * full, the mean is over the frames pushed so far and the median is the last
+ * frame.
+ *
+ * @param denoise Temporal filter.
+ */
+void thermal_denoise_reset(thermal_denoise *denoise) {
+    switch (denoise->mode) {
+    case THERMAL_DENOISE_MEAN:
+        denoise->ring_size = denoise->num_frames;
+        break;
+    case THERMAL_DENOISE_MEDIAN3:
+        denoise->ring_size = 3;
+        break;
+    default:
+        denoise->ring_size = 0;
+        break;
+    }
+
+    denoise->head = 0;
+    denoise->count = 0;
+
+    /* The mean subtracts the frame it replaces, which is 0 until the ring is full. */
+    memset(denoise->ring, 0, sizeof(denoise->ring));
+    memset(denoise->sum, 0, sizeof(denoise->sum));
+    memset(denoise->ema, 0, sizeof(denoise->ema));
+}
+
+/*
+ * sum += new frame - oldest frame, and out = sum / count rounded. The division
+ * is a multiplication by ceil(2^31 / count): sum < 2^18, so the error is below
+ * 2^-13 and the result is exact.
+ */
+static void push_mean(thermal_denoise *denoise, const uint16_t *raw, uint16_t *out, uint16_t *slot) {
+    uint32_t *sum = denoise->sum;
+    uint32_t count = denoise->count;
+    uint32_t half = count / 2;
+    uint32_t recip = ((1u << 31) + count - 1) / count;
+
+    uint16_t i = 0;
+
+#ifdef THERMAL_NEON
+    uint32x4_t vhalf = vdupq_n_u32(half);
+    uint32x2_t vrecip = vdup_n_u32(recip);
+
+    for (i = 0; i < THERMAL_FRAME_NUM_PIXELS; i += 8) {
+        uint16x8_t pixels = vld1q_u16(raw + i);
+        uint16x8_t oldest = vld1q_u16(slot + i);
+        vst1q_u16(slot + i, pixels);
+
+        uint32x4_t lo = vsubw_u16(vaddw_u16(vld1q_u32(sum + i), vget_low_u16(pixels)), vget_low_u16(oldest));
+        uint32x4_t hi = vsubw_u16(vaddw_u16(vld1q_u32(sum + i + 4), vget_high_u16(pixels)), vget_high_u16(oldest));
+        vst1q_u32(sum + i, lo);
+        vst1q_u32(sum + i + 4, hi);
+
+        lo = vaddq_u32(lo, vhalf);
+        hi = vaddq_u32(hi, vhalf);
+        uint32x4_t mean_lo = vcombine_u32(vshrn_n_u64(vmull_u32(vget_low_u32(lo), vrecip), 31),
+                                          vshrn_n_u64(vmull_u32(vget_high_u32(lo), vrecip), 31));
+        uint32x4_t mean_hi = vcombine_u32(vshrn_n_u64(vmull_u32(vget_low_u32(hi), vrecip), 31),
+                                          vshrn_n_u64(vmull_u32(vget_high_u32(hi), vrecip), 31));
+
+        vst1q_u16(out + i, vcombine_u16(vmovn_u32(mean_lo), vmovn_u32(mean_hi)));
+    }
+#else
+    for (i = 0; i < THERMAL_FRAME_NUM_PIXELS; ++i) {
+        uint16_t pixel = raw[i];
+        sum[i] += pixel - slot[i];
+        slot[i] = pixel;
+
+        out[i] = ((uint64_t) (sum[i] + half) * recip) >> 31;
+    }
+#endif
+}
+
+/* ema += (new frame - ema) / 2^ema_shift, out = ema rounded */
+static void push_ema(thermal_denoise *denoise, const uint16_t *raw, uint16_t *out) {
+    uint32_t *ema = denoise->ema;
+    uint16_t i = 0;
+
+    if (denoise->count == 1) {
+        for (i = 0; i < THERMAL_FRAME_NUM_PIXELS; ++i) {
+            ema[i] = (uint32_t) raw[i] << THERMAL_DENOISE_EMA_FRACTION;
+        }
+        memcpy(out, raw, THERMAL_FRAME_NUM_PIXELS * sizeof(*out));
+        return;
+    }
+
+#ifdef THERMAL_NEON
+    int32x4_t vshift = vdupq_n_s32(-(int32_t) denoise->ema_shift);
+
+    for (i = 0; i < THERMAL_FRAME_NUM_PIXELS; i += 8) {
+        uint16x8_t pixels = vld1q_u16(raw + i);
+        int32x4_t lo = vreinterpretq_s32_u32(vld1q_u32(ema + i));
+        int32x4_t hi = vreinterpretq_s32_u32(vld1q_u32(ema + i + 4));
+
+        int32x4_t diff_lo = vsubq_s32(vreinterpretq_s32_u32(vshll_n_u16(vget_low_u16(pixels), THERMAL_DENOISE_EMA_FRACTION)), lo);
+        int32x4_t diff_hi = vsubq_s32(vreinterpretq_s32_u32(vshll_n_u16(vget_high_u16(pixels), THERMAL_DENOISE_EMA_FRACTION)), hi);
+        uint32x4_t new_lo = vreinterpretq_u32_s32(vaddq_s32(lo, vshlq_s32(diff_lo, vshift)));
+        uint32x4_t new_hi = vreinterpretq_u32_s32(vaddq_s32(hi, vshlq_s32(diff_hi, vshift)));
+        vst1q_u32(ema + i, new_lo);
+        vst1q_u32(ema + i + 4, new_hi);
+
+        vst1q_u16(out + i, vcombine_u16(vrshrn_n_u32(new_lo, THERMAL_DENOISE_EMA_FRACTION),
+                                        vrshrn_n_u32(new_hi, THERMAL_DENOISE_EMA_FRACTION)));
+    }
+#else
+    for (i = 0; i < THERMAL_FRAME_NUM_PIXELS; ++i) {
+        int32_t diff = ((int32_t) raw[i] << THERMAL_DENOISE_EMA_FRACTION) - (int32_t) ema[i];
+        ema[i] += diff >> denoise->ema_shift;
+
+        out[i] = (ema[i] + (1 << (THERMAL_DENOISE_EMA_FRACTION - 1))) >> THERMAL_DENOISE_EMA_FRACTION;
+    }
+#endif
+}
+
+/* Median of the new frame and of the 2 previous ones, with 4 min/max */
+static void push_median3(thermal_denoise *denoise, const uint16_t *raw, uint16_t *out, uint16_t *slot) {
+    const uint16_t *prev_1 = denoise->ring[(denoise->head + 2) % 3];
+    const uint16_t *prev_2 = denoise->ring[(denoise->head + 1) % 3];
+    uint16_t i = 0;
+
+    if (denoise->count < 3) {
+        memcpy(slot, raw, THERMAL_FRAME_NUM_PIXELS * sizeof(*slot));
+        memcpy(out, raw, THERMAL_FRAME_NUM_PIXELS * sizeof(*out));
+        return;
+    }
+
+#ifdef THERMAL_NEON
+    for (i = 0; i < THERMAL_FRAME_NUM_PIXELS; i += 8) {
+        uint16x8_t a = vld1q_u16(raw + i);
+        uint16x8_t b = vld1q_u16(prev_1 + i);
+        uint16x8_t c = vld1q_u16(prev_2 + i);
+        vst1q_u16(slot + i, a);
+
+        uint16x8_t median = vmaxq_u16(vminq_u16(a, b), vminq_u16(vmaxq_u16(a, b), c));
+        vst1q_u16(out + i, median);
+    }
+#else
+    for (i = 0; i < THERMAL_FRAME_NUM_PIXELS; ++i) {
+        uint16_t a = raw[i];
+        uint16_t b = prev_1[i];
+        uint16_t c = prev_2[i];
+        slot[i] = a;
+
+        uint16_t low = (a < b) ? a : b;
+        uint16_t high = (a < b) ? b : a;
+        high = (high < c) ? high : c;
+
+        out[i] = (low > high) ? low : high;
+    }
+#endif
+}
+
+/**
+ * thermal_denoise_push
+ *
+ * Adds a frame to the filter and outputs the filtered frame. The time does not
+ * depend on the number of frames of the ring: the mean only adds the new frame
+ * and subtracts the one it replaces.
+ *
+ * @param denoise Temporal filter.
+ * @param raw Raw frame.
+ * @param out Filtered frame (raw frame format).
+ */
+void thermal_denoise_push(thermal_denoise *denoise, const uint16_t *raw, uint16_t *out) {
+    uint16_t *slot = denoise->ring[denoise->head];
+
+    if (denoise->count < THERMAL_DENOISE_MAX_FRAMES) {
+        denoise->count++;
+    }
+    if (denoise->ring_size != 0 && denoise->count > denoise->ring_size) {
+        denoise->count = denoise->ring_size;
+    }
+
+    switch (denoise->mode) {
+    case THERMAL_DENOISE_MEAN:
+        push_mean(denoise, raw, out, slot);
+        break;
+    case THERMAL_DENOISE_MEDIAN3:
+        push_median3(denoise, raw, out, slot);
+        break;
+    default:
+        push_ema(denoise, raw, out);
+        break;
+    }
+
+    if (denoise->ring_size != 0) {
+        denoise->head = (denoise->head + 1) % denoise->ring_size;
+    }
+}
@@ -0,0 +1,53 @@
+#ifndef __THERMAL_DENOISE_H__
+#define __THERMAL_DENOISE_H__
+
+#include <stdint.h>
+
+#include "thermal.h"
+
+/* Frames of the ring */
+#define THERMAL_DENOISE_MAX_FRAMES (16)
+
+/* Fractional bits of the exponential moving average */
+#define THERMAL_DENOISE_EMA_FRACTION (8)
+
+typedef enum {
+    THERMAL_DENOISE_MEAN,   /* Mean of the last num_frames frames */
+    THERMAL_DENOISE_EMA,    /* Exponential moving average */
+    THERMAL_DENOISE_MEDIAN3 /* Median of the last 3 frames */
+} thermal_denoise_mode;
+
+/*
+ * Temporal filter: the last frames in a ring and the state of the filter,
+ * updated incrementally so that the time per frame does not depend on the
+ * number of frames.
+ */
+typedef struct {
+    /* Settings */
+    thermal_denoise_mode mode;
+    uint16_t             num_frames; /* Mean: frames averaged */
+    uint16_t             ema_shift;  /* EMA: weight of a new frame is 2^-ema_shift */
+
+    /* Ring of the last frames, head is the next one to be replaced */
+    uint16_t ring[THERMAL_DENOISE_MAX_FRAMES][THERMAL_FRAME_NUM_PIXELS];
+    uint16_t ring_size;
+    uint16_t head;
+    uint16_t count;
+
+    /* Mean: sum of the frames in the ring */
+    uint32_t sum[THERMAL_FRAME_NUM_PIXELS];
+
+    /* EMA: average of the frames, THERMAL_DENOISE_EMA_FRACTION bits of fraction */
+    uint32_t ema[THERMAL_FRAME_NUM_PIXELS];
+} thermal_denoise;
+
+/*******************************************************************************
+ *  Public API
+ ******************************************************************************/
+
+void thermal_denoise_init(thermal_denoise *denoise, thermal_denoise_mode mode, uint16_t num_frames);
+void thermal_denoise_set_ema_shift(thermal_denoise *denoise, uint16_t ema_shift);
+void thermal_denoise_reset(thermal_denoise *denoise);
+void thermal_denoise_push(thermal_denoise *denoise, const uint16_t *raw, uint16_t *out);
+
+#endif /* __THERMAL_DENOISE_H__ */
@@ -0,0 +1,357 @@
+#include <math.h>
+#include <string.h>
+
+#include "thermal_flatfield.h"
+
+#ifdef THERMAL_NEON
+#include <arm_neon.h>
+#endif
+
+#define ROUNDING (1 << (THERMAL_FLATFIELD_GAIN_FRACTION - 1))
+
+/**
+ * thermal_flatfield_init
+ *
+ * Initializes the flat-field correction to no correction: gains of 1, offsets
+ * of 0 and no bad pixels.
+ *
+ * @param flatfield Flat-field correction.
+ */
+void thermal_flatfield_init(thermal_flatfield *flatfield) {
+    memset(flatfield, 0, sizeof(*flatfield));
+
+    uint16_t i = 0;
+    for (i = 0; i < THERMAL_FRAME_NUM_PIXELS; ++i) {
+        flatfield->gain[i] = THERMAL_FLATFIELD_GAIN_ONE;
+    }
+}
+
+/**
+ * thermal_flatfield_set_bad_pixel
+ *
+ * Flags a pixel as bad: it is replaced by the mean of its good neighbours.
+ *
+ * @param flatfield Flat-field correction.
+ * @param x Column of the pixel.
+ * @param y Row of the pixel.
+ * @return false if there are already THERMAL_FLATFIELD_MAX_BAD bad pixels.
+ */
+bool thermal_flatfield_set_bad_pixel(thermal_flatfield *flatfield, uint16_t x, uint16_t y) {
+    uint16_t i = y * THERMAL_FRAME_WIDTH + x;
+
+    if (flatfield->bad_map[i]) {
+        return true;
+    }
+    if (flatfield->num_bad >= THERMAL_FLATFIELD_MAX_BAD) {
+        return false;
+    }
+
+    flatfield->bad_map[i] = 1;
+    flatfield->bad[flatfield->num_bad++] = i;
+    flatfield->gain[i] = 0;
+    flatfield->offset[i] = 0;
+
+    return true;
+}
+
+/**
+ * thermal_flatfield_calibration_start
+ *
+ * Starts a calibration: the frames given to thermal_flatfield_calibration_add()
+ * until thermal_flatfield_calibration_finish() are averaged. They must see a
+ * uniform scene, e.g. the lens cap (cold scene) and optionally a uniform
+ * warmer target (hot scene).
+ *
+ * @param flatfield Flat-field correction.
+ */
+void thermal_flatfield_calibration_start(thermal_flatfield *flatfield) {
+    memset(flatfield->calibration_sum, 0, sizeof(flatfield->calibration_sum));
+    flatfield->calibration_frames[0] = 0;
+    flatfield->calibration_frames[1] = 0;
+}
+
+/**
+ * thermal_flatfield_calibration_add
+ *
+ * Adds a raw frame of a uniform scene to the calibration.
+ *
+ * @param flatfield Flat-field correction.
+ * @param raw Raw frame.
+ * @param hot false for the cold scene, true for the hot scene.
+ */
+void thermal_flatfield_calibration_add(thermal_flatfield *flatfield, const uint16_t *raw, bool hot) {
+    uint32_t *sum = flatfield->calibration_sum[hot ? 1 : 0];
+
+    /* At most 65535 frames of 14 bits */
+    uint16_t i = 0;
+    for (i = 0; i < THERMAL_FRAME_NUM_PIXELS; ++i) {
+        sum[i] += raw[i];
+    }
+
+    flatfield->calibration_frames[hot ? 1 : 0]++;
+}
+
+/* Mean of a pixel over the frames of the cold scene */
+static double cold_level(const thermal_flatfield *flatfield, uint16_t i) {
+    return (double) flatfield->calibration_sum[0][i] / flatfield->calibration_frames[0];
+}
+
+/* Mean of a pixel over the hot scene minus over the cold one (cold level without a hot scene) */
+static double response(const thermal_flatfield *flatfield, uint16_t i) {
+    if (flatfield->calibration_frames[1] == 0) {
+        return cold_level(flatfield, i);
+    }
+
+    return (double) flatfield->calibration_sum[1][i] / flatfield->calibration_frames[1] - cold_level(flatfield, i);
+}
+
+/* Mean of cold_level() or response() over the pixels not flagged bad */
+static double good_mean(const thermal_flatfield *flatfield, double (*value)(const thermal_flatfield *, uint16_t)) {
+    double sum = 0;
+    uint16_t num = 0;
+
+    uint16_t i = 0;
+    for (i = 0; i < THERMAL_FRAME_NUM_PIXELS; ++i) {
+        if (!flatfield->bad_map[i]) {
+            sum += value(flatfield, i);
+            num++;
+        }
+    }
+
+    return (num > 0) ? sum / num : 0;
+}
+
+/**
+ * thermal_flatfield_calibration_finish
+ *
+ * Builds the maps from the calibration frames, replacing the previous maps and
+ * bad pixels:
+ * - cold and hot scenes: the gain and offset of each pixel map its mean over
+ *   the two scenes to the means of the frame (two-point correction). Pixels
+ *   whose response (hot - cold) differs by more than max_deviation_percent
+ *   from the mean response are bad.
+ * - cold scene only: the offset of each pixel maps its mean to the mean of the
+ *   frame, with gains of 1. Pixels whose level differs by more than
+ *   max_deviation_percent from the mean level are bad.
+ *
+ * @param flatfield Flat-field correction.
+ * @param max_deviation_percent Bad pixel threshold.
+ * @return the number of bad pixels (at most THERMAL_FLATFIELD_MAX_BAD, the
+ *         others are not corrected).
+ */
+uint16_t thermal_flatfield_calibration_finish(thermal_flatfield *flatfield, uint16_t max_deviation_percent) {
+    bool two_point = flatfield->calibration_frames[1] > 0;
+    if (flatfield->calibration_frames[0] == 0) {
+        return flatfield->num_bad;
+    }
+
+    memset(flatfield->bad_map, 0, sizeof(flatfield->bad_map));
+    flatfield->num_bad = 0;
+
+    /* Bad pixels against the mean of all the pixels, then of the good ones */
+    double mean_response = good_mean(flatfield, response);
+    double max_deviation = fabs(mean_response) * max_deviation_percent / 100;
+
+    uint16_t i = 0;
+    for (i = 0; i < THERMAL_FRAME_NUM_PIXELS; ++i) {
+        double r = response(flatfield, i);
+        bool bad = fabs(r - mean_response) > max_deviation || (two_point && r <= 0);
+        if (bad && flatfield->num_bad < THERMAL_FLATFIELD_MAX_BAD) {
+            flatfield->bad_map[i] = 1;
+            flatfield->bad[flatfield->num_bad++] = i;
+        }
+    }
+
+    double mean_cold = good_mean(flatfield, cold_level);
+    mean_response = good_mean(flatfield, response);
+
+    for (i = 0; i < THERMAL_FRAME_NUM_PIXELS; ++i) {
+        double gain = 1;
+        if (two_point && !flatfield->bad_map[i]) {
+            gain = mean_response / response(flatfield, i);
+        }
+        if (gain * THERMAL_FLATFIELD_GAIN_ONE > UINT16_MAX) {
+            gain = (double) UINT16_MAX / THERMAL_FLATFIELD_GAIN_ONE;
+        }
+
+        double offset = mean_cold - gain * cold_level(flatfield, i);
+        offset = (offset < INT16_MIN) ? INT16_MIN : offset;
+        offset = (offset > INT16_MAX) ? INT16_MAX : offset;
+
+        if (flatfield->bad_map[i]) {
+            /* Replaced in each frame, the mean level until then */
+            flatfield->gain[i] = 0;
+            flatfield->offset[i] = lround(mean_cold);
+        } else {
+            flatfield->gain[i] = lround(gain * THERMAL_FLATFIELD_GAIN_ONE);
+            flatfield->offset[i] = lround(offset);
+        }
+    }
+
+    return flatfield->num_bad;
+}
+
+static uint16_t correct_pixel(const thermal_flatfield *flatfield, const uint16_t *raw, uint16_t i) {
+    int32_t value = (int32_t) raw[i] * flatfield->gain[i] + (int32_t) flatfield->offset[i] * THERMAL_FLATFIELD_GAIN_ONE;
+    value = (value + ROUNDING) >> THERMAL_FLATFIELD_GAIN_FRACTION;
+
+    value = (value < 0) ? 0 : value;
+    value = (value > THERMAL_PIXEL_MAX) ? THERMAL_PIXEL_MAX : value;
+
+    return value;
+}
+
+/*
+ * Sets the offset of each bad pixel to the mean of its good neighbours in this
+ * frame (8-connectivity). Without good neighbours, the offset does not change.
+ */
+static void interpolate_bad_pixels(thermal_flatfield *flatfield, const uint16_t *raw) {
+    uint16_t b = 0;
+    for (b = 0; b < flatfield->num_bad; ++b) {
+        uint16_t i = flatfield->bad[b];
+        int16_t x = i % THERMAL_FRAME_WIDTH;
+        int16_t y = i / THERMAL_FRAME_WIDTH;
+
+        uint32_t sum = 0;
+        uint16_t num = 0;
+
+        int16_t dx = 0;
+        int16_t dy = 0;
+        for (dy = -1; dy <= 1; ++dy) {
+            for (dx = -1; dx <= 1; ++dx) {
+                int16_t nx = x + dx;
+                int16_t ny = y + dy;
+                if (nx < 0 || nx >= THERMAL_FRAME_WIDTH || ny < 0 || ny >= THERMAL_FRAME_HEIGHT) {
+                    continue;
+                }
+
+                uint16_t n = ny * THERMAL_FRAME_WIDTH + nx;
+                if (!flatfield->bad_map[n]) {
+                    sum += correct_pixel(flatfield, raw, n);
+                    num++;
+                }
+            }
+        }
+
+        if (num > 0) {
+            flatfield->offset[i] = (sum + num / 2) / num;
+        }
+    }
+}
+
+#ifdef THERMAL_NEON
+/* Corrects 8 pixels: rounded, saturated to 0 - THERMAL_PIXEL_MAX */
+static inline uint16x8_t correct_8(const thermal_flatfield *flatfield, const uint16_t *raw, uint16_t i) {
+    uint16x8_t pixels = vld1q_u16(raw + i);
+    uint16x8_t gain = vld1q_u16(flatfield->gain + i);
+    int16x8_t offset = vld1q_s16(flatfield->offset + i);
+
+    int32x4_t lo = vreinterpretq_s32_u32(vmull_u16(vget_low_u16(pixels), vget_low_u16(gain)));
+    int32x4_t hi = vreinterpretq_s32_u32(vmull_u16(vget_high_u16(pixels), vget_high_u16(gain)));
+    lo = vaddq_s32(lo, vshll_n_s16(vget_low_s16(offset), THERMAL_FLATFIELD_GAIN_FRACTION));
+    hi = vaddq_s32(hi, vshll_n_s16(vget_high_s16(offset), THERMAL_FLATFIELD_GAIN_FRACTION));
+
+    uint16x8_t corrected = vcombine_u16(vqrshrun_n_s32(lo, THERMAL_FLATFIELD_GAIN_FRACTION),
+                                        vqrshrun_n_s32(hi, THERMAL_FLATFIELD_GAIN_FRACTION));
+
+    return vminq_u16(corrected, vdupq_n_u16(THERMAL_PIXEL_MAX));
+}
+#endif
+
+/**
+ * thermal_flatfield_apply
+ *
+ * Corrects a raw frame, for the kernels working on raw frames (statistics,
+ * blobs, tracking).
+ *
+ * @param flatfield Flat-field correction.
+ * @param raw Raw frame.
+ * @param out Corrected frame (raw frame format).
+ */
+void thermal_flatfield_apply(thermal_flatfield *flatfield, const uint16_t *raw, uint16_t *out) {
+    interpolate_bad_pixels(flatfield, raw);
+
+    uint16_t i = 0;
+
+#ifdef THERMAL_NEON
+    for (i = 0; i < THERMAL_FRAME_NUM_PIXELS; i += 8) {
+        vst1q_u16(out + i, correct_8(flatfield, raw, i));
+    }
+#else
+    for (i = 0; i < THERMAL_FRAME_NUM_PIXELS; ++i) {
+        out[i] = correct_pixel(flatfield, raw, i);
+    }
+#endif
+}
+
+/**
+ * thermal_flatfield_agc_linear
+ *
+ * Corrects a raw frame and maps [MIN, MAX] of the corrected frame linearly to
+ * 0 - 255, like thermal_agc_linear() on the output of
+ * thermal_flatfield_apply(). The correction is computed in the loops of the
+ * AGC (range, then mapping), so the corrected frame is never stored.
+ *
+ * @param flatfield Flat-field correction.
+ * @param agc AGC structure.
+ * @param raw Raw frame.
+ * @param out Output frame (8 bits per pixel).
+ */
+void thermal_flatfield_agc_linear(thermal_flatfield *flatfield, thermal_agc *agc, const uint16_t *raw, uint8_t *out) {
+    interpolate_bad_pixels(flatfield, raw);
+
+    uint16_t i = 0;
+    uint16_t low = THERMAL_PIXEL_MAX;
+    uint16_t high = 0;
+
+#ifdef THERMAL_NEON
+    uint16x8_t vmin = vdupq_n_u16(THERMAL_PIXEL_MAX);
+    uint16x8_t vmax = vdupq_n_u16(0);
+    for (i = 0; i < THERMAL_FRAME_NUM_PIXELS; i += 8) {
+        uint16x8_t corrected = correct_8(flatfield, raw, i);
+        vmin = vminq_u16(vmin, corrected);
+        vmax = vmaxq_u16(vmax, corrected);
+    }
+
+    uint16x4_t min4 = vpmin_u16(vget_low_u16(vmin), vget_high_u16(vmin));
+    uint16x4_t max4 = vpmax_u16(vget_low_u16(vmax), vget_high_u16(vmax));
+    min4 = vpmin_u16(min4, min4);
+    max4 = vpmax_u16(max4, max4);
+    min4 = vpmin_u16(min4, min4);
+    max4 = vpmax_u16(max4, max4);
+    low = vget_lane_u16(min4, 0);
+    high = vget_lane_u16(max4, 0);
+#else
+    for (i = 0; i < THERMAL_FRAME_NUM_PIXELS; ++i) {
+        uint16_t corrected = correct_pixel(flatfield, raw, i);
+        low = (corrected < low) ? corrected : low;
+        high = (corrected > high) ? corrected : high;
+    }
+#endif
+
+    /* Same mapping as thermal_agc_linear_range() */
+    uint32_t range = high - low;
+    uint32_t scale = (range == 0) ? 0 : (255 * 65536 + range - 1) / range;
+
+    agc->low = low;
+    agc->high = high;
+
+#ifdef THERMAL_NEON
+    uint16x8_t vlow = vdupq_n_u16(low);
+    uint32x4_t vscale = vdupq_n_u32(scale);
+
+    for (i = 0; i < THERMAL_FRAME_NUM_PIXELS; i += 8) {
+        uint16x8_t pixels = vsubq_u16(correct_8(flatfield, raw, i), vlow);
+
+        uint32x4_t lo = vmulq_u32(vmovl_u16(vget_low_u16(pixels)), vscale);
+        uint32x4_t hi = vmulq_u32(vmovl_u16(vget_high_u16(pixels)), vscale);
+        uint16x8_t mapped = vcombine_u16(vshrn_n_u32(lo, 16), vshrn_n_u32(hi, 16));
+
+        vst1_u8(out + i, vmovn_u16(mapped));
+    }
+#else
+    for (i = 0; i < THERMAL_FRAME_NUM_PIXELS; ++i) {
+        out[i] = ((correct_pixel(flatfield, raw, i) - low) * scale) >> 16;
+    }
+#endif
+}
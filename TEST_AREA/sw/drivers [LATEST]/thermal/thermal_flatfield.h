@@ -0,0 +1,49 @@
+#ifndef __THERMAL_FLATFIELD_H__
+#define __THERMAL_FLATFIELD_H__
+
+#include <stdbool.h>
+#include <stdint.h>
+
+#include "thermal.h"
+#include "thermal_agc.h"
+
+/* Fractional bits of the gains */
+#define THERMAL_FLATFIELD_GAIN_FRACTION (14)
+#define THERMAL_FLATFIELD_GAIN_ONE      (1 << THERMAL_FLATFIELD_GAIN_FRACTION)
+
+/* Bad pixels replaced by their neighbours */
+#define THERMAL_FLATFIELD_MAX_BAD (256)
+
+/*
+ * Flat-field correction: corrected = raw * gain + offset for each pixel, and
+ * bad pixels replaced by the mean of their good neighbours.
+ *
+ * The gain of a bad pixel is 0 and its offset is its replacement for the
+ * current frame, so that the correction loops do not test for bad pixels.
+ */
+typedef struct {
+    /* Maps */
+    uint16_t gain[THERMAL_FRAME_NUM_PIXELS]; /* THERMAL_FLATFIELD_GAIN_FRACTION bits of fraction, below 4 */
+    int16_t  offset[THERMAL_FRAME_NUM_PIXELS];
+    uint8_t  bad_map[THERMAL_FRAME_NUM_PIXELS];
+    uint16_t bad[THERMAL_FLATFIELD_MAX_BAD];
+    uint16_t num_bad;
+
+    /* Calibration: sum of the frames of the cold (0) and hot (1) scenes */
+    uint32_t calibration_sum[2][THERMAL_FRAME_NUM_PIXELS];
+    uint16_t calibration_frames[2];
+} thermal_flatfield;
+
+/*******************************************************************************
+ *  Public API
+ ******************************************************************************/
+
+void thermal_flatfield_init(thermal_flatfield *flatfield);
+bool thermal_flatfield_set_bad_pixel(thermal_flatfield *flatfield, uint16_t x, uint16_t y);
+void thermal_flatfield_calibration_start(thermal_flatfield *flatfield);
+void thermal_flatfield_calibration_add(thermal_flatfield *flatfield, const uint16_t *raw, bool hot);
+uint16_t thermal_flatfield_calibration_finish(thermal_flatfield *flatfield, uint16_t max_deviation_percent);
+void thermal_flatfield_apply(thermal_flatfield *flatfield, const uint16_t *raw, uint16_t *out);
+void thermal_flatfield_agc_linear(thermal_flatfield *flatfield, thermal_agc *agc, const uint16_t *raw, uint8_t *out);
+
+#endif /* __THERMAL_FLATFIELD_H__ */
@@ -0,0 +1,164 @@
+#include <math.h>
+
+#include "thermal_radiometry.h"
+
+/**
+ * thermal_radiometry_default_params
+ *
+ * Sets calibration parameters approximating a lepton around room temperature
+ * (8000 counts at 22 C, 30 counts per Kelvin), for a black body in a room at
+ * 22 C. Use the calibration of the camera for actual measurements.
+ *
+ * @param params Calibration parameters.
+ */
+void thermal_radiometry_default_params(thermal_radiometry_params *params) {
+    params->planck_r = 227700;
+    params->planck_b = 1428;
+    params->planck_f = 1;
+    params->planck_o = 6186;
+    params->emissivity = 1;
+    params->reflected_k = 295.15;
+}
+
+/* Temperature in 1/100 K of a pixel value, from the calibration */
+static uint16_t centikelvin(const thermal_radiometry_params *params, uint16_t counts) {
+    double signal = counts - params->planck_o;
+
+    /* Remove the reflected radiation and correct for the emissivity */
+    double reflected = params->planck_r / (exp(params->planck_b / params->reflected_k) - params->planck_f);
+    double object = (signal - (1 - params->emissivity) * reflected) / params->emissivity;
+    if (object <= 0) {
+        return 0;
+    }
+
+    double log_arg = params->planck_r / object + params->planck_f;
+    if (log_arg <= 1) {
+        return THERMAL_RADIOMETRY_CK_MAX;
+    }
+
+    double ck = 100 * params->planck_b / log(log_arg);
+
+    return (ck >= THERMAL_RADIOMETRY_CK_MAX) ? THERMAL_RADIOMETRY_CK_MAX : (uint16_t) lround(ck);
+}
+
+/**
+ * thermal_radiometry_init
+ *
+ * Builds the table of the temperatures of all the 14-bit pixel values, so
+ * that a conversion is a single lookup.
+ *
+ * @param radiometry Radiometric conversion.
+ * @param params Calibration parameters (see
+ *               thermal_radiometry_default_params()), emissivity above 0.
+ */
+void thermal_radiometry_init(thermal_radiometry *radiometry, const thermal_radiometry_params *params) {
+    radiometry->params = *params;
+    if (radiometry->params.emissivity <= 0) {
+        radiometry->params.emissivity = 1;
+    }
+
+    uint32_t counts = 0;
+    for (counts = 0; counts <= THERMAL_PIXEL_MAX; ++counts) {
+        radiometry->lut[counts] = centikelvin(&radiometry->params, counts);
+    }
+}
+
+/**
+ * thermal_radiometry_counts
+ *
+ * @param radiometry Radiometric conversion.
+ * @param counts Raw pixel value.
+ * @return the temperature in 1/100 K.
+ */
+uint16_t thermal_radiometry_counts(const thermal_radiometry *radiometry, uint16_t counts) {
+    return radiometry->lut[counts & THERMAL_PIXEL_MAX];
+}
+
+/**
+ * thermal_radiometry_pixel
+ *
+ * @param radiometry Radiometric conversion.
+ * @param raw Raw frame.
+ * @param x Column of the pixel.
+ * @param y Row of the pixel.
+ * @return the temperature of the pixel in 1/100 K.
+ */
+uint16_t thermal_radiometry_pixel(const thermal_radiometry *radiometry, const uint16_t *raw, uint16_t x, uint16_t y) {
+    return thermal_radiometry_counts(radiometry, raw[y * THERMAL_FRAME_WIDTH + x]);
+}
+
+/**
+ * thermal_radiometry_frame
+ *
+ * Converts a whole raw frame to temperatures. NEON has no table lookup of 16
+ * bits, so this is a scalar loop over the table (32 KB, the frames only use
+ * a small part of it).
+ *
+ * @param radiometry Radiometric conversion.
+ * @param raw Raw frame.
+ * @param centikelvin Temperatures in 1/100 K (raw frame format).
+ */
+void thermal_radiometry_frame(const thermal_radiometry *radiometry, const uint16_t *raw, uint16_t *centikelvin) {
+    const uint16_t *lut = radiometry->lut;
+
+    uint16_t i = 0;
+    for (i = 0; i < THERMAL_FRAME_NUM_PIXELS; i += 4) {
+        centikelvin[i] = lut[raw[i] & THERMAL_PIXEL_MAX];
+        centikelvin[i + 1] = lut[raw[i + 1] & THERMAL_PIXEL_MAX];
+        centikelvin[i + 2] = lut[raw[i + 2] & THERMAL_PIXEL_MAX];
+        centikelvin[i + 3] = lut[raw[i + 3] & THERMAL_PIXEL_MAX];
+    }
+}
+
+/**
+ * thermal_radiometry_roi_mean
+ *
+ * Temperature of the mean pixel value of a ROI, from the summed-area tables
+ * of the raw frame. Over the temperature range of a ROI, this is the mean
+ * temperature within the linearity of the Planck curve (use the summed-area
+ * tables of the output of thermal_radiometry_frame() for the exact mean).
+ *
+ * @param radiometry Radiometric conversion.
+ * @param sat Summed-area tables of the raw frame.
+ * @param roi Region of interest.
+ * @return the temperature in 1/100 K, 0 if the ROI is empty.
+ */
+uint16_t thermal_radiometry_roi_mean(const thermal_radiometry *radiometry, const thermal_sat *sat, const thermal_roi *roi) {
+    uint32_t num_pixels = thermal_sat_num_pixels(roi);
+    if (num_pixels == 0) {
+        return 0;
+    }
+
+    uint32_t mean = (thermal_sat_sum(sat, roi) + num_pixels / 2) / num_pixels;
+
+    return thermal_radiometry_counts(radiometry, mean);
+}
+
+/**
+ * thermal_radiometry_blob_mean
+ *
+ * Temperature of the mean pixel value of a blob (see
+ * thermal_radiometry_roi_mean()).
+ *
+ * @param radiometry Radiometric conversion.
+ * @param blob Blob of thermal_blobs_detect() on the raw frame.
+ * @return the temperature in 1/100 K.
+ */
+uint16_t thermal_radiometry_blob_mean(const thermal_radiometry *radiometry, const thermal_blob *blob) {
+    if (blob->area == 0) {
+        return 0;
+    }
+
+    return thermal_radiometry_counts(radiometry, (blob->sum + blob->area / 2) / blob->area);
+}
+
+/**
+ * thermal_radiometry_blob_peak
+ *
+ * @param radiometry Radiometric conversion.
+ * @param blob Blob of thermal_blobs_detect() on the raw frame.
+ * @return the temperature of the hottest pixel of the blob in 1/100 K.
+ */
+uint16_t thermal_radiometry_blob_peak(const thermal_radiometry *radiometry, const thermal_blob *blob) {
+    return thermal_radiometry_counts(radiometry, blob->peak);
+}
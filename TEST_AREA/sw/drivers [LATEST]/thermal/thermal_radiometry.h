@@ -0,0 +1,49 @@
+#ifndef __THERMAL_RADIOMETRY_H__
+#define __THERMAL_RADIOMETRY_H__
+
+#include <stdint.h>
+
+#include "thermal.h"
+#include "thermal_blobs.h"
+#include "thermal_stats.h"
+
+/* Temperatures are in 1/100 Kelvin: 0 to 655.35 K */
+#define THERMAL_RADIOMETRY_CK_MAX (0xffff)
+
+/* Celsius from centi-Kelvin */
+#define THERMAL_RADIOMETRY_CK_TO_C(ck) (((ck) - 27315) / 100.0)
+
+/*
+ * Calibration of the camera: a pixel seeing a black body at T Kelvin gives
+ * counts = R / (exp(B / T) - F) + O (Planck curve of the sensor). The scene
+ * has an emissivity and reflects the radiation of its surroundings.
+ */
+typedef struct {
+    double planck_r;
+    double planck_b;
+    double planck_f;
+    double planck_o;
+    double emissivity;  /* 0 to 1 */
+    double reflected_k; /* Temperature of the surroundings */
+} thermal_radiometry_params;
+
+/* Conversion of the raw counts to temperatures, with a table of every count */
+typedef struct {
+    thermal_radiometry_params params;
+    uint16_t                  lut[THERMAL_PIXEL_MAX + 1];
+} thermal_radiometry;
+
+/*******************************************************************************
+ *  Public API
+ ******************************************************************************/
+
+void thermal_radiometry_default_params(thermal_radiometry_params *params);
+void thermal_radiometry_init(thermal_radiometry *radiometry, const thermal_radiometry_params *params);
+uint16_t thermal_radiometry_counts(const thermal_radiometry *radiometry, uint16_t counts);
+uint16_t thermal_radiometry_pixel(const thermal_radiometry *radiometry, const uint16_t *raw, uint16_t x, uint16_t y);
+void thermal_radiometry_frame(const thermal_radiometry *radiometry, const uint16_t *raw, uint16_t *centikelvin);
+uint16_t thermal_radiometry_roi_mean(const thermal_radiometry *radiometry, const thermal_sat *sat, const thermal_roi *roi);
+uint16_t thermal_radiometry_blob_mean(const thermal_radiometry *radiometry, const thermal_blob *blob);
+uint16_t thermal_radiometry_blob_peak(const thermal_radiometry *radiometry, const thermal_blob *blob);
+
+#endif /* __THERMAL_RADIOMETRY_H__ */
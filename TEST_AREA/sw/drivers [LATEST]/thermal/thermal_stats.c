@@ -0,0 +1,276 @@
+#include <string.h>
+
+#include "thermal_stats.h"
+
+#ifdef THERMAL_NEON
+#include <arm_neon.h>
+#endif
+
+/**
+ * thermal_stats_compute
+ *
+ * Computes all the statistics of a raw frame in a single pass over it.
+ *
+ * @param stats Statistics of the frame.
+ * @param raw Raw frame.
+ */
+void thermal_stats_compute(thermal_stats *stats, const uint16_t *raw) {
+    uint16_t min = raw[0];
+    uint16_t max = raw[0];
+    uint16_t min_index = 0;
+    uint16_t max_index = 0;
+    uint32_t sum = 0;
+    uint64_t sum_sq = 0;
+
+    uint16_t i = 0;
+
+#ifdef THERMAL_NEON
+    static const uint16_t first_indices[8] = {0, 1, 2, 3, 4, 5, 6, 7};
+
+    /*
+     * Each lane keeps the first minimum and maximum it sees and their
+     * indices. The sums of 600 vectors fit in 32-bit lanes, the sums of
+     * squares are accumulated in 64-bit lanes.
+     */
+    uint16x8_t indices = vld1q_u16(first_indices);
+    uint16x8_t step = vdupq_n_u16(8);
+    uint16x8_t vmin = vld1q_u16(raw);
+    uint16x8_t vmax = vmin;
+    uint16x8_t vmin_index = indices;
+    uint16x8_t vmax_index = indices;
+    uint32x4_t vsum = vdupq_n_u32(0);
+    uint64x2_t vsum_sq = vdupq_n_u64(0);
+
+    for (i = 0; i < THERMAL_FRAME_NUM_PIXELS; i += 8) {
+        uint16x8_t pixels = vld1q_u16(raw + i);
+
+        vmin_index = vbslq_u16(vcltq_u16(pixels, vmin), indices, vmin_index);
+        vmax_index = vbslq_u16(vcgtq_u16(pixels, vmax), indices, vmax_index);
+        vmin = vminq_u16(vmin, pixels);
+        vmax = vmaxq_u16(vmax, pixels);
+        indices = vaddq_u16(indices, step);
+
+        vsum = vpadalq_u16(vsum, pixels);
+        vsum_sq = vpadalq_u32(vsum_sq, vmull_u16(vget_low_u16(pixels), vget_low_u16(pixels)));
+        vsum_sq = vpadalq_u32(vsum_sq, vmull_u16(vget_high_u16(pixels), vget_high_u16(pixels)));
+    }
+
+    uint16_t lane_min[8], lane_max[8], lane_min_index[8], lane_max_index[8];
+    uint32_t lane_sum[4];
+    vst1q_u16(lane_min, vmin);
+    vst1q_u16(lane_max, vmax);
+    vst1q_u16(lane_min_index, vmin_index);
+    vst1q_u16(lane_max_index, vmax_index);
+    vst1q_u32(lane_sum, vsum);
+
+    /* Ties between lanes go to the first pixel, as in the scalar version */
+    min_index = lane_min_index[0];
+    max_index = lane_max_index[0];
+    min = lane_min[0];
+    max = lane_max[0];
+    for (i = 1; i < 8; ++i) {
+        if (lane_min[i] < min || (lane_min[i] == min && lane_min_index[i] < min_index)) {
+            min = lane_min[i];
+            min_index = lane_min_index[i];
+        }
+        if (lane_max[i] > max || (lane_max[i] == max && lane_max_index[i] < max_index)) {
+            max = lane_max[i];
+            max_index = lane_max_index[i];
+        }
+    }
+
+    sum = lane_sum[0] + lane_sum[1] + lane_sum[2] + lane_sum[3];
+    sum_sq = vgetq_lane_u64(vsum_sq, 0) + vgetq_lane_u64(vsum_sq, 1);
+#else
+    for (i = 0; i < THERMAL_FRAME_NUM_PIXELS; ++i) {
+        uint32_t pixel = raw[i];
+
+        if (pixel < min) {
+            min = pixel;
+            min_index = i;
+        }
+        if (pixel > max) {
+            max = pixel;
+            max_index = i;
+        }
+
+        sum += pixel;
+        sum_sq += pixel * pixel;
+    }
+#endif
+
+    stats->min = min;
+    stats->max = max;
+    stats->sum = sum;
+    stats->sum_sq = sum_sq;
+    stats->min_x = min_index % THERMAL_FRAME_WIDTH;
+    stats->min_y = min_index / THERMAL_FRAME_WIDTH;
+    stats->max_x = max_index % THERMAL_FRAME_WIDTH;
+    stats->max_y = max_index / THERMAL_FRAME_WIDTH;
+    stats->complete = true;
+}
+
+/**
+ * thermal_stats_from_hardware
+ *
+ * Fills the statistics computed by the lepton during the capture (see
+ * lepton_read_statistics()), without reading the frame. The sum of squares
+ * and the locations are not known: use thermal_stats_compute() for them.
+ *
+ * @param stats Statistics of the frame.
+ * @param min MIN register.
+ * @param max MAX register.
+ * @param sum SUM register.
+ */
+void thermal_stats_from_hardware(thermal_stats *stats, uint16_t min, uint16_t max, uint32_t sum) {
+    memset(stats, 0, sizeof(*stats));
+
+    stats->min = min;
+    stats->max = max;
+    stats->sum = sum;
+    stats->complete = false;
+}
+
+/**
+ * thermal_stats_mean
+ *
+ * @param stats Statistics of a frame.
+ * @return the mean pixel value.
+ */
+double thermal_stats_mean(const thermal_stats *stats) {
+    return (double) stats->sum / THERMAL_FRAME_NUM_PIXELS;
+}
+
+/**
+ * thermal_stats_variance
+ *
+ * @param stats Statistics of a frame (complete).
+ * @return the variance of the pixel values, 0 if the statistics are not
+ *         complete.
+ */
+double thermal_stats_variance(const thermal_stats *stats) {
+    if (!stats->complete) {
+        return 0;
+    }
+
+    double mean = thermal_stats_mean(stats);
+    return (double) stats->sum_sq / THERMAL_FRAME_NUM_PIXELS - mean * mean;
+}
+
+/**
+ * thermal_sat_build
+ *
+ * Builds the summed-area tables of a raw frame, after which the ROI queries
+ * cost 4 table reads each.
+ *
+ * @param sat Summed-area tables.
+ * @param raw Raw frame.
+ */
+void thermal_sat_build(thermal_sat *sat, const uint16_t *raw) {
+    memset(sat->sum[0], 0, sizeof(sat->sum[0]));
+    memset(sat->sum_sq[0], 0, sizeof(sat->sum_sq[0]));
+
+    uint16_t x = 0;
+    uint16_t y = 0;
+    for (y = 0; y < THERMAL_FRAME_HEIGHT; ++y) {
+        const uint16_t *row = raw + y * THERMAL_FRAME_WIDTH;
+        uint32_t row_sum = 0;
+        uint64_t row_sum_sq = 0;
+
+        sat->sum[y + 1][0] = 0;
+        sat->sum_sq[y + 1][0] = 0;
+
+        for (x = 0; x < THERMAL_FRAME_WIDTH; ++x) {
+            uint32_t pixel = row[x];
+            row_sum += pixel;
+            row_sum_sq += pixel * pixel;
+
+            sat->sum[y + 1][x + 1] = sat->sum[y][x + 1] + row_sum;
+            sat->sum_sq[y + 1][x + 1] = sat->sum_sq[y][x + 1] + row_sum_sq;
+        }
+    }
+}
+
+/*
+ * Clips a ROI to the frame. Returns false if nothing is left, otherwise the
+ * table coordinates of its top-left and bottom-right corners.
+ */
+static bool roi_clip(const thermal_roi *roi, uint16_t *x0, uint16_t *y0, uint16_t *x1, uint16_t *y1) {
+    if (roi->x >= THERMAL_FRAME_WIDTH || roi->y >= THERMAL_FRAME_HEIGHT || roi->width == 0 || roi->height == 0) {
+        return false;
+    }
+
+    *x0 = roi->x;
+    *y0 = roi->y;
+    *x1 = (roi->width > THERMAL_FRAME_WIDTH - roi->x) ? THERMAL_FRAME_WIDTH : roi->x + roi->width;
+    *y1 = (roi->height > THERMAL_FRAME_HEIGHT - roi->y) ? THERMAL_FRAME_HEIGHT : roi->y + roi->height;
+
+    return true;
+}
+
+/**
+ * thermal_sat_num_pixels
+ *
+ * @param roi Region of interest.
+ * @return the number of pixels of the ROI inside the frame.
+ */
+uint32_t thermal_sat_num_pixels(const thermal_roi *roi) {
+    uint16_t x0, y0, x1, y1;
+    if (!roi_clip(roi, &x0, &y0, &x1, &y1)) {
+        return 0;
+    }
+
+    return (uint32_t) (x1 - x0) * (y1 - y0);
+}
+
+/**
+ * thermal_sat_sum
+ *
+ * @param sat Summed-area tables of the frame.
+ * @param roi Region of interest.
+ * @return the sum of the pixels of the ROI.
+ */
+uint32_t thermal_sat_sum(const thermal_sat *sat, const thermal_roi *roi) {
+    uint16_t x0, y0, x1, y1;
+    if (!roi_clip(roi, &x0, &y0, &x1, &y1)) {
+        return 0;
+    }
+
+    return sat->sum[y1][x1] - sat->sum[y0][x1] - sat->sum[y1][x0] + sat->sum[y0][x0];
+}
+
+/**
+ * thermal_sat_mean
+ *
+ * @param sat Summed-area tables of the frame.
+ * @param roi Region of interest.
+ * @return the mean pixel value of the ROI, 0 if it is empty.
+ */
+double thermal_sat_mean(const thermal_sat *sat, const thermal_roi *roi) {
+    uint32_t num_pixels = thermal_sat_num_pixels(roi);
+    if (num_pixels == 0) {
+        return 0;
+    }
+
+    return (double) thermal_sat_sum(sat, roi) / num_pixels;
+}
+
+/**
+ * thermal_sat_variance
+ *
+ * @param sat Summed-area tables of the frame.
+ * @param roi Region of interest.
+ * @return the variance of the pixel values of the ROI, 0 if it is empty.
+ */
+double thermal_sat_variance(const thermal_sat *sat, const thermal_roi *roi) {
+    uint16_t x0, y0, x1, y1;
+    if (!roi_clip(roi, &x0, &y0, &x1, &y1)) {
+        return 0;
+    }
+
+    uint32_t num_pixels = (uint32_t) (x1 - x0) * (y1 - y0);
+    uint64_t sum_sq = sat->sum_sq[y1][x1] - sat->sum_sq[y0][x1] - sat->sum_sq[y1][x0] + sat->sum_sq[y0][x0];
+    double mean = thermal_sat_mean(sat, roi);
+
+    return (double) sum_sq / num_pixels - mean * mean;
+}
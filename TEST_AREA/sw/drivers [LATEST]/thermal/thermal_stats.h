@@ -0,0 +1,54 @@
+#ifndef __THERMAL_STATS_H__
+#define __THERMAL_STATS_H__
+
+#include <stdbool.h>
+#include <stdint.h>
+
+#include "thermal.h"
+
+/* Statistics of a frame */
+typedef struct {
+    uint16_t min;
+    uint16_t max;
+    uint32_t sum;
+    uint64_t sum_sq;   /* Sum of the squared pixel values */
+    uint16_t min_x;    /* Coldest pixel (first one in row-major order) */
+    uint16_t min_y;
+    uint16_t max_x;    /* Hottest pixel (first one in row-major order) */
+    uint16_t max_y;
+    bool     complete; /* false: only min, max and sum are known */
+} thermal_stats;
+
+/* Rectangular region of interest, clipped to the frame by the queries */
+typedef struct {
+    uint16_t x;
+    uint16_t y;
+    uint16_t width;
+    uint16_t height;
+} thermal_roi;
+
+/*
+ * Summed-area tables of a frame: element (y, x) is the sum of the pixels (or
+ * of their squares) above and left of pixel (y, x). Row and column 0 are 0.
+ */
+typedef struct {
+    uint32_t sum[THERMAL_FRAME_HEIGHT + 1][THERMAL_FRAME_WIDTH + 1];
+    uint64_t sum_sq[THERMAL_FRAME_HEIGHT + 1][THERMAL_FRAME_WIDTH + 1];
+} thermal_sat;
+
+/*******************************************************************************
+ *  Public API
+ ******************************************************************************/
+
+void thermal_stats_compute(thermal_stats *stats, const uint16_t *raw);
+void thermal_stats_from_hardware(thermal_stats *stats, uint16_t min, uint16_t max, uint32_t sum);
+double thermal_stats_mean(const thermal_stats *stats);
+double thermal_stats_variance(const thermal_stats *stats);
+
+void thermal_sat_build(thermal_sat *sat, const uint16_t *raw);
+uint32_t thermal_sat_num_pixels(const thermal_roi *roi);
+uint32_t thermal_sat_sum(const thermal_sat *sat, const thermal_roi *roi);
+double thermal_sat_mean(const thermal_sat *sat, const thermal_roi *roi);
+double thermal_sat_variance(const thermal_sat *sat, const thermal_roi *roi);
+
+#endif /* __THERMAL_STATS_H__ */
@@ -0,0 +1,296 @@
+#include <math.h>
+#include <string.h>
+
+#include "thermal_track.h"
+
+/* Centre of the frame (Q8): pixel x covers [x - 0.5, x + 0.5] */
+#define CENTER_X ((THERMAL_FRAME_WIDTH - 1) * 128)
+#define CENTER_Y ((THERMAL_FRAME_HEIGHT - 1) * 128)
+
+static void axis_init(thermal_track_axis *axis, uint32_t min_duty_us, uint32_t max_duty_us) {
+    memset(axis, 0, sizeof(*axis));
+
+    axis->min_duty_us = min_duty_us;
+    axis->max_duty_us = max_duty_us;
+    axis->sign = 1;
+    axis->duty = THERMAL_TRACK_Q8((min_duty_us + max_duty_us) / 2);
+    axis->target = axis->duty;
+}
+
+/**
+ * thermal_track_init
+ *
+ * Initializes the tracker with the servos centred and the default settings:
+ * 7 us of duty cycle per pixel (51 degrees over 80 pixels, 90 degrees per
+ * 1000 us), kp = 0.25, ki = 0.75, a latency of 125 ms (one lepton frame at
+ * 9 Hz and half a servo period), and hot spots at least 200 counts above the
+ * mean of the frame.
+ *
+ * @param track Tracker.
+ * @param h_min_duty_us Minimum duty cycle of the horizontal servo.
+ * @param h_max_duty_us Maximum duty cycle of the horizontal servo.
+ * @param v_min_duty_us Minimum duty cycle of the vertical servo.
+ * @param v_max_duty_us Maximum duty cycle of the vertical servo.
+ */
+void thermal_track_init(thermal_track *track, uint32_t h_min_duty_us, uint32_t h_max_duty_us,
+                        uint32_t v_min_duty_us, uint32_t v_max_duty_us) {
+    memset(track, 0, sizeof(*track));
+
+    axis_init(&track->h, h_min_duty_us, h_max_duty_us);
+    axis_init(&track->v, v_min_duty_us, v_max_duty_us);
+
+    thermal_track_set_optics(track, 7.0, 1, 1);
+    thermal_track_set_gains(track, 0.25, 0.75);
+    thermal_track_set_latency(track, 125000);
+
+    track->alpha = THERMAL_TRACK_Q8(0.8);
+    track->beta = THERMAL_TRACK_Q8(0.4);
+    track->min_contrast = 200;
+    track->window = 8;
+}
+
+/**
+ * thermal_track_set_gains
+ *
+ * Sets the gains of the PI controller. The error is the difference between
+ * the predicted position of the hot spot and the current command; every
+ * frame, the command moves by kp * (error - previous error) + ki * error.
+ *
+ * @param track Tracker.
+ * @param kp Proportional gain.
+ * @param ki Integral gain (0 to 1, 1 moves to the predicted position at
+ *           once).
+ */
+void thermal_track_set_gains(thermal_track *track, double kp, double ki) {
+    track->kp = THERMAL_TRACK_Q8(kp);
+    track->ki = THERMAL_TRACK_Q8(ki);
+}
+
+/**
+ * thermal_track_set_optics
+ *
+ * Sets how the image moves with the servos.
+ *
+ * @param track Tracker.
+ * @param us_per_px Duty cycle change moving the image by one pixel.
+ * @param h_sign 1 if a larger horizontal duty cycle moves the image to the
+ *               left, -1 if to the right.
+ * @param v_sign 1 if a larger vertical duty cycle moves the image up, -1 if
+ *               down.
+ */
+void thermal_track_set_optics(thermal_track *track, double us_per_px, int32_t h_sign, int32_t v_sign) {
+    track->us_per_px = THERMAL_TRACK_Q8(us_per_px);
+    track->h.sign = (h_sign < 0) ? -1 : 1;
+    track->v.sign = (v_sign < 0) ? -1 : 1;
+}
+
+/**
+ * thermal_track_set_latency
+ *
+ * Sets how far ahead the position of the hot spot is predicted: the time
+ * from the capture of a frame to the servos reaching the command computed
+ * from it.
+ *
+ * @param track Tracker.
+ * @param latency_us Latency in microseconds.
+ */
+void thermal_track_set_latency(thermal_track *track, uint32_t latency_us) {
+    track->latency_us = latency_us;
+}
+
+/**
+ * thermal_track_set_position
+ *
+ * Sets the current servo commands, when the servos were moved by something
+ * else than the tracker (e.g. manually). The filters restart at the next
+ * frame.
+ *
+ * @param track Tracker.
+ * @param h_duty_us Command of the horizontal servo.
+ * @param v_duty_us Command of the vertical servo.
+ */
+void thermal_track_set_position(thermal_track *track, uint32_t h_duty_us, uint32_t v_duty_us) {
+    track->h.duty = THERMAL_TRACK_Q8(h_duty_us);
+    track->v.duty = THERMAL_TRACK_Q8(v_duty_us);
+    track->locked = false;
+}
+
+/*
+ * Finds the hot spot: the centroid of the pixels halfway between the mean and
+ * the maximum, in a window around the hottest pixel, weighted by how much
+ * they are above that threshold.
+ */
+static bool hot_spot(thermal_track *track, const uint16_t *raw) {
+    thermal_stats *stats = &track->stats;
+    thermal_stats_compute(stats, raw);
+
+    uint16_t mean = stats->sum / THERMAL_FRAME_NUM_PIXELS;
+    if (stats->max < mean + track->min_contrast) {
+        return false;
+    }
+
+    uint16_t threshold = mean + (stats->max - mean) / 2;
+
+    int32_t x0 = (stats->max_x > track->window) ? stats->max_x - track->window : 0;
+    int32_t y0 = (stats->max_y > track->window) ? stats->max_y - track->window : 0;
+    int32_t x1 = (stats->max_x + track->window < THERMAL_FRAME_WIDTH) ? stats->max_x + track->window : THERMAL_FRAME_WIDTH - 1;
+    int32_t y1 = (stats->max_y + track->window < THERMAL_FRAME_HEIGHT) ? stats->max_y + track->window : THERMAL_FRAME_HEIGHT - 1;
+
+    uint64_t sum_w = 0;
+    uint64_t sum_wx = 0;
+    uint64_t sum_wy = 0;
+
+    int32_t x = 0;
+    int32_t y = 0;
+    for (y = y0; y <= y1; ++y) {
+        const uint16_t *row = raw + y * THERMAL_FRAME_WIDTH;
+        for (x = x0; x <= x1; ++x) {
+            if (row[x] > threshold) {
+                uint32_t w = row[x] - threshold;
+                sum_w += w;
+                sum_wx += w * x;
+                sum_wy += w * y;
+            }
+        }
+    }
+
+    /* A flat frame (max == mean, allowed by min_contrast 0) has no weight */
+    if (sum_w == 0) {
+        return false;
+    }
+
+    track->centroid_x = (sum_wx * 256 + sum_w / 2) / sum_w;
+    track->centroid_y = (sum_wy * 256 + sum_w / 2) / sum_w;
+
+    return true;
+}
+
+/*
+ * One axis: alpha-beta filter of the duty cycle centring the hot spot,
+ * prediction over the latency, then PI controller with anti-windup.
+ */
+static void axis_update(thermal_track *track, thermal_track_axis *axis, int32_t offset, int64_t dt_us) {
+    /* The frame was captured with the last command. */
+    int32_t measured = axis->duty + axis->sign * (int32_t) (((int64_t) offset * track->us_per_px) >> 8);
+
+    if (!track->locked || dt_us <= 0) {
+        axis->target = measured;
+        axis->velocity = 0;
+        axis->error = 0;
+    } else {
+        int32_t predicted = axis->target + (int32_t) ((int64_t) axis->velocity * dt_us / 1000000);
+        int32_t residual = measured - predicted;
+
+        axis->target = predicted + (int32_t) (((int64_t) track->alpha * residual) >> 8);
+        axis->velocity += (int32_t) ((((int64_t) track->beta * residual) >> 8) * 1000000 / dt_us);
+    }
+
+    int32_t aim = axis->target + (int32_t) ((int64_t) axis->velocity * track->latency_us / 1000000);
+    int32_t error = aim - axis->duty;
+
+    /*
+     * PI controller in velocity form: the command is the sum of its updates,
+     * so clipping it to the servo range is the anti-windup.
+     */
+    int64_t command = axis->duty + ((track->kp * (int64_t) (error - axis->error) + track->ki * (int64_t) error) >> 8);
+    axis->error = error;
+
+    if (command < THERMAL_TRACK_Q8(axis->min_duty_us)) {
+        command = THERMAL_TRACK_Q8(axis->min_duty_us);
+    } else if (command > THERMAL_TRACK_Q8(axis->max_duty_us)) {
+        command = THERMAL_TRACK_Q8(axis->max_duty_us);
+    }
+
+    axis->duty = command;
+}
+
+/**
+ * thermal_track_update
+ *
+ * Processes a frame: finds its hot spot and updates the servo commands (see
+ * thermal_track_h_duty() and thermal_track_v_duty()). Without a hot spot, the
+ * commands do not change and the filters restart at the next hot spot.
+ *
+ * @param track Tracker.
+ * @param raw Raw frame.
+ * @param time_us Time of the capture of the frame, in microseconds.
+ * @return true if a hot spot was found.
+ */
+bool thermal_track_update(thermal_track *track, const uint16_t *raw, uint64_t time_us) {
+    int64_t dt_us = time_us - track->last_time_us;
+    track->last_time_us = time_us;
+    track->num_frames++;
+
+    if (!hot_spot(track, raw)) {
+        track->locked = false;
+        return false;
+    }
+
+    int32_t dx = track->centroid_x - CENTER_X;
+    int32_t dy = track->centroid_y - CENTER_Y;
+
+    axis_update(track, &track->h, dx, dt_us);
+    axis_update(track, &track->v, dy, dt_us);
+    track->locked = true;
+
+    uint64_t error_sq = (int64_t) dx * dx + (int64_t) dy * dy;
+    int32_t error = (int32_t) sqrt((double) error_sq);
+
+    track->num_tracked++;
+    track->error_sq_sum += error_sq;
+    if (error > track->max_error) {
+        track->max_error = error;
+    }
+
+    return true;
+}
+
+/**
+ * thermal_track_h_duty
+ *
+ * @param track Tracker.
+ * @return the command of the horizontal servo, in microseconds.
+ */
+uint32_t thermal_track_h_duty(thermal_track *track) {
+    return (track->h.duty + 128) >> 8;
+}
+
+/**
+ * thermal_track_v_duty
+ *
+ * @param track Tracker.
+ * @return the command of the vertical servo, in microseconds.
+ */
+uint32_t thermal_track_v_duty(thermal_track *track) {
+    return (track->v.duty + 128) >> 8;
+}
+
+/**
+ * thermal_track_rms_error
+ *
+ * @param track Tracker.
+ * @return the RMS distance in pixels between the hot spot and the centre of
+ *         the frame, over the frames with a hot spot since the last
+ *         thermal_track_reset_stats().
+ */
+double thermal_track_rms_error(thermal_track *track) {
+    if (track->num_tracked == 0) {
+        return 0;
+    }
+
+    return sqrt((double) track->error_sq_sum / track->num_tracked) / 256;
+}
+
+/**
+ * thermal_track_reset_stats
+ *
+ * Restarts the tracking statistics (frames, RMS and maximum error).
+ *
+ * @param track Tracker.
+ */
+void thermal_track_reset_stats(thermal_track *track) {
+    track->num_frames = 0;
+    track->num_tracked = 0;
+    track->error_sq_sum = 0;
+    track->max_error = 0;
+}
@@ -0,0 +1,73 @@
+#ifndef __THERMAL_TRACK_H__
+#define __THERMAL_TRACK_H__
+
+#include <stdbool.h>
+#include <stdint.h>
+
+#include "thermal.h"
+#include "thermal_stats.h"
+
+/*
+ * Fixed-point values: Q8 (value * 256) in int32_t. Positions are in pixels,
+ * servo positions in microseconds of duty cycle.
+ */
+#define THERMAL_TRACK_Q8(x) ((int32_t) ((x) * 256))
+
+/* One servo axis of the tracker */
+typedef struct {
+    int32_t min_duty_us;
+    int32_t max_duty_us;
+    int32_t sign;     /* +1 if a larger duty cycle moves the image towards lower x (or y), -1 otherwise */
+    int32_t duty;     /* Q8, last command */
+    int32_t target;   /* Q8, filtered duty cycle centring the hot spot */
+    int32_t velocity; /* Q8, of the target, in us of duty cycle per second */
+    int32_t error;    /* Q8, last error of the controller */
+} thermal_track_axis;
+
+/*
+ * Hot-spot tracker: finds the hot spot of each frame and computes the servo
+ * commands centring it.
+ */
+typedef struct {
+    /* Settings (Q8) */
+    int32_t  us_per_px;    /* Duty cycle change moving the image by one pixel */
+    int32_t  kp;           /* PI controller */
+    int32_t  ki;
+    int32_t  alpha;        /* Alpha-beta filter of the target position */
+    int32_t  beta;
+    uint32_t latency_us;   /* From the capture of a frame to the servos reaching its command */
+    uint16_t min_contrast; /* Hot spot: at least this much above the mean of the frame */
+    uint16_t window;       /* Hot spot: half size of the centroid window around the hottest pixel */
+
+    thermal_track_axis h;
+    thermal_track_axis v;
+    bool               locked;       /* A hot spot was found in the last frame */
+    uint64_t           last_time_us;
+    thermal_stats      stats;        /* Of the last frame */
+    int32_t            centroid_x;   /* Q8, hot spot of the last frame */
+    int32_t            centroid_y;
+
+    /* Tracking statistics */
+    uint32_t num_frames;
+    uint32_t num_tracked;
+    uint64_t error_sq_sum; /* Q16, of the distance between the hot spot and the centre */
+    int32_t  max_error;    /* Q8 */
+} thermal_track;
+
+/*******************************************************************************
+ *  Public API
+ ******************************************************************************/
+
+void thermal_track_init(thermal_track *track, uint32_t h_min_duty_us, uint32_t h_max_duty_us,
+                        uint32_t v_min_duty_us, uint32_t v_max_duty_us);
+void thermal_track_set_gains(thermal_track *track, double kp, double ki);
+void thermal_track_set_optics(thermal_track *track, double us_per_px, int32_t h_sign, int32_t v_sign);
+void thermal_track_set_latency(thermal_track *track, uint32_t latency_us);
+void thermal_track_set_position(thermal_track *track, uint32_t h_duty_us, uint32_t v_duty_us);
+bool thermal_track_update(thermal_track *track, const uint16_t *raw, uint64_t time_us);
+uint32_t thermal_track_h_duty(thermal_track *track);
+uint32_t thermal_track_v_duty(thermal_track *track);
+double thermal_track_rms_error(thermal_track *track);
+void thermal_track_reset_stats(thermal_track *track);
+
+#endif /* __THERMAL_TRACK_H__ */
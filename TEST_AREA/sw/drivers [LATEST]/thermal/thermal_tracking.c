@@ -0,0 +1,248 @@
+/**
+ * @brief Points the pan-tilt at the hottest spot seen by the lepton.
+ *
+ * Manual mode: the LEFT joystick steers the servos (as handle_pantilt() of the
+ * lab applications). Push the RIGHT joystick to the right to start tracking,
+ * to the left to go back to manual mode.
+ *
+ * Tracking mode: every lepton frame is read as soon as it is complete, its
+ * hot spot is found and the servos are commanded by the PI controller of
+ * thermal_track, then the frame is released. Every REPORT_PERIOD_S seconds,
+ * prints the achieved tracking rate, the tracking error and the latency from
+ * FRAME_READY to the servo command against LATENCY_BUDGET_US. FRAME_READY is
+ * polled every TRACKING_POLL_NS, and the latency is counted from the last
+ * poll that didn't see it (it overestimates by up to one poll period).
+ *
+ * Generate the hps_0.h of the system in this directory
+ * (sopc-create-header-files), then: make thermal_tracking
+ *
+ * Usage: thermal_tracking
+ */
+
+#include <assert.h>
+#include <fcntl.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <sys/mman.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "hps_0.h" // MIGHT NEED TO BE REPLACED IF THE HARDWARE IS MODIFIED
+#include "joysticks/joysticks.h"
+#include "lepton/lepton.h"
+#include "pantilt/pantilt.h"
+#include "thermal.h"
+#include "thermal_track.h"
+
+#define HPS_LH2F_BRIDGE_BASE 0xff200000
+#define HPS_LH2F_BRIDGE_SPAN 0x00200000
+
+#define SLEEP_DURATION_NS (1000000)
+#define TRACKING_POLL_NS  (50000)
+
+/* Servos */
+#define PANTILT_PWM_V_CENTER_DUTY_CYCLE_US ((PANTILT_PWM_V_MIN_DUTY_CYCLE_US + PANTILT_PWM_V_MAX_DUTY_CYCLE_US) / 2)
+#define PANTILT_PWM_H_CENTER_DUTY_CYCLE_US ((PANTILT_PWM_H_MIN_DUTY_CYCLE_US + PANTILT_PWM_H_MAX_DUTY_CYCLE_US) / 2)
+
+/* Right joystick horizontal thresholds to enter and leave the tracking mode */
+#define TRACKING_ON_THRESHOLD  ((uint32_t) (0.8 * JOYSTICKS_MAX_VALUE))
+#define TRACKING_OFF_THRESHOLD ((uint32_t) (0.2 * JOYSTICKS_MAX_VALUE))
+
+/*
+ * End-to-end latency: the lepton sends a frame over one frame period, the
+ * software then has LATENCY_BUDGET_US to command the servos, which apply the
+ * command at the end of their current period (half of it on average). The
+ * tracker predicts the hot spot over this total.
+ */
+#define LEPTON_FRAME_PERIOD_US (1000000 / 9)
+#define LATENCY_BUDGET_US      (10000)
+#define SERVO_LATENCY_US       (PANTILT_PWM_PERIOD_US / 2)
+
+#define REPORT_PERIOD_S (5)
+
+static uint16_t frame[THERMAL_FRAME_NUM_PIXELS];
+static thermal_track track;
+
+static uint64_t now_us(void) {
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+
+    return (uint64_t) now.tv_sec * 1000000 + now.tv_nsec / 1000;
+}
+
+static uint32_t interpolate(uint32_t input,
+                            uint32_t input_lower_bound,
+                            uint32_t input_upper_bound,
+                            uint32_t output_lower_bound,
+                            uint32_t output_upper_bound) {
+    double slope = 1.0 * (output_upper_bound - output_lower_bound) / (input_upper_bound - input_lower_bound);
+    return output_lower_bound + (uint32_t) (slope * (input - input_lower_bound));
+}
+
+static void handle_pantilt(pantilt_dev *pantilt, joysticks_dev *joysticks) {
+    uint32_t pantilt_v_duty_us = interpolate(joysticks_read_left_vertical(joysticks),
+                                             JOYSTICKS_MIN_VALUE,
+                                             JOYSTICKS_MAX_VALUE,
+                                             PANTILT_PWM_V_MIN_DUTY_CYCLE_US,
+                                             PANTILT_PWM_V_MAX_DUTY_CYCLE_US);
+    uint32_t pantilt_h_duty_us = interpolate(joysticks_read_left_horizontal(joysticks),
+                                             JOYSTICKS_MIN_VALUE,
+                                             JOYSTICKS_MAX_VALUE,
+                                             PANTILT_PWM_H_MIN_DUTY_CYCLE_US,
+                                             PANTILT_PWM_H_MAX_DUTY_CYCLE_US);
+
+    pantilt_configure_vertical(pantilt, pantilt_v_duty_us);
+    pantilt_configure_horizontal(pantilt, pantilt_h_duty_us);
+
+    /* Tracking starts from the manual position */
+    thermal_track_set_position(&track, pantilt_h_duty_us, pantilt_v_duty_us);
+}
+
+/* Latency statistics of the tracking mode */
+typedef struct {
+    uint32_t num_frames;
+    uint64_t latency_sum_us;
+    uint32_t latency_max_us;
+    uint32_t over_budget;
+    uint64_t start_us;
+    uint64_t not_ready_us; /* Last poll without FRAME_READY */
+} latency_stats;
+
+static void latency_stats_reset(latency_stats *stats) {
+    stats->num_frames = 0;
+    stats->latency_sum_us = 0;
+    stats->latency_max_us = 0;
+    stats->over_budget = 0;
+    stats->start_us = now_us();
+    stats->not_ready_us = stats->start_us;
+}
+
+static void report(latency_stats *stats, lepton_dev *lepton) {
+    double elapsed_s = (now_us() - stats->start_us) / 1e6;
+    uint32_t latency_avg_us = (stats->num_frames > 0) ? stats->latency_sum_us / stats->num_frames : 0;
+
+    printf("tracking: %.1f frames/s (%.1f with a hot spot), error %.2f px RMS, %.2f px max\n",
+           stats->num_frames / elapsed_s, track.num_tracked / elapsed_s,
+           thermal_track_rms_error(&track), track.max_error / 256.0);
+    printf("          latency %u us avg, %u us max, %u frames over the %u us budget, %u dropped\n",
+           latency_avg_us, stats->latency_max_us, stats->over_budget, LATENCY_BUDGET_US,
+           lepton_dropped_frames(lepton));
+    printf("          end to end %u us (prediction horizon)\n", track.latency_us);
+
+    /* Predict over what was actually achieved */
+    thermal_track_set_latency(&track, LEPTON_FRAME_PERIOD_US + latency_avg_us + SERVO_LATENCY_US);
+
+    thermal_track_reset_stats(&track);
+    latency_stats_reset(stats);
+}
+
+static void handle_tracking(pantilt_dev *pantilt, lepton_dev *lepton, latency_stats *stats) {
+    uint64_t poll_us = now_us();
+    if (!lepton_frame_ready(lepton)) {
+        stats->not_ready_us = poll_us;
+        return;
+    }
+
+    /* FRAME_READY was set after the last poll that didn't see it */
+    uint64_t ready_us = stats->not_ready_us;
+
+    lepton_acquire_frame(lepton);
+    if (lepton_error_check(lepton)) {
+        lepton_release_frame(lepton);
+        stats->not_ready_us = now_us();
+        return;
+    }
+    lepton_read_capture(lepton, false, frame);
+
+    if (thermal_track_update(&track, frame, ready_us)) {
+        pantilt_configure_horizontal(pantilt, thermal_track_h_duty(&track));
+        pantilt_configure_vertical(pantilt, thermal_track_v_duty(&track));
+    }
+
+    /* Let the device show every frame again until the next one is ready */
+    lepton_release_frame(lepton);
+
+    uint64_t done_us = now_us();
+    stats->not_ready_us = done_us;
+
+    uint32_t latency_us = done_us - ready_us;
+    stats->num_frames++;
+    stats->latency_sum_us += latency_us;
+    if (latency_us > stats->latency_max_us) {
+        stats->latency_max_us = latency_us;
+    }
+    if (latency_us > LATENCY_BUDGET_US) {
+        stats->over_budget++;
+    }
+
+    if (ready_us - stats->start_us >= REPORT_PERIOD_S * 1000000ull) {
+        report(stats, lepton);
+    }
+}
+
+int main(void) {
+    int mem_fd = open("/dev/mem", O_RDWR | O_SYNC);
+    assert(mem_fd >= 0);
+    void *lh2fbridge = mmap(NULL, HPS_LH2F_BRIDGE_SPAN, PROT_READ | PROT_WRITE, MAP_SHARED, mem_fd, HPS_LH2F_BRIDGE_BASE);
+    assert(lh2fbridge != MAP_FAILED);
+
+    pantilt_dev pantilt = pantilt_inst(lh2fbridge + PWM_0_BASE, lh2fbridge + PWM_1_BASE);
+    joysticks_dev joysticks = joysticks_inst(lh2fbridge + MCP3204_0_BASE);
+    lepton_dev lepton = lepton_inst(lh2fbridge + LEPTON_0_BASE);
+
+    pantilt_init(&pantilt);
+    joysticks_init(&joysticks);
+    lepton_init(&lepton);
+
+    thermal_track_init(&track, PANTILT_PWM_H_MIN_DUTY_CYCLE_US, PANTILT_PWM_H_MAX_DUTY_CYCLE_US,
+                       PANTILT_PWM_V_MIN_DUTY_CYCLE_US, PANTILT_PWM_V_MAX_DUTY_CYCLE_US);
+    thermal_track_set_latency(&track, LEPTON_FRAME_PERIOD_US + LATENCY_BUDGET_US + SERVO_LATENCY_US);
+
+    pantilt_configure_vertical(&pantilt, PANTILT_PWM_V_CENTER_DUTY_CYCLE_US);
+    pantilt_configure_horizontal(&pantilt, PANTILT_PWM_H_CENTER_DUTY_CYCLE_US);
+    pantilt_start_vertical(&pantilt);
+    pantilt_start_horizontal(&pantilt);
+
+    lepton_start_continuous(&lepton);
+
+    bool tracking = false;
+    latency_stats stats;
+
+    while (true) {
+        uint32_t right_joystick_h = joysticks_read_right_horizontal(&joysticks);
+
+        if (!tracking && right_joystick_h > TRACKING_ON_THRESHOLD) {
+            printf("Tracking mode\n");
+            tracking = true;
+            thermal_track_reset_stats(&track);
+            latency_stats_reset(&stats);
+        } else if (tracking && right_joystick_h < TRACKING_OFF_THRESHOLD) {
+            printf("Manual mode\n");
+            tracking = false;
+        }
+
+        if (tracking) {
+            handle_tracking(&pantilt, &lepton, &stats);
+        } else {
+            handle_pantilt(&pantilt, &joysticks);
+        }
+
+        /*
+         * A lepton frame every 111 ms: poll every millisecond, and closely
+         * enough not to eat the latency budget when tracking.
+         */
+        struct timespec requested_time;
+        struct timespec remaining_time;
+        requested_time.tv_sec = 0;
+        requested_time.tv_nsec = tracking ? TRACKING_POLL_NS : SLEEP_DURATION_NS;
+        nanosleep(&requested_time, &remaining_time);
+    }
+
+    lepton_stop_capture(&lepton);
+    munmap(lh2fbridge, HPS_LH2F_BRIDGE_SPAN);
+    close(mem_fd);
+
+    return EXIT_SUCCESS;
+}
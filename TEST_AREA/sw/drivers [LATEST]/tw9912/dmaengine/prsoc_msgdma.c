@@ -0,0 +1,1045 @@
+/*
+ * @file prsoc_msgdma
+ * @date 19 Oct 2026
+ * @brief Linux dmaengine driver for the Altera mSGDMA (standard descriptors).
+ *
+ * msgdma.c is a port of the Altera HAL: on Linux its irq() handler is never
+ * hooked and every user ends up polling the CSR. This driver exposes an
+ * mSGDMA instance as a dmaengine provider with a single channel instead, so
+ * that other drivers (framebuffer, video capture, lepton, ...) can share it
+ * through the standard API:
+ *   - dmaengine_prep_dma_memcpy()  (memory-mapped to memory-mapped mode)
+ *   - dmaengine_prep_slave_sg()    (any mode, see below)
+ *   - dmaengine_prep_dma_cyclic()  (any mode, one hardware descriptor per period)
+ *
+ * The direction that can be served depends on the DMA mode the core was
+ * generated with in Qsys (DMA_MODE in hps_0.h), which is given by the
+ * 'prsoc,dma-mode' property of the device tree:
+ *   0: memory-mapped to memory-mapped -> memcpy, DEV_TO_MEM, MEM_TO_DEV
+ *   1: memory-mapped to streaming     -> MEM_TO_DEV
+ *   2: streaming to memory-mapped     -> DEV_TO_MEM
+ * In mode 0, the "device" of a slave transfer is an Avalon slave seen by the
+ * read (or write) master at the address given in dma_slave_config. Its
+ * address is incremented like a memory (e.g. the lepton's frame buffer). In
+ * modes 1 and 2, the device side is the streaming interface of the core.
+ *
+ * Descriptor prefetch
+ * -------------------
+ * The dispatcher has a descriptor FIFO ('prsoc,descriptor-fifo-depth'
+ * entries). Each transfer is split into hardware descriptors of at most
+ * 'prsoc,max-transfer-size' bytes, and as many descriptors as the FIFO can
+ * hold are written ahead, across transfer boundaries. The FIFO is refilled
+ * on completion (see below), so the masters only wait on the CPU between two
+ * descriptors when the whole FIFO has drained.
+ *
+ * Completion
+ * ----------
+ * The core of the PrSoC system has no response port (RESPONSE_PORT 2), so
+ * the driver cannot read which descriptor completed. Instead it knows how
+ * many descriptors it wrote and derives how many are still outstanding from
+ * the fill level of the last master of the chain and the busy bit:
+ *   outstanding <= fill level + (busy ? 1 : 0)
+ * This bound never reports an unfinished descriptor as done. To guarantee
+ * that an interrupt always follows the last outstanding descriptor, the
+ * "transfer complete" IRQ is requested on the last descriptor of each
+ * refill batch and of each period of a cyclic transfer. It is also requested
+ * on the last descriptor of each transfer prepared with DMA_PREP_INTERRUPT,
+ * so that its callback doesn't wait for the rest of the batch. A
+ * transfer prepared without it (e.g. the fbdev acceleration, which polls)
+ * only completes with the interrupt of a later descriptor: at the latest
+ * when the batch it was pushed with drains.
+ *
+ * Completed transfers get their cookie completed in the interrupt handler
+ * and their callback called from a tasklet. Polling dmaengine_tx_status()
+ * also retires the completed descriptors, so that a client may busy-wait on
+ * a transfer with interrupts disabled.
+ *
+ * The busy bit may still be set for a while when the interrupt of the last
+ * descriptor comes, which then looks outstanding. The interrupt handler
+ * waits up to MSGDMA_BUSY_SETTLE_US for it to fall; if a single descriptor
+ * is still in flight after that, the poll timer below re-checks it every
+ * MSGDMA_POLL_PERIOD_US until it is retired (or other descriptors are
+ * pushed, whose interrupt will come).
+ *
+ * The 'interrupts' property is optional: the Qsys system of the video
+ * capture does not connect the IRQ of the core to the HPS. Without it, a
+ * timer does the work of the interrupt handler every MSGDMA_POLL_PERIOD_US
+ * while descriptors are in flight, so the FIFO only stays empty for up to
+ * one poll period, and the callbacks come up to one poll period late.
+ *
+ * Residue
+ * -------
+ * dmaengine_tx_status() reports the bytes of the hardware descriptors of a
+ * transfer that are not known to be complete (DMA_RESIDUE_GRANULARITY_SEGMENT,
+ * each hardware descriptor being at most 'prsoc,max-transfer-size' bytes).
+ * For a cyclic transfer, it is the residue of the current pass.
+ *
+ * Termination
+ * -----------
+ * dmaengine_terminate_*() resets the core and drops every transfer, whose
+ * cookies are completed without calling their callback so that nobody
+ * waits on them forever. dmaengine_synchronize() waits for the callbacks
+ * that were already running.
+ *
+ *   msgdma0: dma-controller@ff2000e0 {
+ *     compatible = "prsoc,msgdma";
+ *     reg = <0xff2000e0 0x20     // CSR
+ *            0xff200100 0x10>;   // descriptor slave
+ *     interrupts = <GIC_SPI 41 IRQ_TYPE_LEVEL_HIGH>;  // optional
+ *     #dma-cells = <1>;          // always 0: single channel
+ *     prsoc,dma-mode = <2>;
+ *     prsoc,descriptor-fifo-depth = <128>;
+ *     prsoc,max-transfer-size = <16777215>;
+ *   };
+ *
+ * Revisions:
+ *  10/19/2026 Created
+ *  10/19/2026 Poll the hardware from tx_status
+ *  10/19/2026 Optional IRQ, synchronize, residue, reset outside the lock
+ *  10/19/2026 IRQ at the end of DMA_PREP_INTERRUPT transfers, busy bit fallback
+ */
+
+#include <linux/module.h>
+#include <linux/kernel.h>
+#include <linux/io.h>
+#include <linux/delay.h>
+#include <linux/slab.h>
+#include <linux/list.h>
+#include <linux/spinlock.h>
+#include <linux/interrupt.h>
+#include <linux/hrtimer.h>
+#include <linux/platform_device.h>
+#include <linux/of_device.h>
+#include <linux/of_dma.h>
+#include <linux/dmaengine.h>
+#include <linux/dma-mapping.h>
+#include <linux/scatterlist.h>
+#include <linux/types.h>
+
+/* Cookie helpers, private to drivers/dma (see the Makefile). */
+#include "dmaengine.h"
+
+#include "../msgdma_csr_regs.h"
+#include "../msgdma_descriptor_regs.h"
+
+#define MSGDMA_MODE_MM_TO_MM 0
+#define MSGDMA_MODE_MM_TO_ST 1
+#define MSGDMA_MODE_ST_TO_MM 2
+
+#define MSGDMA_DEFAULT_FIFO_DEPTH    128
+#define MSGDMA_DEFAULT_MAX_TRANSFER  ((1 << 24) - 1)
+#define MSGDMA_ALIGN                 4 /* DATA_WIDTH 32, aligned accesses */
+
+/* Time the interrupt handler waits for the busy bit to fall after the last
+ * descriptor completed, before leaving it to the poll timer. */
+#define MSGDMA_BUSY_SETTLE_US        2
+
+/* Time the reset may take. */
+#define MSGDMA_RESET_TIMEOUT_US      1000
+
+/* Completion polling period when the core has no interrupt (or the busy bit
+ * lags behind the last one). */
+#define MSGDMA_POLL_PERIOD_US        100
+
+/* Image of a standard hardware descriptor. */
+struct prsoc_msgdma_hw_desc {
+  uint32_t read_address;
+  uint32_t write_address;
+  uint32_t length;
+  uint32_t control;
+};
+
+/* A transfer, i.e. what a prep_* function returns. */
+struct prsoc_msgdma_tx {
+  struct dma_async_tx_descriptor txd;
+  struct list_head node;
+
+  bool cyclic;           /* loops over its descriptors until terminated */
+  unsigned int num_hw;   /* number of hardware descriptors */
+  unsigned long pushed;  /* descriptors written to the dispatcher so far */
+  unsigned long done;    /* descriptors known to be complete */
+  unsigned long periods; /* completed periods whose callback is pending */
+
+  struct prsoc_msgdma_hw_desc hw[];
+};
+
+/* Enclose the driver data. */
+struct prsoc_msgdma_drvdata {
+  struct dma_device dma;
+  struct dma_chan chan;
+  struct device *dev;
+
+  uint8_t *csr_regs;  /* a pointer to the CSR regs */
+  uint8_t *desc_regs; /* a pointer to the descriptor slave */
+  int irq;            /* < 0 if not connected: completion is polled */
+
+  uint32_t mode;
+  uint32_t fifo_depth;
+  uint32_t max_transfer;
+
+  struct dma_slave_config slave_config;
+
+  spinlock_t lock;            /* protects everything below */
+  struct list_head submitted; /* submitted, waiting for issue_pending */
+  struct list_head issued;    /* issued, pushed in this order */
+  struct list_head completed; /* waiting for their callback */
+  struct list_head unacked;   /* callback done, not acked by the client */
+  unsigned int in_flight;     /* descriptors written but not retired */
+  bool resetting;             /* nothing is pushed during a reset */
+  bool polling;               /* the poll timer is armed */
+
+  struct tasklet_struct tasklet;
+  struct hrtimer poll;
+};
+
+#define CSR_WR(DRVDATA, REG, VAL) \
+  iowrite32((VAL), (DRVDATA)->csr_regs + (REG))
+#define CSR_RD(DRVDATA, REG) \
+  ioread32((DRVDATA)->csr_regs + (REG))
+#define DESC_WR(DRVDATA, REG, VAL) \
+  iowrite32((VAL), (DRVDATA)->desc_regs + (REG))
+
+static inline struct prsoc_msgdma_drvdata *to_drvdata(struct dma_chan *chan)
+{
+  return container_of(chan, struct prsoc_msgdma_drvdata, chan);
+}
+
+static inline struct prsoc_msgdma_tx *to_tx(struct dma_async_tx_descriptor *txd)
+{
+  return container_of(txd, struct prsoc_msgdma_tx, txd);
+}
+
+/* Hardware access */
+
+/* Start a software reset of the dispatcher and masters. Drops every
+ * descriptor. */
+static void msgdma_reset_start(struct prsoc_msgdma_drvdata *drvdata)
+{
+  CSR_WR(drvdata, MSGDMA_CSR_CONTROL_REG, MSGDMA_CSR_RESET_MASK);
+}
+
+/* Wait for the end of the reset. Doesn't need the lock: nothing touches the
+ * core while drvdata->resetting is set. */
+static void msgdma_reset_wait(struct prsoc_msgdma_drvdata *drvdata)
+{
+  int timeout = MSGDMA_RESET_TIMEOUT_US;
+
+  while ((CSR_RD(drvdata, MSGDMA_CSR_STATUS_REG) & MSGDMA_CSR_RESET_STATE_MASK) && --timeout)
+    udelay(1);
+
+  if (!timeout)
+    dev_err(drvdata->dev, "mSGDMA reset timed out.\n");
+}
+
+/* Restart the core after a reset, which clears the control register. */
+static void msgdma_reset_done(struct prsoc_msgdma_drvdata *drvdata)
+{
+  CSR_WR(drvdata, MSGDMA_CSR_STATUS_REG, MSGDMA_CSR_IRQ_SET_MASK);
+  CSR_WR(drvdata, MSGDMA_CSR_CONTROL_REG,
+         drvdata->irq >= 0 ? MSGDMA_CSR_GLOBAL_INTERRUPT_MASK : 0);
+}
+
+/* Number of descriptors that may still be outstanding (upper bound). */
+static unsigned int msgdma_outstanding(struct prsoc_msgdma_drvdata *drvdata)
+{
+  uint32_t fill, status;
+  int settle = MSGDMA_BUSY_SETTLE_US;
+
+  fill = CSR_RD(drvdata, MSGDMA_CSR_DESCRIPTOR_FILL_LEVEL_REG);
+  status = CSR_RD(drvdata, MSGDMA_CSR_STATUS_REG);
+
+  /* The last master of the chain is the write master, except when there is
+   * none (memory-mapped to streaming). */
+  if (drvdata->mode == MSGDMA_MODE_MM_TO_ST)
+    fill = (fill & MSGDMA_CSR_READ_FILL_LEVEL_MASK) >> MSGDMA_CSR_READ_FILL_LEVEL_OFFSET;
+  else
+    fill = (fill & MSGDMA_CSR_WRITE_FILL_LEVEL_MASK) >> MSGDMA_CSR_WRITE_FILL_LEVEL_OFFSET;
+
+  /* With an empty FIFO, the busy bit may lag a little behind the interrupt
+   * of the last descriptor. Give it a chance to settle; if it takes longer,
+   * the poll timer retires the descriptor (see msgdma_poll_needed()). */
+  while (!fill && (status & MSGDMA_CSR_BUSY_MASK) && settle--) {
+    udelay(1);
+    status = CSR_RD(drvdata, MSGDMA_CSR_STATUS_REG);
+  }
+
+  if (!(status & MSGDMA_CSR_BUSY_MASK))
+    return 0;
+
+  return min(fill + 1, drvdata->in_flight);
+}
+
+static void msgdma_write_desc(struct prsoc_msgdma_drvdata *drvdata,
+                              struct prsoc_msgdma_hw_desc *hw, bool irq)
+{
+  uint32_t control = hw->control;
+
+  if (irq)
+    control |= MSGDMA_DESCRIPTOR_CONTROL_TRANSFER_COMPLETE_IRQ_MASK;
+
+  DESC_WR(drvdata, MSGDMA_DESCRIPTOR_READ_ADDRESS_REG, hw->read_address);
+  DESC_WR(drvdata, MSGDMA_DESCRIPTOR_WRITE_ADDRESS_REG, hw->write_address);
+  DESC_WR(drvdata, MSGDMA_DESCRIPTOR_LENGTH_REG, hw->length);
+  /* The control word commits the descriptor (GO bit). */
+  DESC_WR(drvdata, MSGDMA_DESCRIPTOR_CONTROL_STANDARD_REG, control);
+}
+
+/* Channel management (called with the lock held) */
+
+/* Next hardware descriptor to push, or NULL. Advances the transfers. */
+static struct prsoc_msgdma_hw_desc *next_hw_desc(struct prsoc_msgdma_drvdata *drvdata)
+{
+  struct prsoc_msgdma_tx *tx;
+
+  list_for_each_entry(tx, &drvdata->issued, node) {
+    if (tx->cyclic)
+      return &tx->hw[tx->pushed++ % tx->num_hw];
+
+    if (tx->pushed < tx->num_hw)
+      return &tx->hw[tx->pushed++];
+  }
+
+  return NULL;
+}
+
+/* Arm the poll timer, unless it already is. */
+static void msgdma_poll_start(struct prsoc_msgdma_drvdata *drvdata)
+{
+  if (drvdata->polling)
+    return;
+
+  drvdata->polling = true;
+  hrtimer_start(&drvdata->poll, us_to_ktime(MSGDMA_POLL_PERIOD_US),
+                HRTIMER_MODE_REL);
+}
+
+/* Fill the descriptor FIFO as much as possible. */
+static void msgdma_push(struct prsoc_msgdma_drvdata *drvdata)
+{
+  struct prsoc_msgdma_hw_desc *prev = NULL, *cur;
+
+  if (drvdata->resetting)
+    return;
+
+  while (drvdata->in_flight < drvdata->fifo_depth) {
+    cur = next_hw_desc(drvdata);
+    if (!cur)
+      break;
+
+    if (prev)
+      msgdma_write_desc(drvdata, prev, false);
+
+    prev = cur;
+    drvdata->in_flight++;
+  }
+
+  /* The last descriptor of a batch always interrupts, so that the FIFO is
+   * refilled (or the last transfer retired) when it completes. */
+  if (prev)
+    msgdma_write_desc(drvdata, prev, true);
+
+  /* Without interrupt, poll until everything is retired. */
+  if (drvdata->irq < 0 && drvdata->in_flight)
+    msgdma_poll_start(drvdata);
+}
+
+/* Whether the poll timer must (go on) checking the core: always without
+ * interrupt, otherwise while the last descriptor may have completed with the
+ * busy bit still set. Its interrupt may already have come. */
+static bool msgdma_poll_needed(struct prsoc_msgdma_drvdata *drvdata)
+{
+  if (!drvdata->in_flight || drvdata->resetting)
+    return false;
+
+  return drvdata->irq < 0 || drvdata->in_flight == 1;
+}
+
+/* Mark 'count' descriptors as complete, in push order. */
+static void msgdma_retire(struct prsoc_msgdma_drvdata *drvdata, unsigned int count)
+{
+  struct prsoc_msgdma_tx *tx, *tmp;
+
+  if (drvdata->resetting)
+    return;
+
+  drvdata->in_flight -= count;
+
+  list_for_each_entry_safe(tx, tmp, &drvdata->issued, node) {
+    unsigned int n = min_t(unsigned long, count, tx->pushed - tx->done);
+
+    if (!count)
+      break;
+
+    tx->done += n;
+    count -= n;
+
+    if (tx->cyclic) {
+      tx->periods += n;
+      continue;
+    }
+
+    if (tx->done == tx->num_hw) {
+      dma_cookie_complete(&tx->txd);
+      list_move_tail(&tx->node, &drvdata->completed);
+    }
+  }
+}
+
+/* Free the transfers the clients are done with. */
+static void msgdma_free_acked(struct prsoc_msgdma_drvdata *drvdata)
+{
+  struct prsoc_msgdma_tx *tx, *tmp;
+
+  list_for_each_entry_safe(tx, tmp, &drvdata->unacked, node) {
+    if (async_tx_test_ack(&tx->txd)) {
+      list_del(&tx->node);
+      kfree(tx);
+    }
+  }
+}
+
+static void msgdma_free_list(struct list_head *list)
+{
+  struct prsoc_msgdma_tx *tx, *tmp;
+
+  list_for_each_entry_safe(tx, tmp, list, node) {
+    list_del(&tx->node);
+    kfree(tx);
+  }
+}
+
+/* Bytes of 'tx' not known to be transferred. */
+static size_t msgdma_residue(struct prsoc_msgdma_tx *tx)
+{
+  unsigned long i = tx->cyclic ? tx->done % tx->num_hw : tx->done;
+  size_t residue = 0;
+
+  for (; i < tx->num_hw; i++)
+    residue += tx->hw[i].length;
+
+  return residue;
+}
+
+/* Interrupt handling */
+
+static irqreturn_t msgdma_isr(int irq, void *data)
+{
+  struct prsoc_msgdma_drvdata *drvdata = data;
+  uint32_t status;
+
+  spin_lock(&drvdata->lock);
+
+  status = CSR_RD(drvdata, MSGDMA_CSR_STATUS_REG);
+  if (!(status & MSGDMA_CSR_IRQ_SET_MASK)) {
+    spin_unlock(&drvdata->lock);
+    return IRQ_NONE;
+  }
+
+  /* Acknowledge first: any descriptor completing from now on raises a new
+   * interrupt, so nothing is missed by the reads below. */
+  CSR_WR(drvdata, MSGDMA_CSR_STATUS_REG, MSGDMA_CSR_IRQ_SET_MASK);
+
+  if (status & (MSGDMA_CSR_STOPPED_ON_ERROR_MASK | MSGDMA_CSR_STOPPED_ON_EARLY_TERMINATION_MASK))
+    dev_err(drvdata->dev, "mSGDMA stopped (status 0x%x).\n", status);
+
+  msgdma_retire(drvdata, drvdata->in_flight - msgdma_outstanding(drvdata));
+  msgdma_push(drvdata);
+
+  if (msgdma_poll_needed(drvdata))
+    msgdma_poll_start(drvdata);
+
+  spin_unlock(&drvdata->lock);
+
+  tasklet_schedule(&drvdata->tasklet);
+  return IRQ_HANDLED;
+}
+
+/* Does the work of the interrupt handler when there is no interrupt, or
+ * when the busy bit lagged behind the last one. */
+static enum hrtimer_restart msgdma_poll(struct hrtimer *timer)
+{
+  struct prsoc_msgdma_drvdata *drvdata =
+    container_of(timer, struct prsoc_msgdma_drvdata, poll);
+  unsigned int retired;
+  unsigned long flags;
+  bool restart;
+
+  spin_lock_irqsave(&drvdata->lock, flags);
+
+  retired = drvdata->in_flight - msgdma_outstanding(drvdata);
+  msgdma_retire(drvdata, retired);
+  msgdma_push(drvdata);
+
+  if (retired)
+    tasklet_schedule(&drvdata->tasklet);
+
+  /* msgdma_push() doesn't rearm an armed timer: stop here or go on. */
+  restart = msgdma_poll_needed(drvdata);
+  drvdata->polling = restart;
+  if (restart)
+    hrtimer_forward_now(timer, us_to_ktime(MSGDMA_POLL_PERIOD_US));
+
+  spin_unlock_irqrestore(&drvdata->lock, flags);
+
+  return restart ? HRTIMER_RESTART : HRTIMER_NORESTART;
+}
+
+/* Call the callbacks of the completed transfers and periods. */
+static void msgdma_tasklet(unsigned long data)
+{
+  struct prsoc_msgdma_drvdata *drvdata = (struct prsoc_msgdma_drvdata *)data;
+  struct prsoc_msgdma_tx *tx, *tmp;
+  dma_async_tx_callback callback;
+  void *param;
+  unsigned long flags, periods;
+  LIST_HEAD(completed);
+
+  spin_lock_irqsave(&drvdata->lock, flags);
+
+  /* Periods of the running cyclic transfer, if any. */
+  list_for_each_entry(tx, &drvdata->issued, node) {
+    if (!tx->cyclic || !tx->periods)
+      continue;
+
+    periods = tx->periods;
+    tx->periods = 0;
+    callback = tx->txd.callback;
+    param = tx->txd.callback_param;
+
+    spin_unlock_irqrestore(&drvdata->lock, flags);
+    while (callback && periods--)
+      callback(param);
+    spin_lock_irqsave(&drvdata->lock, flags);
+    break;
+  }
+
+  list_splice_tail_init(&drvdata->completed, &completed);
+  spin_unlock_irqrestore(&drvdata->lock, flags);
+
+  list_for_each_entry_safe(tx, tmp, &completed, node) {
+    dma_descriptor_unmap(&tx->txd);
+    if (tx->txd.callback)
+      tx->txd.callback(tx->txd.callback_param);
+    dma_run_dependencies(&tx->txd);
+  }
+
+  spin_lock_irqsave(&drvdata->lock, flags);
+  list_splice_tail(&completed, &drvdata->unacked);
+  msgdma_free_acked(drvdata);
+  spin_unlock_irqrestore(&drvdata->lock, flags);
+}
+
+/* dmaengine callbacks */
+
+static dma_cookie_t prsoc_msgdma_tx_submit(struct dma_async_tx_descriptor *txd)
+{
+  struct prsoc_msgdma_drvdata *drvdata = to_drvdata(txd->chan);
+  unsigned long flags;
+  dma_cookie_t cookie;
+
+  spin_lock_irqsave(&drvdata->lock, flags);
+  cookie = dma_cookie_assign(txd);
+  list_add_tail(&to_tx(txd)->node, &drvdata->submitted);
+  spin_unlock_irqrestore(&drvdata->lock, flags);
+
+  return cookie;
+}
+
+/* Allocate a transfer able to hold 'num_hw' hardware descriptors. */
+static struct prsoc_msgdma_tx *msgdma_alloc_tx(struct prsoc_msgdma_drvdata *drvdata,
+                                               unsigned int num_hw, unsigned long flags)
+{
+  struct prsoc_msgdma_tx *tx;
+  unsigned long lock_flags;
+
+  spin_lock_irqsave(&drvdata->lock, lock_flags);
+  msgdma_free_acked(drvdata);
+  spin_unlock_irqrestore(&drvdata->lock, lock_flags);
+
+  tx = kzalloc(sizeof(*tx) + num_hw * sizeof(tx->hw[0]), GFP_NOWAIT);
+  if (!tx)
+    return NULL;
+
+  dma_async_tx_descriptor_init(&tx->txd, &drvdata->chan);
+  tx->txd.tx_submit = prsoc_msgdma_tx_submit;
+  tx->txd.flags = flags;
+  tx->num_hw = num_hw;
+  INIT_LIST_HEAD(&tx->node);
+
+  return tx;
+}
+
+/* With DMA_PREP_INTERRUPT, interrupt at the end of the transfer rather than
+ * at the end of the batch it is pushed with. */
+static void msgdma_irq_on_last(struct prsoc_msgdma_tx *tx, unsigned long flags)
+{
+  if (flags & DMA_PREP_INTERRUPT)
+    tx->hw[tx->num_hw - 1].control |= MSGDMA_DESCRIPTOR_CONTROL_TRANSFER_COMPLETE_IRQ_MASK;
+}
+
+/* Number of hardware descriptors needed for 'len' bytes. */
+static inline unsigned int num_chunks(struct prsoc_msgdma_drvdata *drvdata, size_t len)
+{
+  return DIV_ROUND_UP(len, drvdata->max_transfer);
+}
+
+/* Split [src, src + len) -> [dst, dst + len) into hardware descriptors.
+ * Returns the number of descriptors written to 'hw'. */
+static unsigned int fill_chunks(struct prsoc_msgdma_drvdata *drvdata,
+                                struct prsoc_msgdma_hw_desc *hw,
+                                dma_addr_t src, dma_addr_t dst, size_t len)
+{
+  unsigned int n = 0;
+
+  while (len) {
+    size_t chunk = min_t(size_t, len, drvdata->max_transfer);
+
+    hw[n].read_address  = src;
+    hw[n].write_address = dst;
+    hw[n].length        = chunk;
+    hw[n].control       = MSGDMA_DESCRIPTOR_CONTROL_GO_MASK;
+
+    src += chunk;
+    dst += chunk;
+    len -= chunk;
+    n++;
+  }
+
+  return n;
+}
+
+static struct dma_async_tx_descriptor *
+prsoc_msgdma_prep_memcpy(struct dma_chan *chan, dma_addr_t dst,
+                         dma_addr_t src, size_t len, unsigned long flags)
+{
+  struct prsoc_msgdma_drvdata *drvdata = to_drvdata(chan);
+  struct prsoc_msgdma_tx *tx;
+
+  if (!len || !IS_ALIGNED(src | dst | len, MSGDMA_ALIGN))
+    return NULL;
+
+  tx = msgdma_alloc_tx(drvdata, num_chunks(drvdata, len), flags);
+  if (!tx)
+    return NULL;
+
+  fill_chunks(drvdata, tx->hw, src, dst, len);
+  msgdma_irq_on_last(tx, flags);
+  return &tx->txd;
+}
+
+/* Whether the mode of the core can serve 'dir'. */
+static bool direction_supported(struct prsoc_msgdma_drvdata *drvdata,
+                                enum dma_transfer_direction dir)
+{
+  switch (drvdata->mode) {
+  case MSGDMA_MODE_MM_TO_MM: return dir == DMA_DEV_TO_MEM || dir == DMA_MEM_TO_DEV;
+  case MSGDMA_MODE_MM_TO_ST: return dir == DMA_MEM_TO_DEV;
+  case MSGDMA_MODE_ST_TO_MM: return dir == DMA_DEV_TO_MEM;
+  }
+  return false;
+}
+
+/* Hardware descriptors of a slave segment. 'dev_offset' is the offset of
+ * the segment within the device window (memory-mapped mode only). */
+static unsigned int fill_slave_chunks(struct prsoc_msgdma_drvdata *drvdata,
+                                      struct prsoc_msgdma_hw_desc *hw,
+                                      enum dma_transfer_direction dir,
+                                      dma_addr_t mem, size_t dev_offset, size_t len)
+{
+  /* Streaming side: the address is ignored by the core. */
+  dma_addr_t dev = 0;
+
+  if (drvdata->mode == MSGDMA_MODE_MM_TO_MM)
+    dev = (dir == DMA_DEV_TO_MEM ? drvdata->slave_config.src_addr
+                                 : drvdata->slave_config.dst_addr) + dev_offset;
+
+  if (dir == DMA_DEV_TO_MEM)
+    return fill_chunks(drvdata, hw, dev, mem, len);
+  else
+    return fill_chunks(drvdata, hw, mem, dev, len);
+}
+
+static struct dma_async_tx_descriptor *
+prsoc_msgdma_prep_slave_sg(struct dma_chan *chan, struct scatterlist *sgl,
+                           unsigned int sg_len, enum dma_transfer_direction dir,
+                           unsigned long flags, void *context)
+{
+  struct prsoc_msgdma_drvdata *drvdata = to_drvdata(chan);
+  struct prsoc_msgdma_tx *tx;
+  struct scatterlist *sg;
+  unsigned int num_hw = 0, n = 0;
+  size_t offset = 0;
+  int i;
+
+  if (!direction_supported(drvdata, dir))
+    return NULL;
+
+  for_each_sg(sgl, sg, sg_len, i) {
+    if (!IS_ALIGNED(sg_dma_address(sg) | sg_dma_len(sg), MSGDMA_ALIGN))
+      return NULL;
+    num_hw += num_chunks(drvdata, sg_dma_len(sg));
+  }
+
+  if (!num_hw)
+    return NULL;
+
+  tx = msgdma_alloc_tx(drvdata, num_hw, flags);
+  if (!tx)
+    return NULL;
+
+  for_each_sg(sgl, sg, sg_len, i) {
+    n += fill_slave_chunks(drvdata, &tx->hw[n], dir, sg_dma_address(sg),
+                           offset, sg_dma_len(sg));
+    offset += sg_dma_len(sg);
+  }
+
+  msgdma_irq_on_last(tx, flags);
+  return &tx->txd;
+}
+
+static struct dma_async_tx_descriptor *
+prsoc_msgdma_prep_cyclic(struct dma_chan *chan, dma_addr_t buf_addr,
+                         size_t buf_len, size_t period_len,
+                         enum dma_transfer_direction dir, unsigned long flags)
+{
+  struct prsoc_msgdma_drvdata *drvdata = to_drvdata(chan);
+  struct prsoc_msgdma_tx *tx;
+  unsigned int i, num_periods;
+
+  if (!direction_supported(drvdata, dir) || !period_len ||
+      buf_len % period_len || period_len > drvdata->max_transfer ||
+      !IS_ALIGNED(buf_addr | period_len, MSGDMA_ALIGN))
+    return NULL;
+
+  num_periods = buf_len / period_len;
+
+  tx = msgdma_alloc_tx(drvdata, num_periods, flags);
+  if (!tx)
+    return NULL;
+
+  /* In memory-mapped mode, every period reads (or writes) the same device
+   * window: the device offset is not accumulated. */
+  for (i = 0; i < num_periods; i++) {
+    fill_slave_chunks(drvdata, &tx->hw[i], dir, buf_addr + i * period_len, 0, period_len);
+    tx->hw[i].control |= MSGDMA_DESCRIPTOR_CONTROL_TRANSFER_COMPLETE_IRQ_MASK;
+  }
+
+  tx->cyclic = true;
+  return &tx->txd;
+}
+
+static int prsoc_msgdma_config(struct dma_chan *chan, struct dma_slave_config *config)
+{
+  struct prsoc_msgdma_drvdata *drvdata = to_drvdata(chan);
+  unsigned long flags;
+
+  spin_lock_irqsave(&drvdata->lock, flags);
+  drvdata->slave_config = *config;
+  spin_unlock_irqrestore(&drvdata->lock, flags);
+
+  return 0;
+}
+
+static void prsoc_msgdma_issue_pending(struct dma_chan *chan)
+{
+  struct prsoc_msgdma_drvdata *drvdata = to_drvdata(chan);
+  unsigned long flags;
+
+  spin_lock_irqsave(&drvdata->lock, flags);
+
+  /* Transfers issued after a cyclic one never run: the cyclic one only
+   * ends with terminate_all. */
+  list_splice_tail_init(&drvdata->submitted, &drvdata->issued);
+  msgdma_push(drvdata);
+
+  spin_unlock_irqrestore(&drvdata->lock, flags);
+}
+
+static int prsoc_msgdma_terminate_all(struct dma_chan *chan)
+{
+  struct prsoc_msgdma_drvdata *drvdata = to_drvdata(chan);
+  struct prsoc_msgdma_tx *tx;
+  unsigned long flags;
+  LIST_HEAD(dropped);
+
+  spin_lock_irqsave(&drvdata->lock, flags);
+
+  msgdma_reset_start(drvdata);
+  drvdata->resetting = true;
+  drvdata->in_flight = 0;
+
+  /* In cookie order: nobody may wait on a dropped transfer forever. Their
+   * callbacks are not called. */
+  list_splice_tail_init(&drvdata->issued, &dropped);
+  list_splice_tail_init(&drvdata->submitted, &dropped);
+  list_for_each_entry(tx, &dropped, node)
+    dma_cookie_complete(&tx->txd);
+
+  /* Already complete, but their callback is not called anymore either. */
+  list_splice_tail_init(&drvdata->completed, &dropped);
+
+  spin_unlock_irqrestore(&drvdata->lock, flags);
+
+  /* Transfers submitted meanwhile wait in drvdata->submitted. */
+  msgdma_reset_wait(drvdata);
+
+  spin_lock_irqsave(&drvdata->lock, flags);
+  msgdma_reset_done(drvdata);
+  drvdata->resetting = false;
+  msgdma_push(drvdata);
+  spin_unlock_irqrestore(&drvdata->lock, flags);
+
+  msgdma_free_list(&dropped);
+  return 0;
+}
+
+/* Wait for the callbacks of the transfers dropped by terminate_all. */
+static void prsoc_msgdma_synchronize(struct dma_chan *chan)
+{
+  struct prsoc_msgdma_drvdata *drvdata = to_drvdata(chan);
+
+  tasklet_kill(&drvdata->tasklet);
+}
+
+static enum dma_status prsoc_msgdma_tx_status(struct dma_chan *chan,
+                                              dma_cookie_t cookie,
+                                              struct dma_tx_state *state)
+{
+  struct prsoc_msgdma_drvdata *drvdata = to_drvdata(chan);
+  struct prsoc_msgdma_tx *tx;
+  enum dma_status status;
+  unsigned long flags;
+
+  status = dma_cookie_status(chan, cookie, state);
+  if (status == DMA_COMPLETE)
+    return status;
+
+  /* Do the work of the interrupt handler, so that clients can poll with
+   * interrupts disabled (e.g. dma_sync_wait() from the framebuffer console).
+   * The callbacks are still called from the tasklet. */
+  spin_lock_irqsave(&drvdata->lock, flags);
+  msgdma_retire(drvdata, drvdata->in_flight - msgdma_outstanding(drvdata));
+  msgdma_push(drvdata);
+  if (!list_empty(&drvdata->completed))
+    tasklet_schedule(&drvdata->tasklet);
+
+  status = dma_cookie_status(chan, cookie, state);
+  if (status != DMA_COMPLETE && state) {
+    list_for_each_entry(tx, &drvdata->issued, node) {
+      if (tx->txd.cookie == cookie) {
+        dma_set_residue(state, msgdma_residue(tx));
+        break;
+      }
+    }
+    list_for_each_entry(tx, &drvdata->submitted, node) {
+      if (tx->txd.cookie == cookie) {
+        dma_set_residue(state, msgdma_residue(tx));
+        break;
+      }
+    }
+  }
+
+  spin_unlock_irqrestore(&drvdata->lock, flags);
+
+  return status;
+}
+
+static int prsoc_msgdma_alloc_chan_resources(struct dma_chan *chan)
+{
+  dma_cookie_init(chan);
+  return 0;
+}
+
+static void prsoc_msgdma_free_chan_resources(struct dma_chan *chan)
+{
+  struct prsoc_msgdma_drvdata *drvdata = to_drvdata(chan);
+  unsigned long flags;
+
+  prsoc_msgdma_terminate_all(chan);
+  prsoc_msgdma_synchronize(chan);
+
+  spin_lock_irqsave(&drvdata->lock, flags);
+  msgdma_free_list(&drvdata->unacked);
+  spin_unlock_irqrestore(&drvdata->lock, flags);
+}
+
+/* Platform driver */
+
+/* Informs the kernel of the corresponding compatible string. */
+static const struct of_device_id prsoc_msgdma_device_ids[] = {
+  { .compatible = "prsoc,msgdma" },
+  { }
+};
+MODULE_DEVICE_TABLE(of, prsoc_msgdma_device_ids);
+
+/* Apply configuration from device tree. */
+static int configure_from_dt(struct platform_device *pdev,
+                             struct prsoc_msgdma_drvdata *drvdata)
+{
+  struct device_node *np = pdev->dev.of_node;
+  struct resource *rsrc;
+  int err;
+
+  /* Maps the addresses of the CSR. */
+  rsrc = platform_get_resource(pdev, IORESOURCE_MEM, 0);
+  drvdata->csr_regs = devm_ioremap_resource(&pdev->dev, rsrc);
+  if (IS_ERR(drvdata->csr_regs))
+    return PTR_ERR(drvdata->csr_regs);
+
+  /* Maps the addresses of the descriptor slave. */
+  rsrc = platform_get_resource(pdev, IORESOURCE_MEM, 1);
+  drvdata->desc_regs = devm_ioremap_resource(&pdev->dev, rsrc);
+  if (IS_ERR(drvdata->desc_regs))
+    return PTR_ERR(drvdata->desc_regs);
+
+  if (of_property_read_u32(np, "prsoc,dma-mode", &drvdata->mode) ||
+      drvdata->mode > MSGDMA_MODE_ST_TO_MM) {
+    printk(KERN_ERR "no valid 'prsoc,dma-mode' in the device tree.\n");
+    return -EINVAL;
+  }
+
+  drvdata->fifo_depth = MSGDMA_DEFAULT_FIFO_DEPTH;
+  of_property_read_u32(np, "prsoc,descriptor-fifo-depth", &drvdata->fifo_depth);
+
+  drvdata->max_transfer = MSGDMA_DEFAULT_MAX_TRANSFER;
+  of_property_read_u32(np, "prsoc,max-transfer-size", &drvdata->max_transfer);
+  drvdata->max_transfer = round_down(drvdata->max_transfer, MSGDMA_ALIGN);
+
+  if (!drvdata->fifo_depth || !drvdata->max_transfer)
+    return -EINVAL;
+
+  /* Optional: completion is polled without it. */
+  drvdata->irq = -ENXIO;
+  if (!of_find_property(np, "interrupts", NULL))
+    return 0;
+
+  drvdata->irq = platform_get_irq(pdev, 0);
+  err = devm_request_irq(&pdev->dev, drvdata->irq, msgdma_isr, 0,
+                         "prsoc-msgdma", drvdata);
+  if (err) {
+    printk(KERN_ERR "couldn't register ISR. Is the 'interrupts' " \
+           "field of the device tree valid?\n");
+    return -ENXIO;
+  }
+
+  return 0;
+}
+
+/*
+ * The following method is called when the driver is loaded.
+ * It collects information from the device tree.
+ */
+static int
+prsoc_msgdma_platform_probe(struct platform_device *pdev)
+{
+  struct prsoc_msgdma_drvdata *drvdata;
+  struct dma_device *dma;
+  int err;
+
+  /* Defensive programming: let's make sure this is the right device. */
+  if (!of_match_device(prsoc_msgdma_device_ids, &pdev->dev))
+    return -EINVAL;
+
+  drvdata = devm_kzalloc(&pdev->dev, sizeof(*drvdata), GFP_KERNEL);
+  if (!drvdata)
+    return -ENOMEM;
+
+  drvdata->dev = &pdev->dev;
+  spin_lock_init(&drvdata->lock);
+  INIT_LIST_HEAD(&drvdata->submitted);
+  INIT_LIST_HEAD(&drvdata->issued);
+  INIT_LIST_HEAD(&drvdata->completed);
+  INIT_LIST_HEAD(&drvdata->unacked);
+  tasklet_init(&drvdata->tasklet, msgdma_tasklet, (unsigned long)drvdata);
+  hrtimer_init(&drvdata->poll, CLOCK_MONOTONIC, HRTIMER_MODE_REL);
+  drvdata->poll.function = msgdma_poll;
+  platform_set_drvdata(pdev, drvdata);
+
+  /* Reset before the interrupt can fire. */
+  err = configure_from_dt(pdev, drvdata);
+  if (err)
+    return err;
+
+  msgdma_reset_start(drvdata);
+  msgdma_reset_wait(drvdata);
+  msgdma_reset_done(drvdata);
+
+  dma = &drvdata->dma;
+  dma->dev = &pdev->dev;
+  INIT_LIST_HEAD(&dma->channels);
+
+  dma_cap_set(DMA_SLAVE, dma->cap_mask);
+  dma_cap_set(DMA_CYCLIC, dma->cap_mask);
+  if (drvdata->mode == MSGDMA_MODE_MM_TO_MM) {
+    dma_cap_set(DMA_MEMCPY, dma->cap_mask);
+    dma->device_prep_dma_memcpy = prsoc_msgdma_prep_memcpy;
+    dma->directions = BIT(DMA_DEV_TO_MEM) | BIT(DMA_MEM_TO_DEV);
+  } else if (drvdata->mode == MSGDMA_MODE_MM_TO_ST) {
+    dma->directions = BIT(DMA_MEM_TO_DEV);
+  } else {
+    dma->directions = BIT(DMA_DEV_TO_MEM);
+  }
+
+  dma->copy_align = DMAENGINE_ALIGN_4_BYTES;
+  dma->src_addr_widths = BIT(DMA_SLAVE_BUSWIDTH_4_BYTES);
+  dma->dst_addr_widths = BIT(DMA_SLAVE_BUSWIDTH_4_BYTES);
+  dma->residue_granularity = DMA_RESIDUE_GRANULARITY_SEGMENT;
+
+  dma->device_alloc_chan_resources = prsoc_msgdma_alloc_chan_resources;
+  dma->device_free_chan_resources = prsoc_msgdma_free_chan_resources;
+  dma->device_prep_slave_sg = prsoc_msgdma_prep_slave_sg;
+  dma->device_prep_dma_cyclic = prsoc_msgdma_prep_cyclic;
+  dma->device_config = prsoc_msgdma_config;
+  dma->device_terminate_all = prsoc_msgdma_terminate_all;
+  dma->device_synchronize = prsoc_msgdma_synchronize;
+  dma->device_issue_pending = prsoc_msgdma_issue_pending;
+  dma->device_tx_status = prsoc_msgdma_tx_status;
+
+  drvdata->chan.device = dma;
+  list_add_tail(&drvdata->chan.device_node, &dma->channels);
+
+  err = dma_async_device_register(dma);
+  if (err) {
+    printk(KERN_ERR "prsoc_msgdma: couldn't register the DMA device.\n");
+    return err;
+  }
+
+  err = of_dma_controller_register(pdev->dev.of_node, of_dma_xlate_by_chan_id, dma);
+  if (err) {
+    dma_async_device_unregister(dma);
+    return err;
+  }
+
+  printk(KERN_INFO "mSGDMA in mode %u, %u descriptors FIFO%s\n",
+         drvdata->mode, drvdata->fifo_depth,
+         drvdata->irq < 0 ? ", polled" : "");
+  return 0;
+}
+
+static int prsoc_msgdma_platform_remove(struct platform_device *pdev)
+{
+  struct prsoc_msgdma_drvdata *drvdata = platform_get_drvdata(pdev);
+
+  of_dma_controller_free(pdev->dev.of_node);
+  dma_async_device_unregister(&drvdata->dma);
+
+  /* Make sure the interrupt doesn't fire anymore before devres frees it. */
+  CSR_WR(drvdata, MSGDMA_CSR_CONTROL_REG, MSGDMA_CSR_RESET_MASK);
+  hrtimer_cancel(&drvdata->poll);
+  tasklet_kill(&drvdata->tasklet);
+
+  return 0;
+}
+
+static struct platform_driver prsoc_msgdma_pdriver = {
+  .probe = prsoc_msgdma_platform_probe,
+  .remove = prsoc_msgdma_platform_remove,
+  .driver = {
+    .name = "prsoc-msgdma",
+    .owner = THIS_MODULE,
+    .of_match_table = prsoc_msgdma_device_ids,
+  },
+};
+
+MODULE_LICENSE("GPL");
+module_platform_driver(prsoc_msgdma_pdriver);
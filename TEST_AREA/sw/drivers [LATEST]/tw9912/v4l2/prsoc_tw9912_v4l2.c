@@ -0,0 +1,618 @@
+/*
+ * @file prsoc_tw9912_v4l2
+ * @date 19 Oct 2026
+ * @brief V4L2 capture driver for the TW9912 video decoder of the PrSoC board.
+ *
+ * The capture path is made of three components:
+ *   - the FPGA I2C master, used to configure the TW9912 (../i2c.c),
+ *   - the tw9912_adapter, which captures one frame from the TW9912 every
+ *     time its CONTROL register is written and streams it out,
+ *   - an mSGDMA in streaming to memory-mapped mode, which writes the stream
+ *     to memory. It is driven through dmaengine (../dmaengine).
+ *
+ * This driver exposes that path as a standard V4L2 capture device
+ * (/dev/videoN) backed by videobuf2 with the MMAP and DMABUF memory types,
+ * so the frames land directly in buffers that can be shared with other
+ * devices. While streaming, each queued buffer gets its own DMA transfer;
+ * the next capture is started from the completion callback of the previous
+ * one, so no field is lost as long as user space keeps buffers queued.
+ *
+ * The adapter measures the frames it captures (bytes per line and number of
+ * lines). A first capture is done at probe time to read these values; the
+ * only format offered is that frame size in UYVY (the TW9912 outputs
+ * Cb Y0 Cr Y1 bytes, i.e. 2 bytes per pixel).
+ *
+ *   video-capture {
+ *     compatible = "prsoc,tw9912";
+ *     reg = <0xff2000c0 0x20    // tw9912_adapter <address span>
+ *            0xff200110 0x04>;  // I2C master <address span>
+ *     dmas = <&msgdma0 0>;
+ *     dma-names = "rx";
+ *   };
+ *
+ * This driver is written against the videobuf2 API of Linux 4.9 (struct
+ * vb2_v4l2_buffer, alloc_devs in queue_setup).
+ *
+ * Revisions:
+ *  10/19/2026 Created
+ *  10/19/2026 Synchronous stop, fail buffers the DMA can't take
+ *  10/19/2026 Stop streaming on remove, free drvdata with the last handle
+ */
+
+#include <linux/module.h>
+#include <linux/kernel.h>
+#include <linux/io.h>
+#include <linux/delay.h>
+#include <linux/slab.h>
+#include <linux/list.h>
+#include <linux/mutex.h>
+#include <linux/spinlock.h>
+#include <linux/platform_device.h>
+#include <linux/of_device.h>
+#include <linux/dmaengine.h>
+#include <linux/dma-mapping.h>
+#include <linux/types.h>
+
+#include <media/v4l2-device.h>
+#include <media/v4l2-dev.h>
+#include <media/v4l2-ioctl.h>
+#include <media/v4l2-fh.h>
+#include <media/videobuf2-v4l2.h>
+#include <media/videobuf2-dma-contig.h>
+
+#include "../i2c.h"
+
+/* Registers of the tw9912_adapter. */
+#define TW9912_ADAPTER_REG_CONTROL      0x00 /* W: start a capture, R: bit 0 = done */
+#define TW9912_ADAPTER_REG_LINE_WIDTH   0x04 /* bytes per line of the last capture */
+#define TW9912_ADAPTER_REG_FRAME_HEIGHT 0x08 /* lines of the last capture */
+
+#define TW9912_ADAPTER_CONTROL_DONE_MASK (1UL << 0)
+
+/* TW9912 on the I2C bus. */
+#define TW9912_I2C_ADDRESS   0x88
+#define TW9912_I2C_FREQUENCY (50000000 * 4) /* as in app.c */
+
+#define TW9912_BYTES_PER_PIXEL    2
+#define TW9912_CAPTURE_TIMEOUT_MS 100 /* > 2 PAL fields */
+#define TW9912_MIN_BUFFERS        2
+
+/* Register values written at probe time (see app.c). */
+static const uint8_t tw9912_init_sequence[][2] = {
+  { 0xc0, 0x01 }, /* LLPLL input control */
+  { 0x03, 0x26 }, /* output control */
+  { 0x02, 0x40 }, /* input format: Y0 selected, DO NOT CHANGE */
+  { 0x05, 0x00 }, /* output control 2 */
+  { 0x37, 0x00 }, /* HDELAY2 */
+  { 0x38, 0x00 }, /* HSTART */
+};
+
+/* A videobuf2 buffer. */
+struct prsoc_tw9912_buffer {
+  struct vb2_v4l2_buffer vb;
+  struct list_head list;
+};
+
+/* Enclose the driver data. */
+struct prsoc_tw9912_drvdata {
+  struct v4l2_device v4l2_dev;
+  struct video_device vdev;
+  struct vb2_queue queue;
+  struct mutex lock; /* serializes the ioctls */
+
+  uint8_t *adapter_regs; /* a pointer to the tw9912_adapter's regs */
+  i2c_dev i2c;           /* the I2C master, see ../i2c.h */
+  struct dma_chan *dma;
+
+  /* Frame size as measured by the adapter. */
+  uint32_t width;
+  uint32_t height;
+
+  spinlock_t qlock;        /* protects the list and the current buffer */
+  struct list_head queued; /* buffers waiting to be filled */
+  struct prsoc_tw9912_buffer *current_buf; /* buffer being filled */
+  unsigned int sequence;
+  bool streaming;
+};
+
+#define ADAPTER_WR(DRVDATA, REG, VAL) \
+  iowrite32((VAL), (DRVDATA)->adapter_regs + (REG))
+#define ADAPTER_RD(DRVDATA, REG) \
+  ioread32((DRVDATA)->adapter_regs + (REG))
+
+static inline struct prsoc_tw9912_buffer *to_tw9912_buffer(struct vb2_buffer *vb)
+{
+  return container_of(to_vb2_v4l2_buffer(vb), struct prsoc_tw9912_buffer, vb);
+}
+
+static inline uint32_t frame_size(struct prsoc_tw9912_drvdata *drvdata)
+{
+  return drvdata->width * drvdata->height * TW9912_BYTES_PER_PIXEL;
+}
+
+/* Hardware */
+
+/* Configure the TW9912 over I2C. */
+static int tw9912_configure(struct prsoc_tw9912_drvdata *drvdata)
+{
+  int i;
+
+  i2c_init(&drvdata->i2c, TW9912_I2C_FREQUENCY);
+  i2c_configure(&drvdata->i2c, false);
+
+  for (i = 0; i < ARRAY_SIZE(tw9912_init_sequence); i++) {
+    if (i2c_write(&drvdata->i2c, TW9912_I2C_ADDRESS,
+                  tw9912_init_sequence[i][0], tw9912_init_sequence[i][1]) != I2C_SUCCESS) {
+      printk(KERN_ERR "prsoc_tw9912: couldn't write register 0x%02x.\n",
+             tw9912_init_sequence[i][0]);
+      return -EIO;
+    }
+  }
+
+  return 0;
+}
+
+/* Capture a frame without DMA to measure its size. The FIFO of the adapter
+ * simply overflows since nobody reads it. */
+static int tw9912_measure(struct prsoc_tw9912_drvdata *drvdata)
+{
+  unsigned long timeout = jiffies + msecs_to_jiffies(TW9912_CAPTURE_TIMEOUT_MS);
+  uint32_t line_width;
+
+  ADAPTER_WR(drvdata, TW9912_ADAPTER_REG_CONTROL, 0);
+
+  /* The done bit takes a few cycles to fall (clock domain crossing). */
+  usleep_range(100, 200);
+
+  while (!(ADAPTER_RD(drvdata, TW9912_ADAPTER_REG_CONTROL) & TW9912_ADAPTER_CONTROL_DONE_MASK)) {
+    if (time_after(jiffies, timeout))
+      return -ETIMEDOUT;
+    usleep_range(1000, 2000);
+  }
+
+  line_width = ADAPTER_RD(drvdata, TW9912_ADAPTER_REG_LINE_WIDTH);
+  drvdata->width = line_width / TW9912_BYTES_PER_PIXEL;
+  drvdata->height = ADAPTER_RD(drvdata, TW9912_ADAPTER_REG_FRAME_HEIGHT);
+
+  if (!drvdata->width || !drvdata->height)
+    return -EIO;
+
+  return 0;
+}
+
+static void tw9912_dma_callback(void *data);
+
+/* Start filling the next queued buffer. Called with qlock held. */
+static void tw9912_start_next(struct prsoc_tw9912_drvdata *drvdata)
+{
+  struct prsoc_tw9912_buffer *buf;
+  struct dma_async_tx_descriptor *txd;
+
+  if (!drvdata->streaming || drvdata->current_buf || list_empty(&drvdata->queued))
+    return;
+
+  buf = list_first_entry(&drvdata->queued, struct prsoc_tw9912_buffer, list);
+
+  txd = dmaengine_prep_slave_single(drvdata->dma,
+                                    vb2_dma_contig_plane_dma_addr(&buf->vb.vb2_buf, 0),
+                                    frame_size(drvdata), DMA_DEV_TO_MEM,
+                                    DMA_PREP_INTERRUPT | DMA_CTRL_ACK);
+  list_del(&buf->list);
+
+  /* Give the buffer back rather than leaving it queued forever: the next
+   * capture is attempted when user space queues a buffer again. */
+  if (!txd) {
+    printk(KERN_ERR "prsoc_tw9912: couldn't prepare the DMA transfer.\n");
+    vb2_buffer_done(&buf->vb.vb2_buf, VB2_BUF_STATE_ERROR);
+    return;
+  }
+
+  drvdata->current_buf = buf;
+
+  txd->callback = tw9912_dma_callback;
+  txd->callback_param = drvdata;
+  dmaengine_submit(txd);
+  dma_async_issue_pending(drvdata->dma);
+
+  /* The descriptor is waiting for the stream: start the capture. */
+  ADAPTER_WR(drvdata, TW9912_ADAPTER_REG_CONTROL, 0);
+}
+
+/* Called by the DMA engine once a frame is in memory. */
+static void tw9912_dma_callback(void *data)
+{
+  struct prsoc_tw9912_drvdata *drvdata = data;
+  struct prsoc_tw9912_buffer *buf;
+  unsigned long flags;
+
+  spin_lock_irqsave(&drvdata->qlock, flags);
+
+  buf = drvdata->current_buf;
+  drvdata->current_buf = NULL;
+
+  /* Restart as soon as possible not to miss the next frame. */
+  tw9912_start_next(drvdata);
+
+  spin_unlock_irqrestore(&drvdata->qlock, flags);
+
+  if (!buf)
+    return;
+
+  buf->vb.vb2_buf.timestamp = ktime_get_ns();
+  buf->vb.sequence = drvdata->sequence++;
+  buf->vb.field = V4L2_FIELD_NONE;
+  vb2_set_plane_payload(&buf->vb.vb2_buf, 0, frame_size(drvdata));
+  vb2_buffer_done(&buf->vb.vb2_buf, VB2_BUF_STATE_DONE);
+}
+
+/* videobuf2 operations */
+
+static int tw9912_queue_setup(struct vb2_queue *vq,
+                              unsigned int *nbuffers, unsigned int *nplanes,
+                              unsigned int sizes[], struct device *alloc_devs[])
+{
+  struct prsoc_tw9912_drvdata *drvdata = vb2_get_drv_priv(vq);
+
+  /* VIDIOC_CREATE_BUFS */
+  if (*nplanes)
+    return sizes[0] < frame_size(drvdata) ? -EINVAL : 0;
+
+  *nplanes = 1;
+  sizes[0] = frame_size(drvdata);
+  return 0;
+}
+
+static int tw9912_buf_prepare(struct vb2_buffer *vb)
+{
+  struct prsoc_tw9912_drvdata *drvdata = vb2_get_drv_priv(vb->vb2_queue);
+
+  if (vb2_plane_size(vb, 0) < frame_size(drvdata))
+    return -EINVAL;
+
+  return 0;
+}
+
+static void tw9912_buf_queue(struct vb2_buffer *vb)
+{
+  struct prsoc_tw9912_drvdata *drvdata = vb2_get_drv_priv(vb->vb2_queue);
+  struct prsoc_tw9912_buffer *buf = to_tw9912_buffer(vb);
+  unsigned long flags;
+
+  spin_lock_irqsave(&drvdata->qlock, flags);
+  list_add_tail(&buf->list, &drvdata->queued);
+  tw9912_start_next(drvdata);
+  spin_unlock_irqrestore(&drvdata->qlock, flags);
+}
+
+/* Give all the buffers back to videobuf2. */
+static void tw9912_return_buffers(struct prsoc_tw9912_drvdata *drvdata,
+                                  enum vb2_buffer_state state)
+{
+  struct prsoc_tw9912_buffer *buf, *tmp;
+  unsigned long flags;
+
+  spin_lock_irqsave(&drvdata->qlock, flags);
+
+  if (drvdata->current_buf) {
+    list_add(&drvdata->current_buf->list, &drvdata->queued);
+    drvdata->current_buf = NULL;
+  }
+
+  list_for_each_entry_safe(buf, tmp, &drvdata->queued, list) {
+    list_del(&buf->list);
+    vb2_buffer_done(&buf->vb.vb2_buf, state);
+  }
+
+  spin_unlock_irqrestore(&drvdata->qlock, flags);
+}
+
+static int tw9912_start_streaming(struct vb2_queue *vq, unsigned int count)
+{
+  struct prsoc_tw9912_drvdata *drvdata = vb2_get_drv_priv(vq);
+  unsigned long flags;
+
+  drvdata->sequence = 0;
+
+  spin_lock_irqsave(&drvdata->qlock, flags);
+  drvdata->streaming = true;
+  tw9912_start_next(drvdata);
+  spin_unlock_irqrestore(&drvdata->qlock, flags);
+
+  return 0;
+}
+
+static void tw9912_stop_streaming(struct vb2_queue *vq)
+{
+  struct prsoc_tw9912_drvdata *drvdata = vb2_get_drv_priv(vq);
+  unsigned long flags;
+
+  spin_lock_irqsave(&drvdata->qlock, flags);
+  drvdata->streaming = false;
+  spin_unlock_irqrestore(&drvdata->qlock, flags);
+
+  /* The capture in progress (if any) completes in the adapter and its data
+   * is dropped by the reset of the mSGDMA. Wait for a callback that is
+   * already running, so that no buffer is marked done after this. */
+  dmaengine_terminate_sync(drvdata->dma);
+  tw9912_return_buffers(drvdata, VB2_BUF_STATE_ERROR);
+}
+
+static const struct vb2_ops tw9912_vb2_ops = {
+  .queue_setup = tw9912_queue_setup,
+  .buf_prepare = tw9912_buf_prepare,
+  .buf_queue = tw9912_buf_queue,
+  .start_streaming = tw9912_start_streaming,
+  .stop_streaming = tw9912_stop_streaming,
+  .wait_prepare = vb2_ops_wait_prepare,
+  .wait_finish = vb2_ops_wait_finish,
+};
+
+/* V4L2 ioctls */
+
+static int tw9912_querycap(struct file *file, void *priv, struct v4l2_capability *cap)
+{
+  strlcpy(cap->driver, "prsoc_tw9912", sizeof(cap->driver));
+  strlcpy(cap->card, "PrSoC TW9912", sizeof(cap->card));
+  strlcpy(cap->bus_info, "platform:prsoc-tw9912", sizeof(cap->bus_info));
+  cap->device_caps = V4L2_CAP_VIDEO_CAPTURE | V4L2_CAP_STREAMING;
+  cap->capabilities = cap->device_caps | V4L2_CAP_DEVICE_CAPS;
+  return 0;
+}
+
+static int tw9912_enum_fmt(struct file *file, void *priv, struct v4l2_fmtdesc *f)
+{
+  if (f->index)
+    return -EINVAL;
+
+  f->pixelformat = V4L2_PIX_FMT_UYVY;
+  strlcpy(f->description, "UYVY 4:2:2", sizeof(f->description));
+  return 0;
+}
+
+/* The only format is the one measured by the adapter. */
+static int tw9912_g_fmt(struct file *file, void *priv, struct v4l2_format *f)
+{
+  struct prsoc_tw9912_drvdata *drvdata = video_drvdata(file);
+  struct v4l2_pix_format *pix = &f->fmt.pix;
+
+  pix->width = drvdata->width;
+  pix->height = drvdata->height;
+  pix->pixelformat = V4L2_PIX_FMT_UYVY;
+  pix->field = V4L2_FIELD_NONE;
+  pix->bytesperline = drvdata->width * TW9912_BYTES_PER_PIXEL;
+  pix->sizeimage = frame_size(drvdata);
+  pix->colorspace = V4L2_COLORSPACE_SMPTE170M;
+  return 0;
+}
+
+static int tw9912_enum_input(struct file *file, void *priv, struct v4l2_input *inp)
+{
+  if (inp->index)
+    return -EINVAL;
+
+  inp->type = V4L2_INPUT_TYPE_CAMERA;
+  inp->std = V4L2_STD_PAL;
+  strlcpy(inp->name, "Composite", sizeof(inp->name));
+  return 0;
+}
+
+static int tw9912_g_input(struct file *file, void *priv, unsigned int *i)
+{
+  *i = 0;
+  return 0;
+}
+
+static int tw9912_s_input(struct file *file, void *priv, unsigned int i)
+{
+  return i ? -EINVAL : 0;
+}
+
+static const struct v4l2_ioctl_ops tw9912_ioctl_ops = {
+  .vidioc_querycap = tw9912_querycap,
+  .vidioc_enum_fmt_vid_cap = tw9912_enum_fmt,
+  .vidioc_g_fmt_vid_cap = tw9912_g_fmt,
+  .vidioc_s_fmt_vid_cap = tw9912_g_fmt,
+  .vidioc_try_fmt_vid_cap = tw9912_g_fmt,
+  .vidioc_enum_input = tw9912_enum_input,
+  .vidioc_g_input = tw9912_g_input,
+  .vidioc_s_input = tw9912_s_input,
+
+  .vidioc_reqbufs = vb2_ioctl_reqbufs,
+  .vidioc_create_bufs = vb2_ioctl_create_bufs,
+  .vidioc_prepare_buf = vb2_ioctl_prepare_buf,
+  .vidioc_querybuf = vb2_ioctl_querybuf,
+  .vidioc_qbuf = vb2_ioctl_qbuf,
+  .vidioc_dqbuf = vb2_ioctl_dqbuf,
+  .vidioc_expbuf = vb2_ioctl_expbuf,
+  .vidioc_streamon = vb2_ioctl_streamon,
+  .vidioc_streamoff = vb2_ioctl_streamoff,
+};
+
+static const struct v4l2_file_operations tw9912_fops = {
+  .owner = THIS_MODULE,
+  .open = v4l2_fh_open,
+  .release = vb2_fop_release,
+  .unlocked_ioctl = video_ioctl2,
+  .poll = vb2_fop_poll,
+  .mmap = vb2_fop_mmap,
+};
+
+/* Platform driver */
+
+/* Informs the kernel of the corresponding compatible string. */
+static const struct of_device_id prsoc_tw9912_device_ids[] = {
+  { .compatible = "prsoc,tw9912" },
+  { }
+};
+MODULE_DEVICE_TABLE(of, prsoc_tw9912_device_ids);
+
+/* Called when the last reference to the v4l2_device is dropped: the video
+ * device holds one until its last file handle is closed, which may be after
+ * remove. */
+static void tw9912_v4l2_release(struct v4l2_device *v4l2_dev)
+{
+  struct prsoc_tw9912_drvdata *drvdata =
+    container_of(v4l2_dev, struct prsoc_tw9912_drvdata, v4l2_dev);
+
+  kfree(drvdata);
+}
+
+/* Apply configuration from device tree. */
+static int configure_from_dt(struct platform_device *pdev,
+                             struct prsoc_tw9912_drvdata *drvdata)
+{
+  struct resource *rsrc;
+  void *i2c_regs;
+
+  /* Maps the addresses of the registers of the tw9912_adapter. */
+  rsrc = platform_get_resource(pdev, IORESOURCE_MEM, 0);
+  drvdata->adapter_regs = devm_ioremap_resource(&pdev->dev, rsrc);
+  if (IS_ERR(drvdata->adapter_regs))
+    return PTR_ERR(drvdata->adapter_regs);
+
+  /* Maps the addresses of the I2C master. */
+  rsrc = platform_get_resource(pdev, IORESOURCE_MEM, 1);
+  i2c_regs = devm_ioremap_resource(&pdev->dev, rsrc);
+  if (IS_ERR(i2c_regs))
+    return PTR_ERR(i2c_regs);
+
+  drvdata->i2c = i2c_inst(i2c_regs);
+
+  /* -EPROBE_DEFER until the mSGDMA driver is loaded. */
+  drvdata->dma = dma_request_slave_channel_reason(&pdev->dev, "rx");
+  if (IS_ERR(drvdata->dma))
+    return PTR_ERR(drvdata->dma);
+
+  return 0;
+}
+
+/*
+ * The following method is called when the driver is loaded.
+ * It collects information from the device tree.
+ */
+static int
+prsoc_tw9912_platform_probe(struct platform_device *pdev)
+{
+  struct prsoc_tw9912_drvdata *drvdata;
+  struct vb2_queue *q;
+  struct video_device *vdev;
+  int err;
+
+  /* Defensive programming: let's make sure this is the right device. */
+  if (!of_match_device(prsoc_tw9912_device_ids, &pdev->dev))
+    return -EINVAL;
+
+  /* Not devm: an open file handle may outlive the device. */
+  drvdata = kzalloc(sizeof(*drvdata), GFP_KERNEL);
+  if (!drvdata)
+    return -ENOMEM;
+
+  mutex_init(&drvdata->lock);
+  spin_lock_init(&drvdata->qlock);
+  INIT_LIST_HEAD(&drvdata->queued);
+  platform_set_drvdata(pdev, drvdata);
+
+  err = configure_from_dt(pdev, drvdata);
+  if (err)
+    goto err_free;
+
+  err = tw9912_configure(drvdata);
+  if (err)
+    goto err_release_dma;
+
+  err = tw9912_measure(drvdata);
+  if (err) {
+    printk(KERN_ERR "prsoc_tw9912: no video signal? (%d)\n", err);
+    goto err_release_dma;
+  }
+
+  printk(KERN_INFO "TW9912 frames are %ux%u\n", drvdata->width, drvdata->height);
+
+  drvdata->v4l2_dev.release = tw9912_v4l2_release;
+  err = v4l2_device_register(&pdev->dev, &drvdata->v4l2_dev);
+  if (err)
+    goto err_release_dma;
+
+  /* videobuf2 queue */
+  q = &drvdata->queue;
+  q->type = V4L2_BUF_TYPE_VIDEO_CAPTURE;
+  q->io_modes = VB2_MMAP | VB2_DMABUF;
+  q->drv_priv = drvdata;
+  q->buf_struct_size = sizeof(struct prsoc_tw9912_buffer);
+  q->ops = &tw9912_vb2_ops;
+  q->mem_ops = &vb2_dma_contig_memops;
+  q->timestamp_flags = V4L2_BUF_FLAG_TIMESTAMP_MONOTONIC;
+  q->min_buffers_needed = TW9912_MIN_BUFFERS;
+  q->lock = &drvdata->lock;
+  q->dev = &pdev->dev;
+
+  err = vb2_queue_init(q);
+  if (err)
+    goto err_unregister_v4l2;
+
+  /* Video device */
+  vdev = &drvdata->vdev;
+  strlcpy(vdev->name, "prsoc-tw9912", sizeof(vdev->name));
+  vdev->release = video_device_release_empty;
+  vdev->fops = &tw9912_fops;
+  vdev->ioctl_ops = &tw9912_ioctl_ops;
+  vdev->v4l2_dev = &drvdata->v4l2_dev;
+  vdev->queue = q;
+  vdev->lock = &drvdata->lock;
+  vdev->tvnorms = V4L2_STD_PAL;
+  video_set_drvdata(vdev, drvdata);
+
+  err = video_register_device(vdev, VFL_TYPE_GRABBER, -1);
+  if (err)
+    goto err_unregister_v4l2;
+
+  printk(KERN_INFO "TW9912 registered as %s\n", video_device_node_name(vdev));
+  return 0;
+
+err_unregister_v4l2:
+  v4l2_device_unregister(&drvdata->v4l2_dev);
+  dma_release_channel(drvdata->dma);
+  v4l2_device_put(&drvdata->v4l2_dev); /* frees drvdata */
+  return err;
+err_release_dma:
+  dma_release_channel(drvdata->dma);
+err_free:
+  kfree(drvdata);
+  return err;
+}
+
+static int prsoc_tw9912_platform_remove(struct platform_device *pdev)
+{
+  struct prsoc_tw9912_drvdata *drvdata = platform_get_drvdata(pdev);
+
+  /* No new ioctl from here on. */
+  video_unregister_device(&drvdata->vdev);
+
+  /* A file handle may still be open and streaming: stop it while the DMA
+   * channel and the registers are there, and free its buffers. Closing the
+   * handle later only releases the (now empty) queue again. */
+  mutex_lock(&drvdata->lock);
+  vb2_queue_release(&drvdata->queue);
+  mutex_unlock(&drvdata->lock);
+
+  v4l2_device_unregister(&drvdata->v4l2_dev);
+  dma_release_channel(drvdata->dma);
+
+  /* drvdata is freed once the last file handle is closed. */
+  v4l2_device_put(&drvdata->v4l2_dev);
+
+  return 0;
+}
+
+static struct platform_driver prsoc_tw9912_pdriver = {
+  .probe = prsoc_tw9912_platform_probe,
+  .remove = prsoc_tw9912_platform_remove,
+  .driver = {
+    .name = "prsoc-tw9912",
+    .owner = THIS_MODULE,
+    .of_match_table = prsoc_tw9912_device_ids,
+  },
+};
+
+MODULE_LICENSE("GPL");
+module_platform_driver(prsoc_tw9912_pdriver);